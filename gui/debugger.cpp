@@ -144,6 +144,7 @@ void Ep128EmuGUI_DebugWindow::activate()
   debugTabs->clear_output();
   mainTab->clear_output();
   monitorTab->clear_output();
+  stepBackButton->clear_output();
   stepIntoButton->clear_output();
   returnButton->clear_output();
   stepToButton->clear_output();
@@ -170,6 +171,7 @@ void Ep128EmuGUI_DebugWindow::deactivate(double tt)
   mainTab->set_output();
   monitorTab->set_output();
   debugTabs->set_output();
+  stepBackButton->set_output();
   stepIntoButton->set_output();
   returnButton->set_output();
   stepToButton->set_output();
@@ -522,7 +524,8 @@ void Ep128EmuGUI_DebugWindow::applyBreakPointList()
     std::string bpListText(buf);
     std::free(const_cast<char *>(buf));
     buf = (char *) 0;
-    Ep128Emu::BreakPointList  bpList(bpListText);
+    Ep128Emu::BreakPointList  bpList(bpListText,
+                                        &(gui.vm.getSymbolTable()));
     gui.vm.clearBreakPoints();
     gui.vm.setBreakPoints(bpList);
   }
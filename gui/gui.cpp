@@ -69,6 +69,7 @@ void Ep128EmuGUI::init_()
   oldDemoStatus = -1;
   oldSpeedPercentage = 100;
   oldPauseFlag = true;
+  oldWarpModeFlag = false;
   oldTapeSampleRate = -1L;
   oldTapeSampleSize = -1;
   oldFloppyDriveLEDState = 0U;
@@ -133,6 +134,10 @@ void Ep128EmuGUI::updateDisplay_windowTitle()
   if (oldPauseFlag) {
     std::sprintf(&(windowTitleBuf[0]), "ep128emu 2.0.11.2 (paused)");
   }
+  else if (oldWarpModeFlag) {
+    std::sprintf(&(windowTitleBuf[0]), "ep128emu 2.0.11.2 (warp, %d%%)",
+                 int(oldSpeedPercentage));
+  }
   else {
     std::sprintf(&(windowTitleBuf[0]), "ep128emu 2.0.11.2 (%d%%)",
                  int(oldSpeedPercentage));
@@ -286,8 +291,10 @@ void Ep128EmuGUI::updateDisplay(double t)
            mainWindow->h() != oldWindowHeight) {
     updateDisplay_windowSize();
   }
-  if (vmThreadStatus.isPaused != oldPauseFlag) {
+  if (vmThreadStatus.isPaused != oldPauseFlag ||
+      vmThreadStatus.isWarpModeOn != oldWarpModeFlag) {
     oldPauseFlag = vmThreadStatus.isPaused;
+    oldWarpModeFlag = vmThreadStatus.isWarpModeOn;
     updateDisplay_windowTitle();
   }
   int   newDemoStatus = (vmThreadStatus.isRecordingDemo ?
@@ -472,6 +479,12 @@ Fl_Menu_Item& Ep128EmuGUI::getMenuItem(int n)
   case 8:
     s = "Options/Process priority/High";
     break;
+  case 9:
+    s = "Machine/Speed/Warp while tape is running";
+    break;
+  case 10:
+    s = "Machine/Speed/Warp while disk is active";
+    break;
   default:
     throw Ep128Emu::Exception("internal error: invalid menu item number");
   }
@@ -584,6 +597,10 @@ void Ep128EmuGUI::createMenus()
                    (char *) 0, &menuCallback_Machine_Speed_200, (void *) this);
   mainMenuBar->add("Machine/Speed/400%",
                    (char *) 0, &menuCallback_Machine_Speed_400, (void *) this);
+  mainMenuBar->add("Machine/Speed/Warp while tape is running",
+                   (char *) 0, &menuCallback_Machine_WarpTape, (void *) this);
+  mainMenuBar->add("Machine/Speed/Warp while disk is active",
+                   (char *) 0, &menuCallback_Machine_WarpDisk, (void *) this);
   mainMenuBar->add("Machine/Tape/Select image file (Alt+T)",
                    (char *) 0, &menuCallback_Machine_OpenTape, (void *) this);
   mainMenuBar->add("Machine/Tape/Play (Alt+P)",
@@ -699,6 +716,10 @@ void Ep128EmuGUI::createMenus()
   getMenuItem(2).deactivate();
   // "Machine/Speed/No limit (Alt+W)"
   mainMenuBar->mode(getMenuItemIndex(3), FL_MENU_TOGGLE);
+  // "Machine/Speed/Warp while tape is running"
+  // "Machine/Speed/Warp while disk is active"
+  mainMenuBar->mode(getMenuItemIndex(9), FL_MENU_TOGGLE);
+  mainMenuBar->mode(getMenuItemIndex(10), FL_MENU_TOGGLE);
   // "Options/Process priority/Idle"
   // "Options/Process priority/Below normal"
   // "Options/Process priority/Normal"
@@ -1276,6 +1297,8 @@ void Ep128EmuGUI::applyEmulatorConfiguration(bool updateWindowFlag_)
       vmThread.setSpeedPercentage(config.vm.speedPercentage == 100U &&
                                   config.sound.enabled ?
                                   0 : int(config.vm.speedPercentage));
+      vmThread.setAutoWarpMode(config.vm.autoWarpTape,
+                               config.vm.autoWarpDisk);
       if (config.joystickSettingsChanged) {
         joystickInput.setConfiguration(config.joystick);
         config.joystickSettingsChanged = false;
@@ -1313,6 +1336,16 @@ void Ep128EmuGUI::updateMenu()
     getMenuItem(3).set();
   else
     getMenuItem(3).clear();
+  // "Machine/Speed/Warp while tape is running"
+  if (config.vm.autoWarpTape)
+    getMenuItem(9).set();
+  else
+    getMenuItem(9).clear();
+  // "Machine/Speed/Warp while disk is active"
+  if (config.vm.autoWarpDisk)
+    getMenuItem(10).set();
+  else
+    getMenuItem(10).clear();
   // "File/Record audio/Stop"
   if (config.sound.file.length() > 0)
     getMenuItem(1).activate();
@@ -1798,20 +1831,36 @@ void Ep128EmuGUI::menuCallback_File_RecordVideo(Fl_Widget *o, void *v)
   Ep128EmuGUI&  gui_ = *(reinterpret_cast<Ep128EmuGUI *>(v));
   try {
     std::string tmp;
-    if (!gui_.browseFile(tmp, gui_.soundFileDirectory, "AVI files\t*.avi",
-                         Fl_Native_File_Chooser::BROWSE_SAVE_FILE,
-                         "Record video output to AVI file")) {
+    // format 3 is a YUV4MPEG2 video file with a separate WAV file, and
+    // format 4 is a text file of frame hashes
+    const char  *filterStr = "AVI files\t*.avi";
+    const char  *titleStr = "Record video output to AVI file";
+    const char  *extStr = "avi";
+    if (gui_.config.videoCapture.format == 3) {
+      filterStr = "YUV4MPEG2 files\t*.y4m";
+      titleStr = "Record video output to Y4M and WAV file";
+      extStr = "y4m";
+    }
+    else if (gui_.config.videoCapture.format == 4) {
+      filterStr = "Text files\t*.txt";
+      titleStr = "Record frame hashes to log file";
+      extStr = "txt";
+    }
+    if (!gui_.browseFile(tmp, gui_.soundFileDirectory, filterStr,
+                         Fl_Native_File_Chooser::BROWSE_SAVE_FILE, titleStr)) {
       return;
     }
     if (tmp.length() < 1) {
       gui_.menuCallback_File_StopAVIRecord(o, v);
       return;
     }
-    Ep128Emu::addFileNameExtension(tmp, "avi");
+    Ep128Emu::addFileNameExtension(tmp, extStr);
     if (gui_.lockVMThread()) {
       try {
         gui_.vm.openVideoCapture(gui_.config.videoCapture.frameRate,
-                                 gui_.config.videoCapture.yuvFormat,
+                                 gui_.config.videoCapture.format,
+                                 gui_.config.videoCapture.hashInterval,
+                                 gui_.config.videoCapture.hashPNG,
                                  &Ep128EmuGUI::errorMessageCallback,
                                  &Ep128EmuGUI::fileNameCallback, v);
         gui_.getMenuItem(2).activate();         // "File/Record video/Stop"
@@ -1981,6 +2030,32 @@ void Ep128EmuGUI::menuCallback_Machine_Speed_400(Fl_Widget *o, void *v)
   }
 }
 
+void Ep128EmuGUI::menuCallback_Machine_WarpTape(Fl_Widget *o, void *v)
+{
+  (void) o;
+  Ep128EmuGUI&  gui_ = *(reinterpret_cast<Ep128EmuGUI *>(v));
+  try {
+    gui_.config["vm.autoWarpTape"] = !gui_.config.vm.autoWarpTape;
+    gui_.applyEmulatorConfiguration();
+  }
+  catch (std::exception& e) {
+    gui_.errorMessage(e.what());
+  }
+}
+
+void Ep128EmuGUI::menuCallback_Machine_WarpDisk(Fl_Widget *o, void *v)
+{
+  (void) o;
+  Ep128EmuGUI&  gui_ = *(reinterpret_cast<Ep128EmuGUI *>(v));
+  try {
+    gui_.config["vm.autoWarpDisk"] = !gui_.config.vm.autoWarpDisk;
+    gui_.applyEmulatorConfiguration();
+  }
+  catch (std::exception& e) {
+    gui_.errorMessage(e.what());
+  }
+}
+
 void Ep128EmuGUI::menuCallback_Machine_OpenTape(Fl_Widget *o, void *v)
 {
   (void) o;
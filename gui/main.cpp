@@ -74,6 +74,7 @@ int main(int argc, char **argv)
   const char      *cfgFileName = "ep128cfg.dat";
   Ep128Emu::File  *snapshotFile = (Ep128Emu::File *) 0;
   int       snapshotNameIndex = 0;
+  int       frameHashNameIndex = 0;
   int       colorScheme = 0;
   int8_t    machineType = -1;   // 0: EP (default), 1: ZX, 2: CPC, 3: TVC
   int8_t    retval = 0;
@@ -117,6 +118,11 @@ int main(int argc, char **argv)
           throw Ep128Emu::Exception("missing snapshot file name");
         snapshotNameIndex = i;
       }
+      else if (std::strcmp(argv[i], "-framehash") == 0) {
+        if (++i >= argc)
+          throw Ep128Emu::Exception("missing frame hash log file name");
+        frameHashNameIndex = i;
+      }
       else if (std::strcmp(argv[i], "-colorscheme") == 0) {
         if (++i >= argc)
           throw Ep128Emu::Exception("missing color scheme number");
@@ -160,6 +166,9 @@ int main(int argc, char **argv)
         std::fprintf(stderr,
                      "    -snapshot <FNAME>   "
                      "load snapshot or demo file on startup\n");
+        std::fprintf(stderr,
+                     "    -framehash <FNAME>  "
+                     "write frame hash log (see videoCapture.hash*)\n");
 #ifndef DISABLE_OPENGL_DISPLAY
         std::fprintf(stderr,
                      "    -opengl             "
@@ -355,6 +364,7 @@ int main(int argc, char **argv)
         config->loadState(argv[i], false);
       }
       else if (std::strcmp(argv[i], "-snapshot") == 0 ||
+               std::strcmp(argv[i], "-framehash") == 0 ||
                std::strcmp(argv[i], "-colorscheme") == 0) {
         i++;
       }
@@ -401,6 +411,14 @@ int main(int argc, char **argv)
       delete snapshotFile;
       snapshotFile = (Ep128Emu::File *) 0;
     }
+    if (frameHashNameIndex > 0) {
+      // start recording frame hashes from the first frame, for automated
+      // testing (the log is closed on exit)
+      vm->openVideoCapture(config->videoCapture.frameRate, 4,
+                           config->videoCapture.hashInterval,
+                           config->videoCapture.hashPNG);
+      vm->setVideoCaptureFile(argv[frameHashNameIndex]);
+    }
     vmThread = new Ep128Emu::VMThread(*vm);
     gui_ = new Ep128EmuGUI(*(dynamic_cast<Ep128Emu::VideoDisplay *>(w)),
                            *audioOutput, *vm, *vmThread, *config);
@@ -23,6 +23,7 @@
 
 #include <typeinfo>
 #include <vector>
+#include <algorithm>
 
 #define MONITOR_MAX_LINES   (160)
 
@@ -64,8 +65,20 @@ void Ep128EmuGUIMonitor::command_assemble(const std::vector<std::string>& args)
     (void) parseHexNumberEx(args[1].c_str());
     return;
   }
-  uint32_t  addr = Ep128::Z80Disassembler::assembleInstruction(
-                       args, gui->vm, cpuAddressMode, assembleOffset);
+  uint32_t  addr = 0U;
+  size_t    commentPos = 1;
+  while (commentPos < args.size() && args[commentPos] != ";")
+    commentPos++;
+  if (commentPos < args.size()) {
+    // ignore symbol names printed after the instruction
+    std::vector<std::string>  tmpArgs(args.begin(), args.begin() + commentPos);
+    addr = Ep128::Z80Disassembler::assembleInstruction(
+               tmpArgs, gui->vm, cpuAddressMode, assembleOffset);
+  }
+  else {
+    addr = Ep128::Z80Disassembler::assembleInstruction(
+               args, gui->vm, cpuAddressMode, assembleOffset);
+  }
   this->move_up();
   disassembleOffset = -assembleOffset;
   disassembleAddress = addr;
@@ -142,6 +155,11 @@ void Ep128EmuGUIMonitor::command_disassemble(const std::vector<std::string>&
       // disassemble to file
       while (true) {
         uint32_t  prvAddr = disassembleAddress;
+        uint32_t  symOffs = 0U;
+        const char  *name = gui->vm.findSymbol(symOffs, disassembleAddress,
+                                               cpuAddressMode);
+        if (name)
+          std::fprintf(f, "%s:\n", name);
         uint32_t  nextAddr = gui->vm.disassembleInstruction(tmpBuf,
                                                             disassembleAddress,
                                                             cpuAddressMode,
@@ -749,6 +767,236 @@ void Ep128EmuGUIMonitor::command_trace(const std::vector<std::string>& args)
   debugWindow->deactivate();
 }
 
+void Ep128EmuGUIMonitor::command_traceBinary(
+    const std::vector<std::string>& args)
+{
+  if (args.size() > 3)
+    throw Ep128Emu::Exception("invalid number of arguments");
+  if (args.size() < 2) {
+    if (!gui->vm.getIsRecordingTrace()) {
+      printMessage("Execution trace is not being recorded");
+      return;
+    }
+    gui->vm.closeTraceFile();
+    printMessage("Execution trace stopped");
+    return;
+  }
+  if (args[1].length() < 1 || args[1][0] != '"')
+    throw Ep128Emu::Exception("file name is not a string");
+  uint8_t   flags = 0x00;
+  if (args.size() > 2)
+    flags = uint8_t(parseHexNumberEx(args[2].c_str(), 0x03U));
+  std::string fileName(args[1].c_str() + 1);
+  std::FILE *f = (std::FILE *) 0;
+  int       err = gui->vm.openFileInWorkingDirectory(f, fileName, "wb");
+  if (err != 0) {
+    printMessage(gui->vm.getFileOpenErrorMessage(err));
+    return;
+  }
+  gui->vm.openTraceFile(f, flags);
+  printMessage("Recording execution trace, continue with X");
+}
+
+void Ep128EmuGUIMonitor::command_luaHookStats(
+    const std::vector<std::string>& args)
+{
+  if (args.size() > 1)
+    throw Ep128Emu::Exception("too many arguments");
+  bool    haveHooks = false;
+  for (int i = 0; i < 2; i++) {
+    const Ep128Emu::LuaScript::HookStats& s =
+        debugWindow->luaScript.getHookStats(i);
+    if (!s.isDefined)
+      continue;
+    haveHooks = true;
+    char    tmpBuf[128];
+    double  avgTime = s.totalTime / double(s.callCnt > 0U ? s.callCnt : 1U);
+    std::sprintf(&(tmpBuf[0]),
+                 "%s: %.0f calls, total %.3f ms, avg %.4f ms, max %.4f ms%s",
+                 (i == 0 ? "frameCallback " : "ioPortCallback"),
+                 double(s.callCnt), s.totalTime * 1000.0,
+                 avgTime * 1000.0, s.maxTime * 1000.0,
+                 (s.isDisabled ? " (disabled)" : ""));
+    printMessage(&(tmpBuf[0]));
+  }
+  if (!haveHooks)
+    printMessage("No Lua hook functions are defined");
+}
+
+void Ep128EmuGUIMonitor::command_accessStats(
+    const std::vector<std::string>& args)
+{
+  if (args.size() > 2)
+    throw Ep128Emu::Exception("too many arguments");
+  if (args.size() > 1) {
+    if (args[1].length() > 0 && args[1][0] == '"') {
+      gui->vm.saveAccessStats(args[1].c_str() + 1);
+      return;
+    }
+    bool    isEnabled = (parseHexNumberEx(args[1].c_str(), 1U) != 0U);
+    gui->vm.setAccessStatsEnabled(isEnabled);
+    if (isEnabled)
+      printMessage("Counting memory and I/O accesses, continue with X");
+    else
+      printMessage("Memory and I/O access counting stopped");
+    return;
+  }
+  if (!gui->vm.getAccessStatsEnabled()) {
+    printMessage("Memory and I/O accesses are not being counted");
+    return;
+  }
+  // print the 256 byte blocks and I/O ports with the most accesses
+  std::vector< std::pair< uint64_t, uint32_t > >  tmp;
+  for (uint32_t addr = 0U; addr < 0x00400000U; addr += 0x0100U) {
+    uint64_t  r, w, x;
+    gui->vm.getMemoryAccessStats(addr, r, w, x);
+    if ((r | w | x) != 0U)
+      tmp.push_back(std::pair< uint64_t, uint32_t >(r + w + x, addr));
+  }
+  std::sort(tmp.begin(), tmp.end());
+  char    tmpBuf[64];
+  printMessage("Block        reads     writes   executes");
+  for (size_t i = 0; i < tmp.size() && i < 10; i++) {
+    uint64_t  r, w, x;
+    uint32_t  addr = tmp[tmp.size() - (i + 1)].second;
+    gui->vm.getMemoryAccessStats(addr, r, w, x);
+    std::sprintf(&(tmpBuf[0]), "%06X %10.0f %10.0f %10.0f",
+                 (unsigned int) addr, double(r), double(w), double(x));
+    printMessage(&(tmpBuf[0]));
+  }
+  tmp.clear();
+  for (uint16_t addr = 0; addr < 0x0100; addr++) {
+    uint64_t  r, w;
+    gui->vm.getIOPortAccessStats(addr, r, w);
+    if ((r | w) != 0U)
+      tmp.push_back(std::pair< uint64_t, uint32_t >(r + w, addr));
+  }
+  std::sort(tmp.begin(), tmp.end());
+  printMessage("Port         reads     writes");
+  for (size_t i = 0; i < tmp.size() && i < 6; i++) {
+    uint64_t  r, w;
+    uint16_t  addr = uint16_t(tmp[tmp.size() - (i + 1)].second);
+    gui->vm.getIOPortAccessStats(addr, r, w);
+    std::sprintf(&(tmpBuf[0]), "%02X     %10.0f %10.0f",
+                 (unsigned int) addr, double(r), double(w));
+    printMessage(&(tmpBuf[0]));
+  }
+}
+
+void Ep128EmuGUIMonitor::command_reverseDebug(
+    const std::vector<std::string>& args)
+{
+  if (args.size() > 4)
+    throw Ep128Emu::Exception("too many arguments");
+  if (args.size() > 1) {
+    bool    isEnabled = (parseHexNumberEx(args[1].c_str(), 1U) != 0U);
+    double  checkpointInterval = 0.1;
+    size_t  maxMemoryMB = 64;
+    if (args.size() > 2) {
+      checkpointInterval =
+          double(parseHexNumberEx(args[2].c_str(), 0xFFFFU)) * 0.001;
+    }
+    if (args.size() > 3)
+      maxMemoryMB = size_t(parseHexNumberEx(args[3].c_str(), 0xFFFFU));
+    try {
+      gui->vm.setReverseDebugEnabled(isEnabled,
+                                     checkpointInterval, maxMemoryMB);
+    }
+    catch (std::exception& e) {
+      printMessage(e.what());
+      return;
+    }
+  }
+  if (gui->vm.getReverseDebugEnabled())
+    printMessage("Recording execution history for ZB, XB, and WB");
+  else
+    printMessage("Execution history is not being recorded");
+}
+
+void Ep128EmuGUIMonitor::command_reverseExecute(
+    const std::vector<std::string>& args)
+{
+  int       mode = 0;
+  uint32_t  addr = 0U;
+  if (args[0] == "WB") {
+    if (args.size() != 2)
+      throw Ep128Emu::Exception("invalid number of arguments");
+    mode = 2;
+    addr = parseHexNumberEx(args[1].c_str(), addressMask);
+    if (cpuAddressMode) {
+      addr = (uint32_t(gui->vm.getMemoryPage(int(addr >> 14))) << 14)
+             | (addr & 0x3FFFU);
+    }
+  }
+  else {
+    if (args.size() > 1)
+      throw Ep128Emu::Exception("too many arguments");
+    mode = (args[0] == "XB" ? 1 : 0);
+  }
+  try {
+    gui->vm.reverseExecute(mode, addr);
+  }
+  catch (std::exception& e) {
+    printMessage(e.what());
+    return;
+  }
+  debugWindow->focusWidget = this;
+  debugWindow->deactivate();
+}
+
+void Ep128EmuGUIMonitor::command_symbols(
+    const std::vector<std::string>& args)
+{
+  Ep128Emu::SymbolTable&  symbols = gui->vm.getSymbolTable();
+  char      tmpBuf[64];
+  if (args.size() > 1 && args[1] == "*") {
+    if (args.size() > 2)
+      throw Ep128Emu::Exception("too many arguments");
+    symbols.clear();
+  }
+  else if (args.size() > 1 && args[1].length() > 0 && args[1][0] == '"') {
+    if (args.size() > 3)
+      throw Ep128Emu::Exception("too many arguments");
+    int     segment = -1;
+    if (args.size() > 2)
+      segment = int(parseHexNumberEx(args[2].c_str(), 0xFFU));
+    try {
+      size_t  n = gui->vm.loadSymbolFile(args[1].c_str() + 1, segment);
+      std::sprintf(&(tmpBuf[0]), "Loaded %lu symbol(s)", (unsigned long) n);
+      printMessage(&(tmpBuf[0]));
+    }
+    catch (std::exception& e) {
+      printMessage(e.what());
+      return;
+    }
+  }
+  else if (args.size() > 1) {
+    // the tokenizer splits names at '.' and '@', so join all arguments
+    std::string name;
+    for (size_t i = 1; i < args.size(); i++)
+      name += args[i];
+    uint32_t  addr = 0U;
+    bool      isCPUAddress = false;
+    if (!symbols.findAddress(addr, isCPUAddress, name)) {
+      printMessage("Symbol is not defined");
+      return;
+    }
+    if (isCPUAddress) {
+      std::sprintf(&(tmpBuf[0]), "%04X", (unsigned int) addr);
+    }
+    else {
+      std::sprintf(&(tmpBuf[0]), "%02X:%04X (%06X)",
+                   (unsigned int) (addr >> 14),
+                   (unsigned int) (addr & 0x3FFFU), (unsigned int) addr);
+    }
+    printMessage(&(tmpBuf[0]));
+    return;
+  }
+  std::sprintf(&(tmpBuf[0]), "%lu symbol(s) defined",
+               (unsigned long) symbols.size());
+  printMessage(&(tmpBuf[0]));
+}
+
 void Ep128EmuGUIMonitor::command_load(const std::vector<std::string>& args,
                                       bool verifyMode)
 {
@@ -860,17 +1108,25 @@ void Ep128EmuGUIMonitor::command_help(const std::vector<std::string>& args)
     printMessage("I       print current settings");
     printMessage("IO      dump I/O registers");
     printMessage("L       load binary or ASCII file to memory");
+    printMessage("LH      print Lua hook statistics");
     printMessage("M       dump memory");
+    printMessage("MS      memory and I/O access statistics");
     printMessage("O       modify I/O registers");
     printMessage("R       print CPU registers");
+    printMessage("RV      enable/disable reverse execution");
     printMessage("S       save memory to binary or ASCII file");
     printMessage("SR      search and replace pattern in memory");
+    printMessage("SY      load or look up symbols");
     printMessage("T       copy memory");
+    printMessage("TB      record binary execution trace");
     printMessage("TR      trace (log instructions to file)");
     printMessage("V       verify (compare memory and file)");
+    printMessage("WB      go back to the last write to address");
     printMessage("X       continue");
+    printMessage("XB      go back to the previous breakpoint");
     printMessage("Y       step over");
     printMessage("Z       step");
+    printMessage("ZB      step back");
   }
   else if (args[1] == "." || args[1] == "A") {
     printMessage("A <address> ...");
@@ -933,15 +1189,37 @@ void Ep128EmuGUIMonitor::command_help(const std::vector<std::string>& args)
     printMessage("L <\"filename\"> <asciiMode> <start> [end]");
     printMessage("'asciiMode' is 0 for binary, and 1 for text");
   }
+  else if (args[1] == "LH") {
+    printMessage("LH      print the number of calls and the time");
+    printMessage("spent in the frameCallback and ioPortCallback");
+    printMessage("functions of the Lua script");
+  }
   else if (args[1] == "M") {
     printMessage("M [start [end]]");
   }
+  else if (args[1] == "MS") {
+    printMessage("MS 1    start counting memory and I/O accesses");
+    printMessage("MS 0    stop counting and discard the data");
+    printMessage("MS      print the most accessed 256 byte");
+    printMessage("        memory blocks and I/O ports");
+    printMessage("MS <\"filename\"> save all counts to file");
+  }
   else if (args[1] == "O") {
     printMessage("O<address> [value1 [value2 [...]]]");
   }
   else if (args[1] == "R") {
     printMessage("R       print CPU registers");
   }
+  else if (args[1] == "RV") {
+    printMessage("RV 1 [interval [maxMB]]");
+    printMessage("        record execution history, taking a");
+    printMessage("        snapshot every 'interval' ms (default:");
+    printMessage("        64 hex = 100 ms) and keeping at most");
+    printMessage("        'maxMB' megabytes (default: 40 hex)");
+    printMessage("RV 0    stop recording and discard history");
+    printMessage("Mouse, tape, disk, and clock input, and changes");
+    printMessage("made in the debugger are not replayed");
+  }
   else if (args[1] == "S") {
     printMessage("S <\"filename\"> <asciiMode> <start> <end>");
     printMessage("'asciiMode' is 0 for binary, and 1 for text");
@@ -954,6 +1232,14 @@ void Ep128EmuGUIMonitor::command_help(const std::vector<std::string>& args)
     printMessage("     *  match any single byte / no change");
     printMessage(" \"str\"  string (bit mask = 7F)");
   }
+  else if (args[1] == "SY") {
+    printMessage("SY <\"filename\"> [segment]");
+    printMessage("        load symbol file; 16-bit values are");
+    printMessage("        offsets into 'segment' if specified");
+    printMessage("SY <name>  print the address of a symbol");
+    printMessage("SY *    delete all symbols");
+    printMessage("SY      print the number of symbols");
+  }
   else if (args[1] == "T") {
     printMessage("T <srcStart> <srcEnd> <dstStart>");
   }
@@ -964,19 +1250,39 @@ void Ep128EmuGUIMonitor::command_help(const std::vector<std::string>& args)
     printMessage("flags is an 8-bit value that enables the printing");
     printMessage("of [X,Y], AF, BC, DE, HL, SP, segment, and opcode");
   }
+  else if (args[1] == "TB") {
+    printMessage("TB <\"filename\"> [flags]");
+    printMessage("TB      stop recording the trace");
+    printMessage("flags is 1 to also record memory accesses,");
+    printMessage("2 for I/O ports, and 3 for both; the file");
+    printMessage("can be processed with the tracedis utility");
+  }
   else if (args[1] == "V") {
     printMessage("V <\"filename\"> <asciiMode> <start> [end]");
     printMessage("'asciiMode' is 0 for binary, and 1 for text");
   }
+  else if (args[1] == "WB") {
+    printMessage("WB <address>");
+    printMessage("        go back to the last instruction that");
+    printMessage("        wrote 'address' (requires RV 1)");
+  }
   else if (args[1] == "X") {
     printMessage("X       continue emulation");
   }
+  else if (args[1] == "XB") {
+    printMessage("XB      go back to the last instruction that");
+    printMessage("        triggered a breakpoint (requires RV 1)");
+  }
   else if (args[1] == "Y") {
     printMessage("Y       step one instruction with step over");
   }
   else if (args[1] == "Z") {
     printMessage("Z       step one CPU instruction");
   }
+  else if (args[1] == "ZB") {
+    printMessage("ZB      step back one CPU instruction");
+    printMessage("        (requires RV 1)");
+  }
   else {
     printMessage("Unknown command name");
   }
@@ -1062,22 +1368,34 @@ void Ep128EmuGUIMonitor::parseCommand(const char *s)
     command_ioDump(args);
   else if (args[0] == "L")
     command_load(args, false);
+  else if (args[0] == "LH")
+    command_luaHookStats(args);
   else if (args[0] == "M")
     command_memoryDump(args);
+  else if (args[0] == "MS")
+    command_accessStats(args);
   else if (args[0] == "O")
     command_ioModify(args);
   else if (args[0] == "R")
     command_printRegisters(args);
+  else if (args[0] == "RV")
+    command_reverseDebug(args);
   else if (args[0] == "S")
     command_save(args);
   else if (args[0] == "SR")
     command_searchAndReplace(args);
+  else if (args[0] == "SY")
+    command_symbols(args);
   else if (args[0] == "T")
     command_memoryCopy(args);
+  else if (args[0] == "TB")
+    command_traceBinary(args);
   else if (args[0] == "TR")
     command_trace(args);
   else if (args[0] == "V")
     command_load(args, true);
+  else if (args[0] == "WB" || args[0] == "XB" || args[0] == "ZB")
+    command_reverseExecute(args);
   else if (args[0] == "X")
     command_continue(args);
   else if (args[0] == "Y")
@@ -1118,6 +1436,16 @@ void Ep128EmuGUIMonitor::disassembleInstruction(bool assembleMode)
 {
   disassembleAddress = disassembleAddress & addressMask;
   std::string tmpBuf;
+  if (!assembleMode) {
+    uint32_t    symOffs = 0U;
+    const char  *name = gui->vm.findSymbol(symOffs, disassembleAddress,
+                                           cpuAddressMode);
+    if (name) {
+      tmpBuf = name;
+      tmpBuf += ':';
+      printMessage(tmpBuf.c_str());
+    }
+  }
   uint32_t  nextAddr = gui->vm.disassembleInstruction(tmpBuf,
                                                       disassembleAddress,
                                                       cpuAddressMode,
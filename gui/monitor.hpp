@@ -64,6 +64,12 @@ class Ep128EmuGUIMonitor : public Fl_Text_Editor {
   void command_step(const std::vector<std::string>& args);
   void command_stepOver(const std::vector<std::string>& args);
   void command_trace(const std::vector<std::string>& args);
+  void command_traceBinary(const std::vector<std::string>& args);
+  void command_luaHookStats(const std::vector<std::string>& args);
+  void command_accessStats(const std::vector<std::string>& args);
+  void command_reverseDebug(const std::vector<std::string>& args);
+  void command_reverseExecute(const std::vector<std::string>& args);
+  void command_symbols(const std::vector<std::string>& args);
   void command_load(const std::vector<std::string>& args,
                     bool verifyMode = false);
   void command_save(const std::vector<std::string>& args);
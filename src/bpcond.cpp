@@ -0,0 +1,396 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "z80/z80.hpp"
+#include "vm.hpp"
+#include "bpcond.hpp"
+
+namespace Ep128Emu {
+
+  // stack machine instructions
+  enum {
+    BPC_CONST = 0,              // push the next code word
+    BPC_REG,                    // push register (bits 8 to 15 of opcode)
+    BPC_PEEK,
+    BPC_PEEKW,
+    BPC_SEG,
+    BPC_NEG,
+    BPC_NOT,
+    BPC_LNOT,
+    // binary operators, in the order of operatorTable[] below
+    BPC_MUL,
+    BPC_DIV,
+    BPC_MOD,
+    BPC_ADD,
+    BPC_SUB,
+    BPC_SHL,
+    BPC_SHR,
+    BPC_LE,
+    BPC_LT,
+    BPC_GE,
+    BPC_GT,
+    BPC_EQ,
+    BPC_NE,
+    BPC_LAND,
+    BPC_AND,
+    BPC_XOR,
+    BPC_LOR,
+    BPC_OR
+  };
+
+  // operands selected by BPC_REG
+  enum {
+    BPC_REG_A = 0, BPC_REG_F, BPC_REG_B, BPC_REG_C, BPC_REG_D, BPC_REG_E,
+    BPC_REG_H, BPC_REG_L, BPC_REG_AF, BPC_REG_BC, BPC_REG_DE, BPC_REG_HL,
+    BPC_REG_AF_, BPC_REG_BC_, BPC_REG_DE_, BPC_REG_HL_, BPC_REG_SP,
+    BPC_REG_PC, BPC_REG_IX, BPC_REG_IY, BPC_REG_IXH, BPC_REG_IXL,
+    BPC_REG_IYH, BPC_REG_IYL, BPC_REG_I, BPC_REG_R, BPC_REG_IM,
+    BPC_REG_IFF1, BPC_REG_IFF2, BPC_VAR_TYPE, BPC_VAR_ADDR, BPC_VAR_VALUE
+  };
+
+  static const char *operandNames[32] = {
+    "A", "F", "B", "C", "D", "E", "H", "L", "AF", "BC", "DE", "HL",
+    "AF'", "BC'", "DE'", "HL'", "SP", "PC", "IX", "IY", "IXH", "IXL",
+    "IYH", "IYL", "I", "R", "IM", "IFF1", "IFF2", "TYPE", "ADDR", "VALUE"
+  };
+
+  struct BPCOperator {
+    const char  *name;
+    int         prec;
+    uint32_t    opcode;
+  };
+
+  // longer operators must be listed before their prefixes
+  static const BPCOperator operatorTable[] = {
+    { "*",  10, BPC_MUL },
+    { "/",  10, BPC_DIV },
+    { "%",  10, BPC_MOD },
+    { "+",  9,  BPC_ADD },
+    { "-",  9,  BPC_SUB },
+    { "<<", 8,  BPC_SHL },
+    { ">>", 8,  BPC_SHR },
+    { "<=", 7,  BPC_LE },
+    { "<",  7,  BPC_LT },
+    { ">=", 7,  BPC_GE },
+    { ">",  7,  BPC_GT },
+    { "==", 6,  BPC_EQ },
+    { "!=", 6,  BPC_NE },
+    { "&&", 2,  BPC_LAND },
+    { "&",  5,  BPC_AND },
+    { "^",  4,  BPC_XOR },
+    { "||", 1,  BPC_LOR },
+    { "|",  3,  BPC_OR },
+    { (char *) 0, 0, 0 }
+  };
+
+  static void skipSpace(const std::string& s, size_t& pos)
+  {
+    while (pos < s.length() &&
+           (s[pos] == ' ' || s[pos] == '\t' ||
+            s[pos] == '\r' || s[pos] == '\n')) {
+      pos++;
+    }
+  }
+
+  static inline bool isNameChar(char c)
+  {
+    return ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+            (c >= '0' && c <= '9') || c == '_' || c == '\'');
+  }
+
+  static inline void pushDepth(size_t& depth, size_t& maxDepth)
+  {
+    if (++depth > maxDepth) {
+      maxDepth = depth;
+      if (maxDepth > BreakPointCondition::maxStackDepth)
+        throw Exception("breakpoint condition is too complex");
+    }
+  }
+
+  // --------------------------------------------------------------------------
+
+  BreakPointCondition::BreakPointCondition(const std::string& s)
+    : exprString(s)
+  {
+    size_t  pos = 0;
+    size_t  depth = 0;
+    size_t  maxDepth = 0;
+    compileExpression_(s, pos, 1, depth, maxDepth);
+    skipSpace(s, pos);
+    if (pos < s.length())
+      throw Exception("syntax error in breakpoint condition");
+  }
+
+  BreakPointCondition::~BreakPointCondition()
+  {
+  }
+
+  void BreakPointCondition::compileOperand_(const std::string& s, size_t& pos,
+                                            size_t& depth, size_t& maxDepth)
+  {
+    skipSpace(s, pos);
+    if (pos >= s.length())
+      throw Exception("syntax error in breakpoint condition");
+    char    c = s[pos];
+    if (c == '(') {
+      pos++;
+      compileExpression_(s, pos, 1, depth, maxDepth);
+      skipSpace(s, pos);
+      if (pos >= s.length() || s[pos] != ')')
+        throw Exception("missing ')' in breakpoint condition");
+      pos++;
+      return;
+    }
+    if (c == '-' || c == '~' || c == '!') {
+      pos++;
+      compileOperand_(s, pos, depth, maxDepth);
+      code.push_back(c == '-' ? BPC_NEG : (c == '~' ? BPC_NOT : BPC_LNOT));
+      return;
+    }
+    if ((c >= '0' && c <= '9') || c == '$') {
+      uint32_t  n = 0U;
+      uint32_t  base = 10U;
+      size_t    nDigits = 0;
+      if (c == '$') {
+        base = 16U;
+        pos++;
+      }
+      else if (c == '0' && (pos + 1) < s.length() &&
+               (s[pos + 1] == 'x' || s[pos + 1] == 'X')) {
+        base = 16U;
+        pos = pos + 2;
+      }
+      for ( ; pos < s.length(); pos++, nDigits++) {
+        char      d = s[pos];
+        uint32_t  digit = base;
+        if (d >= '0' && d <= '9')
+          digit = uint32_t(d - '0');
+        else if (d >= 'A' && d <= 'F')
+          digit = uint32_t(d - 'A') + 10U;
+        else if (d >= 'a' && d <= 'f')
+          digit = uint32_t(d - 'a') + 10U;
+        if (digit >= base)
+          break;
+        n = (n * base) + digit;
+      }
+      if (nDigits < 1 || (pos < s.length() && isNameChar(s[pos])))
+        throw Exception("invalid number in breakpoint condition");
+      code.push_back(BPC_CONST);
+      code.push_back(n);
+      pushDepth(depth, maxDepth);
+      return;
+    }
+    std::string name;
+    while (pos < s.length() && isNameChar(s[pos])) {
+      char    d = s[pos++];
+      if (d >= 'a' && d <= 'z')
+        d = d - ('a' - 'A');
+      name += d;
+    }
+    if (name.length() < 1)
+      throw Exception("syntax error in breakpoint condition");
+    if (name == "PEEK" || name == "PEEKW" || name == "SEG") {
+      skipSpace(s, pos);
+      if (pos >= s.length() || s[pos] != '(')
+        throw Exception("missing '(' in breakpoint condition");
+      compileOperand_(s, pos, depth, maxDepth);
+      code.push_back(name == "PEEK" ?
+                     BPC_PEEK : (name == "PEEKW" ? BPC_PEEKW : BPC_SEG));
+      return;
+    }
+    for (uint32_t i = 0U; i < 32U; i++) {
+      if (name == operandNames[i]) {
+        code.push_back(BPC_REG | (i << 8));
+        pushDepth(depth, maxDepth);
+        return;
+      }
+    }
+    throw Exception("invalid name in breakpoint condition");
+  }
+
+  void BreakPointCondition::compileExpression_(const std::string& s,
+                                               size_t& pos, int minPrec,
+                                               size_t& depth, size_t& maxDepth)
+  {
+    compileOperand_(s, pos, depth, maxDepth);
+    while (true) {
+      skipSpace(s, pos);
+      const BPCOperator *op = (BPCOperator *) 0;
+      for (size_t i = 0; operatorTable[i].name; i++) {
+        if (s.compare(pos, std::strlen(operatorTable[i].name),
+                      operatorTable[i].name) == 0) {
+          op = &(operatorTable[i]);
+          break;
+        }
+      }
+      if (!op || op->prec < minPrec)
+        return;
+      pos = pos + std::strlen(op->name);
+      // all binary operators are left associative
+      compileExpression_(s, pos, op->prec + 1, depth, maxDepth);
+      code.push_back(op->opcode);
+      depth--;
+    }
+  }
+
+  bool BreakPointCondition::evaluate(const VirtualMachine& vm,
+                                     int type, uint16_t addr,
+                                     uint8_t value) const
+  {
+    const Ep128::Z80_REGISTERS& r = vm.getZ80Registers();
+    int32_t   stack[maxStackDepth + 1];
+    int32_t   *sp = &(stack[0]);
+    const uint32_t  *ip = &(code.front());
+    const uint32_t  *endp = ip + code.size();
+    while (ip < endp) {
+      uint32_t  op = *(ip++);
+      switch (op & 0xFFU) {
+      case BPC_CONST:
+        *(++sp) = int32_t(*(ip++));
+        break;
+      case BPC_REG:
+        {
+          int32_t tmp = 0;
+          switch (op >> 8) {
+          case BPC_REG_A:     tmp = r.AF.B.h;                 break;
+          case BPC_REG_F:     tmp = r.AF.B.l;                 break;
+          case BPC_REG_B:     tmp = r.BC.B.h;                 break;
+          case BPC_REG_C:     tmp = r.BC.B.l;                 break;
+          case BPC_REG_D:     tmp = r.DE.B.h;                 break;
+          case BPC_REG_E:     tmp = r.DE.B.l;                 break;
+          case BPC_REG_H:     tmp = r.HL.B.h;                 break;
+          case BPC_REG_L:     tmp = r.HL.B.l;                 break;
+          case BPC_REG_AF:    tmp = r.AF.W;                   break;
+          case BPC_REG_BC:    tmp = r.BC.W;                   break;
+          case BPC_REG_DE:    tmp = r.DE.W;                   break;
+          case BPC_REG_HL:    tmp = r.HL.W;                   break;
+          case BPC_REG_AF_:   tmp = r.altAF.W;                break;
+          case BPC_REG_BC_:   tmp = r.altBC.W;                break;
+          case BPC_REG_DE_:   tmp = r.altDE.W;                break;
+          case BPC_REG_HL_:   tmp = r.altHL.W;                break;
+          case BPC_REG_SP:    tmp = r.SP.W;                   break;
+          case BPC_REG_PC:    tmp = r.PC.W.l;                 break;
+          case BPC_REG_IX:    tmp = r.IX.W;                   break;
+          case BPC_REG_IY:    tmp = r.IY.W;                   break;
+          case BPC_REG_IXH:   tmp = r.IX.B.h;                 break;
+          case BPC_REG_IXL:   tmp = r.IX.B.l;                 break;
+          case BPC_REG_IYH:   tmp = r.IY.B.h;                 break;
+          case BPC_REG_IYL:   tmp = r.IY.B.l;                 break;
+          case BPC_REG_I:     tmp = r.I;                      break;
+          case BPC_REG_R:     tmp = (r.RBit7 & 0x80) | (r.R & 0x7F);  break;
+          case BPC_REG_IM:    tmp = r.IM;                     break;
+          case BPC_REG_IFF1:  tmp = int32_t(bool(r.IFF1));    break;
+          case BPC_REG_IFF2:  tmp = int32_t(bool(r.IFF2));    break;
+          case BPC_VAR_TYPE:  tmp = type;                     break;
+          case BPC_VAR_ADDR:  tmp = addr;                     break;
+          case BPC_VAR_VALUE: tmp = value;                    break;
+          }
+          *(++sp) = tmp;
+        }
+        break;
+      case BPC_PEEK:
+        *sp = vm.readMemory(uint32_t(*sp) & 0xFFFFU, true);
+        break;
+      case BPC_PEEKW:
+        *sp = int32_t(vm.readMemory(uint32_t(*sp) & 0xFFFFU, true))
+              | (int32_t(vm.readMemory(uint32_t(*sp + 1) & 0xFFFFU, true))
+                 << 8);
+        break;
+      case BPC_SEG:
+        *sp = vm.getMemoryPage(int((uint32_t(*sp) >> 14) & 3U));
+        break;
+      case BPC_NEG:
+        *sp = int32_t(0U - uint32_t(*sp));
+        break;
+      case BPC_NOT:
+        *sp = ~(*sp);
+        break;
+      case BPC_LNOT:
+        *sp = int32_t(!(*sp));
+        break;
+      default:
+        {
+          int32_t b = *(sp--);
+          int32_t a = *sp;
+          switch (op) {
+          case BPC_MUL:
+            a = int32_t(uint32_t(a) * uint32_t(b));
+            break;
+          case BPC_DIV:
+            a = (b != 0 && !(b == -1 && a < -0x7FFFFFFF) ? (a / b) : 0);
+            break;
+          case BPC_MOD:
+            a = (b != 0 && !(b == -1 && a < -0x7FFFFFFF) ? (a % b) : 0);
+            break;
+          case BPC_ADD:
+            a = int32_t(uint32_t(a) + uint32_t(b));
+            break;
+          case BPC_SUB:
+            a = int32_t(uint32_t(a) - uint32_t(b));
+            break;
+          case BPC_SHL:
+            a = int32_t(uint32_t(a) << (b & 31));
+            break;
+          case BPC_SHR:
+            a = a >> (b & 31);
+            break;
+          case BPC_LE:
+            a = int32_t(a <= b);
+            break;
+          case BPC_LT:
+            a = int32_t(a < b);
+            break;
+          case BPC_GE:
+            a = int32_t(a >= b);
+            break;
+          case BPC_GT:
+            a = int32_t(a > b);
+            break;
+          case BPC_EQ:
+            a = int32_t(a == b);
+            break;
+          case BPC_NE:
+            a = int32_t(a != b);
+            break;
+          case BPC_LAND:
+            a = int32_t(a != 0 && b != 0);
+            break;
+          case BPC_AND:
+            a = a & b;
+            break;
+          case BPC_XOR:
+            a = a ^ b;
+            break;
+          case BPC_LOR:
+            a = int32_t(a != 0 || b != 0);
+            break;
+          case BPC_OR:
+            a = a | b;
+            break;
+          }
+          *sp = a;
+        }
+        break;
+      }
+    }
+    return (*sp != 0);
+  }
+
+}       // namespace Ep128Emu
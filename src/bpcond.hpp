@@ -0,0 +1,89 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_BPCOND_HPP
+#define EP128EMU_BPCOND_HPP
+
+#include "ep128emu.hpp"
+
+#include <vector>
+
+namespace Ep128Emu {
+
+  class VirtualMachine;
+
+  /*!
+   * Breakpoint condition expression, compiled to a simple stack machine
+   * code so that it can be evaluated quickly every time the breakpoint is
+   * triggered. The syntax is similar to C expressions, with these operands
+   * (all names are case insensitive):
+   *   123, 0x7B, $7B   decimal or hexadecimal integer constant
+   *   A, F, B, C, D, E, H, L, AF, BC, DE, HL, AF', BC', DE', HL', SP, PC,
+   *   IX, IY, IXH, IXL, IYH, IYL, I, R, IM, IFF1, IFF2
+   *                    Z80 registers
+   *   TYPE             breakpoint type (0: opcode read, 1: memory read,
+   *                    2: memory write, 5: I/O read, 6: I/O write)
+   *   ADDR             16-bit address that triggered the breakpoint
+   *   VALUE            the value being read or written
+   *   PEEK(n)          byte at CPU address n
+   *   PEEKW(n)         16-bit little endian word at CPU address n
+   *   SEG(n)           segment mapped to the page of CPU address n
+   * and operators, in decreasing order of precedence:
+   *   unary - ~ !, * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||
+   * Integer arithmetic is 32-bit signed, division by zero returns zero.
+   * The breakpoint is triggered if the result is non-zero.
+   * Example: HL == 0x4000 && (A & 0x80)
+   */
+  class BreakPointCondition {
+   public:
+    static const size_t maxStackDepth = 32;
+   private:
+    std::vector< uint32_t > code;
+    std::string exprString;
+    // --------
+    void compileExpression_(const std::string& s, size_t& pos, int minPrec,
+                            size_t& depth, size_t& maxDepth);
+    void compileOperand_(const std::string& s, size_t& pos,
+                         size_t& depth, size_t& maxDepth);
+   public:
+    /*!
+     * Compile expression 's'. Ep128Emu::Exception is thrown on syntax
+     * errors.
+     */
+    BreakPointCondition(const std::string& s);
+    virtual ~BreakPointCondition();
+    /*!
+     * Evaluate the expression using the current state of 'vm', and the
+     * breakpoint type, address, and value. Returns true if the breakpoint
+     * should be triggered.
+     */
+    bool evaluate(const VirtualMachine& vm,
+                  int type, uint16_t addr, uint8_t value) const;
+    /*!
+     * Returns the original expression string.
+     */
+    inline const std::string& getExpression() const
+    {
+      return exprString;
+    }
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_BPCOND_HPP
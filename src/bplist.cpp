@@ -19,6 +19,8 @@
 
 #include "ep128emu.hpp"
 #include "bplist.hpp"
+#include "bpcond.hpp"
+#include "symtab.hpp"
 
 #include <map>
 #include <sstream>
@@ -29,7 +31,9 @@ namespace Ep128Emu {
 
   BreakPoint::BreakPoint(bool isIO_, bool haveSegment_,
                          bool r_, bool w_, bool x_, bool ignoreFlag_,
-                         uint8_t segment_, uint16_t addr_, int priority_)
+                         uint8_t segment_, uint16_t addr_, int priority_,
+                         const std::string& cond)
+    : cond_(cond)
   {
     n_ = (r_ ? 0x01000000U : 0x00000000U)
          | (w_ ? 0x02000000U : 0x00000000U)
@@ -53,19 +57,73 @@ namespace Ep128Emu {
     }
   }
 
-  BreakPointList::BreakPointList(const std::string& lst)
+  // replace symbol names in square brackets with hexadecimal addresses
+
+  static std::string replaceBreakPointSymbols(const std::string& lst,
+                                              const SymbolTable *symbols)
+  {
+    std::string s;
+    bool        inCondition = false;
+    for (size_t i = 0; i < lst.length(); i++) {
+      char    ch = lst[i];
+      if (ch == '{' || ch == '}')
+        inCondition = (ch == '{');
+      if (ch != '[' || inCondition) {
+        s += ch;
+        continue;
+      }
+      size_t  j = lst.find(']', i);
+      if (j == std::string::npos)
+        throw Exception("syntax error in breakpoint list");
+      std::string name(lst, i + 1, j - (i + 1));
+      uint32_t  addr = 0U;
+      bool      isCPUAddress = false;
+      if (!symbols)
+        throw Exception("symbol names are not allowed in breakpoint list");
+      if (!symbols->findAddress(addr, isCPUAddress, name))
+        throw Exception("undefined symbol in breakpoint list");
+      char    tmpBuf[16];
+      if (isCPUAddress) {
+        std::sprintf(&(tmpBuf[0]), "%04X", (unsigned int) addr);
+      }
+      else if (i > 0 && lst[i - 1] == '-') {
+        // end of segment:offset range
+        std::sprintf(&(tmpBuf[0]), "%04X", (unsigned int) (addr & 0x3FFFU));
+      }
+      else {
+        std::sprintf(&(tmpBuf[0]), "%02X:%04X", (unsigned int) (addr >> 14),
+                     (unsigned int) (addr & 0x3FFFU));
+      }
+      s += &(tmpBuf[0]);
+      i = j;
+    }
+    return s;
+  }
+
+  BreakPointList::BreakPointList(const std::string& lstText,
+                                 const SymbolTable *symbols)
   {
     std::map<uint32_t, BreakPoint>  bpList;
     std::string curToken = "";
+    bool        inCondition = false;
+    std::string lst;
 
+    if (lstText.find('[') == std::string::npos)
+      lst = lstText;
+    else
+      lst = replaceBreakPointSymbols(lstText, symbols);
     for (size_t i = 0; i < lst.length(); i++) {
       {
         char    ch = lst[i];
-        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+        if ((ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') &&
+            !inCondition) {
           if (curToken.length() < 1)
             continue;
         }
         else {
+          // whitespace is allowed in condition expressions
+          if (ch == '{' || ch == '}')
+            inCondition = (ch == '{');
           curToken += ch;
           if ((i + 1) < lst.length())
             continue;
@@ -78,6 +136,7 @@ namespace Ep128Emu {
       bool      isRead = false, isWrite = false, isExecute = false;
       bool      isIgnore = false;
       int       priority = -1;
+      std::string cond;
       uint32_t  n;
 
       n = 0;
@@ -167,6 +226,18 @@ namespace Ep128Emu {
             throw Exception("syntax error in breakpoint list");
           priority = int(curToken[j] - '0');
           break;
+        case '{':
+          if (curToken[curToken.length() - 1] != '}' ||
+              (j + 2) >= curToken.length()) {
+            throw Exception("syntax error in breakpoint list");
+          }
+          cond.assign(curToken, j + 1, curToken.length() - (j + 2));
+          {
+            // check syntax
+            BreakPointCondition tmp(cond);
+          }
+          j = curToken.length() - 1;
+          break;
         default:
           throw Exception("syntax error in breakpoint list");
         }
@@ -174,9 +245,11 @@ namespace Ep128Emu {
       if (isIgnore) {
         if (isIO)
           throw Exception("ignore flag is not allowed for I/O breakpoints");
-        if (isRead || isWrite || isExecute || priority >= 0)
-          throw Exception("read/write flags and priority are not allowed "
-                          "for ignore breakpoints");
+        if (isRead || isWrite || isExecute || priority >= 0 ||
+            cond.length() > 0) {
+          throw Exception("read/write flags, priority, and condition are "
+                          "not allowed for ignore breakpoints");
+        }
         priority = 0;
       }
       else if (isIO && isExecute) {
@@ -194,7 +267,7 @@ namespace Ep128Emu {
       else if (haveSegment)
         addr_ |= (uint32_t(0x40000000UL) | (uint32_t(segment) << 14));
       BreakPoint  bp(isIO, haveSegment, isRead, isWrite, isExecute, isIgnore,
-                     segment, addr, priority);
+                     segment, addr, priority, cond);
       while (true) {
         std::map<uint32_t, BreakPoint>::iterator  i_ = bpList.find(addr_);
         if (i_ == bpList.end()) {
@@ -215,6 +288,11 @@ namespace Ep128Emu {
             // combine read, write, execute, and ignore flags
             bpp->n_ = ((bpp->n_ | bp.n_) & 0x27000000U)
                       | (tmp1 >= tmp2 ? tmp1 : tmp2);
+            // break if any of the conditions is true
+            if (bpp->cond_.length() < 1 || bp.cond_.length() < 1)
+              bpp->cond_.clear();
+            else if (bpp->cond_ != bp.cond_)
+              bpp->cond_ = "(" + bpp->cond_ + ") || (" + bp.cond_ + ")";
           }
         }
         if (addr >= lastAddr)
@@ -280,7 +358,8 @@ namespace Ep128Emu {
               bp.isExecute() == prv_bp.isExecute() &&
               bp.isIgnore() == prv_bp.isIgnore() &&
               bp.priority() == prv_bp.priority() &&
-              bp.segment() == prv_bp.segment()) {
+              bp.segment() == prv_bp.segment() &&
+              bp.condition() == prv_bp.condition()) {
             prv_bp = bp;
             continue;
           }
@@ -320,6 +399,8 @@ namespace Ep128Emu {
           }
           if (prv_bp.priority() != 2)
             lst << "p" << std::setw(1) << prv_bp.priority();
+          if (prv_bp.condition().length() > 0)
+            lst << "{" << prv_bp.condition() << "}";
           lst << "\n";
         }
         prv_bp = bp;
@@ -357,7 +438,7 @@ namespace Ep128Emu {
   void BreakPointList::saveState(File::Buffer& buf)
   {
     buf.setPosition(0);
-    buf.writeUInt32(0x01000002);        // version number
+    buf.writeUInt32(0x01000003);        // version number
     for (size_t i = 0; i < lst_.size(); i++) {
       buf.writeBoolean(lst_[i].isIO());
       buf.writeBoolean(lst_[i].haveSegment());
@@ -368,6 +449,7 @@ namespace Ep128Emu {
       buf.writeByte(lst_[i].segment());
       buf.writeUInt32(lst_[i].addr());
       buf.writeByte(uint8_t(lst_[i].priority()));
+      buf.writeString(lst_[i].condition());
     }
   }
 
@@ -383,7 +465,7 @@ namespace Ep128Emu {
     buf.setPosition(0);
     // check version number
     unsigned int  version = buf.readUInt32();
-    if (!(version >= 0x01000001 && version <= 0x01000002)) {
+    if (!(version >= 0x01000001 && version <= 0x01000003)) {
       buf.setPosition(buf.getDataSize());
       throw Exception("incompatible breakpoint list format");
     }
@@ -402,8 +484,11 @@ namespace Ep128Emu {
       uint8_t   segment = buf.readByte();
       uint16_t  addr = uint16_t(buf.readUInt32());
       int       priority = buf.readByte();
+      std::string cond;
+      if (version >= 0x01000003)
+        cond = buf.readString();
       BreakPoint  bp(isIO, haveSegment, isRead, isWrite, isExecute, isIgnore,
-                     segment, addr, priority);
+                     segment, addr, priority, cond);
       lst_.push_back(bp);
     }
   }
@@ -25,6 +25,8 @@
 
 namespace Ep128Emu {
 
+  class SymbolTable;
+
   class BreakPoint {
    private:
     // 0x00000000: memory (16 bit address),
@@ -37,10 +39,13 @@ namespace Ep128Emu {
     // + priority (0 to 3) * 0x00400000
     // + address
     uint32_t  n_;
+    // condition expression (see bpcond.hpp), or empty string if none
+    std::string cond_;
    public:
     BreakPoint(bool isIO_, bool haveSegment_,
                bool r_, bool w_, bool x_, bool ignoreFlag_,
-               uint8_t segment_, uint16_t addr_, int priority_);
+               uint8_t segment_, uint16_t addr_, int priority_,
+               const std::string& cond = std::string());
     bool isIO() const
     {
       return bool(this->n_ & 0x10000000);
@@ -81,6 +86,10 @@ namespace Ep128Emu {
         return ((uint16_t) (this->n_ & 0x3FFF));
       return ((uint16_t) this->n_ & 0xFFFF);
     }
+    const std::string& condition() const
+    {
+      return this->cond_;
+    }
     bool operator<(const BreakPoint& bp) const
     {
       return (this->n_ < bp.n_);
@@ -119,15 +128,25 @@ namespace Ep128Emu {
      *                  is at an address for which this breakpoint is set
      *                  (read/write flags and priority are not used in
      *                  this case)
+     *   {expr}         only break if the condition expression 'expr' is
+     *                  true (see bpcond.hpp); this must be the last
+     *                  modifier, and 'expr' may contain whitespace
      * by default, the breakpoint is triggered on both reads and writes if
      * 'r', 'w', or 'x' is not used, and has a priority of 2.
      * Example: 8000-8003rp1 means break on reading CPU addresses 0x8000,
      * 0x8001, 0x8002, and 0x8003, if the breakpoint priority threshold is
      * less than or equal to 1.
+     * 0038x{SP < 0x4000} breaks at the interrupt handler only if the stack
+     * pointer is below 0x4000.
+     * If 'symbols' is not NULL, any memory address can also be specified
+     * as a symbol name in square brackets, which is replaced with the
+     * CPU or segment:offset address of the symbol; for example,
+     * [main]x or [buffer]-[buffer_end]w.
      * If there are any syntax errors in the list, Ep128Emu::Exception is
      * thrown, and no breakpoints are added.
      */
-    BreakPointList(const std::string& lst);
+    BreakPointList(const std::string& lst,
+                   const SymbolTable *symbols = (SymbolTable *) 0);
     void addMemoryBreakPoint(uint8_t segment, uint16_t addr,
                              bool r, bool w, bool x, bool ignoreFlag,
                              int priority);
@@ -32,6 +32,7 @@
 #include "videorec.hpp"
 #include "fdc765.hpp"
 #include "cpcdisk.hpp"
+#include "profiler.hpp"
 
 #include <vector>
 
@@ -176,6 +177,8 @@ namespace CPC464 {
   EP128EMU_REGPARM1 uint8_t CPC464VM::Z80_::readOpcodeFirstByte()
   {
     uint16_t  addr = uint16_t(R.PC.W.l);
+    if (EP128EMU_UNLIKELY(vm.profilerRunning))
+      vm.profileInstruction(addr);
     vm.memoryWaitM1();
     if (!vm.singleStepMode) {
       uint8_t   retval = vm.memory.readOpcode(addr);
@@ -261,6 +264,8 @@ namespace CPC464 {
   EP128EMU_REGPARM3 void CPC464VM::Z80_::doOut(uint16_t addr, uint8_t value)
   {
     vm.ioPortWait();
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 6, addr, value);
     vm.ioPorts.write(addr, value);
     vm.updateCPUHalfCycles(1);
   }
@@ -270,6 +275,8 @@ namespace CPC464 {
     vm.ioPortWait();
     uint8_t   retval = vm.ioPorts.read(addr);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 5, addr, retval);
     return retval;
   }
 
@@ -306,7 +313,7 @@ namespace CPC464 {
       int     bpType = int(isWrite) + 1;
       if (!isWrite && uint16_t(vm.z80.getReg().PC.W.l) == addr)
         bpType = 0;
-      vm.breakPointCallback(vm.breakPointCallbackUserData, bpType, addr, value);
+      vm.runBreakPointCallback(bpType, addr, value);
     }
   }
 
@@ -326,8 +333,7 @@ namespace CPC464 {
                                               uint16_t addr, uint8_t value)
   {
     if (!vm.memory.checkIgnoreBreakPoint(vm.z80.getReg().PC.W.l)) {
-      vm.breakPointCallback(vm.breakPointCallbackUserData,
-                            int(isWrite) + 5, addr, value);
+      vm.runBreakPointCallback(int(isWrite) + 5, addr, value);
     }
   }
 
@@ -360,6 +366,8 @@ namespace CPC464 {
       vm.display.vsyncStateChange(newState, currentSlot_);
     if (vm.videoCapture)
       vm.videoCapture->vsyncStateChange(newState, currentSlot_);
+    if (newState)
+      vm.runFrameHook();
   }
 
   // --------------------------------------------------------------------------
@@ -825,6 +833,20 @@ namespace CPC464 {
     vm.demoTimeCnt++;
   }
 
+  void CPC464VM::profilerCallback(void *userData)
+  {
+    CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
+    vm.profilerTimeBase = vm.profilerTimeBase + 8U;
+  }
+
+  void CPC464VM::profileInstruction(uint16_t addr)
+  {
+    profiler->addInstruction((uint32_t(memory.getPage(uint8_t(addr >> 14)))
+                              << 14) | uint32_t(addr & 0x3FFF),
+                             addr, uint16_t(z80.getReg().SP.W),
+                             profilerTimeBase + uint32_t(z80OpcodeHalfCycles));
+  }
+
   void CPC464VM::videoCaptureCallback(void *userData)
   {
     CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
@@ -1004,6 +1026,7 @@ namespace CPC464 {
       ayRegisterSelected(0x00),
       ayCycleCnt(4),
       z80OpcodeHalfCycles(0),
+      profilerTimeBase(0U),
       ppiPortARegister(0x00),
       ppiPortAState(0xFF),
       ppiPortBRegister(0x00),
@@ -1066,6 +1089,7 @@ namespace CPC464 {
 
   CPC464VM::~CPC464VM()
   {
+    stopProfiler();
     if (videoCapture) {
       delete videoCapture;
       videoCapture = (Ep128Emu::VideoCapture *) 0;
@@ -1235,6 +1259,7 @@ namespace CPC464 {
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
     vmStatus_.tapeSampleSize = getTapeSampleSize();
+    vmStatus_.tapeMotorOn = getIsTapeRunning();
     vmStatus_.floppyDriveLEDState = floppyDrive->getLEDState(0x0C);
     vmStatus_.isPlayingDemo = isPlayingDemo;
     if (demoFile != (Ep128Emu::File *) 0 && !isRecordingDemo)
@@ -1244,16 +1269,31 @@ namespace CPC464 {
 
   void CPC464VM::openVideoCapture(
       int frameRate_,
-      bool yuvFormat_,
+      int videoFormat_,
+      int frameHashInterval_,
+      bool frameHashPNG_,
       void (*errorCallback_)(void *userData, const char *msg),
       void (*fileNameCallback_)(void *userData, std::string& fileName),
       void *userData_)
   {
     if (!videoCapture) {
-      if (yuvFormat_) {
+      if (videoFormat_ == 1) {
         videoCapture = new Ep128Emu::VideoCapture_YV12(
                                &CPCVideo::convertPixelToRGB, frameRate_);
       }
+      else if (videoFormat_ == 2) {
+        videoCapture = new Ep128Emu::VideoCapture_ZMBV(
+                               &CPCVideo::convertPixelToRGB, frameRate_);
+      }
+      else if (videoFormat_ == 3) {
+        videoCapture = new Ep128Emu::VideoCapture_Y4M(
+                               &CPCVideo::convertPixelToRGB, frameRate_);
+      }
+      else if (videoFormat_ == 4) {
+        videoCapture = new Ep128Emu::VideoCapture_FrameHash(
+                               &CPCVideo::convertPixelToRGB, frameRate_,
+                               frameHashInterval_, frameHashPNG_);
+      }
       else {
         videoCapture = new Ep128Emu::VideoCapture_RLE8(
                                &CPCVideo::convertPixelToRGB, frameRate_);
@@ -1341,6 +1381,7 @@ namespace CPC464 {
 
   void CPC464VM::setBreakPoint(const Ep128Emu::BreakPoint& bp, bool isEnabled)
   {
+    setBreakPointCondition(bp, isEnabled);
     if (EP128EMU_UNLIKELY(!isEnabled)) {
       if (bp.isIO()) {
         ioPorts.setBreakPoint(bp.addr(), 0, false, false);
@@ -1373,10 +1414,32 @@ namespace CPC464 {
 
   void CPC464VM::clearBreakPoints()
   {
+    clearBreakPointConditions();
     memory.clearAllBreakPoints();
     ioPorts.clearBreakPoints();
   }
 
+  void CPC464VM::startProfiler(bool callStackEnabled)
+  {
+    stopProfiler();
+    if (profiler) {
+      delete profiler;
+      profiler = (Ep128Emu::Profiler *) 0;
+    }
+    profiler = new Ep128Emu::Profiler(*this, 0xFFFFFFFFU, callStackEnabled);
+    profilerTimeBase = 0U;
+    setCallback(&profilerCallback, this, true);
+    profilerRunning = true;
+  }
+
+  void CPC464VM::stopProfiler()
+  {
+    if (profilerRunning) {
+      setCallback(&profilerCallback, this, false);
+      profilerRunning = false;
+    }
+  }
+
   void CPC464VM::setBreakPointPriorityThreshold(int n)
   {
     breakPointPriorityThreshold = uint8_t(n > 0 ? (n < 4 ? n : 4) : 0);
@@ -1601,7 +1664,7 @@ namespace CPC464 {
                                             int32_t offs) const
   {
     return Ep128::Z80Disassembler::disassembleInstruction(
-               buf, (*this), addr, isCPUAddress, offs);
+               buf, (*this), addr, isCPUAddress, offs, &getSymbolTable());
   }
 
   void CPC464VM::getVideoPosition(int& xPos, int& yPos) const
@@ -110,6 +110,7 @@ namespace CPC464 {
     uint8_t   ayRegisterSelected;
     uint8_t   ayCycleCnt;
     uint8_t   z80OpcodeHalfCycles;      // time since the last CRTC cycle
+    uint32_t  profilerTimeBase;         // in Z80 half cycles
     uint8_t   ppiPortARegister;
     uint8_t   ppiPortAState;
     uint8_t   ppiPortBRegister;
@@ -191,6 +192,8 @@ namespace CPC464 {
     void stopDemoRecording(bool writeFile_);
     EP128EMU_REGPARM1 void updatePPIState();
     uint8_t checkSingleStepModeBreak();
+    static void profilerCallback(void *userData);
+    void profileInstruction(uint16_t addr);
     void convertKeyboardState();
     void resetKeyboard();
     // Set function to be called at every CRTC cycle. The functions are called
@@ -233,13 +236,18 @@ namespace CPC464 {
     virtual void getVMStatus(VirtualMachine::VMStatus& vmStatus_);
     /*!
      * Create video capture object with the specified frame rate (24 to 60)
-     * and format (768x576 RLE8 or 384x288 YV12) if it does not exist yet,
-     * and optionally set callbacks for printing error messages and asking
-     * for a new output file on reaching 2 GB file size.
+     * and format (0: 768x576 RLE8, 1: 384x288 YV12, 2: 768x576 ZMBV,
+     * 3: 768x576 YUV4MPEG2 and WAV, 4: frame hash log) if it does not exist
+     * yet, and optionally set callbacks for printing error messages and
+     * asking for a new output file when the index of the AVI file is full.
+     * For the frame hash log, every 'frameHashInterval_'th frame is hashed,
+     * and also saved as a PNG image if 'frameHashPNG_' is true.
      */
     virtual void openVideoCapture(
         int frameRate_ = 50,
-        bool yuvFormat_ = false,
+        int videoFormat_ = 0,
+        int frameHashInterval_ = 1,
+        bool frameHashPNG_ = false,
         void (*errorCallback_)(void *userData, const char *msg) =
             (void (*)(void *, const char *)) 0,
         void (*fileNameCallback_)(void *userData, std::string& fileName) =
@@ -301,6 +309,14 @@ namespace CPC464 {
      */
     virtual void setBreakPoint(const Ep128Emu::BreakPoint& bp,
                                bool isEnabled = true);
+    /*!
+     * Start collecting profiler data (see vm.hpp).
+     */
+    virtual void startProfiler(bool callStackEnabled = false);
+    /*!
+     * Stop collecting profiler data.
+     */
+    virtual void stopProfiler();
     /*!
      * Clear all breakpoints.
      */
@@ -938,9 +938,184 @@ namespace Ep128 {
 #endif
   };
 
+  class Z80OpcodeBufferReader_ {
+   private:
+    const uint8_t *buf;
+    uint32_t  baseAddr;
+   public:
+    Z80OpcodeBufferReader_(const uint8_t *buf_, uint32_t baseAddr_)
+      : buf(buf_),
+        baseAddr(baseAddr_)
+    {
+    }
+    inline uint8_t readMemory(uint32_t addr, bool isCPUAddress) const
+    {
+      (void) isCPUAddress;
+      return buf[(addr - baseAddr) & 3U];
+    }
+  };
+
   uint32_t Z80Disassembler::disassembleInstruction(
       std::string& buf, const Ep128Emu::VirtualMachine& vm,
-      uint32_t addr, bool isCPUAddress, int32_t offs)
+      uint32_t addr, bool isCPUAddress, int32_t offs,
+      const Ep128Emu::SymbolTable *symbols)
+  {
+    unsigned char addrOperandType = 0;
+    uint32_t  addrOperand = 0U;
+    uint32_t  nextAddr =
+        disassembleInstruction_(buf, vm, addr, isCPUAddress, offs,
+                                addrOperandType, addrOperand);
+    if (addrOperandType != 0 && symbols && !symbols->empty()) {
+      // relative jump targets are in the same address space as 'addr',
+      // other operands are always CPU addresses; only data references
+      // are allowed to point into a symbol
+      uint32_t  physAddr = 0xFFFFFFFFU;
+      uint32_t  cpuAddr = 0xFFFFFFFFU;
+      if (isCPUAddress || addrOperandType != 19) {
+        cpuAddr = addrOperand & 0xFFFFU;
+        physAddr = (uint32_t(vm.getMemoryPage(int(cpuAddr >> 14))) << 14)
+                   | (cpuAddr & 0x3FFFU);
+      }
+      else {
+        physAddr = addrOperand & 0x003FFFFFU;
+        for (int i = 0; i < 4; i++) {
+          if (uint32_t(vm.getMemoryPage(i)) == (physAddr >> 14)) {
+            cpuAddr = (uint32_t(i) << 14) | (physAddr & 0x3FFFU);
+            break;
+          }
+        }
+      }
+      uint32_t    symOffs = 0U;
+      const char  *name =
+          symbols->findMemorySymbol(symOffs, physAddr, cpuAddr,
+                                    (addrOperandType == 21 ? 0xFFU : 0U));
+      if (name)
+        appendSymbolName_(buf, name, symOffs);
+    }
+    return nextAddr;
+  }
+
+  uint32_t Z80Disassembler::disassembleInstruction(
+      std::string& buf, const uint8_t *opcodeBuf,
+      uint32_t addr, bool isCPUAddress, int32_t offs,
+      const Ep128Emu::SymbolTable *symbols, int segment)
+  {
+    addr &= (isCPUAddress ? 0x0000FFFFU : 0x003FFFFFU);
+    Z80OpcodeBufferReader_  mem(opcodeBuf, addr);
+    unsigned char addrOperandType = 0;
+    uint32_t  addrOperand = 0U;
+    uint32_t  nextAddr =
+        disassembleInstruction_(buf, mem, addr, isCPUAddress, offs,
+                                addrOperandType, addrOperand);
+    if (addrOperandType != 0 && symbols && !symbols->empty()) {
+      uint32_t  physAddr = 0xFFFFFFFFU;
+      uint32_t  cpuAddr = 0xFFFFFFFFU;
+      if (addrOperandType == 19 && !isCPUAddress) {
+        physAddr = addrOperand;
+      }
+      else {
+        cpuAddr = addrOperand;
+        // the segment is only known for addresses in the same 16K page
+        // as the instruction
+        if (isCPUAddress && segment >= 0 && ((cpuAddr ^ addr) & 0xC000U) == 0U)
+          physAddr = (uint32_t(segment & 0xFF) << 14) | (cpuAddr & 0x3FFFU);
+      }
+      uint32_t    symOffs = 0U;
+      const char  *name =
+          symbols->findMemorySymbol(symOffs, physAddr, cpuAddr,
+                                    (addrOperandType == 21 ? 0xFFU : 0U));
+      if (name)
+        appendSymbolName_(buf, name, symOffs);
+    }
+    return nextAddr;
+  }
+
+  uint32_t Z80Disassembler::getInstructionFlow(int& flowType,
+                                               uint32_t& targetAddr,
+                                               const uint8_t *opcodeBuf,
+                                               uint32_t addr)
+  {
+    addr &= 0xFFFFU;
+    Z80OpcodeBufferReader_  mem(opcodeBuf, addr);
+    std::string   tmpBuf;
+    unsigned char addrOperandType = 0;
+    uint32_t  addrOperand = 0U;
+    uint32_t  nextAddr =
+        disassembleInstruction_(tmpBuf, mem, addr, true, 0,
+                                addrOperandType, addrOperand);
+    flowType = 0;
+    targetAddr = 0xFFFFFFFFU;
+    size_t    n = 0;
+    if (opcodeBuf[0] == 0xDD || opcodeBuf[0] == 0xFD) {
+      if (((nextAddr - addr) & 0xFFFFU) < 2U)
+        return nextAddr;                // ignored prefix
+      n = 1;
+    }
+    const unsigned char *opcodeTablePtr = &(opcodeTable[0]);
+    if (opcodeBuf[n] == 0xCB) {
+      return nextAddr;
+    }
+    else if (opcodeBuf[n] == 0xED) {
+      if (n > 0)
+        return nextAddr;
+      opcodeTablePtr = &(opcodeTableED[0]);
+      n++;
+    }
+    opcodeTablePtr = opcodeTablePtr + (size_t(opcodeBuf[n]) * 3);
+    if (opcodeTablePtr[0] > 75) {
+      flowType = 5;
+      return nextAddr;
+    }
+    const char    *name = &(opcodeNames[size_t(opcodeTablePtr[0]) * 5]);
+    unsigned char operand1Type = opcodeTablePtr[1];
+    bool          isConditional = (operand1Type >= 67 && operand1Type <= 74);
+    if (std::strncmp(name, " JP  ", 5) == 0) {
+      if (operand1Type == 40) {
+        flowType = 4;                   // JP (HL), JP (IX), JP (IY)
+      }
+      else {
+        flowType = (isConditional ? 2 : 1);
+        targetAddr = addrOperand & 0xFFFFU;
+      }
+    }
+    else if (std::strncmp(name, " JR  ", 5) == 0 ||
+             std::strncmp(name, " DJNZ", 5) == 0) {
+      flowType = (isConditional || name[1] == 'D' ? 2 : 1);
+      targetAddr = addrOperand & 0xFFFFU;
+    }
+    else if (std::strncmp(name, " CALL", 5) == 0) {
+      flowType = 3;
+      targetAddr = addrOperand & 0xFFFFU;
+    }
+    else if (std::strncmp(name, " RST ", 5) == 0) {
+      flowType = 3;
+      targetAddr = uint32_t(operand1Type - 9) << 3;
+    }
+    else if (std::strncmp(name + 1, "RET", 3) == 0) {
+      // RET cc continues if the condition is false
+      if (!(name[4] == ' ' && operand1Type != 0))
+        flowType = 4;
+    }
+    return nextAddr;
+  }
+
+  void Z80Disassembler::appendSymbolName_(std::string& buf,
+                                          const char *name, uint32_t offs)
+  {
+    buf += "  ; ";
+    buf += name;
+    if (offs) {
+      char    tmpBuf[8];
+      std::sprintf(&(tmpBuf[0]), "+%02X", (unsigned int) (offs & 0xFFU));
+      buf += &(tmpBuf[0]);
+    }
+  }
+
+  template < typename T >
+  uint32_t Z80Disassembler::disassembleInstruction_(
+      std::string& buf, const T& vm,
+      uint32_t addr, bool isCPUAddress, int32_t offs,
+      unsigned char& addrOperandType, uint32_t& addrOperand)
   {
     char      tmpBuf[48];
     uint8_t   opcodeBuf[8];
@@ -1135,6 +1310,14 @@ namespace Ep128 {
       std::strcpy(bufp, "  ???");
     }
     buf = &(tmpBuf[0]);
+    addrOperandType = 0;
+    addrOperand = operand;
+    if (!invalidOpcode) {
+      if (operand1Type >= 19 && operand1Type < 22)
+        addrOperandType = operand1Type;
+      else if (operand2Type >= 19 && operand2Type < 22)
+        addrOperandType = operand2Type;
+    }
     return addr;
   }
 
@@ -47,6 +47,14 @@ namespace Ep128 {
     static void parseOperand(const std::vector< std::string >& args,
                              size_t argOffs, size_t argCnt, int& opType,
                              bool& haveOpValue, uint32_t& opValue);
+    template < typename T >
+    static uint32_t disassembleInstruction_(std::string& buf, const T& mem,
+                                            uint32_t addr, bool isCPUAddress,
+                                            int32_t offs,
+                                            unsigned char& addrOperandType,
+                                            uint32_t& addrOperand);
+    static void appendSymbolName_(std::string& buf,
+                                  const char *name, uint32_t offs);
    public:
     /*!
      * Disassemble one Z80 instruction, reading from memory of virtual
@@ -58,12 +66,45 @@ namespace Ep128 {
      * true, 'addr' is interpreted as a 16-bit CPU address, otherwise it
      * is assumed to be a 22-bit physical address (8 bit segment + 14 bit
      * offset).
+     * If 'symbols' is not NULL, address operands are annotated with the
+     * name of the symbol at (or, for memory operands, near) the address,
+     * using the current memory paging of 'vm' to find symbols defined for
+     * both physical and CPU addresses.
      */
-    static uint32_t disassembleInstruction(std::string& buf,
-                                           const Ep128Emu::VirtualMachine& vm,
-                                           uint32_t addr,
-                                           bool isCPUAddress = false,
-                                           int32_t offs = 0);
+    static uint32_t disassembleInstruction(
+        std::string& buf, const Ep128Emu::VirtualMachine& vm,
+        uint32_t addr, bool isCPUAddress = false, int32_t offs = 0,
+        const Ep128Emu::SymbolTable *symbols = (Ep128Emu::SymbolTable *) 0);
+    /*!
+     * Disassemble one Z80 instruction from the first four bytes of
+     * 'opcodeBuf', which was read from address 'addr'. Useful for
+     * processing execution traces without a virtual machine.
+     * If 'symbols' is not NULL, address operands are annotated with symbol
+     * names; 'segment' is the segment the instruction was read from if
+     * 'addr' is a CPU address, or -1 if it is not known.
+     */
+    static uint32_t disassembleInstruction(
+        std::string& buf, const uint8_t *opcodeBuf,
+        uint32_t addr, bool isCPUAddress = false, int32_t offs = 0,
+        const Ep128Emu::SymbolTable *symbols = (Ep128Emu::SymbolTable *) 0,
+        int segment = -1);
+    /*!
+     * Decode the Z80 instruction in the first four bytes of 'opcodeBuf',
+     * which was read from CPU address 'addr', for code flow analysis.
+     * Returns the address of the next instruction, and stores the type
+     * of the instruction in 'flowType':
+     *   0: continues with the next instruction
+     *   1: unconditional jump to 'targetAddr'
+     *   2: conditional jump to 'targetAddr' (JP cc, JR cc, DJNZ)
+     *   3: call to 'targetAddr' (CALL, CALL cc, RST), continues with the
+     *      next instruction after the subroutine returns
+     *   4: end of code path (RET, RETI, RETN, JP (HL), JP (IX), JP (IY))
+     *   5: invalid opcode
+     * 'targetAddr' is set to 0xFFFFFFFF if there is no known target.
+     */
+    static uint32_t getInstructionFlow(int& flowType, uint32_t& targetAddr,
+                                       const uint8_t *opcodeBuf,
+                                       uint32_t addr);
     // Same as disassembleInstruction() without actually writing to a string.
     static uint32_t getNextInstructionAddr(const Ep128Emu::VirtualMachine& vm,
                                            uint32_t addr,
@@ -95,6 +95,7 @@ namespace Ep128Emu {
     pixelAspectRatio = (src.pixelAspectRatio > 0.5f ?
                         (src.pixelAspectRatio < 2.0f ?
                          src.pixelAspectRatio : 2.0f) : 0.5f);
+    shaderPaletteLookup = src.shaderPaletteLookup;
   }
 
   VideoDisplay::DisplayParameters::DisplayParameters()
@@ -109,7 +110,8 @@ namespace Ep128Emu {
       lineShade(0.75f),
       blendScale(1.0f),
       motionBlur(0.25f),
-      pixelAspectRatio(1.0f)
+      pixelAspectRatio(1.0f),
+      shaderPaletteLookup(false)
   {
   }
 
@@ -179,5 +181,10 @@ namespace Ep128Emu {
     (void) isEnabled;
   }
 
+  void VideoDisplay::setWarpMode(bool isEnabled)
+  {
+    (void) isEnabled;
+  }
+
 }       // namespace Ep128Emu
 
@@ -92,6 +92,11 @@ namespace Ep128Emu {
        * (calculated as (screen_width / screen_height) / (X_res / Y_res))
        */
       float   pixelAspectRatio;
+      /*!
+       * If true, upload 8-bit color indices, and do the palette lookup and
+       * PAL blending in the shader (OpenGL display quality 3 and 4 only).
+       */
+      bool    shaderPaletteLookup;
      private:
       static void defaultIndexToRGBFunc(uint8_t color,
                                         float& red, float& green, float& blue);
@@ -144,6 +149,12 @@ namespace Ep128Emu {
      * maximum of 50.
      */
     virtual void limitFrameRate(bool isEnabled);
+    /*!
+     * Should be called with isEnabled = true when the emulation is running
+     * in warp mode; the frame rate is then limited to 50 frames per second,
+     * regardless of the limitFrameRate() setting.
+     */
+    virtual void setWarpMode(bool isEnabled);
   };
 
 }       // namespace Ep128Emu
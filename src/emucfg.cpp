@@ -71,6 +71,19 @@ static void defineConfigurationVariable(
                        &changeFlag, true);
 }
 
+static void videoCaptureYUVFormatCallback(void *userData,
+                                          const std::string& name, bool value)
+{
+  (void) name;
+  if (value) {
+    // convert the deprecated setting to videoCapture.format = 1 (YV12)
+    Ep128Emu::EmulatorConfiguration&  config =
+        *(reinterpret_cast<Ep128Emu::EmulatorConfiguration *>(userData));
+    config["videoCapture.format"] = int(1);
+    config.videoCapture.yuvFormat = false;
+  }
+}
+
 static void defaultErrorCallback(void *userData, const char *msg)
 {
   (void) userData;
@@ -107,6 +120,12 @@ namespace Ep128Emu {
     defineConfigurationVariable(*this, "vm.speedPercentage",
                                 vm.speedPercentage, 100U,
                                 soundSettingsChanged, 0.0, 1000.0);
+    defineConfigurationVariable(*this, "vm.autoWarpTape",
+                                vm.autoWarpTape, false,
+                                soundSettingsChanged);
+    defineConfigurationVariable(*this, "vm.autoWarpDisk",
+                                vm.autoWarpDisk, false,
+                                soundSettingsChanged);
     defineConfigurationVariable(*this, "vm.processPriority",
                                 vm.processPriority, int(0),
                                 vmProcessPriorityChanged,
@@ -215,6 +234,9 @@ namespace Ep128Emu {
     defineConfigurationVariable(*this, "display.pixelAspectRatio",
                                 display.pixelAspectRatio, 1.0,
                                 displaySettingsChanged, 0.5, 2.0);
+    defineConfigurationVariable(*this, "display.shaderPaletteLookup",
+                                display.shaderPaletteLookup, false,
+                                displaySettingsChanged);
     // ----------------
     defineConfigurationVariable(*this, "sound.enabled",
                                 sound.enabled, true,
@@ -396,6 +418,9 @@ namespace Ep128Emu {
     defineConfigurationVariable(*this, "tape.forceMotorOn",
                                 tape.forceMotorOn, false,
                                 tapeSettingsChanged);
+    defineConfigurationVariable(*this, "tape.fastLoad",
+                                tape.fastLoad, false,
+                                tapeSettingsChanged);
     // ----------------
     defineConfigurationVariable(*this, "fileio.workingDirectory",
                                 fileio.workingDirectory, std::string("."),
@@ -408,9 +433,19 @@ namespace Ep128Emu {
     defineConfigurationVariable(*this, "videoCapture.frameRate",
                                 videoCapture.frameRate, int(50),
                                 videoCaptureSettingsChanged, 24.0, 60.0);
-    defineConfigurationVariable(*this, "videoCapture.yuvFormat",
-                                videoCapture.yuvFormat, false,
+    defineConfigurationVariable(*this, "videoCapture.format",
+                                videoCapture.format, int(0),
+                                videoCaptureSettingsChanged, 0.0, 4.0);
+    defineConfigurationVariable(*this, "videoCapture.hashInterval",
+                                videoCapture.hashInterval, int(1),
+                                videoCaptureSettingsChanged, 1.0, 1000000.0);
+    defineConfigurationVariable(*this, "videoCapture.hashPNG",
+                                videoCapture.hashPNG, false,
                                 videoCaptureSettingsChanged);
+    videoCapture.yuvFormat = false;
+    createKey("videoCapture.yuvFormat", videoCapture.yuvFormat);
+    (*this)["videoCapture.yuvFormat"].setCallback(
+        &videoCaptureYUVFormatCallback, (void *) this, true);
     // ----------------
     // videoCaptureSettingsChanged is used only as a dummy variable here
     defineConfigurationVariable(*this, "compressFiles",
@@ -619,6 +654,7 @@ namespace Ep128Emu {
       dp.blendScale = float(display.blendScale);
       dp.motionBlur = float(display.motionBlur);
       dp.pixelAspectRatio = float(display.pixelAspectRatio);
+      dp.shaderPaletteLookup = display.shaderPaletteLookup;
       videoDisplay.setDisplayParameters(dp);
       // NOTE: resolution changes are not handled here
       displaySettingsChanged = false;
@@ -741,6 +777,7 @@ namespace Ep128Emu {
     if (tapeSettingsChanged) {
       vm_.setDefaultTapeSampleRate(tape.defaultSampleRate);
       vm_.setForceTapeMotorOn(tape.forceMotorOn);
+      vm_.setEnableFastTapeLoad(tape.fastLoad);
       tapeSettingsChanged = false;
     }
     if (tapeFileChanged) {
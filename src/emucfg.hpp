@@ -50,6 +50,8 @@ namespace Ep128Emu {
       unsigned int  videoClockFrequency;
       unsigned int  soundClockFrequency;
       unsigned int  speedPercentage;    // NOTE: this uses soundSettingsChanged
+      bool          autoWarpTape;       // uses soundSettingsChanged
+      bool          autoWarpDisk;       // uses soundSettingsChanged
       int           processPriority;    // uses vmProcessPriorityChanged
       bool          enableMemoryTimingEmulation;
       bool          enableFileIO;
@@ -110,6 +112,7 @@ namespace Ep128Emu {
       int         width;
       int         height;
       double      pixelAspectRatio;
+      bool        shaderPaletteLookup;
     } display;
     bool          displaySettingsChanged;
     // --------
@@ -206,6 +209,7 @@ namespace Ep128Emu {
       int         soundFileChannel;
       bool        enableSoundFileFilter;
       bool        forceMotorOn;
+      bool        fastLoad;
       double      soundFileFilterMinFreq;
       double      soundFileFilterMaxFreq;
     };
@@ -227,6 +231,12 @@ namespace Ep128Emu {
     // --------
     struct {
       int         frameRate;
+      int         format;
+      // frame hash log (format 4) settings
+      int         hashInterval;
+      bool        hashPNG;
+      // deprecated, replaced by 'format'; setting it to true in an old
+      // configuration file selects format 1 (YV12), and it is then reset
       bool        yuvFormat;
     } videoCapture;
     bool          videoCaptureSettingsChanged;
@@ -30,6 +30,8 @@
 #include "debuglib.hpp"
 #include "videorec.hpp"
 #include "ide.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
 #ifdef ENABLE_SDEXT
 #  include "sdext.hpp"
 #endif
@@ -113,7 +115,11 @@ namespace Ep128 {
     else {
       vm.cpuCyclesRemaining -= (int64_t(3) << 32);
     }
-    return vm.memory.read(addr);
+    uint8_t   retval = vm.memory.read(addr);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     addr, retval);
+    return retval;
   }
 
   EP128EMU_REGPARM2 uint16_t Ep128VM::Z80_::readMemoryWord(uint16_t addr)
@@ -133,12 +139,22 @@ namespace Ep128 {
     }
     uint16_t  retval = vm.memory.read(addr);
     retval |= (uint16_t(vm.memory.read((addr + 1) & 0xFFFF) << 8));
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     addr, uint8_t(retval & 0xFF));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     (addr + 1) & 0xFFFF, uint8_t(retval >> 8));
+    }
     return retval;
   }
 
   EP128EMU_REGPARM1 uint8_t Ep128VM::Z80_::readOpcodeFirstByte()
   {
     uint16_t  addr = uint16_t(R.PC.W.l);
+    if (EP128EMU_UNLIKELY(vm.reverseDebugMode != 0))
+      vm.reverseDebugInstruction();
+    if (EP128EMU_UNLIKELY(vm.profilerRunning))
+      vm.profileInstruction(addr);
     if (vm.memoryTimingEnabled) {
       if (vm.pageTable[addr >> 14] < 0xFC)
         vm.cpuCyclesRemaining -= vm.memoryWaitCycles_M1;
@@ -148,6 +164,8 @@ namespace Ep128 {
     else {
       vm.cpuCyclesRemaining -= (int64_t(4) << 32);
     }
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceInstruction(addr);
     if (!vm.singleStepMode)
       return vm.memory.readOpcode(addr);
     // single step mode
@@ -224,6 +242,9 @@ namespace Ep128 {
       vm.cpuCyclesRemaining -= (int64_t(3) << 32);
     }
     vm.memory.write(addr, value);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, value);
     if (vm.spectrumEmulatorEnabled) {
       uint32_t  tmp = uint32_t(addr) & 0x3FFFU;
       tmp = tmp | (uint32_t(vm.pageTable[addr >> 14]) << 14);
@@ -255,6 +276,12 @@ namespace Ep128 {
     }
     vm.memory.write(addr, uint8_t(value) & 0xFF);
     vm.memory.write((addr + 1) & 0xFFFF, uint8_t(value >> 8));
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, uint8_t(value & 0xFF));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     (addr + 1) & 0xFFFF, uint8_t(value >> 8));
+    }
   }
 
   EP128EMU_REGPARM2 void Ep128VM::Z80_::pushWord(uint16_t value)
@@ -282,6 +309,12 @@ namespace Ep128 {
     }
     vm.memory.write((addr + 1) & 0xFFFF, uint8_t(value >> 8));
     vm.memory.write(addr, uint8_t(value) & 0xFF);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     (addr + 1) & 0xFFFF, uint8_t(value >> 8));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, uint8_t(value & 0xFF));
+    }
   }
 
   EP128EMU_REGPARM3 void Ep128VM::Z80_::doOut(uint16_t addr, uint8_t value)
@@ -290,6 +323,10 @@ namespace Ep128 {
     if (vm.cpuCyclesRemaining < -(vm.cpuCyclesPerNickCycle))
       vm.runDevices();
     vm.cpuCyclesRemaining -= (int64_t(1) << 32);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeIOWrite, addr, value);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 6, addr, value);
     vm.ioPorts.write(addr, value);
   }
 
@@ -299,7 +336,12 @@ namespace Ep128 {
     if (vm.cpuCyclesRemaining < -(vm.cpuCyclesPerNickCycle))
       vm.runDevices();
     vm.cpuCyclesRemaining -= (int64_t(1) << 32);
-    return vm.ioPorts.read(addr);
+    uint8_t   retval = vm.ioPorts.read(addr);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeIORead, addr, retval);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 5, addr, retval);
+    return retval;
   }
 
   EP128EMU_REGPARM1 void Ep128VM::Z80_::updateCycle()
@@ -568,7 +610,7 @@ namespace Ep128 {
       int     bpType = int(isWrite) + 1;
       if (!isWrite && uint16_t(vm.z80.getReg().PC.W.l) == addr)
         bpType = 0;
-      vm.breakPointCallback(vm.breakPointCallbackUserData, bpType, addr, value);
+      vm.runBreakPointCallback(bpType, addr, value);
     }
   }
 
@@ -588,8 +630,7 @@ namespace Ep128 {
                                              uint16_t addr, uint8_t value)
   {
     if (!vm.memory.checkIgnoreBreakPoint(vm.z80.getReg().PC.W.l)) {
-      vm.breakPointCallback(vm.breakPointCallbackUserData,
-                            int(isWrite) + 5, addr, value);
+      vm.runBreakPointCallback(int(isWrite) + 5, addr, value);
     }
   }
 
@@ -663,6 +704,8 @@ namespace Ep128 {
 
   void Ep128VM::Nick_::drawLine(const uint8_t *buf, size_t nBytes)
   {
+    if (EP128EMU_UNLIKELY(vm.reverseDebugMode > 1))
+      return;                   // replaying execution history
     if (vm.getIsDisplayEnabled())
       vm.display.drawLine(buf, nBytes);
     if (vm.videoCapture)
@@ -672,10 +715,14 @@ namespace Ep128 {
   void Ep128VM::Nick_::vsyncStateChange(bool newState,
                                         unsigned int currentSlot_)
   {
+    if (EP128EMU_UNLIKELY(vm.reverseDebugMode > 1))
+      return;
     if (vm.getIsDisplayEnabled())
       vm.display.vsyncStateChange(newState, currentSlot_);
     if (vm.videoCapture)
       vm.videoCapture->vsyncStateChange(newState, currentSlot_);
+    if (newState)
+      vm.runFrameHook();
   }
 
   // --------------------------------------------------------------------------
@@ -1301,6 +1348,47 @@ namespace Ep128 {
     vm.demoTimeCnt++;
   }
 
+  void Ep128VM::traceCallback(void *userData)
+  {
+    Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
+    vm.traceRecorder->advanceTime();
+  }
+
+  void Ep128VM::traceInstruction(uint16_t addr)
+  {
+    uint32_t  opcode = 0U;
+    for (int i = 3; i >= 0; i--) {
+      opcode = (opcode << 8)
+               | uint32_t(memory.readNoDebug(uint16_t((addr + i) & 0xFFFF)));
+    }
+    traceRecorder->addInstruction(addr, memory.getPage(uint8_t(addr >> 14)),
+                                  opcode);
+  }
+
+  void Ep128VM::traceAccess(uint8_t type_, uint16_t addr, uint8_t value)
+  {
+    uint8_t   segment = 0;
+    if (type_ < Ep128Emu::TraceRecorder::recordTypeIORead)
+      segment = memory.getPage(uint8_t(addr >> 14));
+    traceRecorder->addAccess(type_, addr, segment, value);
+  }
+
+  void Ep128VM::profilerCallback(void *userData)
+  {
+    Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
+    vm.profilerTimeBase += uint64_t(vm.cpuCyclesPerNickCycle);
+  }
+
+  void Ep128VM::profileInstruction(uint16_t addr)
+  {
+    // current time in Z80 half cycles
+    uint32_t  t = uint32_t((profilerTimeBase - uint64_t(cpuCyclesRemaining))
+                           >> 31);
+    profiler->addInstruction((uint32_t(memory.getPage(uint8_t(addr >> 14)))
+                              << 14) | uint32_t(addr & 0x3FFF),
+                             addr, uint16_t(z80.getReg().SP.W), t);
+  }
+
   void Ep128VM::videoCaptureCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
@@ -1551,6 +1639,7 @@ namespace Ep128 {
       nickCyclesRemainingH(0),
       cpuCyclesPerNickCycle(0L),
       cpuCyclesRemaining(-1L),
+      profilerTimeBase(0U),
       daveCyclesPerNickCycle(0L),
       daveCyclesRemaining(-1L),
       memoryWaitCycles_M1(0L),
@@ -1613,6 +1702,27 @@ namespace Ep128 {
       midiDevFlags(0xFF),
       midiSavedStatus(0x00)
 #endif
+      , reverseInsnCnt(0U),
+      reverseNextEventCnt(0U),
+      reverseRequestCnt(0U),
+      reverseStopCnt(0U),
+      reverseHitCnt(0U),
+      reverseInputEventPos(0),
+      reverseMemoryUsed(0),
+      reverseMemoryLimit(0),
+      reverseCheckpointTime(0),
+      reverseCheckpointInterval(0),
+      reverseWatchAddr(0xFFFFFFFFU),
+      reverseDebugMode(0),
+      reverseRequestType(0),
+      reverseReplayDone(false),
+      reverseRestoreFlag(false),
+      reverseSavedBreakPointCallback((void (*)(void *, int, uint16_t,
+                                               uint8_t)) 0),
+      reverseSavedBreakPointUserData((void *) 0),
+      reverseSavedFrameHook((void (*)(void *)) 0),
+      reverseSavedIOHook((void (*)(void *, int, uint16_t, uint8_t)) 0),
+      reverseSavedProfilerRunning(false)
   {
 #ifdef ENABLE_SDEXT
     memory.setSDExtPtr(&sdext);
@@ -1701,6 +1811,10 @@ namespace Ep128 {
 
   Ep128VM::~Ep128VM()
   {
+    reverseDebugMode = 0;
+    clearReverseHistory();
+    closeTraceFile();
+    stopProfiler();
     if (videoCapture) {
       delete videoCapture;
       videoCapture = (Ep128Emu::VideoCapture *) 0;
@@ -1734,6 +1848,13 @@ namespace Ep128 {
         dave.setTapeInput(0, 0);
       setCallback(&tapeCallback, this, tapeCallbackFlag);
     }
+    if (EP128EMU_UNLIKELY(reverseDebugMode != 0)) {
+      while (reverseDebugMode == 2)
+        processReverseRequest();
+      reverseCheckpointTime += int64_t(microseconds);
+      if (reverseCheckpointTime >= reverseCheckpointInterval)
+        saveReverseCheckpoint();
+    }
     {
       int64_t tmp =
           int64_t(nickCyclesRemainingL) | (int64_t(nickCyclesRemainingH) << 32);
@@ -1768,6 +1889,7 @@ namespace Ep128 {
 
   void Ep128VM::reset(bool isColdReset)
   {
+    clearReverseHistory();      // the reset cannot be replayed
     stopDemoPlayback();         // TODO: should be recorded as an event ?
     stopDemoRecording(false);
     z80.reset();
@@ -1918,6 +2040,13 @@ namespace Ep128 {
   {
     if (!isPlayingDemo)
       dave.setKeyboardState(keyCode, int(isPressed));
+    if (EP128EMU_UNLIKELY(reverseDebugMode != 0)) {
+      ReverseInputEvent e;
+      e.insnCnt = reverseInsnCnt;
+      e.keyCode = uint8_t(keyCode & 0x7F);
+      e.isPressed = isPressed;
+      reverseInputEvents.push_back(e);
+    }
     if (isRecordingDemo) {
       if (haveTape() && getIsTapeMotorOn() && getTapeButtonState() != 0) {
         stopDemoRecording(false);
@@ -1976,6 +2105,7 @@ namespace Ep128 {
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
     vmStatus_.tapeSampleSize = getTapeSampleSize();
+    vmStatus_.tapeMotorOn = getIsTapeRunning();
     uint32_t  n = 0U;
     for (int i = 3; i >= 0; i--) {
       n = n << 8;
@@ -1993,16 +2123,31 @@ namespace Ep128 {
 
   void Ep128VM::openVideoCapture(
       int frameRate_,
-      bool yuvFormat_,
+      int videoFormat_,
+      int frameHashInterval_,
+      bool frameHashPNG_,
       void (*errorCallback_)(void *userData, const char *msg),
       void (*fileNameCallback_)(void *userData, std::string& fileName),
       void *userData_)
   {
     if (!videoCapture) {
-      if (yuvFormat_) {
+      if (videoFormat_ == 1) {
         videoCapture = new Ep128Emu::VideoCapture_YV12(&Nick::convertPixelToRGB,
                                                        frameRate_);
       }
+      else if (videoFormat_ == 2) {
+        videoCapture = new Ep128Emu::VideoCapture_ZMBV(&Nick::convertPixelToRGB,
+                                                       frameRate_);
+      }
+      else if (videoFormat_ == 3) {
+        videoCapture = new Ep128Emu::VideoCapture_Y4M(&Nick::convertPixelToRGB,
+                                                      frameRate_);
+      }
+      else if (videoFormat_ == 4) {
+        videoCapture = new Ep128Emu::VideoCapture_FrameHash(
+                               &Nick::convertPixelToRGB, frameRate_,
+                               frameHashInterval_, frameHashPNG_);
+      }
       else {
         videoCapture = new Ep128Emu::VideoCapture_RLE8(&Nick::convertPixelToRGB,
                                                        frameRate_);
@@ -2204,6 +2349,7 @@ namespace Ep128 {
 
   void Ep128VM::setBreakPoint(const Ep128Emu::BreakPoint& bp, bool isEnabled)
   {
+    setBreakPointCondition(bp, isEnabled);
     if (EP128EMU_UNLIKELY(!isEnabled)) {
       if (bp.isIO()) {
         ioPorts.setBreakPoint(bp.addr(), 0, false, false);
@@ -2236,10 +2382,75 @@ namespace Ep128 {
 
   void Ep128VM::clearBreakPoints()
   {
+    clearBreakPointConditions();
     memory.clearAllBreakPoints();
     ioPorts.clearBreakPoints();
   }
 
+  void Ep128VM::openTraceFile(std::FILE *f, uint8_t flags)
+  {
+    closeTraceFile();
+    traceRecorder =
+        new Ep128Emu::TraceRecorder(f, uint32_t(nickFrequency), flags);
+    setCallback(&traceCallback, this, true);
+  }
+
+  void Ep128VM::closeTraceFile()
+  {
+    if (traceRecorder) {
+      setCallback(&traceCallback, this, false);
+      Ep128Emu::VirtualMachine::closeTraceFile();
+    }
+  }
+
+  void Ep128VM::startProfiler(bool callStackEnabled)
+  {
+    stopProfiler();
+    if (profiler) {
+      delete profiler;
+      profiler = (Ep128Emu::Profiler *) 0;
+    }
+    profiler = new Ep128Emu::Profiler(*this, 0xFFFFFFFFU, callStackEnabled);
+    profilerTimeBase = 0U;
+    setCallback(&profilerCallback, this, true);
+    profilerRunning = true;
+  }
+
+  void Ep128VM::stopProfiler()
+  {
+    if (profilerRunning) {
+      setCallback(&profilerCallback, this, false);
+      profilerRunning = false;
+    }
+  }
+
+  void Ep128VM::setAccessStatsEnabled(bool isEnabled)
+  {
+    memory.setAccessCountersEnabled(isEnabled);
+    ioPorts.setAccessCountersEnabled(isEnabled);
+  }
+
+  bool Ep128VM::getAccessStatsEnabled() const
+  {
+    return memory.getAccessCountersEnabled();
+  }
+
+  void Ep128VM::getMemoryAccessStats(uint32_t addr, uint64_t& readCnt,
+                                     uint64_t& writeCnt,
+                                     uint64_t& execCnt) const
+  {
+    readCnt = memory.getAccessCount(addr, 0);
+    writeCnt = memory.getAccessCount(addr, 1);
+    execCnt = memory.getAccessCount(addr, 2);
+  }
+
+  void Ep128VM::getIOPortAccessStats(uint16_t addr, uint64_t& readCnt,
+                                     uint64_t& writeCnt) const
+  {
+    readCnt = ioPorts.getAccessCount(addr, 0);
+    writeCnt = ioPorts.getAccessCount(addr, 1);
+  }
+
   void Ep128VM::setBreakPointPriorityThreshold(int n)
   {
     breakPointPriorityThreshold = uint8_t(n > 0 ? (n < 4 ? n : 4) : 0);
@@ -2467,7 +2678,8 @@ namespace Ep128 {
                                            int32_t offs) const
   {
     return Z80Disassembler::disassembleInstruction(buf, (*this),
-                                                   addr, isCPUAddress, offs);
+                                                   addr, isCPUAddress, offs,
+                                                   &getSymbolTable());
   }
 
   Z80_REGISTERS& Ep128VM::getZ80Registers()
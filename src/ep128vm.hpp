@@ -40,6 +40,7 @@
 #endif
 
 #include <map>
+#include <vector>
 
 namespace Ep128Emu {
   class VideoCapture;
@@ -140,6 +141,7 @@ namespace Ep128 {
     int32_t   nickCyclesRemainingH;
     int64_t   cpuCyclesPerNickCycle;    // in 2^-32 Z80 cycle units
     int64_t   cpuCyclesRemaining;       // in 2^-32 Z80 cycle units
+    uint64_t  profilerTimeBase;         // in 2^-32 Z80 cycle units
     int64_t   daveCyclesPerNickCycle;   // in 2^-32 DAVE cycle units
     int64_t   daveCyclesRemaining;      // in 2^-32 DAVE cycle units
     int64_t   memoryWaitCycles_M1;      // in 2^-32 Z80 cycle units
@@ -240,6 +242,51 @@ namespace Ep128 {
     uint8_t   midiSavedStatus;
     uint8_t   midiBuffer[256];
 #endif
+    // reverse debugging (see revdebug.cpp)
+    struct ReverseCheckpoint {
+      Ep128Emu::File  *snapshot;
+      // number of instructions executed before the snapshot was taken
+      uint64_t  insnCnt;
+    };
+    struct ReverseInputEvent {
+      uint64_t  insnCnt;                // instruction count at the event
+      uint8_t   keyCode;
+      bool      isPressed;
+    };
+    std::vector< ReverseCheckpoint >  reverseCheckpoints;
+    std::vector< ReverseInputEvent >  reverseInputEvents;
+    // number of opcode fetches since reverse debugging was enabled
+    uint64_t  reverseInsnCnt;
+    // reverseDebugEvent() is called when reverseInsnCnt reaches this value
+    uint64_t  reverseNextEventCnt;
+    // instruction count at the time of the last reverseExecute() request
+    uint64_t  reverseRequestCnt;
+    // replay stops at this instruction count
+    uint64_t  reverseStopCnt;
+    // last instruction found while searching (0: none)
+    uint64_t  reverseHitCnt;
+    size_t    reverseInputEventPos;     // next event to replay
+    size_t    reverseMemoryUsed;        // total size of checkpoints in bytes
+    size_t    reverseMemoryLimit;
+    int64_t   reverseCheckpointTime;    // microseconds since last checkpoint
+    int64_t   reverseCheckpointInterval;
+    uint32_t  reverseWatchAddr;
+    // 0: disabled, 1: recording history, 2: reverseExecute() request
+    // pending, 3: searching for breakpoints or writes, 4: replaying to
+    // reverseStopCnt
+    uint8_t   reverseDebugMode;
+    uint8_t   reverseRequestType;       // 'mode' of reverseExecute()
+    bool      reverseReplayDone;
+    // true while loading a checkpoint, so that loadState() does not reset
+    // devices and stop demos
+    bool      reverseRestoreFlag;
+    void      (*reverseSavedBreakPointCallback)(void *userData, int type,
+                                                uint16_t addr, uint8_t value);
+    void      *reverseSavedBreakPointUserData;
+    void      (*reverseSavedFrameHook)(void *userData);
+    void      (*reverseSavedIOHook)(void *userData, int type,
+                                    uint16_t addr, uint8_t value);
+    bool      reverseSavedProfilerRunning;
     // ----------------
     void updateTimingParameters();
     void setMemoryWaitTiming();
@@ -298,7 +345,27 @@ namespace Ep128 {
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
     uint8_t checkSingleStepModeBreak();
+    static void traceCallback(void *userData);
+    void traceInstruction(uint16_t addr);
+    void traceAccess(uint8_t type_, uint16_t addr, uint8_t value);
+    static void profilerCallback(void *userData);
+    void profileInstruction(uint16_t addr);
     void spectrumEmulatorNMI_AttrWrite(uint32_t addr, uint8_t value);
+    inline void reverseDebugInstruction()
+    {
+      if (++reverseInsnCnt >= reverseNextEventCnt)
+        reverseDebugEvent();
+    }
+    void reverseDebugEvent();
+    static void reverseBreakPointCallback(void *userData, int type,
+                                          uint16_t addr, uint8_t value);
+    void saveReverseCheckpoint();
+    void loadReverseCheckpoint(size_t n);
+    size_t findReverseCheckpoint(uint64_t insnCnt) const;
+    void runReverseReplay(uint64_t stopCnt);
+    void processReverseRequest();
+    void endReverseReplay();
+    void clearReverseHistory();
     void updateRTC();
     void resetCMOSMemory();
     void resetFloppyDrives(bool isColdReset);
@@ -393,13 +460,18 @@ namespace Ep128 {
     virtual void getVMStatus(VirtualMachine::VMStatus& vmStatus_);
     /*!
      * Create video capture object with the specified frame rate (24 to 60)
-     * and format (768x576 RLE8 or 384x288 YV12) if it does not exist yet,
-     * and optionally set callbacks for printing error messages and asking
-     * for a new output file on reaching 2 GB file size.
+     * and format (0: 768x576 RLE8, 1: 384x288 YV12, 2: 768x576 ZMBV,
+     * 3: 768x576 YUV4MPEG2 and WAV, 4: frame hash log) if it does not exist
+     * yet, and optionally set callbacks for printing error messages and
+     * asking for a new output file when the index of the AVI file is full.
+     * For the frame hash log, every 'frameHashInterval_'th frame is hashed,
+     * and also saved as a PNG image if 'frameHashPNG_' is true.
      */
     virtual void openVideoCapture(
         int frameRate_ = 50,
-        bool yuvFormat_ = false,
+        int videoFormat_ = 0,
+        int frameHashInterval_ = 1,
+        bool frameHashPNG_ = false,
         void (*errorCallback_)(void *userData, const char *msg) =
             (void (*)(void *, const char *)) 0,
         void (*fileNameCallback_)(void *userData, std::string& fileName) =
@@ -488,6 +560,43 @@ namespace Ep128 {
      */
     virtual void setBreakPoint(const Ep128Emu::BreakPoint& bp,
                                bool isEnabled = true);
+    /*!
+     * Start recording a binary execution trace to 'f' (see vm.hpp).
+     */
+    virtual void openTraceFile(std::FILE *f, uint8_t flags = 0);
+    /*!
+     * Stop recording the execution trace, and close the file.
+     */
+    virtual void closeTraceFile();
+    /*!
+     * Start collecting profiler data (see vm.hpp).
+     */
+    virtual void startProfiler(bool callStackEnabled = false);
+    /*!
+     * Stop collecting profiler data.
+     */
+    virtual void stopProfiler();
+    /*!
+     * Start or stop counting memory and I/O port accesses (see vm.hpp).
+     */
+    virtual void setAccessStatsEnabled(bool isEnabled);
+    virtual bool getAccessStatsEnabled() const;
+    virtual void getMemoryAccessStats(uint32_t addr, uint64_t& readCnt,
+                                      uint64_t& writeCnt,
+                                      uint64_t& execCnt) const;
+    virtual void getIOPortAccessStats(uint16_t addr, uint64_t& readCnt,
+                                      uint64_t& writeCnt) const;
+    /*!
+     * Enable or disable recording the execution history for reverse
+     * debugging, and go back in it from the breakpoint callback (see
+     * vm.hpp). Mouse, tape, disk, and real time clock input is not
+     * replayed, so the history may not be accurate while these are used.
+     */
+    virtual void setReverseDebugEnabled(bool isEnabled,
+                                        double checkpointInterval = 0.1,
+                                        size_t maxMemoryMB = 64);
+    virtual bool getReverseDebugEnabled() const;
+    virtual void reverseExecute(int mode, uint32_t addr = 0U);
     /*!
      * Clear all breakpoints.
      */
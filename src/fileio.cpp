@@ -633,6 +633,14 @@ namespace Ep128Emu {
       throw Exception("CRC error in file data");
   }
 
+  void File::appendEndOfFileChunk()
+  {
+    size_t  startPos = buf.getPosition();
+    buf.writeUInt32(uint32_t(EP128EMU_CHUNKTYPE_END_OF_FILE));
+    buf.writeUInt32(0U);
+    buf.writeUInt32(hash_32(buf.getData() + startPos, 8));
+  }
+
   void File::writeFile(const char *fileName, bool useHomeDirectory,
                        bool enableCompression)
   {
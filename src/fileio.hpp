@@ -135,6 +135,9 @@ namespace Ep128Emu {
    public:
     void addChunk(ChunkType type, const Buffer& buf_);
     void processAllChunks();
+    // append the 'end of file' chunk without writing or clearing the data,
+    // so that processAllChunks() can be used on a snapshot kept in memory
+    void appendEndOfFileChunk();
     void writeFile(const char *fileName, bool useHomeDirectory = false,
                    bool enableCompression = false);
     void registerChunkType(ChunkTypeHandler *);
@@ -241,6 +241,75 @@ namespace Ep128Emu {
 
   // --------------------------------------------------------------------------
 
+  FLTKDisplay_::DecoderThread::DecoderThread()
+    : Thread(),
+      doneLock(),
+      func((void (*)(void *, int, int)) 0),
+      userData((void *) 0),
+      bandNum(0),
+      nBands(1),
+      exitFlag(false)
+  {
+  }
+
+  FLTKDisplay_::DecoderThread::~DecoderThread()
+  {
+    exitFlag = true;
+    join();
+  }
+
+  void FLTKDisplay_::DecoderThread::startJob(void (*func_)(void *, int, int),
+                                             void *userData_,
+                                             int bandNum_, int nBands_)
+  {
+    func = func_;
+    userData = userData_;
+    bandNum = bandNum_;
+    nBands = nBands_;
+    start();
+  }
+
+  void FLTKDisplay_::DecoderThread::run()
+  {
+    while (true) {
+      if (exitFlag)
+        break;
+      if (func)
+        func(userData, bandNum, nBands);
+      doneLock.notify();
+      wait();
+    }
+  }
+
+  void FLTKDisplay_::runDecoderThreads(void (*func)(void *userData,
+                                                    int bandNum, int nBands),
+                                       void *userData)
+  {
+    if (EP128EMU_UNLIKELY(decoderThreadCnt < 0)) {
+      // use up to 4 threads (including this one), one per processor
+      int     nThreads = getProcessorCount() - 1;
+      nThreads = (nThreads < 3 ? nThreads : 3);
+      decoderThreadCnt = 0;
+      try {
+        while (decoderThreadCnt < nThreads) {
+          decoderThreads[decoderThreadCnt] = new DecoderThread();
+          decoderThreadCnt++;
+        }
+      }
+      catch (...) {
+        // not enough resources: continue with the threads already created
+      }
+    }
+    int     nBands = decoderThreadCnt + 1;
+    for (int i = 0; i < decoderThreadCnt; i++)
+      decoderThreads[i]->startJob(func, userData, i, nBands);
+    func(userData, decoderThreadCnt, nBands);
+    for (int i = 0; i < decoderThreadCnt; i++)
+      decoderThreads[i]->waitJob();
+  }
+
+  // --------------------------------------------------------------------------
+
   FLTKDisplay_::FLTKDisplay_()
     : VideoDisplay(),
       messageQueue((Message *) 0),
@@ -258,14 +327,18 @@ namespace Ep128Emu {
       videoResampleEnabled(false),
       exitFlag(false),
       limitFrameRateFlag(false),
+      warpModeFlag(false),
       displayParameters(),
       savedDisplayParameters(),
       fltkEventCallback(&defaultFLTKEventCallback),
       fltkEventCallbackUserData((void *) 0),
       screenshotCallback((void (*)(void *, const unsigned char *, int, int)) 0),
       screenshotCallbackUserData((void *) 0),
-      screenshotCallbackFlag(false)
+      screenshotCallbackFlag(false),
+      decoderThreadCnt(-1)
   {
+    for (int i = 0; i < 3; i++)
+      decoderThreads[i] = (DecoderThread *) 0;
     try {
       lineBuffers = new Message_LineData*[578];
       for (size_t n = 0; n < 578; n++)
@@ -280,6 +353,8 @@ namespace Ep128Emu {
 
   FLTKDisplay_::~FLTKDisplay_()
   {
+    for (int i = 0; i < decoderThreadCnt; i++)
+      delete decoderThreads[i];
     messageQueueMutex.lock();
     exitFlag = true;
     while (freeMessageStack) {
@@ -371,8 +446,9 @@ namespace Ep128Emu {
     if (!skippedFrame)
       framesPending++;
     bool    overrunFlag = (framesPending > 3);  // should this be configurable ?
+    bool    limitFlag = (limitFrameRateFlag || warpModeFlag);
     skippingFrame = overrunFlag;
-    if (limitFrameRateFlag) {
+    if (limitFlag) {
       if (limitFrameRateTimer.getRealTime() < 0.02)
         skippingFrame = true;
       else
@@ -380,7 +456,7 @@ namespace Ep128Emu {
     }
     messageQueueMutex.unlock();
     if (skippedFrame) {
-      if (overrunFlag || !limitFrameRateFlag) {
+      if (overrunFlag || !limitFlag) {
         Fl::awake();
         threadLock.wait(1);
       }
@@ -424,6 +500,11 @@ namespace Ep128Emu {
     limitFrameRateFlag = isEnabled;
   }
 
+  void FLTKDisplay_::setWarpMode(bool isEnabled)
+  {
+    warpModeFlag = isEnabled;
+  }
+
   void FLTKDisplay_::checkScreenshotCallback()
   {
     if (!screenshotCallbackFlag)
@@ -552,7 +633,9 @@ namespace Ep128Emu {
       forceUpdateLineMask(0),
       redrawFlag(false),
       prvFrameWasOdd(false),
-      lastLineNum(-2)
+      lastLineNum(-2),
+      frameWidth(0),
+      frameHalfResolutionX(false)
   {
     displayParameters.displayQuality = 0;
     displayParameters.bufferingMode = 0;
@@ -633,211 +716,35 @@ namespace Ep128Emu {
       }
       forceUpdateLineMask = 0;
     }
-    unsigned char lineBuf_[768];
-    unsigned char *pixelBuf_ =
-        (unsigned char *) std::calloc(size_t(displayWidth_ * 4 * 3),
-                                      sizeof(unsigned char));
-    int   lineNumbers_[5];
-    if (pixelBuf_) {
+    try {
+      pixelBuf.resize(size_t(displayWidth_) * size_t(displayHeight_) * 3);
+      rowLineNumbers.resize(size_t(displayHeight_));
+      rowGroupsChanged.resize(size_t((displayHeight_ + 3) >> 2));
+    }
+    catch (...) {
+      return;
+    }
+    // find the line to be displayed in each row, and the groups of 4 rows
+    // that have changed
+    {
       int   curLine_ = 2;
       int   fracY_ = 0;
-      bool  skippingLines_ = true;
-      lineNumbers_[3] = -2;
       for (int yc = 0; yc < displayHeight_; yc++) {
-        int   ycAnd3 = yc & 3;
-        if (ycAnd3 == 0) {
-          skippingLines_ = true;
-          lineNumbers_[4] = lineNumbers_[3];
-        }
+        if (!(yc & 3))
+          rowGroupsChanged[yc >> 2] = 0;
         int   l0 = curLine_;
         if (lineBuffers[l0]) {
-          lineNumbers_[ycAnd3] = l0;
+          rowLineNumbers[yc] = l0;
         }
         else if (lineBuffers[l0 - 1]) {
           l0 = l0 - 1;
-          lineNumbers_[ycAnd3] = l0;
+          rowLineNumbers[yc] = l0;
         }
         else {
-          lineNumbers_[ycAnd3] = -1;
+          rowLineNumbers[yc] = -1;
         }
         if (linesChanged[l0 >> 1])
-          skippingLines_ = false;
-        if (ycAnd3 == 3 || yc == (displayHeight_ - 1)) {
-          if (!skippingLines_) {
-            int   nLines_ = 4;
-            if (ycAnd3 != 3)
-              nLines_ = displayHeight_ & 3;
-            for (int yTmp = 0; yTmp < nLines_; yTmp++) {
-              unsigned char *p = &(pixelBuf_[displayWidth_ * yTmp * 3]);
-              if (yTmp == 0) {
-                if (lineNumbers_[0] == lineNumbers_[4] ||
-                    (lineNumbers_[0] >= 0 && lineNumbers_[4] >= 0 &&
-                     *(lineBuffers[lineNumbers_[0]])
-                     == *(lineBuffers[lineNumbers_[4]]))) {
-                  std::memcpy(p, &(pixelBuf_[displayWidth_ * 3 * 3]),
-                              size_t(displayWidth_ * 3));
-                  continue;
-                }
-              }
-              else {
-                if (lineNumbers_[yTmp] == lineNumbers_[yTmp - 1] ||
-                    (lineNumbers_[yTmp - 1] >= 0 && lineNumbers_[yTmp] >= 0 &&
-                     *(lineBuffers[lineNumbers_[yTmp]])
-                     == *(lineBuffers[lineNumbers_[yTmp - 1]]))) {
-                  std::memcpy(p, &(pixelBuf_[displayWidth_ * (yTmp - 1) * 3]),
-                              size_t(displayWidth_ * 3));
-                  continue;
-                }
-              }
-              if (lineNumbers_[yTmp] >= 0) {
-                // decode video data
-                const unsigned char *bufp = (unsigned char *) 0;
-                size_t  nBytes = 0;
-                lineBuffers[lineNumbers_[yTmp]]->getLineData(bufp, nBytes);
-                decodeLine(&(lineBuf_[0]), bufp, nBytes);
-                // convert to RGB
-                bufp = &(lineBuf_[0]);
-                switch (displayWidth_) {
-                case 384:
-                  do {
-                    uint32_t  tmp = colormap(bufp[0], bufp[1]);
-                    p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    bufp = bufp + 2;
-                    p = p + 3;
-                  } while (bufp < &(lineBuf_[768]));
-                  break;
-                case 768:
-                  do {
-                    uint32_t  tmp = colormap(bufp[0]);
-                    p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = colormap(bufp[1]);
-                    p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    bufp = bufp + 2;
-                    p = p + 6;
-                  } while (bufp < &(lineBuf_[768]));
-                  break;
-                case 1152:
-                  do {
-                    uint32_t  tmp = colormap(bufp[0]);
-                    p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = colormap(bufp[0], bufp[1]);
-                    p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = colormap(bufp[1]);
-                    p[8] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[7] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[6] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    bufp = bufp + 2;
-                    p = p + 9;
-                  } while (bufp < &(lineBuf_[768]));
-                  break;
-                case 1536:
-                  do {
-                    uint32_t  tmp = colormap(*bufp);
-                    p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    tmp = tmp >> 8;
-                    p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
-                    bufp++;
-                    p = p + 6;
-                  } while (bufp < &(lineBuf_[768]));
-                  break;
-                default:
-                  {
-                    int       fracX_ = displayWidth_;
-                    uint32_t  c = 0U;
-                    if (!halfResolutionX_) {
-                      fracX_ = (fracX_ >= 768 ? fracX_ : 768);
-                      while (true) {
-                        if (fracX_ >= displayWidth_) {
-                          if (bufp >= &(lineBuf_[768]))
-                            break;
-                          do {
-                            c = colormap(*bufp);
-                            fracX_ -= displayWidth_;
-                            bufp++;
-                          } while (fracX_ >= displayWidth_);
-                        }
-                        {
-                          uint32_t  tmp = c;
-                          p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                          tmp = tmp >> 8;
-                          p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                          tmp = tmp >> 8;
-                          p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                        }
-                        fracX_ += 768;
-                        p += 3;
-                      }
-                    }
-                    else {
-                      fracX_ = (fracX_ >= 384 ? fracX_ : 384);
-                      while (true) {
-                        if (fracX_ >= displayWidth_) {
-                          if (bufp >= &(lineBuf_[768]))
-                            break;
-                          do {
-                            c = colormap(bufp[0], bufp[1]);
-                            fracX_ -= displayWidth_;
-                            bufp += 2;
-                          } while (fracX_ >= displayWidth_);
-                        }
-                        {
-                          uint32_t  tmp = c;
-                          p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
-                          tmp = tmp >> 8;
-                          p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
-                          tmp = tmp >> 8;
-                          p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
-                        }
-                        fracX_ += 384;
-                        p += 3;
-                      }
-                    }
-                  }
-                }
-              }
-              else {
-                uint32_t  c = colormap(0x00);
-                for (int xc = 0; xc < displayWidth_; xc++) {
-                  p[0] = (unsigned char) ((c >> 16) & 0xFF);
-                  p[1] = (unsigned char) ((c >> 8) & 0xFF);
-                  p[2] = (unsigned char) (c & 0xFF);
-                  p = p + 3;
-                }
-              }
-            }
-            fl_draw_image(pixelBuf_, x0, y0 + (yc & (~(int(3)))),
-                          displayWidth_, nLines_);
-          }
-          else
-            lineNumbers_[3] = -2;
-        }
+          rowGroupsChanged[yc >> 2] = 1;
         if (!halfResolutionY_) {
           fracY_ += 576;
           while (fracY_ >= displayHeight_) {
@@ -853,9 +760,209 @@ namespace Ep128Emu {
           }
         }
       }
-      std::free(pixelBuf_);
-      for (size_t yc = 0; yc < 289; yc++)
-        linesChanged[yc] = false;
+    }
+    // decode and convert the changed rows to RGB on multiple threads
+    frameWidth = displayWidth_;
+    frameHalfResolutionX = halfResolutionX_;
+    runDecoderThreads(&convertLinesCallback, (void *) this);
+    // draw each continuous range of changed rows with a single call
+    int     nGroups = int(rowGroupsChanged.size());
+    for (int i = 0; i < nGroups; ) {
+      if (!rowGroupsChanged[i]) {
+        i++;
+        continue;
+      }
+      int     yc = i << 2;
+      do {
+        i++;
+      } while (i < nGroups && rowGroupsChanged[i]);
+      int     nLines_ = (i << 2) - yc;
+      nLines_ = (nLines_ < (displayHeight_ - yc) ?
+                 nLines_ : (displayHeight_ - yc));
+      fl_draw_image(&(pixelBuf[size_t(displayWidth_) * size_t(yc) * 3]),
+                    x0, y0 + yc, displayWidth_, nLines_);
+    }
+    for (size_t yc = 0; yc < 289; yc++)
+      linesChanged[yc] = false;
+  }
+
+  void FLTKDisplay::convertLine(unsigned char *p, int lineNum,
+                                int displayWidth_, bool halfResolutionX_) const
+  {
+    if (lineNum < 0) {
+      uint32_t  c = colormap(0x00);
+      for (int xc = 0; xc < displayWidth_; xc++) {
+        p[0] = (unsigned char) ((c >> 16) & 0xFF);
+        p[1] = (unsigned char) ((c >> 8) & 0xFF);
+        p[2] = (unsigned char) (c & 0xFF);
+        p = p + 3;
+      }
+      return;
+    }
+    // decode video data
+    unsigned char lineBuf_[768];
+    const unsigned char *bufp = (unsigned char *) 0;
+    size_t  nBytes = 0;
+    lineBuffers[lineNum]->getLineData(bufp, nBytes);
+    decodeLine(&(lineBuf_[0]), bufp, nBytes);
+    // convert to RGB
+    bufp = &(lineBuf_[0]);
+    switch (displayWidth_) {
+    case 384:
+      do {
+        uint32_t  tmp = colormap(bufp[0], bufp[1]);
+        p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+        bufp = bufp + 2;
+        p = p + 3;
+      } while (bufp < &(lineBuf_[768]));
+      break;
+    case 768:
+      do {
+        uint32_t  tmp = colormap(bufp[0]);
+        p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = colormap(bufp[1]);
+        p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
+        bufp = bufp + 2;
+        p = p + 6;
+      } while (bufp < &(lineBuf_[768]));
+      break;
+    case 1152:
+      do {
+        uint32_t  tmp = colormap(bufp[0]);
+        p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = colormap(bufp[0], bufp[1]);
+        p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = colormap(bufp[1]);
+        p[8] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[7] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[6] = (unsigned char) tmp & (unsigned char) 0xFF;
+        bufp = bufp + 2;
+        p = p + 9;
+      } while (bufp < &(lineBuf_[768]));
+      break;
+    case 1536:
+      do {
+        uint32_t  tmp = colormap(*bufp);
+        p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+        p[5] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+        p[4] = (unsigned char) tmp & (unsigned char) 0xFF;
+        tmp = tmp >> 8;
+        p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+        p[3] = (unsigned char) tmp & (unsigned char) 0xFF;
+        bufp++;
+        p = p + 6;
+      } while (bufp < &(lineBuf_[768]));
+      break;
+    default:
+      {
+        int       fracX_ = displayWidth_;
+        uint32_t  c = 0U;
+        if (!halfResolutionX_) {
+          fracX_ = (fracX_ >= 768 ? fracX_ : 768);
+          while (true) {
+            if (fracX_ >= displayWidth_) {
+              if (bufp >= &(lineBuf_[768]))
+                break;
+              do {
+                c = colormap(*bufp);
+                fracX_ -= displayWidth_;
+                bufp++;
+              } while (fracX_ >= displayWidth_);
+            }
+            {
+              uint32_t  tmp = c;
+              p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+              tmp = tmp >> 8;
+              p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+              tmp = tmp >> 8;
+              p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+            }
+            fracX_ += 768;
+            p += 3;
+          }
+        }
+        else {
+          fracX_ = (fracX_ >= 384 ? fracX_ : 384);
+          while (true) {
+            if (fracX_ >= displayWidth_) {
+              if (bufp >= &(lineBuf_[768]))
+                break;
+              do {
+                c = colormap(bufp[0], bufp[1]);
+                fracX_ -= displayWidth_;
+                bufp += 2;
+              } while (fracX_ >= displayWidth_);
+            }
+            {
+              uint32_t  tmp = c;
+              p[2] = (unsigned char) tmp & (unsigned char) 0xFF;
+              tmp = tmp >> 8;
+              p[1] = (unsigned char) tmp & (unsigned char) 0xFF;
+              tmp = tmp >> 8;
+              p[0] = (unsigned char) tmp & (unsigned char) 0xFF;
+            }
+            fracX_ += 384;
+            p += 3;
+          }
+        }
+      }
+    }
+  }
+
+  void FLTKDisplay::convertLinesCallback(void *userData,
+                                         int bandNum, int nBands)
+  {
+    FLTKDisplay&  this_ = *(reinterpret_cast<FLTKDisplay *>(userData));
+    int     w = this_.frameWidth;
+    int     h = int(this_.rowLineNumbers.size());
+    int     nGroups = int(this_.rowGroupsChanged.size());
+    // each band is a range of groups of 4 rows
+    int     yc = ((nGroups * bandNum) / nBands) << 2;
+    int     ycEnd = ((nGroups * (bandNum + 1)) / nBands) << 2;
+    int     yFirst = yc;
+    ycEnd = (ycEnd < h ? ycEnd : h);
+    const int *lineNumbers_ = &(this_.rowLineNumbers[0]);
+    for ( ; yc < ycEnd; yc++) {
+      if (!this_.rowGroupsChanged[yc >> 2])
+        continue;
+      unsigned char *p = &(this_.pixelBuf[size_t(w) * size_t(yc) * 3]);
+      // if the previous row has the same content and is decoded by this
+      // thread, it can be copied
+      if (yc > yFirst && this_.rowGroupsChanged[(yc - 1) >> 2]) {
+        int     l0 = lineNumbers_[yc - 1];
+        int     l1 = lineNumbers_[yc];
+        if (l0 == l1 ||
+            (l0 >= 0 && l1 >= 0 &&
+             *(this_.lineBuffers[l1]) == *(this_.lineBuffers[l0]))) {
+          std::memcpy(p, p - (w * 3), size_t(w * 3));
+          continue;
+        }
+      }
+      this_.convertLine(p, lineNumbers_[yc], w, this_.frameHalfResolutionX);
     }
   }
 
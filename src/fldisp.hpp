@@ -26,6 +26,8 @@
 
 #include <FL/Fl_Window.H>
 
+#include <vector>
+
 namespace Ep128Emu {
 
   class FLTKDisplay_ : public VideoDisplay {
@@ -141,6 +143,37 @@ namespace Ep128Emu {
     void frameDone();
     void checkScreenshotCallback();
     // ----------------
+    class DecoderThread : public Thread {
+     private:
+      ThreadLock    doneLock;
+      void          (*func)(void *userData, int bandNum, int nBands);
+      void          *userData;
+      int           bandNum;
+      int           nBands;
+      volatile bool exitFlag;
+     public:
+      DecoderThread();
+      virtual ~DecoderThread();
+      void startJob(void (*func_)(void *, int, int), void *userData_,
+                    int bandNum_, int nBands_);
+      inline void waitJob()
+      {
+        doneLock.wait();
+      }
+     protected:
+      virtual void run();
+    };
+    /*!
+     * Call func(userData, n, nBands) for n = 0 to nBands - 1 in parallel,
+     * and return when all calls have finished. 'nBands' is the number of
+     * decoder threads plus one, as the calling thread also processes a band.
+     * This is used by the derived classes to decode and convert the lines
+     * of a frame split into horizontal bands; 'func' must not throw.
+     */
+    void runDecoderThreads(void (*func)(void *userData,
+                                        int bandNum, int nBands),
+                           void *userData);
+    // ----------------
     Message       *messageQueue;
     Message       *lastMessage;
     Message       *freeMessageStack;
@@ -157,6 +190,7 @@ namespace Ep128Emu {
     volatile bool videoResampleEnabled;
     volatile bool exitFlag;
     volatile bool limitFrameRateFlag;
+    volatile bool warpModeFlag;
     DisplayParameters   displayParameters;
     DisplayParameters   savedDisplayParameters;
     Timer         limitFrameRateTimer;
@@ -167,6 +201,10 @@ namespace Ep128Emu {
                                         const unsigned char *, int, int);
     void          *screenshotCallbackUserData;
     bool          screenshotCallbackFlag;
+    // worker threads for runDecoderThreads(), created on first use
+    DecoderThread *decoderThreads[3];
+    // number of decoder threads, or -1 if not created yet
+    int           decoderThreadCnt;
    public:
     FLTKDisplay_();
     virtual ~FLTKDisplay_();
@@ -235,6 +273,11 @@ namespace Ep128Emu {
      * maximum of 50.
      */
     virtual void limitFrameRate(bool isEnabled);
+    /*!
+     * If enabled, limit the frame rate to 50 frames per second, similarly
+     * to limitFrameRate(), while the emulation is running in warp mode.
+     */
+    virtual void setWarpMode(bool isEnabled);
    protected:
     virtual void draw();
    public:
@@ -264,6 +307,10 @@ namespace Ep128Emu {
       }
     };
     void displayFrame();
+    // convert line 'lineNum' (-1: blank line) to 'displayWidth' RGB pixels
+    void convertLine(unsigned char *p, int lineNum,
+                     int displayWidth_, bool halfResolutionX_) const;
+    static void convertLinesCallback(void *userData, int bandNum, int nBands);
     // ----------------
     Colormap      colormap;
     /*!
@@ -277,6 +324,14 @@ namespace Ep128Emu {
     int           lastLineNum;
     Timer         noInputTimer;
     Timer         forceUpdateTimer;
+    // RGB image of the display area, written by convertLinesCallback()
+    std::vector< unsigned char >  pixelBuf;
+    // line number for each row of pixelBuf (-1 if there is no line)
+    std::vector< int >  rowLineNumbers;
+    // non-zero for each group of 4 rows that needs to be redrawn
+    std::vector< unsigned char >  rowGroupsChanged;
+    int           frameWidth;
+    bool          frameHalfResolutionX;
    public:
     FLTKDisplay(int xx = 0, int yy = 0, int ww = 768, int hh = 576,
                 const char *lbl = (char *) 0);
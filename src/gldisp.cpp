@@ -39,9 +39,16 @@ typedef void (APIENTRY *PFNGLBLENDCOLORPROC)(GLclampf, GLclampf, GLclampf,
 #  endif
 #endif
 
+#if defined(ENABLE_GL_SHADERS) && defined(GL_PIXEL_UNPACK_BUFFER)
+// use pixel buffer objects (OpenGL 2.1) for uploading the frame in quality=0
+// mode, if supported at run time
+#  define ENABLE_GL_PIXEL_BUFFERS   1
+#endif
+
 #ifndef WIN32
 #  define   glBlendColor_         glBlendColor
 #  ifdef ENABLE_GL_SHADERS
+#    define glActiveTexture_      glActiveTexture
 #    define glAttachShader_       glAttachShader
 #    define glCompileShader_      glCompileShader
 #    define glCreateProgram_      glCreateProgram
@@ -57,6 +64,14 @@ typedef void (APIENTRY *PFNGLBLENDCOLORPROC)(GLclampf, GLclampf, GLclampf,
 #    define glUniform1i_          glUniform1i
 #    define glUseProgram_         glUseProgram
 #  endif
+#  ifdef ENABLE_GL_PIXEL_BUFFERS
+#    define glBindBuffer_         glBindBuffer
+#    define glBufferData_         glBufferData
+#    define glDeleteBuffers_      glDeleteBuffers
+#    define glGenBuffers_         glGenBuffers
+#    define glMapBuffer_          glMapBuffer
+#    define glUnmapBuffer_        glUnmapBuffer
+#  endif
 #else
 static PFNGLBLENDCOLORPROC      glBlendColor__ = (PFNGLBLENDCOLORPROC) 0;
 static inline void glBlendColor_(GLclampf r, GLclampf g, GLclampf b, GLclampf a)
@@ -68,6 +83,7 @@ static inline void glBlendColor_(GLclampf r, GLclampf g, GLclampf b, GLclampf a)
 }
 #  ifdef ENABLE_GL_SHADERS
 static volatile bool  haveGLShaderFuncs = false;
+static PFNGLACTIVETEXTUREPROC   glActiveTexture_ = (PFNGLACTIVETEXTUREPROC) 0;
 static PFNGLATTACHSHADERPROC    glAttachShader_ = (PFNGLATTACHSHADERPROC) 0;
 static PFNGLCOMPILESHADERPROC   glCompileShader_ = (PFNGLCOMPILESHADERPROC) 0;
 static PFNGLCREATEPROGRAMPROC   glCreateProgram_ = (PFNGLCREATEPROGRAMPROC) 0;
@@ -86,6 +102,10 @@ static PFNGLUSEPROGRAMPROC      glUseProgram_ = (PFNGLUSEPROGRAMPROC) 0;
 static bool queryGLShaderFunctions()
 {
   if (!haveGLShaderFuncs) {
+    glActiveTexture_ =
+        (PFNGLACTIVETEXTUREPROC) wglGetProcAddress("glActiveTexture");
+    if (!glActiveTexture_)
+      return false;
     glAttachShader_ =
         (PFNGLATTACHSHADERPROC) wglGetProcAddress("glAttachShader");
     if (!glAttachShader_)
@@ -147,6 +167,42 @@ static bool queryGLShaderFunctions()
   return haveGLShaderFuncs;
 }
 #  endif
+#  ifdef ENABLE_GL_PIXEL_BUFFERS
+static volatile bool  haveGLBufferFuncs = false;
+static PFNGLBINDBUFFERPROC      glBindBuffer_ = (PFNGLBINDBUFFERPROC) 0;
+static PFNGLBUFFERDATAPROC      glBufferData_ = (PFNGLBUFFERDATAPROC) 0;
+static PFNGLDELETEBUFFERSPROC   glDeleteBuffers_ = (PFNGLDELETEBUFFERSPROC) 0;
+static PFNGLGENBUFFERSPROC      glGenBuffers_ = (PFNGLGENBUFFERSPROC) 0;
+static PFNGLMAPBUFFERPROC       glMapBuffer_ = (PFNGLMAPBUFFERPROC) 0;
+static PFNGLUNMAPBUFFERPROC     glUnmapBuffer_ = (PFNGLUNMAPBUFFERPROC) 0;
+static bool queryGLBufferFunctions()
+{
+  if (!haveGLBufferFuncs) {
+    glBindBuffer_ = (PFNGLBINDBUFFERPROC) wglGetProcAddress("glBindBuffer");
+    if (!glBindBuffer_)
+      return false;
+    glBufferData_ = (PFNGLBUFFERDATAPROC) wglGetProcAddress("glBufferData");
+    if (!glBufferData_)
+      return false;
+    glDeleteBuffers_ =
+        (PFNGLDELETEBUFFERSPROC) wglGetProcAddress("glDeleteBuffers");
+    if (!glDeleteBuffers_)
+      return false;
+    glGenBuffers_ = (PFNGLGENBUFFERSPROC) wglGetProcAddress("glGenBuffers");
+    if (!glGenBuffers_)
+      return false;
+    glMapBuffer_ = (PFNGLMAPBUFFERPROC) wglGetProcAddress("glMapBuffer");
+    if (!glMapBuffer_)
+      return false;
+    glUnmapBuffer_ =
+        (PFNGLUNMAPBUFFERPROC) wglGetProcAddress("glUnmapBuffer");
+    if (!glUnmapBuffer_)
+      return false;
+    haveGLBufferFuncs = true;
+  }
+  return haveGLBufferFuncs;
+}
+#  endif
 #endif
 
 #ifdef ENABLE_GL_SHADERS
@@ -197,6 +253,110 @@ static const char *shaderSourcePAL[1] = {
   "}\n"
 };
 
+// versions of the above shaders for 8-bit color index textures: the
+// palette lookup and bilinear filtering are done in the shader, using
+// a 1024x32 index texture (strip lines are stored from the second row),
+// and a 256x2 palette texture
+
+static const char *shaderSourceQ3Palette[1] = {
+  "uniform sampler2D textureHandle;\n"
+  "uniform sampler2D paletteHandle;\n"
+  "uniform float lineShade;\n"
+  "vec4 getPixel(vec2 p)\n"
+  "{\n"
+  "  float c = texture2D(textureHandle,\n"
+  "                      vec2(p.x * 0.0009765625, (p.y + 1.0) * 0.03125)).r;\n"
+  "  return texture2D(paletteHandle,\n"
+  "                   vec2(c * 0.99609375 + 0.001953125, 0.25));\n"
+  "}\n"
+  "void main()\n"
+  "{\n"
+  "  float txc = gl_TexCoord[0][0];\n"
+  "  float tyc = gl_TexCoord[0][1] + 0.015625;\n"
+  "  vec2 p = vec2(txc * 1024.0 - 0.5, tyc * 16.0 - 0.5);\n"
+  "  vec2 f = fract(p);\n"
+  "  p = p - f + 0.5;\n"
+  "  vec4 p0 = mix(mix(getPixel(p), getPixel(p + vec2(1.0, 0.0)), f.x),\n"
+  "                mix(getPixel(p + vec2(0.0, 1.0)),\n"
+  "                    getPixel(p + vec2(1.0, 1.0)), f.x), f.y);\n"
+  "  p0 = p0 * mix(cos(tyc * 100.531) * -0.5 + 0.5, 1.0, lineShade);\n"
+  "  gl_FragColor = vec4(p0.r, p0.g, p0.b, 1.0);\n"
+  "}\n"
+};
+
+static const char *shaderSourcePALPalette[1] = {
+  "uniform sampler2D textureHandle;\n"
+  "uniform sampler2D paletteHandle;\n"
+  "uniform float lineShade;\n"
+  "uniform float linePhase;\n"
+  "const mat4 yuv2rgbMatrix = mat4( 1.21433,  0.00000,  0.38046, -1.95146,\n"
+  "                                 1.21433, -0.09339, -0.19380,  0.59560,\n"
+  "                                 1.21433,  0.48087,  0.00000, -2.33451,\n"
+  "                                 0.00000,  0.00000,  0.00000,  0.00000);\n"
+  "vec4 getPixel(vec2 p)\n"
+  "{\n"
+  "  float c0 = texture2D(textureHandle,\n"
+  "                       vec2(p.x * 0.0009765625, (p.y + 1.0) * 0.03125)).r;\n"
+  "  float c1 = texture2D(textureHandle,\n"
+  "                       vec2(p.x * 0.0009765625, p.y * 0.03125)).r;\n"
+  "  float ph = mod(floor(p.y) + linePhase, 2.0);\n"
+  "  vec4 p0 = texture2D(paletteHandle, vec2(c0 * 0.99609375 + 0.001953125,\n"
+  "                                          ph * 0.5 + 0.25));\n"
+  "  vec4 p1 = texture2D(paletteHandle, vec2(c1 * 0.99609375 + 0.001953125,\n"
+  "                                          0.75 - ph * 0.5));\n"
+  "  return vec4((p0.r + p1.r) * 0.5, p0.g, (p0.b + p1.b) * 0.5, 1.0);\n"
+  "}\n"
+  "vec4 getPixel2(vec2 p, float fy)\n"
+  "{\n"
+  "  return mix(getPixel(p), getPixel(p + vec2(0.0, 1.0)), fy);\n"
+  "}\n"
+  "void main()\n"
+  "{\n"
+  "  float txc = gl_TexCoord[0][0];\n"
+  "  float tyc = gl_TexCoord[0][1] + 0.015625;\n"
+  "  vec2 p = vec2(txc * 1024.0 - 0.5, tyc * 16.0 - 0.5);\n"
+  "  vec2 f = fract(p);\n"
+  "  p = p - f + 0.5;\n"
+  "  vec4 t0 = getPixel2(p + vec2(-5.0, 0.0), f.y);\n"
+  "  vec4 t1 = getPixel2(p + vec2(-4.0, 0.0), f.y);\n"
+  "  vec4 t2 = getPixel2(p + vec2(-3.0, 0.0), f.y);\n"
+  "  vec4 t3 = getPixel2(p + vec2(-2.0, 0.0), f.y);\n"
+  "  vec4 t4 = getPixel2(p + vec2(-1.0, 0.0), f.y);\n"
+  "  vec4 t5 = getPixel2(p, f.y);\n"
+  "  vec4 t6 = getPixel2(p + vec2(1.0, 0.0), f.y);\n"
+  "  vec4 t7 = getPixel2(p + vec2(2.0, 0.0), f.y);\n"
+  "  vec4 t8 = getPixel2(p + vec2(3.0, 0.0), f.y);\n"
+  "  vec4 t9 = getPixel2(p + vec2(4.0, 0.0), f.y);\n"
+  "  vec4 t10 = getPixel2(p + vec2(5.0, 0.0), f.y);\n"
+  "  vec4 pm5 = mix(t0, t1, f.x);\n"
+  "  vec4 pm4 = mix(t1, t2, f.x);\n"
+  "  vec4 pm3 = mix(t2, t3, f.x);\n"
+  "  vec4 pm2 = mix(t3, t4, f.x);\n"
+  "  vec4 pm1 = mix(t4, t5, f.x);\n"
+  "  vec4 p0  = mix(t5, t6, f.x);\n"
+  "  vec4 pp1 = mix(t6, t7, f.x);\n"
+  "  vec4 pp2 = mix(t7, t8, f.x);\n"
+  "  vec4 pp3 = mix(t8, t9, f.x);\n"
+  "  vec4 pp4 = mix(t9, t10, f.x);\n"
+  "  float ytmp = (pp3.g * 0.0196) + (pp2.g * -0.2353) + (pp1.g * 0.3529)\n"
+  "               + p0.g + (pm1.g * 0.3333) + (pm2.g * 0.1373)\n"
+  "               + (pm3.g * 0.0392);\n"
+  "  vec2 ctmp = (pp4.br * 0.45) + (pp3.br * 0.68) + (pp2.br * 0.84)\n"
+  "              + (pp1.br * 0.92) + p0.br + (pm1.br * 1.04)\n"
+  "              + (pm2.br * 0.96) + (pm3.br * 0.80) + (pm4.br * 0.57)\n"
+  "              + (pm5.br * 0.37);\n"
+  "  float f1 = mix(cos(tyc * 100.531) * -0.5 + 0.5, 1.0, lineShade);\n"
+  "  gl_FragColor = (vec4(ytmp, ctmp[0], ctmp[1], 1.0) * yuv2rgbMatrix) * f1;\n"
+  "}\n"
+};
+
+static const char **shaderSources[4] = {
+  &(shaderSourceQ3[0]),
+  &(shaderSourcePAL[0]),
+  &(shaderSourceQ3Palette[0]),
+  &(shaderSourcePALPalette[0])
+};
+
 #endif  // ENABLE_GL_SHADERS
 
 static void setTextureParameters(int displayQuality)
@@ -248,8 +408,205 @@ static void initializeTexture(const Ep128Emu::VideoDisplay::DisplayParameters&
   }
 }
 
+#ifdef ENABLE_GL_PIXEL_BUFFERS
+
+static bool checkGLPixelBufferSupport()
+{
+  // pixel buffer objects are core functionality since OpenGL 2.1
+  const char  *s = reinterpret_cast< const char * >(glGetString(GL_VERSION));
+  if (!s)
+    return false;
+  int     majorVersion = 0;
+  int     minorVersion = 0;
+  while (*s >= '0' && *s <= '9')
+    majorVersion = (majorVersion * 10) + int(*(s++) - '0');
+  if (*s == '.') {
+    s++;
+    while (*s >= '0' && *s <= '9')
+      minorVersion = (minorVersion * 10) + int(*(s++) - '0');
+  }
+  if (majorVersion < 2 || (majorVersion == 2 && minorVersion < 1))
+    return false;
+#  ifdef WIN32
+  if (!queryGLBufferFunctions())
+    return false;
+#  endif
+  return true;
+}
+
+#endif  // ENABLE_GL_PIXEL_BUFFERS
+
 namespace Ep128Emu {
 
+  bool OpenGLDisplay::initializePixelBuffers()
+  {
+#ifdef ENABLE_GL_PIXEL_BUFFERS
+    if (frameTextureID)
+      return true;
+    if (pixelBufferSupport == 0)
+      return false;
+    pixelBufferSupport = 0;
+    if (!checkGLPixelBufferSupport())
+      return false;
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++)
+      ;
+    GLuint  tmp[2];
+    tmp[0] = 0U;
+    tmp[1] = 0U;
+    glGenBuffers_(2, &(tmp[0]));
+    for (int i = 0; i < 2; i++) {
+      glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, tmp[i]);
+      glBufferData_(GL_PIXEL_UNPACK_BUFFER,
+                    GLsizeiptr(sizeof(uint16_t) * 768 * 288),
+                    (const GLvoid *) 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0U);
+    // 1024x512 texture in 16-bit (R5G6B5) format for the whole frame
+    GLuint  textureID_ = 0U;
+    glGenTextures(1, &textureID_);
+    glBindTexture(GL_TEXTURE_2D, textureID_);
+    setTextureParameters(0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1024, 512, 0,
+                 GL_RGB, GL_UNSIGNED_SHORT_5_6_5, (const GLvoid *) 0);
+    if (glGetError() != GL_NO_ERROR || !(tmp[0] && tmp[1] && textureID_)) {
+      if (textureID_)
+        glDeleteTextures(1, &textureID_);
+      glDeleteBuffers_(2, &(tmp[0]));
+      return false;
+    }
+    pixelBufferIDs[0] = (unsigned long) tmp[0];
+    pixelBufferIDs[1] = (unsigned long) tmp[1];
+    frameTextureID = (unsigned long) textureID_;
+    pixelBufferIndex = 0;
+    pixelBufferSupport = 1;
+    return true;
+#else
+    pixelBufferSupport = 0;
+    return false;
+#endif  // ENABLE_GL_PIXEL_BUFFERS
+  }
+
+  void OpenGLDisplay::deletePixelBuffers()
+  {
+#ifdef ENABLE_GL_PIXEL_BUFFERS
+    if (pixelBufferSupport < 0)
+      return;
+    pixelBufferSupport = -1;
+    if (!frameTextureID)
+      return;
+    GLuint  textureID_ = GLuint(frameTextureID);
+    frameTextureID = 0UL;
+    glDeleteTextures(1, &textureID_);
+    GLuint  tmp[2];
+    tmp[0] = GLuint(pixelBufferIDs[0]);
+    tmp[1] = GLuint(pixelBufferIDs[1]);
+    pixelBufferIDs[0] = 0UL;
+    pixelBufferIDs[1] = 0UL;
+#  ifdef WIN32
+    if (!queryGLBufferFunctions())
+      return;
+#  endif
+    glDeleteBuffers_(2, &(tmp[0]));
+#endif  // ENABLE_GL_PIXEL_BUFFERS
+  }
+
+  bool OpenGLDisplay::initializePaletteTextures(int shaderMode_)
+  {
+#ifdef ENABLE_GL_SHADERS
+#  ifdef WIN32
+    if (!queryGLShaderFunctions())
+      return false;
+#  endif
+    if (!indexTextureID) {
+      GLuint  tmp[2];
+      tmp[0] = 0U;
+      tmp[1] = 0U;
+      glGenTextures(2, &(tmp[0]));
+      if (!(tmp[0] && tmp[1])) {
+        glDeleteTextures(2, &(tmp[0]));
+        return false;
+      }
+      indexTextureID = (unsigned long) tmp[0];
+      paletteTextureID = (unsigned long) tmp[1];
+      paletteTextureMode = 0;
+      // 1024x32 texture of 8-bit color indices
+      std::memset(textureSpace, 0, 1024 * 32);
+      glBindTexture(GL_TEXTURE_2D, tmp[0]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, 1024, 32, 0,
+                   GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                   (const GLvoid *) textureSpace);
+      glBindTexture(GL_TEXTURE_2D, tmp[1]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glActiveTexture_(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, GLuint(paletteTextureID));
+    if (paletteTextureMode != shaderMode_) {
+      // 256x2 palette texture, the second row is used only by the PAL
+      // shader for alternate lines
+      if (shaderMode_ != 4) {
+        uint16_t  *buf = reinterpret_cast< uint16_t * >(textureSpace);
+        for (size_t i = 0; i < 256; i++) {
+          buf[i] = colormap(uint8_t(i));
+          buf[i + 256] = buf[i];
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 256, 2, 0,
+                     GL_RGB, GL_UNSIGNED_SHORT_5_6_5, (const GLvoid *) buf);
+      }
+      else {
+        uint32_t  *buf = textureBuffer32;
+        for (size_t i = 0; i < 256; i++) {
+          buf[i] = colormap32.getColor_0(uint8_t(i));
+          buf[i + 256] = colormap32.getColor_1(uint8_t(i));
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, 256, 2, 0,
+                     GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV,
+                     (const GLvoid *) buf);
+      }
+      paletteTextureMode = shaderMode_;
+    }
+    glActiveTexture_(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, GLuint(indexTextureID));
+    return true;
+#else
+    (void) shaderMode_;
+    return false;
+#endif  // ENABLE_GL_SHADERS
+  }
+
+  void OpenGLDisplay::deletePaletteTextures()
+  {
+    paletteTextureMode = 0;
+    if (!indexTextureID)
+      return;
+    GLuint  tmp[2];
+    tmp[0] = GLuint(indexTextureID);
+    tmp[1] = GLuint(paletteTextureID);
+    indexTextureID = 0UL;
+    paletteTextureID = 0UL;
+    glDeleteTextures(2, &(tmp[0]));
+  }
+
+  void OpenGLDisplay::unbindPaletteTexture()
+  {
+#ifdef ENABLE_GL_SHADERS
+#  ifdef WIN32
+    if (!queryGLShaderFunctions())
+      return;
+#  endif
+    glActiveTexture_(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0U);
+    glActiveTexture_(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, GLuint(textureID));
+#endif  // ENABLE_GL_SHADERS
+  }
+
   bool OpenGLDisplay::compileShader(int shaderMode_)
   {
 #ifdef ENABLE_GL_SHADERS
@@ -273,9 +630,7 @@ namespace Ep128Emu {
       return false;
     }
     glShaderSource_(GLuint(shaderHandle), GLsizei(1),
-                    (shaderMode_ == 2 ?
-                     &(shaderSourcePAL[0]) : &(shaderSourceQ3[0])),
-                    (GLint *) 0);
+                    shaderSources[shaderMode_ - 1], (GLint *) 0);
     glAttachShader_(GLuint(programHandle), GLuint(shaderHandle));
     shaderMode = shaderMode_;
     glCompileShader_(GLuint(shaderHandle));
@@ -328,6 +683,12 @@ namespace Ep128Emu {
                  0);
     glUniform1f_(glGetUniformLocation_(GLuint(programHandle), "lineShade"),
                  displayParameters.lineShade * 0.998f + 0.001f);
+    if (shaderMode >= 3) {
+      // palette texture for shaderPaletteLookup mode
+      glUniform1i_(glGetUniformLocation_(GLuint(programHandle),
+                                         "paletteHandle"),
+                   1);
+    }
     return true;
 #else
     return false;
@@ -484,8 +845,18 @@ namespace Ep128Emu {
       programHandle(0UL),
       textureSpace((unsigned char *) 0),
       textureBuffer32((uint32_t *) 0),
-      colormap32()
+      colormap32(),
+      frameTextureID(0UL),
+      pixelBufferIndex(0),
+      pixelBufferSupport(-1),
+      indexTextureID(0UL),
+      paletteTextureID(0UL),
+      paletteTextureMode(0),
+      frameIndexBuf((unsigned char *) 0),
+      frameTextureBuf((uint32_t *) 0)
   {
+    pixelBufferIDs[0] = 0UL;
+    pixelBufferIDs[1] = 0UL;
     try {
       for (size_t n = 0; n < 4; n++)
         frameRingBuffer[n] = (Message_LineData **) 0;
@@ -496,6 +867,8 @@ namespace Ep128Emu {
       textureSpace = reinterpret_cast< unsigned char * >(textureBuffer32);
       textureBuffer16 = reinterpret_cast< uint16_t * >(textureSpace);
       std::memset(textureSpace, 0, sizeof(uint32_t) * 1024 * 16);
+      frameIndexBuf = new unsigned char[768 * 304];
+      frameTextureBuf = new uint32_t[768 * 304];
       for (size_t n = 0; n < 4; n++) {
         frameRingBuffer[n] = new Message_LineData*[578];
         for (size_t yc = 0; yc < 578; yc++)
@@ -507,6 +880,10 @@ namespace Ep128Emu {
         delete[] linesChanged;
       if (textureBuffer32)
         delete[] textureBuffer32;
+      if (frameIndexBuf)
+        delete[] frameIndexBuf;
+      if (frameTextureBuf)
+        delete[] frameTextureBuf;
       for (size_t n = 0; n < 4; n++) {
         if (frameRingBuffer[n])
           delete[] frameRingBuffer[n];
@@ -522,12 +899,16 @@ namespace Ep128Emu {
   {
     Fl::remove_idle(&fltkIdleCallback, (void *) this);
     deleteShader();
+    deletePixelBuffers();
+    deletePaletteTextures();
     if (textureID) {
       GLuint  tmp = GLuint(textureID);
       textureID = 0UL;
       glDeleteTextures(1, &tmp);
     }
     delete[] textureBuffer32;
+    delete[] frameIndexBuf;
+    delete[] frameTextureBuf;
     delete[] linesChanged;
     for (size_t n = 0; n < 4; n++) {
       for (size_t yc = 0; yc < 578; yc++) {
@@ -541,37 +922,217 @@ namespace Ep128Emu {
     }
   }
 
+  void OpenGLDisplay::decodeFrame(Message_LineData **lineBuffers_,
+                                  bool oddFrame_, int convMode,
+                                  int firstRow, int nRows, void *outBuf)
+  {
+    FrameDecodeJob  job;
+    job.display = this;
+    job.lineBuffers = lineBuffers_;
+    job.outBuf = outBuf;
+    job.convMode = convMode;
+    job.firstRow = firstRow;
+    job.nRows = nRows;
+    job.oddFrame = oddFrame_;
+    runDecoderThreads(&decodeFrameCallback, (void *) &job);
+  }
+
+  void OpenGLDisplay::decodeFrameCallback(void *userData,
+                                          int bandNum, int nBands)
+  {
+    const FrameDecodeJob& job =
+        *(reinterpret_cast< const FrameDecodeJob * >(userData));
+    const OpenGLDisplay&  this_ = *(job.display);
+    int     rowBegin = job.firstRow + ((job.nRows * bandNum) / nBands);
+    int     rowEnd = job.firstRow + ((job.nRows * (bandNum + 1)) / nBands);
+    if (rowBegin >= rowEnd)
+      return;
+    unsigned char lineBuf1[768];
+    uint32_t  prvTextureLine[768];
+    int     yc = rowBegin;
+    if (job.convMode == 3) {
+      for (int xc = 0; xc < 768; xc++)
+        prvTextureLine[xc] = 0x20000200U;
+      // the chroma of the first row is averaged with the previous one,
+      // which is decoded again if it belongs to another band
+      if (yc > job.firstRow)
+        yc--;
+    }
+    for ( ; yc < rowEnd; yc++) {
+      // decode video data
+      int     lineNum = (yc << 1) - 6 + int(job.oddFrame);
+      unsigned char *curLine_ = &(lineBuf1[0]);
+      if (yc >= rowBegin)
+        curLine_ = &(this_.frameIndexBuf[size_t(yc) * 768]);
+      const unsigned char *bufp = (unsigned char *) 0;
+      size_t  nBytes = 0;
+      if ((unsigned int) lineNum < 578U) {
+        if (job.lineBuffers[lineNum])
+          job.lineBuffers[lineNum]->getLineData(bufp, nBytes);
+      }
+      if (bufp)
+        decodeLine(curLine_, bufp, nBytes);
+      else
+        std::memset(curLine_, 0, 768);
+      switch (job.convMode) {
+      case 1:
+        {
+          // build 16-bit texture
+          uint16_t  *txtp = reinterpret_cast< uint16_t * >(job.outBuf)
+                            + (size_t(yc - job.firstRow) * 768);
+          for (size_t xc = 0; xc < 768; xc++)
+            txtp[xc] = this_.colormap(curLine_[xc]);
+        }
+        break;
+      case 2:
+        {
+          // build 16-bit texture at half horizontal resolution
+          uint16_t  *txtp = reinterpret_cast< uint16_t * >(job.outBuf)
+                            + (size_t(yc - job.firstRow) * 384);
+          for (size_t xc = 0; xc < 768; xc += 2)
+            txtp[xc >> 1] = this_.colormap(curLine_[xc], curLine_[xc + 1]);
+        }
+        break;
+      case 3:
+        {
+          // build 32-bit texture
+          uint32_t  *txtp = &(prvTextureLine[0]);
+          if (yc >= rowBegin) {
+            txtp = reinterpret_cast< uint32_t * >(job.outBuf)
+                   + (size_t(yc - job.firstRow) * 768);
+          }
+          const uint32_t  yMask = 0x000FFC00U;
+          const uint32_t  cMask = 0x3FF003FFU;
+          if (lineNum & 2) {
+            for (size_t xc = 0; xc < 768; xc++) {
+              uint32_t  p = this_.colormap32.getColor_1(curLine_[xc]);
+              uint32_t  c = p & cMask;
+              txtp[xc] =
+                  (p & yMask) | (((prvTextureLine[xc] + c) >> 1) & cMask);
+              prvTextureLine[xc] = c;
+            }
+          }
+          else {
+            for (size_t xc = 0; xc < 768; xc++) {
+              uint32_t  p = this_.colormap32.getColor_0(curLine_[xc]);
+              uint32_t  c = p & cMask;
+              txtp[xc] =
+                  (p & yMask) | (((prvTextureLine[xc] + c) >> 1) & cMask);
+              prvTextureLine[xc] = c;
+            }
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  bool OpenGLDisplay::drawFrame_pixelBuffer(Message_LineData **lineBuffers_,
+                                            double x0, double y0,
+                                            double x1, double y1,
+                                            bool oddFrame_,
+                                            bool changedLinesOnly)
+  {
+#ifdef ENABLE_GL_PIXEL_BUFFERS
+    if (!frameTextureID) {
+      if (!initializePixelBuffers()) {
+        glBindTexture(GL_TEXTURE_2D, GLuint(textureID));
+        setTextureParameters(displayParameters.displayQuality);
+        return false;
+      }
+      // the new texture is not initialized yet
+      changedLinesOnly = false;
+    }
+    // find the range of lines to be updated
+    size_t  firstLine = 0;
+    size_t  lastLine = 287;
+    if (changedLinesOnly) {
+      while (firstLine < 288 && !linesChanged[firstLine + 1])
+        firstLine++;
+      while (lastLine > firstLine && !linesChanged[lastLine + 1])
+        lastLine--;
+    }
+    for (size_t yc = 1; yc < 289; yc++)
+      linesChanged[yc] = false;
+    glBindTexture(GL_TEXTURE_2D, GLuint(frameTextureID));
+    setTextureParameters(0);
+    if (firstLine < 288) {
+      // decode video data directly into the next pixel buffer, and upload
+      // all changed lines with a single asynchronous texture update
+      glBindBuffer_(GL_PIXEL_UNPACK_BUFFER,
+                    GLuint(pixelBufferIDs[pixelBufferIndex]));
+      pixelBufferIndex = pixelBufferIndex ^ 1;
+      // discard the previous contents of the buffer, so that there is no
+      // need to wait for an earlier texture update that is still reading it
+      glBufferData_(GL_PIXEL_UNPACK_BUFFER,
+                    GLsizeiptr(sizeof(uint16_t) * 768 * 288),
+                    (const GLvoid *) 0, GL_STREAM_DRAW);
+      uint16_t  *pixelBuf =
+          reinterpret_cast< uint16_t * >(glMapBuffer_(GL_PIXEL_UNPACK_BUFFER,
+                                                      GL_WRITE_ONLY));
+      if (!pixelBuf) {
+        glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0U);
+        deletePixelBuffers();
+        pixelBufferSupport = 0;
+        glBindTexture(GL_TEXTURE_2D, GLuint(textureID));
+        setTextureParameters(displayParameters.displayQuality);
+        return false;
+      }
+      decodeFrame(lineBuffers_, oddFrame_, 1,
+                  int(firstLine) + 4, int(lastLine + 1 - firstLine),
+                  &(pixelBuf[firstLine * 768]));
+      glUnmapBuffer_(GL_PIXEL_UNPACK_BUFFER);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, GLint(firstLine),
+                      768, GLsizei(lastLine + 1 - firstLine),
+                      GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
+                      (GLvoid *) (sizeof(uint16_t) * 768 * firstLine));
+      glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0U);
+    }
+    // update display
+    glBegin(GL_QUADS);
+    glTexCoord2f(GLfloat(0.0), GLfloat(0.001 / 512.0));
+    glVertex2f(GLfloat(x0), GLfloat(y0));
+    glTexCoord2f(GLfloat(768.0 / 1024.0), GLfloat(0.001 / 512.0));
+    glVertex2f(GLfloat(x1), GLfloat(y0));
+    glTexCoord2f(GLfloat(768.0 / 1024.0), GLfloat(287.999 / 512.0));
+    glVertex2f(GLfloat(x1), GLfloat(y1));
+    glTexCoord2f(GLfloat(0.0), GLfloat(287.999 / 512.0));
+    glVertex2f(GLfloat(x0), GLfloat(y1));
+    glEnd();
+    return true;
+#else
+    (void) lineBuffers_;
+    (void) x0;
+    (void) y0;
+    (void) x1;
+    (void) y1;
+    (void) oddFrame_;
+    (void) changedLinesOnly;
+    pixelBufferSupport = 0;
+    return false;
+#endif  // ENABLE_GL_PIXEL_BUFFERS
+  }
+
   void OpenGLDisplay::drawFrame_quality0(Message_LineData **lineBuffers_,
                                          double x0, double y0,
                                          double x1, double y1, bool oddFrame_)
   {
-    unsigned char lineBuf1[768];
-    unsigned char *curLine_ = &(lineBuf1[0]);
+    if (pixelBufferSupport != 0) {
+      if (drawFrame_pixelBuffer(lineBuffers_, x0, y0, x1, y1, oddFrame_,
+                                false)) {
+        return;
+      }
+    }
     // full horizontal resolution, no interlace (768x288)
     // no texture filtering or effects
+    decodeFrame(lineBuffers_, oddFrame_, 1, 4, 288, frameTextureBuf);
+    const uint16_t  *frameBuf =
+        reinterpret_cast< const uint16_t * >(frameTextureBuf);
     for (size_t yc = 0; yc < 288; yc += 8) {
-      for (size_t offs = 0; offs < 8; offs++) {
-        // decode video data
-        const unsigned char *bufp = (unsigned char *) 0;
-        size_t  nBytes = 0;
-        size_t  lineNum = ((yc + offs + 1) << 1) + size_t(oddFrame_);
-        if (lineBuffers_[lineNum]) {
-          lineBuffers_[lineNum]->getLineData(bufp, nBytes);
-          decodeLine(curLine_, bufp, nBytes);
-        }
-        else {
-          std::memset(curLine_, 0, 768);
-        }
-        // build 16-bit texture:
-        // full horizontal resolution, no interlace (768x8)
-        uint16_t  *txtp = &(textureBuffer16[offs * 768]);
-        for (size_t xc = 0; xc < 768; xc++)
-          txtp[xc] = colormap(curLine_[xc]);
-      }
       // load texture
       glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 8,
                       GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-                      (GLvoid *) textureBuffer16);
+                      (const GLvoid *) &(frameBuf[yc * 768]));
       // update display
       double  ycf0 = y0 + ((double(int(yc << 1)) * (1.0 / 576.0))
                            * (y1 - y0));
@@ -594,7 +1155,6 @@ namespace Ep128Emu {
                                          double x0, double y0,
                                          double x1, double y1, bool oddFrame_)
   {
-    unsigned char lineBuf1[768];
     GLfloat txtycf0 = GLfloat(1.0 / 16.0);
     GLfloat txtycf1 = GLfloat(15.0 / 16.0);
     if (oddFrame_) {
@@ -602,30 +1162,15 @@ namespace Ep128Emu {
       txtycf0 -= GLfloat(0.5 / 16.0);
       txtycf1 -= GLfloat(0.5 / 16.0);
     }
-    unsigned char *curLine_ = &(lineBuf1[0]);
     // half horizontal resolution, no interlace (384x288)
+    decodeFrame(lineBuffers_, oddFrame_, 2, 3, 296, frameTextureBuf);
+    const uint16_t  *frameBuf =
+        reinterpret_cast< const uint16_t * >(frameTextureBuf);
     for (size_t yc = 0; yc < 588; yc += 28) {
-      for (size_t offs = size_t(oddFrame_); offs < 32; offs += 2) {
-        // decode video data
-        const unsigned char *bufp = (unsigned char *) 0;
-        size_t  nBytes = 0;
-        if ((yc + offs) < 578) {
-          if (lineBuffers_[yc + offs])
-            lineBuffers_[yc + offs]->getLineData(bufp, nBytes);
-        }
-        if (bufp)
-          decodeLine(curLine_, bufp, nBytes);
-        else
-          std::memset(curLine_, 0, 768);
-        // build 16-bit texture
-        uint16_t  *txtp = &(textureBuffer16[(offs >> 1) * 384]);
-        for (size_t xc = 0; xc < 768; xc += 2)
-          txtp[xc >> 1] = colormap(curLine_[xc], curLine_[xc + 1]);
-      }
       // load texture
       glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 384, 16,
                       GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-                      (GLvoid *) textureBuffer16);
+                      (const GLvoid *) &(frameBuf[(yc >> 1) * 384]));
       // update display
       double  ycf0 = y0 + ((double(int(yc)) * (1.0 / 576.0)) * (y1 - y0));
       double  ycf1 = y0 + ((double(int(yc + 28)) * (1.0 / 576.0)) * (y1 - y0));
@@ -650,7 +1195,6 @@ namespace Ep128Emu {
                                          double x0, double y0,
                                          double x1, double y1, bool oddFrame_)
   {
-    unsigned char lineBuf1[768];
     GLfloat txtycf0 = GLfloat(1.0 / 16.0);
     GLfloat txtycf1 = GLfloat(15.0 / 16.0);
     if (oddFrame_) {
@@ -658,30 +1202,15 @@ namespace Ep128Emu {
       txtycf0 -= GLfloat(0.5 / 16.0);
       txtycf1 -= GLfloat(0.5 / 16.0);
     }
-    unsigned char *curLine_ = &(lineBuf1[0]);
     // full horizontal resolution, no interlace (768x288)
+    decodeFrame(lineBuffers_, oddFrame_, 1, 3, 296, frameTextureBuf);
+    const uint16_t  *frameBuf =
+        reinterpret_cast< const uint16_t * >(frameTextureBuf);
     for (size_t yc = 0; yc < 588; yc += 28) {
-      for (size_t offs = size_t(oddFrame_); offs < 32; offs += 2) {
-        // decode video data
-        const unsigned char *bufp = (unsigned char *) 0;
-        size_t  nBytes = 0;
-        if ((yc + offs) < 578) {
-          if (lineBuffers_[yc + offs])
-            lineBuffers_[yc + offs]->getLineData(bufp, nBytes);
-        }
-        if (bufp)
-          decodeLine(curLine_, bufp, nBytes);
-        else
-          std::memset(curLine_, 0, 768);
-        // build 16-bit texture
-        uint16_t  *txtp = &(textureBuffer16[(offs >> 1) * 768]);
-        for (size_t xc = 0; xc < 768; xc++)
-          txtp[xc] = colormap(curLine_[xc]);
-      }
       // load texture
       glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 16,
                       GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-                      (GLvoid *) textureBuffer16);
+                      (const GLvoid *) &(frameBuf[(yc >> 1) * 768]));
       // update display
       double  ycf0 = y0 + ((double(int(yc)) * (1.0 / 576.0)) * (y1 - y0));
       double  ycf1 = y0 + ((double(int(yc + 28)) * (1.0 / 576.0)) * (y1 - y0));
@@ -706,6 +1235,10 @@ namespace Ep128Emu {
                                          double x0, double y0,
                                          double x1, double y1, bool oddFrame_)
   {
+    if (displayParameters.shaderPaletteLookup) {
+      if (drawFrame_quality3_palette(lineBuffers_, x0, y0, x1, y1, oddFrame_))
+        return;
+    }
     if (shaderMode != 1) {
       if (!compileShader(1)) {
         displayParameters.displayQuality = 2;
@@ -719,7 +1252,6 @@ namespace Ep128Emu {
       drawFrame_quality2(lineBuffers_, x0, y0, x1, y1, oddFrame_);
       return;
     }
-    unsigned char lineBuf1[768];
     GLfloat txtycf0 = GLfloat(1.0 / 16.0);
     GLfloat txtycf1 = GLfloat(15.0 / 16.0);
     if (oddFrame_) {
@@ -727,30 +1259,15 @@ namespace Ep128Emu {
       txtycf0 -= GLfloat(0.5 / 16.0);
       txtycf1 -= GLfloat(0.5 / 16.0);
     }
-    unsigned char *curLine_ = &(lineBuf1[0]);
     // full horizontal resolution, interlace with shader (768x288)
+    decodeFrame(lineBuffers_, oddFrame_, 1, 3, 296, frameTextureBuf);
+    const uint16_t  *frameBuf =
+        reinterpret_cast< const uint16_t * >(frameTextureBuf);
     for (size_t yc = 0; yc < 588; yc += 28) {
-      for (size_t offs = size_t(oddFrame_); offs < 32; offs += 2) {
-        // decode video data
-        const unsigned char *bufp = (unsigned char *) 0;
-        size_t  nBytes = 0;
-        if ((yc + offs) < 578) {
-          if (lineBuffers_[yc + offs])
-            lineBuffers_[yc + offs]->getLineData(bufp, nBytes);
-        }
-        if (bufp)
-          decodeLine(curLine_, bufp, nBytes);
-        else
-          std::memset(curLine_, 0, 768);
-        // build 16-bit texture
-        uint16_t  *txtp = &(textureBuffer16[(offs >> 1) * 768]);
-        for (size_t xc = 0; xc < 768; xc++)
-          txtp[xc] = colormap(curLine_[xc]);
-      }
       // load texture
       glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 16,
                       GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-                      (GLvoid *) textureBuffer16);
+                      (const GLvoid *) &(frameBuf[(yc >> 1) * 768]));
       // update display
       double  ycf0 = y0 + ((double(int(yc)) * (1.0 / 576.0)) * (y1 - y0));
       double  ycf1 = y0 + ((double(int(yc + 28)) * (1.0 / 576.0)) * (y1 - y0));
@@ -776,6 +1293,10 @@ namespace Ep128Emu {
                                          double x0, double y0,
                                          double x1, double y1, bool oddFrame_)
   {
+    if (displayParameters.shaderPaletteLookup) {
+      if (drawFrame_quality4_palette(lineBuffers_, x0, y0, x1, y1, oddFrame_))
+        return;
+    }
     if (shaderMode != 2) {
       if (!compileShader(2)) {
         displayParameters.displayQuality = 2;
@@ -790,64 +1311,142 @@ namespace Ep128Emu {
       return;
     }
     double  yOffs = (y1 - y0) * (-2.0 / 576.0);
-    unsigned char lineBuf1[768];
-    unsigned char *curLine_ = &(lineBuf1[0]);
-    uint32_t  prvTextureLine[768];
-    for (int xc = 0; xc < 768; xc++)
-      prvTextureLine[xc] = 0x20000200U;
     // full horizontal resolution, interlace (768x576), TV emulation
+    decodeFrame(lineBuffers_, oddFrame_, 3, 1, 302, frameTextureBuf);
     for (int yc = int(oddFrame_) - 4; yc < 594; yc += 26) {
-      if (yc > 0) {
-        std::memcpy(&(textureBuffer32[0]), &(textureBuffer32[13 * 768]),
-                    sizeof(uint32_t) * size_t(3 * 768));
-      }
-      for (int offs = (yc > 0 ? 6 : 0); offs < 32; offs += 2) {
-        // decode video data
-        const unsigned char *bufp = (unsigned char *) 0;
-        size_t  nBytes = 0;
-        if ((unsigned int) (yc + offs) < 578U) {
-          if (lineBuffers_[yc + offs])
-            lineBuffers_[yc + offs]->getLineData(bufp, nBytes);
-        }
-        if (bufp)
-          decodeLine(curLine_, bufp, nBytes);
-        else
-          std::memset(curLine_, 0, 768);
-        // build 32-bit texture
-        uint32_t  *txtp = &(textureBuffer32[(offs >> 1) * 768]);
-        const uint32_t  yMask = 0x000FFC00U;
-        const uint32_t  cMask = 0x3FF003FFU;
-        if ((yc + offs) & 2) {
-          for (size_t xc = 0; xc < 768; xc += 2) {
-            uint32_t  p = colormap32.getColor_1(curLine_[xc]);
-            uint32_t  c = p & cMask;
-            txtp[xc] = (p & yMask) | (((prvTextureLine[xc] + c) >> 1) & cMask);
-            prvTextureLine[xc] = c;
-            p = colormap32.getColor_1(curLine_[xc + 1]);
-            c = p & cMask;
-            txtp[xc + 1] =
-                (p & yMask) | (((prvTextureLine[xc + 1] + c) >> 1) & cMask);
-            prvTextureLine[xc + 1] = c;
-          }
-        }
-        else {
-          for (size_t xc = 0; xc < 768; xc += 2) {
-            uint32_t  p = colormap32.getColor_0(curLine_[xc]);
-            uint32_t  c = p & cMask;
-            txtp[xc] = (p & yMask) | (((prvTextureLine[xc] + c) >> 1) & cMask);
-            prvTextureLine[xc] = c;
-            p = colormap32.getColor_0(curLine_[xc + 1]);
-            c = p & cMask;
-            txtp[xc + 1] =
-                (p & yMask) | (((prvTextureLine[xc + 1] + c) >> 1) & cMask);
-            prvTextureLine[xc + 1] = c;
-          }
-        }
-      }
       // load texture
       glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 16,
                       GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV,
-                      (GLvoid *) textureBuffer32);
+                      (const GLvoid *) &(frameTextureBuf[
+                          size_t((yc + 4 - int(oddFrame_)) >> 1) * 768]));
+      // update display
+      double  ycf0 =
+          y0 + ((double(yc + 4) * (1.0 / 576.0)) * (y1 - y0)) + yOffs;
+      double  ycf1 =
+          y0 + ((double(yc + 30) * (1.0 / 576.0)) * (y1 - y0)) + yOffs;
+      double  txtycf0 = 2.0 / 16.0;
+      double  txtycf1 = 15.0 / 16.0;
+      if (ycf0 < y0) {
+        txtycf0 -= ((ycf0 - y0) * (288.0 / 16.0) / (y1 - y0));
+        ycf0 = y0;
+      }
+      if (yc >= 568) {
+        ycf1 -= ((y1 - y0) * (20.0 / 576.0));
+        txtycf1 -= (10.0 / 16.0);
+      }
+      glBegin(GL_QUADS);
+      glTexCoord2f(GLfloat(0.0), GLfloat(txtycf0));
+      glVertex2f(GLfloat(x0), GLfloat(ycf0));
+      glTexCoord2f(GLfloat(768.0 / 1024.0), GLfloat(txtycf0));
+      glVertex2f(GLfloat(x1), GLfloat(ycf0));
+      glTexCoord2f(GLfloat(768.0 / 1024.0), GLfloat(txtycf1));
+      glVertex2f(GLfloat(x1), GLfloat(ycf1));
+      glTexCoord2f(GLfloat(0.0), GLfloat(txtycf1));
+      glVertex2f(GLfloat(x0), GLfloat(ycf1));
+      glEnd();
+    }
+    disableShader();
+  }
+
+  bool OpenGLDisplay::drawFrame_quality3_palette(
+      Message_LineData **lineBuffers_,
+      double x0, double y0, double x1, double y1, bool oddFrame_)
+  {
+    if (shaderMode != 3) {
+      if (!compileShader(3)) {
+        displayParameters.shaderPaletteLookup = false;
+        return false;
+      }
+    }
+    if (!initializePaletteTextures(3)) {
+      deleteShader();
+      displayParameters.shaderPaletteLookup = false;
+      return false;
+    }
+    if (!enableShader()) {
+      unbindPaletteTexture();
+      deleteShader();
+      displayParameters.shaderPaletteLookup = false;
+      return false;
+    }
+    GLfloat txtycf0 = GLfloat(1.0 / 16.0);
+    GLfloat txtycf1 = GLfloat(15.0 / 16.0);
+    if (oddFrame_) {
+      // interlace
+      txtycf0 -= GLfloat(0.5 / 16.0);
+      txtycf1 -= GLfloat(0.5 / 16.0);
+    }
+    // full horizontal resolution, interlace with shader (768x288)
+    // the first row of the index texture is not used in this mode
+    decodeFrame(lineBuffers_, oddFrame_, 0, 2, 297, (void *) 0);
+    for (size_t yc = 0; yc < 588; yc += 28) {
+      // load texture
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 17,
+                      GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                      (const GLvoid *) &(frameIndexBuf[((yc >> 1) + 2) * 768]));
+      // update display
+      double  ycf0 = y0 + ((double(int(yc)) * (1.0 / 576.0)) * (y1 - y0));
+      double  ycf1 = y0 + ((double(int(yc + 28)) * (1.0 / 576.0)) * (y1 - y0));
+      if (yc == 560) {
+        ycf1 -= ((y1 - y0) * (12.0 / 576.0));
+        txtycf1 -= GLfloat(6.0 / 16.0);
+      }
+      glBegin(GL_QUADS);
+      glTexCoord2f(GLfloat(0.0), txtycf0);
+      glVertex2f(GLfloat(x0), GLfloat(ycf0));
+      glTexCoord2f(GLfloat(768.0 / 1024.0), txtycf0);
+      glVertex2f(GLfloat(x1), GLfloat(ycf0));
+      glTexCoord2f(GLfloat(768.0 / 1024.0), txtycf1);
+      glVertex2f(GLfloat(x1), GLfloat(ycf1));
+      glTexCoord2f(GLfloat(0.0), txtycf1);
+      glVertex2f(GLfloat(x0), GLfloat(ycf1));
+      glEnd();
+    }
+    disableShader();
+    unbindPaletteTexture();
+    return true;
+  }
+
+  bool OpenGLDisplay::drawFrame_quality4_palette(
+      Message_LineData **lineBuffers_,
+      double x0, double y0, double x1, double y1, bool oddFrame_)
+  {
+    if (shaderMode != 4) {
+      if (!compileShader(4)) {
+        displayParameters.shaderPaletteLookup = false;
+        return false;
+      }
+    }
+    if (!initializePaletteTextures(4)) {
+      deleteShader();
+      displayParameters.shaderPaletteLookup = false;
+      return false;
+    }
+    if (!enableShader()) {
+      unbindPaletteTexture();
+      deleteShader();
+      displayParameters.shaderPaletteLookup = false;
+      return false;
+    }
+#ifdef ENABLE_GL_SHADERS
+    GLint   linePhaseLocation =
+        glGetUniformLocation_(GLuint(programHandle), "linePhase");
+#endif
+    double  yOffs = (y1 - y0) * (-2.0 / 576.0);
+    // the first row of the index texture is the line before the strip,
+    // the shader averages its chroma with that of the first line
+    // full horizontal resolution, interlace (768x576), TV emulation
+    decodeFrame(lineBuffers_, oddFrame_, 0, 0, 303, (void *) 0);
+    for (int yc = int(oddFrame_) - 4; yc < 594; yc += 26) {
+#ifdef ENABLE_GL_SHADERS
+      // select the palette of the first line
+      glUniform1f_(linePhaseLocation, GLfloat((yc & 2) >> 1));
+#endif
+      // load texture
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 17,
+                      GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                      (const GLvoid *) &(frameIndexBuf[
+                          size_t((yc + 4 - int(oddFrame_)) >> 1) * 768]));
       // update display
       double  ycf0 =
           y0 + ((double(yc + 4) * (1.0 / 576.0)) * (y1 - y0)) + yOffs;
@@ -875,6 +1474,8 @@ namespace Ep128Emu {
       glEnd();
     }
     disableShader();
+    unbindPaletteTexture();
+    return true;
   }
 
   void OpenGLDisplay::fltkIdleCallback(void *userData_)
@@ -960,41 +1561,49 @@ namespace Ep128Emu {
         forceUpdateLineMask = 0;
       }
       glDisable(GL_BLEND);
-      unsigned char lineBuf1[768];
-      unsigned char *curLine_ = &(lineBuf1[0]);
-      for (size_t yc = 0; yc < 288; yc += 8) {
-        size_t  offs;
-        // quality=0 with single buffered display is special case: only those
-        // lines are updated that have changed since the last frame
-        for (offs = 0; offs < 8; offs++) {
-          if (linesChanged[yc + offs + 1])
-            break;
+      if (pixelBufferSupport != 0) {
+        if (drawFrame_pixelBuffer(lineBuffers, x0, y0, x1, y1,
+                                  prvFrameWasOdd, true)) {
+          // clean up
+          glBindTexture(GL_TEXTURE_2D, GLuint(savedTextureID));
+          glPopMatrix();
+          glFlush();
+          return;
         }
-        if (offs == 8)
-          continue;
-        for (offs = 0; offs < 8; offs++) {
-          linesChanged[yc + offs + 1] = false;
-          // decode video data
-          const unsigned char *bufp = (unsigned char *) 0;
-          size_t  nBytes = 0;
-          size_t  lineNum = ((yc + offs + 1) << 1) + size_t(prvFrameWasOdd);
-          if (lineBuffers[lineNum]) {
-            lineBuffers[lineNum]->getLineData(bufp, nBytes);
-            decodeLine(curLine_, bufp, nBytes);
-          }
-          else {
-            std::memset(curLine_, 0, 768);
+      }
+      // quality=0 with single buffered display is special case: only those
+      // blocks of 8 lines are updated that have changed since the last frame
+      bool    blocksChanged[36];
+      size_t  firstBlock = 36;
+      size_t  lastBlock = 0;
+      for (size_t n = 0; n < 36; n++) {
+        blocksChanged[n] = false;
+        for (size_t offs = 0; offs < 8; offs++) {
+          if (linesChanged[(n << 3) + offs + 1]) {
+            linesChanged[(n << 3) + offs + 1] = false;
+            blocksChanged[n] = true;
           }
-          // build 16-bit texture:
-          // full horizontal resolution, no interlace (768x8)
-          uint16_t  *txtp = &(textureBuffer16[offs * 768]);
-          for (size_t xc = 0; xc < 768; xc++)
-            txtp[xc] = colormap(curLine_[xc]);
         }
+        if (blocksChanged[n]) {
+          firstBlock = (firstBlock < n ? firstBlock : n);
+          lastBlock = n;
+        }
+      }
+      if (firstBlock < 36) {
+        decodeFrame(lineBuffers, prvFrameWasOdd, 1,
+                    int(firstBlock << 3) + 4,
+                    int((lastBlock + 1 - firstBlock) << 3), frameTextureBuf);
+      }
+      const uint16_t  *frameBuf =
+          reinterpret_cast< const uint16_t * >(frameTextureBuf);
+      for (size_t yc = 0; yc < 288; yc += 8) {
+        if (!blocksChanged[yc >> 3])
+          continue;
         // load texture
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 768, 8,
                         GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-                        (GLvoid *) textureBuffer16);
+                        (const GLvoid *) &(frameBuf[(yc - (firstBlock << 3))
+                                                    * 768]));
         // update display
         double  ycf0 = y0 + ((double(int(yc << 1)) * (1.0 / 576.0))
                              * (y1 - y0));
@@ -1340,11 +1949,16 @@ namespace Ep128Emu {
             // if TV emulation (quality=4) or double buffering mode
             // has changed, also need to generate a new texture ID
             deleteShader();
+            deletePixelBuffers();
+            deletePaletteTextures();
 #ifdef WIN32
             glBlendColor__ = (PFNGLBLENDCOLORPROC) 0;
 #  ifdef ENABLE_GL_SHADERS
             haveGLShaderFuncs = false;
 #  endif
+#  ifdef ENABLE_GL_PIXEL_BUFFERS
+            haveGLBufferFuncs = false;
+#  endif
 #endif
             GLuint  oldTextureID = GLuint(textureID);
             textureID = 0UL;
@@ -1406,6 +2020,8 @@ namespace Ep128Emu {
         }
         for (size_t yc = 0; yc < 289; yc++)
           linesChanged[yc] = true;
+        // the colormaps may have changed
+        paletteTextureMode = 0;
       }
       deleteMessage(m);
     }
@@ -68,12 +68,24 @@ namespace Ep128Emu {
       }
     };
     // ----------------
+    bool initializePixelBuffers();
+    void deletePixelBuffers();
+    bool initializePaletteTextures(int shaderMode_);
+    void deletePaletteTextures();
+    void unbindPaletteTexture();
     bool compileShader(int shaderMode_);
     void deleteShader();
     bool enableShader();
     void disableShader();
     void displayFrame();
     void initializeGLDisplay();
+    // draw quality=0 frame as a single 768x288 texture, uploaded from a
+    // pixel buffer object; if 'changedLinesOnly' is true, only the lines
+    // set in linesChanged are decoded. Returns false if pixel buffers are
+    // not supported
+    bool drawFrame_pixelBuffer(Message_LineData **lineBuffers_,
+                               double x0, double y0, double x1, double y1,
+                               bool oddFrame_, bool changedLinesOnly);
     void drawFrame_quality0(Message_LineData **lineBuffers_,
                             double x0, double y0, double x1, double y1,
                             bool oddFrame_);
@@ -89,6 +101,33 @@ namespace Ep128Emu {
     void drawFrame_quality4(Message_LineData **lineBuffers_,
                             double x0, double y0, double x1, double y1,
                             bool oddFrame_);
+    // quality=3 and 4 with palette lookup in the shader, return false if
+    // shaders are not supported
+    bool drawFrame_quality3_palette(Message_LineData **lineBuffers_,
+                                    double x0, double y0, double x1, double y1,
+                                    bool oddFrame_);
+    bool drawFrame_quality4_palette(Message_LineData **lineBuffers_,
+                                    double x0, double y0, double x1, double y1,
+                                    bool oddFrame_);
+    // decode rows 'firstRow' to 'firstRow' + 'nRows' - 1 of a frame to
+    // frameIndexBuf on all decoder threads, and convert them to the texture
+    // format selected by 'convMode' (0: none, 1: 768 R5G6B5 pixels,
+    // 2: 384 R5G6B5 pixels, 3: 768 A2U10Y10V10 pixels with the chroma of
+    // the previous row averaged) into 'outBuf', starting with 'firstRow'.
+    // Row n of the frame is line n * 2 - 6 of the field selected by
+    // 'oddFrame_', missing lines are decoded as color 0
+    struct FrameDecodeJob {
+      OpenGLDisplay     *display;
+      Message_LineData  **lineBuffers;
+      void      *outBuf;
+      int       convMode;
+      int       firstRow;
+      int       nRows;
+      bool      oddFrame;
+    };
+    void decodeFrame(Message_LineData **lineBuffers_, bool oddFrame_,
+                     int convMode, int firstRow, int nRows, void *outBuf);
+    static void decodeFrameCallback(void *userData, int bandNum, int nBands);
     void copyFrameToRingBuffer();
     static void fltkIdleCallback(void *userData_);
     // ----------------
@@ -113,7 +152,9 @@ namespace Ep128Emu {
     Message_LineData  **frameRingBuffer[4];
     double        ringBufferReadPos;
     int           ringBufferWritePos;
-    int           shaderMode;   // 0: no shader, 1: PAL
+    // 0: no shader, 1: quality=3, 2: PAL, 3, 4: quality=3 and PAL with
+    // palette lookup
+    int           shaderMode;
     unsigned long shaderHandle;
     unsigned long programHandle;
    protected:
@@ -122,6 +163,22 @@ namespace Ep128Emu {
     // 1024x16 YUV texture in 32-bit (A2U10Y10V10) format
     uint32_t      *textureBuffer32;
     Colormap_YUV  colormap32;
+   private:
+    // 1024x512 texture used with pixel buffers
+    unsigned long frameTextureID;
+    // double buffered pixel buffer objects for the frame texture
+    unsigned long pixelBufferIDs[2];
+    int           pixelBufferIndex;
+    // -1: not checked yet, 0: not supported, 1: pixel buffers are enabled
+    int           pixelBufferSupport;
+    // 8-bit color index and palette textures for shaderPaletteLookup mode
+    unsigned long indexTextureID;
+    unsigned long paletteTextureID;
+    // shader mode the palette texture was created for, 0 if it is not valid
+    int           paletteTextureMode;
+    // 768x304 color indices and converted pixels written by decodeFrame()
+    unsigned char *frameIndexBuf;
+    uint32_t      *frameTextureBuf;
    public:
     OpenGLDisplay(int xx = 0, int yy = 0, int ww = 768, int hh = 576,
                   const char *lbl = (char *) 0, bool isDoubleBuffered = false);
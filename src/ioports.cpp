@@ -42,6 +42,7 @@ namespace Ep128 {
     breakPointTable = (uint8_t*) 0;
     breakPointCnt = 0;
     breakPointPriorityThreshold = 0;
+    accessCountTable = (uint64_t*) 0;
     try {
       portValues = new uint8_t[256];
       this->reset();
@@ -99,6 +100,8 @@ namespace Ep128 {
     delete[] writeCallbacks;
     delete[] debugReadCallbacks;
     delete[] breakPointTable;
+    if (accessCountTable)
+      delete[] accessCountTable;
     portValues = (uint8_t*) 0;
     readCallbacks = (ReadCallback*) 0;
     writeCallbacks = (WriteCallback*) 0;
@@ -106,6 +109,7 @@ namespace Ep128 {
     breakPointTable = (uint8_t*) 0;
     breakPointCnt = 0;
     breakPointPriorityThreshold = 0;
+    accessCountTable = (uint64_t*) 0;
   }
 
   void IOPorts::setBreakPoint(uint16_t addr, int priority, bool r, bool w)
@@ -178,6 +182,20 @@ namespace Ep128 {
     return bplst;
   }
 
+  void IOPorts::setAccessCountersEnabled(bool isEnabled)
+  {
+    if (isEnabled) {
+      if (!accessCountTable)
+        accessCountTable = new uint64_t[512];
+      for (int i = 0; i < 512; i++)
+        accessCountTable[i] = 0U;
+    }
+    else if (accessCountTable) {
+      delete[] accessCountTable;
+      accessCountTable = (uint64_t*) 0;
+    }
+  }
+
   uint8_t IOPorts::readDebug(uint16_t addr) const
   {
     uint8_t       offs = uint8_t(addr & 0xFF);
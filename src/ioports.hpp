@@ -44,6 +44,8 @@ namespace Ep128 {
     uint8_t *breakPointTable;
     size_t breakPointCnt;
     uint8_t breakPointPriorityThreshold;
+    // number of reads and writes for each port, or NULL if disabled
+    uint64_t *accessCountTable;
    public:
     IOPorts();
     virtual ~IOPorts();
@@ -52,6 +54,24 @@ namespace Ep128 {
     void setBreakPointPriorityThreshold(int n);
     int getBreakPointPriorityThreshold();
     Ep128Emu::BreakPointList getBreakPointList();
+    /*!
+     * Enable or disable counting reads and writes for each port. Enabling
+     * clears any previous counts.
+     */
+    void setAccessCountersEnabled(bool isEnabled);
+    inline bool getAccessCountersEnabled() const
+    {
+      return (accessCountTable != (uint64_t *) 0);
+    }
+    /*!
+     * Returns the number of reads (type = 0) or writes (1) of port 'addr'.
+     */
+    inline uint64_t getAccessCount(uint16_t addr, int type) const
+    {
+      if (!accessCountTable)
+        return 0U;
+      return accessCountTable[(size_t(addr & 0xFF) << 1) + size_t(type)];
+    }
     inline uint8_t read(uint16_t addr);
     inline void write(uint16_t addr, uint8_t value);
     uint8_t readDebug(uint16_t addr) const;
@@ -83,6 +103,8 @@ namespace Ep128 {
     ReadCallback& cb = readCallbacks[offs];
 
     value = cb.func(cb.userData_, cb.addr_);
+    if (EP128EMU_UNLIKELY(accessCountTable != (uint64_t *) 0))
+      accessCountTable[size_t(offs) << 1]++;
     if (breakPointTable) {
       if (breakPointTable[offs] >= breakPointPriorityThreshold &&
           (breakPointTable[offs] & 1) != 0)
@@ -96,6 +118,8 @@ namespace Ep128 {
     uint8_t         offs = uint8_t(addr & 0xFF);
     WriteCallback&  cb = writeCallbacks[offs];
 
+    if (EP128EMU_UNLIKELY(accessCountTable != (uint64_t *) 0))
+      accessCountTable[(size_t(offs) << 1) + 1]++;
     if (breakPointTable) {
       if (breakPointTable[offs] >= breakPointPriorityThreshold &&
           (breakPointTable[offs] & 2) != 0)
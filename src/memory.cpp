@@ -39,6 +39,8 @@ namespace Ep128 {
   void Memory::checkExecuteBreakPoint(uint16_t addr, uint8_t page,
                                       uint8_t value)
   {
+    if (accessCountTable)
+      countAccess(addr, page, 2);
     const uint8_t *tbl = breakPointTable;
     if (tbl != (uint8_t *) 0 &&
         tbl[addr] >= breakPointPriorityThreshold && (tbl[addr] & 36) == 4) {
@@ -56,6 +58,8 @@ namespace Ep128 {
 
   void Memory::checkReadBreakPoint(uint16_t addr, uint8_t page, uint8_t value)
   {
+    if (accessCountTable)
+      countAccess(addr, page, 0);
     const uint8_t *tbl = breakPointTable;
     if (tbl != (uint8_t *) 0 &&
         tbl[addr] >= breakPointPriorityThreshold && (tbl[addr] & 1) != 0) {
@@ -73,6 +77,12 @@ namespace Ep128 {
 
   void Memory::checkWriteBreakPoint(uint16_t addr, uint8_t page, uint8_t value)
   {
+    if (accessCountTable)
+      countAccess(addr, page, 1);
+    if (EP128EMU_UNLIKELY(((uint32_t(pageTable[page]) << 14)
+                           | uint32_t(addr & 0x3FFF)) == writeWatchAddr)) {
+      writeWatchFlag = true;
+    }
     const uint8_t *tbl = breakPointTable;
     if (tbl != (uint8_t *) 0 &&
         tbl[addr] >= breakPointPriorityThreshold && (tbl[addr] & 2) != 0) {
@@ -95,16 +105,20 @@ namespace Ep128 {
       breakPointCnt(0),
       segmentBreakPointTable((uint8_t **) 0),
       segmentBreakPointCntTable((size_t *) 0),
-      haveBreakPoints(false),
       breakPointPriorityThreshold(0),
       videoMemory((uint8_t *) 0),
-      dummyMemory((uint8_t *) 0)
+      dummyMemory((uint8_t *) 0),
+      accessCountTable((uint64_t *) 0),
+      writeWatchAddr(0xFFFFFFFFU),
+      writeWatchFlag(false)
 #ifdef ENABLE_SDEXT
       , sdext((SDExt *) 0)
 #endif
   {
     for (int i = 0; i < 4; i++) {
       pageTable[i] = 0;
+      pageBreakPointCntTable[i] = 0;
+      pageBreakPointFlags[i] = false;
       pageAddressTableR[i] = (uint8_t *) 0;
       pageAddressTableW[i] = (uint8_t *) 0;
     }
@@ -181,6 +195,8 @@ namespace Ep128 {
     }
     delete[] segmentBreakPointTable;
     delete[] segmentBreakPointCntTable;
+    if (accessCountTable)
+      delete[] accessCountTable;
   }
 
   void Memory::setBreakPoint(uint8_t segment, uint16_t addr, int priority,
@@ -196,7 +212,6 @@ namespace Ep128 {
         for (int i = 0; i < 16384; i++)
           segmentBreakPointTable[segment][i] = 0;
       }
-      haveBreakPoints = true;
       uint8_t&  bp = segmentBreakPointTable[segment][addr & 0x3FFF];
       if (!bp)
         segmentBreakPointCntTable[segment]++;
@@ -204,14 +219,18 @@ namespace Ep128 {
         mode = (bp & 56) + (mode & 7);
       mode |= (bp & 7);
       bp = mode;
+      updatePageBreakPointFlags();
     }
     else if (segmentBreakPointTable[segment]) {
-      if (segmentBreakPointTable[segment][addr & 0x3FFF]) {
+      uint8_t&  bp = segmentBreakPointTable[segment][addr & 0x3FFF];
+      if (bp) {
         // remove a previously existing breakpoint
+        bp = 0;
         segmentBreakPointCntTable[segment]--;
         if (!segmentBreakPointCntTable[segment]) {
           delete[] segmentBreakPointTable[segment];
           segmentBreakPointTable[segment] = (uint8_t *) 0;
+          updatePageBreakPointFlags();
         }
       }
     }
@@ -230,19 +249,25 @@ namespace Ep128 {
         for (int i = 0; i < 65536; i++)
           breakPointTable[i] = 0;
       }
-      haveBreakPoints = true;
       uint8_t&  bp = breakPointTable[addr];
-      if (!bp)
+      if (!bp) {
         breakPointCnt++;
+        if (!(pageBreakPointCntTable[addr >> 14]++))
+          updatePageBreakPointFlags();
+      }
       if (bp > mode)
         mode = (bp & 56) + (mode & 7);
       mode |= (bp & 7);
       bp = mode;
     }
     else if (breakPointTable) {
-      if (breakPointTable[addr]) {
+      uint8_t&  bp = breakPointTable[addr];
+      if (bp) {
         // remove a previously existing breakpoint
+        bp = 0;
         breakPointCnt--;
+        if (!(--pageBreakPointCntTable[addr >> 14]))
+          updatePageBreakPointFlags();
         if (!breakPointCnt) {
           delete[] breakPointTable;
           breakPointTable = (uint8_t *) 0;
@@ -268,7 +293,41 @@ namespace Ep128 {
     clearBreakPoints();
     for (unsigned int segment = 0; segment < 256; segment++)
       clearBreakPoints((uint8_t) segment);
-    haveBreakPoints = false;
+  }
+
+  void Memory::updatePageBreakPointFlags()
+  {
+    // memory accesses check for breakpoints only on pages where this is
+    // true, so that breakpoints elsewhere do not slow down emulation
+    for (int i = 0; i < 4; i++) {
+      pageBreakPointFlags[i] =
+          (pageBreakPointCntTable[i] != 0 ||
+           segmentBreakPointTable[pageTable[i]] != (uint8_t *) 0 ||
+           accessCountTable != (uint64_t *) 0 ||
+           (writeWatchAddr >> 14) == uint32_t(pageTable[i]));
+    }
+  }
+
+  void Memory::setAccessCountersEnabled(bool isEnabled)
+  {
+    if (isEnabled) {
+      if (!accessCountTable)
+        accessCountTable = new uint64_t[256 * 64 * 3];
+      for (size_t i = 0; i < (256 * 64 * 3); i++)
+        accessCountTable[i] = 0U;
+    }
+    else if (accessCountTable) {
+      delete[] accessCountTable;
+      accessCountTable = (uint64_t *) 0;
+    }
+    updatePageBreakPointFlags();
+  }
+
+  void Memory::setWriteWatchAddress(uint32_t addr)
+  {
+    writeWatchAddr = (addr < 0x00400000U ? addr : 0xFFFFFFFFU);
+    writeWatchFlag = false;
+    updatePageBreakPointFlags();
   }
 
   void Memory::breakPointCallback(bool isWrite, uint16_t addr, uint8_t value)
@@ -339,6 +398,11 @@ namespace Ep128 {
   {
     page = page & 3;
     pageTable[page] = segment;
+    pageBreakPointFlags[page] =
+        (pageBreakPointCntTable[page] != 0 ||
+         segmentBreakPointTable[segment] != (uint8_t *) 0 ||
+         accessCountTable != (uint64_t *) 0 ||
+         (writeWatchAddr >> 14) == uint32_t(segment));
     long    offs = -(long(page) << 14);
     if (segmentTable[segment] != (uint8_t *) 0) {
       pageAddressTableR[page] = segmentTable[segment] + offs;
@@ -37,12 +37,22 @@ namespace Ep128 {
     size_t  breakPointCnt;
     uint8_t **segmentBreakPointTable;
     size_t  *segmentBreakPointCntTable;
-    bool    haveBreakPoints;
+    // number of breakpoints in 'breakPointTable' for each 16K page
+    size_t  pageBreakPointCntTable[4];
+    // true if there are any breakpoints on the page, either by address,
+    // or in the segment currently mapped to it
+    bool    pageBreakPointFlags[4];
     uint8_t breakPointPriorityThreshold;
     uint8_t *videoMemory;   // 64K for segments FC, FD, FE, and FF; always RAM
     uint8_t *dummyMemory;   // 2*16K dummy memory for invalid reads and writes
     uint8_t *pageAddressTableR[4];
     uint8_t *pageAddressTableW[4];
+    // number of reads, writes, and opcode reads for each 256 byte block
+    // (256 segments * 64 blocks * 3 counters), or NULL if disabled
+    uint64_t *accessCountTable;
+    // 22-bit address of the byte to watch for writes, or 0xFFFFFFFF
+    uint32_t writeWatchAddr;
+    bool    writeWatchFlag;
 #ifdef ENABLE_SDEXT
     SDExt   *sdext;
 #endif
@@ -50,6 +60,12 @@ namespace Ep128 {
     void checkExecuteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkReadBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkWriteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
+    void updatePageBreakPointFlags();
+    inline void countAccess(uint16_t addr, uint8_t page, int type)
+    {
+      accessCountTable[((size_t(pageTable[page]) << 6)
+                        | size_t((addr >> 8) & 0x3F)) * 3 + size_t(type)]++;
+    }
    public:
     Memory();
     virtual ~Memory();
@@ -79,6 +95,45 @@ namespace Ep128 {
     inline bool isSegmentROM(uint8_t segment) const;
     inline bool isSegmentRAM(uint8_t segment) const;
     bool checkIgnoreBreakPoint(uint16_t addr) const;
+    /*!
+     * Enable or disable counting the CPU memory accesses in each 256 byte
+     * block of every segment. While enabled, all accesses take the slower
+     * breakpoint checking path. Enabling clears any previous counts.
+     */
+    void setAccessCountersEnabled(bool isEnabled);
+    inline bool getAccessCountersEnabled() const
+    {
+      return (accessCountTable != (uint64_t *) 0);
+    }
+    /*!
+     * Returns the number of reads (type = 0), writes (1), or opcode reads
+     * (2) in the 256 byte block at 22-bit physical address 'addr'.
+     */
+    inline uint64_t getAccessCount(uint32_t addr, int type) const
+    {
+      if (!accessCountTable)
+        return 0U;
+      return accessCountTable[size_t((addr >> 8) & 0x3FFFU) * 3
+                              + size_t(type)];
+    }
+    /*!
+     * Set the 22-bit physical address of a byte for which CPU writes are
+     * reported by getWriteWatchFlag(), or 0xFFFFFFFF to disable watching.
+     * Clears the flag.
+     */
+    void setWriteWatchAddress(uint32_t addr);
+    /*!
+     * Returns true if the watched byte has been written since the last call
+     * to clearWriteWatchFlag().
+     */
+    inline bool getWriteWatchFlag() const
+    {
+      return writeWatchFlag;
+    }
+    inline void clearWriteWatchFlag()
+    {
+      writeWatchFlag = false;
+    }
     Ep128Emu::BreakPointList getBreakPointList();
     void saveState(Ep128Emu::File::Buffer&);
     void saveState(Ep128Emu::File&);
@@ -104,7 +159,7 @@ namespace Ep128 {
     if (EP128EMU_UNLIKELY(sdext->isSDExtSegment(pageTable[page])))
       value = sdext->readCartP3(addr);
 #endif
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkReadBreakPoint(addr, page, value);
     return value;
   }
@@ -117,7 +172,7 @@ namespace Ep128 {
     if (EP128EMU_UNLIKELY(sdext->isSDExtSegment(pageTable[page])))
       value = sdext->readCartP3(addr);
 #endif
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkExecuteBreakPoint(addr, page, value);
     return value;
   }
@@ -150,7 +205,7 @@ namespace Ep128 {
   inline void Memory::write(uint16_t addr, uint8_t value)
   {
     uint8_t page = uint8_t(addr >> 14);
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkWriteBreakPoint(addr, page, value);
 #ifdef ENABLE_SDEXT
     if (EP128EMU_UNLIKELY(sdext->isSDExtSegment(pageTable[page]))) {
@@ -27,6 +27,10 @@
 #include "pngwrite.hpp"
 
 #define DEFLATE_MAX_THREADS     4
+// minimum number of bytes per band in fast compression mode
+#define DEFLATE_FAST_MIN_BAND   65536
+// maximum number of hash chain entries checked for each byte in fast mode
+#define DEFLATE_FAST_MAX_CHAIN  16
 #if 0
 #  define PNGWRITE_DEBUG        1
 #endif
@@ -576,6 +580,319 @@ namespace Ep128Emu {
 
   // --------------------------------------------------------------------------
 
+  // Fast compression of the bytes from startPos to endPos - 1 of the input
+  // buffer to a single fixed Huffman block, with greedy matching using hash
+  // chains. Matches may refer to the 32K bytes before startPos, which are
+  // compressed by the previous band. Unless this is the last band, the
+  // output ends with a sync point (empty stored block), so that the bands
+  // can be concatenated as bytes.
+
+  class ZLibFastCompressorThread : public Thread {
+   private:
+    // packed bits, LSB first
+    uint64_t  bitBuf;
+    size_t    bitCnt;
+    // fixed Huffman codes (bit reversed) and lengths of the literal and
+    // length symbols
+    unsigned short  literalCodes[288];
+    unsigned char   literalCodeLengths[288];
+    // --------
+    inline void writeBits(unsigned int c, size_t nBits);
+    void flushBits();
+    void writeStoredBlocks();
+   public:
+    std::vector< unsigned char >  outBuf;
+    const unsigned char *inBuf;
+    size_t  startPos;
+    size_t  endPos;
+    bool    isLastBand;
+    bool    errorFlag;
+    // --------
+    ZLibFastCompressorThread();
+    virtual ~ZLibFastCompressorThread();
+    virtual void run();
+  };
+
+  ZLibFastCompressorThread::ZLibFastCompressorThread()
+    : bitBuf(0U),
+      bitCnt(0),
+      inBuf((unsigned char *) 0),
+      startPos(0),
+      endPos(0),
+      isLastBand(true),
+      errorFlag(false)
+  {
+    for (unsigned int i = 0U; i < 288U; i++) {
+      unsigned int  c = 0U;
+      unsigned int  nBits = 0U;
+      if (i < 144U) {
+        c = i + 0x30U;
+        nBits = 8U;
+      }
+      else if (i < 256U) {
+        c = i + (0x190U - 144U);
+        nBits = 9U;
+      }
+      else if (i < 280U) {
+        c = i - 256U;
+        nBits = 7U;
+      }
+      else {
+        c = i + (0xC0U - 280U);
+        nBits = 8U;
+      }
+      // Huffman codes are stored MSB first
+      unsigned int  r = 0U;
+      for (unsigned int j = 0U; j < nBits; j++)
+        r = r | (((c >> j) & 1U) << (nBits - (j + 1U)));
+      literalCodes[i] = (unsigned short) r;
+      literalCodeLengths[i] = (unsigned char) nBits;
+    }
+  }
+
+  ZLibFastCompressorThread::~ZLibFastCompressorThread()
+  {
+  }
+
+  inline void ZLibFastCompressorThread::writeBits(unsigned int c,
+                                                  size_t nBits)
+  {
+    bitBuf = bitBuf | (uint64_t(c) << bitCnt);
+    bitCnt = bitCnt + nBits;
+    if (bitCnt >= 32) {
+      outBuf.push_back((unsigned char) (bitBuf & 0xFFU));
+      outBuf.push_back((unsigned char) ((bitBuf >> 8) & 0xFFU));
+      outBuf.push_back((unsigned char) ((bitBuf >> 16) & 0xFFU));
+      outBuf.push_back((unsigned char) ((bitBuf >> 24) & 0xFFU));
+      bitBuf = bitBuf >> 32;
+      bitCnt = bitCnt - 32;
+    }
+  }
+
+  void ZLibFastCompressorThread::flushBits()
+  {
+    // write any remaining bits, padded to a byte boundary
+    while (bitCnt > 0) {
+      outBuf.push_back((unsigned char) (bitBuf & 0xFFU));
+      bitBuf = bitBuf >> 8;
+      bitCnt = (bitCnt > 8 ? (bitCnt - 8) : 0);
+    }
+    bitBuf = 0U;
+  }
+
+  void ZLibFastCompressorThread::writeStoredBlocks()
+  {
+    outBuf.clear();
+    bitBuf = 0U;
+    bitCnt = 0;
+    size_t  i = startPos;
+    do {
+      size_t  nBytes = endPos - i;
+      nBytes = (nBytes < 65535 ? nBytes : 65535);
+      bool    isLastBlock = (isLastBand && (i + nBytes) >= endPos);
+      writeBits((unsigned int) isLastBlock, 3);
+      flushBits();
+      outBuf.push_back((unsigned char) (nBytes & 0xFF));
+      outBuf.push_back((unsigned char) (nBytes >> 8));
+      outBuf.push_back((unsigned char) ((~nBytes) & 0xFF));
+      outBuf.push_back((unsigned char) (((~nBytes) >> 8) & 0xFF));
+      outBuf.insert(outBuf.end(), inBuf + i, inBuf + (i + nBytes));
+      i = i + nBytes;
+    } while (i < endPos);
+  }
+
+  void ZLibFastCompressorThread::run()
+  {
+    try {
+      if (!inBuf || endPos <= startPos)
+        return;
+      const size_t  maxDist = Compressor_ZLib::maxMatchDist;
+      const size_t  minLen = Compressor_ZLib::minMatchLen;
+      const size_t  maxLen = Compressor_ZLib::maxMatchLen;
+      size_t  dictStart = (startPos > maxDist ? (startPos - maxDist) : 0);
+      // hash chains of 3-byte sequences, positions are relative to dictStart
+      std::vector< int32_t >  hashTable(32768, -1);
+      std::vector< int32_t >  prvPos(endPos - dictStart, -1);
+      outBuf.clear();
+      outBuf.reserve((endPos - startPos) >> 2);
+      bitBuf = 0U;
+      bitCnt = 0;
+      // block header: last block flag, fixed Huffman codes (01b)
+      writeBits((unsigned int) isLastBand | 2U, 3);
+      for (size_t i = dictStart; i < endPos; ) {
+        size_t  bestLen = 0;
+        size_t  bestDist = 0;
+        if ((i + minLen) <= endPos) {
+          unsigned int  h = ((unsigned int) inBuf[i] << 16)
+                            | ((unsigned int) inBuf[i + 1] << 8)
+                            | (unsigned int) inBuf[i + 2];
+          h = ((h * 0x9E3779B1U) >> 17) & 0x7FFFU;
+          int32_t p = hashTable[h];
+          if (i >= startPos) {
+            size_t  lenLimit = endPos - i;
+            lenLimit = (lenLimit < maxLen ? lenLimit : maxLen);
+            for (int n = DEFLATE_FAST_MAX_CHAIN; p >= 0 && n > 0; n--) {
+              size_t  j = dictStart + size_t(p);
+              if ((i - j) > maxDist)
+                break;
+              if (inBuf[j + bestLen] == inBuf[i + bestLen]) {
+                size_t  len = 0;
+                while (len < lenLimit && inBuf[j + len] == inBuf[i + len])
+                  len++;
+                if (len > bestLen) {
+                  bestLen = len;
+                  bestDist = i - j;
+                  if (len >= lenLimit)
+                    break;
+                }
+              }
+              p = prvPos[j - dictStart];
+            }
+          }
+          prvPos[i - dictStart] = hashTable[h];
+          hashTable[h] = int32_t(i - dictStart);
+        }
+        if (i < startPos) {
+          // only add the dictionary to the hash table
+          i++;
+          continue;
+        }
+        if (bestLen < minLen) {
+          unsigned int  c = inBuf[i];
+          writeBits(literalCodes[c], literalCodeLengths[c]);
+          i++;
+          continue;
+        }
+        // write length and distance codes
+        unsigned int  lenCode = getLengthCode(bestLen);
+        unsigned int  lenBits = ((lenCode >= 265U && lenCode < 285U) ?
+                                 ((lenCode - 261U) >> 2) : 0U);
+        writeBits(literalCodes[lenCode], literalCodeLengths[lenCode]);
+        writeBits((unsigned int) (bestLen - minLen) & ((1U << lenBits) - 1U),
+                  lenBits);
+        unsigned int  distCode = getDistanceCode(bestDist);
+        unsigned int  distBits = (distCode >= 4U ? ((distCode - 2U) >> 1) : 0U);
+        unsigned int  r = 0U;
+        for (unsigned int j = 0U; j < 5U; j++)
+          r = r | (((distCode >> j) & 1U) << (4U - j));
+        writeBits(r, 5);
+        writeBits((unsigned int) (bestDist - 1) & ((1U << distBits) - 1U),
+                  distBits);
+        // add the rest of the match to the hash table
+        size_t  matchEnd = i + bestLen;
+        for (i++; i < matchEnd; i++) {
+          if ((i + minLen) <= endPos) {
+            unsigned int  h = ((unsigned int) inBuf[i] << 16)
+                              | ((unsigned int) inBuf[i + 1] << 8)
+                              | (unsigned int) inBuf[i + 2];
+            h = ((h * 0x9E3779B1U) >> 17) & 0x7FFFU;
+            prvPos[i - dictStart] = hashTable[h];
+            hashTable[h] = int32_t(i - dictStart);
+          }
+        }
+      }
+      // end of block symbol
+      writeBits(literalCodes[256], literalCodeLengths[256]);
+      if (!isLastBand) {
+        // sync point: empty stored block, aligned to a byte boundary
+        writeBits(0U, 3);
+        flushBits();
+        outBuf.push_back(0x00);
+        outBuf.push_back(0x00);
+        outBuf.push_back(0xFF);
+        outBuf.push_back(0xFF);
+      }
+      else {
+        flushBits();
+      }
+      if (outBuf.size() > ((endPos - startPos) + (endPos - startPos) / 8192
+                           + 16)) {
+        // if cannot reduce the data size, store without compression
+        writeStoredBlocks();
+      }
+    }
+    catch (std::exception&) {
+      errorFlag = true;
+    }
+  }
+
+  // --------------------------------------------------------------------------
+
+  static unsigned int calculateAdler32(const unsigned char *buf, size_t nBytes)
+  {
+    unsigned int  tmp1 = 1U;
+    unsigned int  tmp2 = 0U;
+    for (size_t i = 0; i < nBytes; i++) {
+      tmp1 = tmp1 + (unsigned int) buf[i];
+      if (tmp1 >= 65521U)
+        tmp1 -= 65521U;
+      tmp2 = tmp2 + tmp1;
+      if (tmp2 >= 65521U)
+        tmp2 -= 65521U;
+    }
+    return (tmp1 | (tmp2 << 16));
+  }
+
+  void Compressor_ZLib::compressDataFast(std::vector< unsigned char >& outBuf,
+                                         const unsigned char *inBuf,
+                                         size_t inBufSize)
+  {
+    outBuf.clear();
+    if (inBufSize < 1 || !inBuf)
+      return;
+    ZLibFastCompressorThread  *compressorThreads[DEFLATE_MAX_THREADS];
+    for (int i = 0; i < DEFLATE_MAX_THREADS; i++)
+      compressorThreads[i] = (ZLibFastCompressorThread *) 0;
+    try {
+      int     nBands = int(inBufSize / DEFLATE_FAST_MIN_BAND);
+      nBands = (nBands > 1 ? (nBands < DEFLATE_MAX_THREADS ?
+                              nBands : DEFLATE_MAX_THREADS) : 1);
+      size_t  bandSize = (inBufSize + size_t(nBands - 1)) / size_t(nBands);
+      for (int i = 0; i < nBands; i++) {
+        compressorThreads[i] = new ZLibFastCompressorThread();
+        compressorThreads[i]->inBuf = inBuf;
+        compressorThreads[i]->startPos = size_t(i) * bandSize;
+        compressorThreads[i]->endPos =
+            (i < (nBands - 1) ? (size_t(i + 1) * bandSize) : inBufSize);
+        compressorThreads[i]->isLastBand = (i == (nBands - 1));
+      }
+      for (int i = 0; i < nBands; i++)
+        compressorThreads[i]->start();
+      unsigned int  adler32Sum = calculateAdler32(inBuf, inBufSize);
+      for (int i = 0; i < nBands; i++)
+        compressorThreads[i]->join();
+      // write ZLib header:
+      //   CINFO = 7 (32K dictionary size)
+      //   CM = 8 (Deflate method)
+      //   FLEVEL = 0 (fastest compression)
+      //   FDICT = 0 (no preset dictionary)
+      //   FCHECK = 1 ((0x7801 % 31) == 0)
+      outBuf.push_back(0x78);
+      outBuf.push_back(0x01);
+      for (int i = 0; i < nBands; i++) {
+        if (compressorThreads[i]->errorFlag)
+          throw Exception("error compressing data");
+        outBuf.insert(outBuf.end(), compressorThreads[i]->outBuf.begin(),
+                      compressorThreads[i]->outBuf.end());
+        delete compressorThreads[i];
+        compressorThreads[i] = (ZLibFastCompressorThread *) 0;
+      }
+      // store Adler-32 checksum
+      outBuf.push_back((unsigned char) ((adler32Sum >> 24) & 0xFFU));
+      outBuf.push_back((unsigned char) ((adler32Sum >> 16) & 0xFFU));
+      outBuf.push_back((unsigned char) ((adler32Sum >> 8) & 0xFFU));
+      outBuf.push_back((unsigned char) (adler32Sum & 0xFFU));
+    }
+    catch (...) {
+      for (int i = 0; i < DEFLATE_MAX_THREADS; i++) {
+        if (compressorThreads[i])
+          delete compressorThreads[i];
+      }
+      outBuf.clear();
+      throw;
+    }
+  }
+
   void Compressor_ZLib::compressData(std::vector< unsigned char >& outBuf,
                                      const unsigned char *inBuf,
                                      size_t inBufSize, size_t blockSize)
@@ -601,20 +918,7 @@ namespace Ep128Emu {
       for (int i = 0; i < nThreads; i++)
         compressorThreads[i]->start();
       // calculate Adler-32 checksum of input data
-      unsigned int  adler32Sum;
-      {
-        unsigned int  tmp1 = 1U;
-        unsigned int  tmp2 = 0U;
-        for (size_t i = 0; i < inBufSize; i++) {
-          tmp1 = tmp1 + (unsigned int) inBuf[i];
-          if (tmp1 >= 65521U)
-            tmp1 -= 65521U;
-          tmp2 = tmp2 + tmp1;
-          if (tmp2 >= 65521U)
-            tmp2 -= 65521U;
-        }
-        adler32Sum = tmp1 | (tmp2 << 16);
-      }
+      unsigned int  adler32Sum = calculateAdler32(inBuf, inBufSize);
       for (int i = 0; i < nThreads; i++) {
         compressorThreads[i]->join();
         // startPos is now the read position of the output buffer of the thread
@@ -739,7 +1043,8 @@ namespace Ep128Emu {
 
   void writePNGImage(const char *fileName,
                      const unsigned char *inBuf, int w, int h, int nColors,
-                     bool optimizePalette, size_t blockSize)
+                     bool optimizePalette, size_t blockSize,
+                     bool fastCompression)
   {
     static const char *pngSignature = "\211PNG\r\n\032\n";
 #ifdef PNGWRITE_DEBUG
@@ -823,8 +1128,14 @@ namespace Ep128Emu {
           srcp = srcp + lineBytesI;
           dstp = dstp + lineBytesO;
         }
-        Compressor_ZLib::compressData(outBuf, &(imgDataBuf.front()),
-                                      imgDataBuf.size(), blockSize);
+        if (fastCompression) {
+          Compressor_ZLib::compressDataFast(outBuf, &(imgDataBuf.front()),
+                                            imgDataBuf.size());
+        }
+        else {
+          Compressor_ZLib::compressData(outBuf, &(imgDataBuf.front()),
+                                        imgDataBuf.size(), blockSize);
+        }
       }
       f = fileOpen(fileName, "wb");
       if (!f)
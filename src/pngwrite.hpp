@@ -95,6 +95,12 @@ namespace Ep128Emu {
     static void compressData(std::vector< unsigned char >& outBuf,
                              const unsigned char *inBuf, size_t inBufSize,
                              size_t blockSize = 16384);
+    // fast compression with greedy matching and fixed Huffman codes; the
+    // input is split into up to 4 bands that are compressed in parallel,
+    // and joined at sync points (empty stored blocks)
+    static void compressDataFast(std::vector< unsigned char >& outBuf,
+                                 const unsigned char *inBuf,
+                                 size_t inBufSize);
   };
 
   // ==========================================================================
@@ -109,10 +115,14 @@ namespace Ep128Emu {
    * used, and w * h * 3 in the case of RGB format. If a palette is present,
    * it is expected to be at the beginning of 'inBuf' as nColors * 3
    * interleaved R, G, B values.
+   * If 'fastCompression' is true, the image data is compressed with
+   * Compressor_ZLib::compressDataFast() instead, which is much faster, but
+   * creates larger files; 'blockSize' is ignored in this case.
    */
   void writePNGImage(const char *fileName,
                      const unsigned char *inBuf, int w, int h, int nColors,
-                     bool optimizePalette = false, size_t blockSize = 16384);
+                     bool optimizePalette = false, size_t blockSize = 16384,
+                     bool fastCompression = false);
 
 }       // namespace Ep128Emu
 
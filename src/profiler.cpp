@@ -0,0 +1,210 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "vm.hpp"
+#include "debuglib.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+static void printCountToFile(std::FILE *f, uint64_t n, int fieldWidth)
+{
+  // print a 64-bit unsigned integer without relying on printf() support
+  char    tmpBuf[24];
+  int     len = 0;
+  do {
+    tmpBuf[len++] = char('0' + int(n % 10U));
+    n = n / 10U;
+  } while (n);
+  for ( ; fieldWidth > len; fieldWidth--)
+    std::fputc(' ', f);
+  while (len > 0)
+    std::fputc(tmpBuf[--len], f);
+}
+
+namespace Ep128Emu {
+
+  Profiler::Profiler(const VirtualMachine& vm_, uint32_t timeMask_,
+                     bool callStackEnabled_)
+    : vm(vm_),
+      prvAddr(0xFFFFFFFFU),
+      prvTime(0U),
+      timeMask(timeMask_),
+      prvPC(0),
+      prvSP(0),
+      callStackEnabled(callStackEnabled_),
+      totalInsnCnt(0U),
+      totalTime(0U)
+  {
+    for (size_t i = 0; i < 256; i++)
+      histogram[i] = (HistogramEntry *) 0;
+  }
+
+  Profiler::~Profiler()
+  {
+    for (size_t i = 0; i < 256; i++) {
+      if (histogram[i]) {
+        delete[] histogram[i];
+        histogram[i] = (HistogramEntry *) 0;
+      }
+    }
+  }
+
+  Profiler::HistogramEntry * Profiler::allocateSegment_(uint8_t segment)
+  {
+    HistogramEntry  *p = new HistogramEntry[16384];
+    for (size_t i = 0; i < 16384; i++) {
+      p[i].insnCnt = 0U;
+      p[i].halfCycleCnt = 0U;
+    }
+    histogram[segment] = p;
+    return p;
+  }
+
+  void Profiler::updateCallStack_(uint32_t addr, uint16_t pc, uint16_t sp)
+  {
+    // if the stack pointer is above the return address of the innermost
+    // function, then it has returned (or the stack was reset)
+    while (!callStack.empty() && sp > callStack.back().sp) {
+      const CallStackEntry& e = callStack.back();
+      FunctionStats&  s = functionStats[e.addr];
+      s.callCnt++;
+      s.halfCycleCnt += (totalTime - e.startTime);
+      callStack.pop_back();
+    }
+    if (sp == uint16_t(prvSP - 2)) {
+      // CALL, RST, or interrupt: a return address just after the previous
+      // instruction was pushed, and the program jumped somewhere else
+      uint16_t  retAddr = uint16_t(vm.readMemory(sp, true))
+                          | (uint16_t(vm.readMemory(uint16_t(sp + 1), true))
+                             << 8);
+      if (uint16_t(retAddr - prvPC) >= 1 && uint16_t(retAddr - prvPC) <= 4 &&
+          pc != retAddr) {
+        if (callStack.size() >= maxCallStackDepth)
+          callStack.erase(callStack.begin());
+        CallStackEntry  e;
+        e.addr = addr;
+        e.sp = sp;
+        e.startTime = totalTime;
+        callStack.push_back(e);
+      }
+    }
+    prvPC = pc;
+    prvSP = sp;
+  }
+
+  void Profiler::clear()
+  {
+    for (size_t i = 0; i < 256; i++) {
+      if (histogram[i]) {
+        delete[] histogram[i];
+        histogram[i] = (HistogramEntry *) 0;
+      }
+    }
+    prvAddr = 0xFFFFFFFFU;
+    totalInsnCnt = 0U;
+    totalTime = 0U;
+    callStack.clear();
+    functionStats.clear();
+  }
+
+  void Profiler::getInstructionStats(uint32_t addr, uint64_t& insnCnt,
+                                     uint64_t& cycleCnt) const
+  {
+    insnCnt = 0U;
+    cycleCnt = 0U;
+    const HistogramEntry  *p = histogram[(addr >> 14) & 0xFFU];
+    if (p) {
+      insnCnt = p[addr & 0x3FFFU].insnCnt;
+      cycleCnt = p[addr & 0x3FFFU].halfCycleCnt >> 1;
+    }
+  }
+
+  void Profiler::writeReport(std::FILE *f, size_t maxEntries) const
+  {
+    std::vector< std::pair< uint64_t, uint32_t > >  tmp;
+    for (size_t i = 0; i < 256; i++) {
+      const HistogramEntry  *p = histogram[i];
+      if (!p)
+        continue;
+      for (size_t j = 0; j < 16384; j++) {
+        if (p[j].insnCnt) {
+          tmp.push_back(std::pair< uint64_t, uint32_t >(
+                            p[j].halfCycleCnt, uint32_t((i << 14) | j)));
+        }
+      }
+    }
+    std::sort(tmp.begin(), tmp.end());
+    std::fprintf(f, "; instructions: ");
+    printCountToFile(f, totalInsnCnt, 0);
+    std::fprintf(f, ", cycles: ");
+    printCountToFile(f, totalTime >> 1, 0);
+    std::fprintf(f, "\n;\n;      cycles    %%       count  address\n");
+    double  pctScale = 100.0 / double(totalTime > 0U ? totalTime : 1U);
+    std::string disasmBuf;
+    size_t  n = tmp.size();
+    if (maxEntries > 0 && maxEntries < n)
+      n = maxEntries;
+    for (size_t i = 0; i < n; i++) {
+      const std::pair< uint64_t, uint32_t >&  e = tmp[tmp.size() - (i + 1)];
+      const HistogramEntry& h = histogram[e.second >> 14][e.second & 0x3FFFU];
+      printCountToFile(f, h.halfCycleCnt >> 1, 13);
+      std::fprintf(f, " %5.2f ", double(h.halfCycleCnt) * pctScale);
+      printCountToFile(f, h.insnCnt, 11);
+      try {
+        Ep128::Z80Disassembler::disassembleInstruction(disasmBuf, vm,
+                                                       e.second, false, 0,
+                                                       &vm.getSymbolTable());
+      }
+      catch (...) {
+        disasmBuf = "";
+      }
+      std::fprintf(f, "%s\n", disasmBuf.c_str());
+    }
+    if (functionStats.size() < 1)
+      return;
+    tmp.clear();
+    for (std::map< uint32_t, FunctionStats >::const_iterator i =
+             functionStats.begin(); i != functionStats.end(); i++) {
+      tmp.push_back(std::pair< uint64_t, uint32_t >(i->second.halfCycleCnt,
+                                                    i->first));
+    }
+    std::sort(tmp.begin(), tmp.end());
+    std::fprintf(f, ";\n; functions (including called functions)\n;\n"
+                    ";      cycles    %%       calls  address\n");
+    n = tmp.size();
+    if (maxEntries > 0 && maxEntries < n)
+      n = maxEntries;
+    for (size_t i = 0; i < n; i++) {
+      const std::pair< uint64_t, uint32_t >&  e = tmp[tmp.size() - (i + 1)];
+      const FunctionStats&  s = functionStats.find(e.second)->second;
+      printCountToFile(f, s.halfCycleCnt >> 1, 13);
+      std::fprintf(f, " %5.2f ", double(s.halfCycleCnt) * pctScale);
+      printCountToFile(f, s.callCnt, 11);
+      uint32_t    symOffs = 0U;
+      const char  *name = vm.findSymbol(symOffs, e.second, false);
+      if (name)
+        std::fprintf(f, "  %06X  %s\n", (unsigned int) e.second, name);
+      else
+        std::fprintf(f, "  %06X\n", (unsigned int) e.second);
+    }
+  }
+
+}       // namespace Ep128Emu
@@ -0,0 +1,138 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_PROFILER_HPP
+#define EP128EMU_PROFILER_HPP
+
+#include "ep128emu.hpp"
+
+#include <vector>
+#include <map>
+
+namespace Ep128Emu {
+
+  class VirtualMachine;
+
+  class Profiler {
+   public:
+    struct FunctionStats {
+      uint64_t  callCnt;
+      uint64_t  halfCycleCnt;           // including the called functions
+      FunctionStats()
+        : callCnt(0U),
+          halfCycleCnt(0U)
+      {
+      }
+    };
+   private:
+    struct HistogramEntry {
+      uint64_t  insnCnt;
+      uint64_t  halfCycleCnt;
+    };
+    struct CallStackEntry {
+      uint32_t  addr;                   // 22-bit address of the function
+      uint16_t  sp;                     // SP after pushing the return address
+      uint64_t  startTime;
+    };
+    static const size_t maxCallStackDepth = 1024;
+    const VirtualMachine& vm;
+    // 256 segments * 16384 entries, allocated on first use
+    HistogramEntry  *histogram[256];
+    // 22-bit address of the last instruction, or 0xFFFFFFFF after clear()
+    uint32_t  prvAddr;
+    uint32_t  prvTime;                  // in CPU half cycles
+    uint32_t  timeMask;
+    uint16_t  prvPC;
+    uint16_t  prvSP;
+    bool      callStackEnabled;
+    uint64_t  totalInsnCnt;
+    uint64_t  totalTime;                // in CPU half cycles
+    std::vector< CallStackEntry >   callStack;
+    std::map< uint32_t, FunctionStats > functionStats;
+    // --------
+    HistogramEntry *allocateSegment_(uint8_t segment);
+    void updateCallStack_(uint32_t addr, uint16_t pc, uint16_t sp);
+   public:
+    /*!
+     * Create profiler for the Z80 code running on 'vm_'. The time stamps
+     * passed to addInstruction() are in CPU half cycles, and only the bits
+     * set in 'timeMask_' are valid. If 'callStackEnabled_' is true, calls
+     * (including interrupts) and returns are also tracked to collect the
+     * number of calls and total time spent in each function.
+     */
+    Profiler(const VirtualMachine& vm_, uint32_t timeMask_,
+             bool callStackEnabled_ = false);
+    virtual ~Profiler();
+    /*!
+     * Called by the virtual machine at the beginning of each instruction.
+     * 'addr' is the 22-bit physical address of the instruction, 'pc' and
+     * 'sp' are the current Z80 registers, and 't' is the current time.
+     */
+    EP128EMU_INLINE void addInstruction(uint32_t addr, uint16_t pc,
+                                        uint16_t sp, uint32_t t)
+    {
+      if (EP128EMU_UNLIKELY(prvAddr > 0x003FFFFFU)) {
+        prvAddr = addr;
+        prvTime = t;
+        prvPC = pc;
+        prvSP = sp;
+        return;
+      }
+      uint32_t  d = (t - prvTime) & timeMask;
+      prvTime = t;
+      HistogramEntry  *p = histogram[(prvAddr >> 14) & 0xFFU];
+      if (EP128EMU_UNLIKELY(!p))
+        p = allocateSegment_(uint8_t((prvAddr >> 14) & 0xFFU));
+      p = p + (prvAddr & 0x3FFFU);
+      p->insnCnt++;
+      p->halfCycleCnt += d;
+      totalTime += d;
+      totalInsnCnt++;
+      prvAddr = addr;
+      if (callStackEnabled)
+        updateCallStack_(addr, pc, sp);
+    }
+    /*!
+     * Clear all collected data.
+     */
+    void clear();
+    /*!
+     * Returns the number of times the instruction at 22-bit address 'addr'
+     * was executed, and the total number of CPU cycles it took.
+     */
+    void getInstructionStats(uint32_t addr,
+                             uint64_t& insnCnt, uint64_t& cycleCnt) const;
+    inline uint64_t getTotalInstructions() const
+    {
+      return totalInsnCnt;
+    }
+    inline uint64_t getTotalCycles() const
+    {
+      return (totalTime >> 1);
+    }
+    /*!
+     * Write a text report of the 'maxEntries' most expensive instructions
+     * (0: all) and functions to 'f', sorted by the number of cycles.
+     */
+    void writeReport(std::FILE *f, size_t maxEntries = 0) const;
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_PROFILER_HPP
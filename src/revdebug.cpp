@@ -0,0 +1,347 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Reverse debugging for the Enterprise: while enabled, the complete machine
+// state is saved to memory periodically (a checkpoint), and every opcode
+// fetch is counted. Any earlier instruction can then be reached by loading
+// the last checkpoint before it, and running the emulation without audio
+// and video output until the instruction count matches. Keyboard events
+// are logged with the instruction count, and applied again at the same
+// position during replay. Searching for the last breakpoint or write
+// replays one checkpoint interval at a time, starting from the newest one.
+
+#include "ep128emu.hpp"
+#include "z80/z80.hpp"
+#include "memory.hpp"
+#include "ioports.hpp"
+#include "dave.hpp"
+#include "nick.hpp"
+#include "vm.hpp"
+#include "ep128vm.hpp"
+
+namespace Ep128 {
+
+  void Ep128VM::reverseDebugEvent()
+  {
+    // apply the keyboard events that were recorded before this instruction
+    while (reverseInputEventPos < reverseInputEvents.size()) {
+      const ReverseInputEvent&  e = reverseInputEvents[reverseInputEventPos];
+      if (e.insnCnt >= reverseInsnCnt)
+        break;
+      dave.setKeyboardState(e.keyCode, int(e.isPressed));
+      reverseInputEventPos++;
+    }
+    if (reverseDebugMode == 3) {
+      if (memory.getWriteWatchFlag()) {
+        // the previous instruction wrote the watched byte
+        memory.clearWriteWatchFlag();
+        if ((reverseInsnCnt - 1U) < reverseRequestCnt)
+          reverseHitCnt = reverseInsnCnt - 1U;
+      }
+      if (reverseInsnCnt >= reverseStopCnt)
+        reverseReplayDone = true;
+    }
+    else if (reverseDebugMode == 4) {
+      if (reverseInsnCnt >= reverseStopCnt) {
+        // reached the requested instruction: everything recorded after it
+        // is no longer valid, because execution continues from here
+        endReverseReplay();
+        while (!reverseCheckpoints.empty() &&
+               reverseCheckpoints.back().insnCnt >= reverseInsnCnt) {
+          reverseMemoryUsed -=
+              reverseCheckpoints.back().snapshot->getBufferDataSize();
+          delete reverseCheckpoints.back().snapshot;
+          reverseCheckpoints.pop_back();
+        }
+        reverseInputEvents.resize(reverseInputEventPos);
+        reverseCheckpointTime = 0;
+        reverseReplayDone = true;
+        // break at this instruction
+        setSingleStepMode(1);
+      }
+    }
+  }
+
+  void Ep128VM::reverseBreakPointCallback(void *userData, int type,
+                                          uint16_t addr, uint8_t value)
+  {
+    (void) addr;
+    (void) value;
+    Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
+    if (vm.reverseDebugMode == 3 && vm.reverseRequestType == 1 &&
+        type != 3 && vm.reverseInsnCnt < vm.reverseRequestCnt) {
+      vm.reverseHitCnt = vm.reverseInsnCnt;
+    }
+  }
+
+  void Ep128VM::saveReverseCheckpoint()
+  {
+    reverseCheckpointTime = 0;
+    ReverseCheckpoint cp;
+    cp.snapshot = new Ep128Emu::File();
+    cp.insnCnt = reverseInsnCnt;
+    try {
+      saveState(*(cp.snapshot));
+      cp.snapshot->appendEndOfFileChunk();
+      registerChunkTypes(*(cp.snapshot));
+      reverseCheckpoints.push_back(cp);
+    }
+    catch (...) {
+      delete cp.snapshot;
+      throw;
+    }
+    reverseMemoryUsed += cp.snapshot->getBufferDataSize();
+    // delete the oldest checkpoints if over the memory limit
+    size_t  n = 0;
+    while ((reverseCheckpoints.size() - n) > 1 &&
+           reverseMemoryUsed > reverseMemoryLimit) {
+      reverseMemoryUsed -= reverseCheckpoints[n].snapshot->getBufferDataSize();
+      delete reverseCheckpoints[n].snapshot;
+      n++;
+    }
+    if (n > 0) {
+      reverseCheckpoints.erase(reverseCheckpoints.begin(),
+                               reverseCheckpoints.begin() + n);
+      uint64_t  minCnt = reverseCheckpoints.front().insnCnt;
+      n = 0;
+      while (n < reverseInputEvents.size() &&
+             reverseInputEvents[n].insnCnt < minCnt) {
+        n++;
+      }
+      reverseInputEvents.erase(reverseInputEvents.begin(),
+                               reverseInputEvents.begin() + n);
+    }
+  }
+
+  void Ep128VM::loadReverseCheckpoint(size_t n)
+  {
+    const ReverseCheckpoint&  cp = reverseCheckpoints[n];
+    reverseRestoreFlag = true;
+    try {
+      cp.snapshot->processAllChunks();
+    }
+    catch (...) {
+      reverseRestoreFlag = false;
+      throw;
+    }
+    reverseRestoreFlag = false;
+    reverseInsnCnt = cp.insnCnt;
+    // events logged at the same instruction count may have been recorded
+    // before taking the snapshot, but applying them again is harmless
+    reverseInputEventPos = 0;
+    while (reverseInputEventPos < reverseInputEvents.size() &&
+           reverseInputEvents[reverseInputEventPos].insnCnt < cp.insnCnt) {
+      reverseInputEventPos++;
+    }
+    memory.clearWriteWatchFlag();
+  }
+
+  size_t Ep128VM::findReverseCheckpoint(uint64_t insnCnt) const
+  {
+    // returns the last checkpoint from which 'insnCnt' can be reached
+    size_t  n = reverseCheckpoints.size();
+    while (n > 1 && reverseCheckpoints[n - 1].insnCnt >= insnCnt)
+      n--;
+    return (n - 1);
+  }
+
+  void Ep128VM::runReverseReplay(uint64_t stopCnt)
+  {
+    reverseStopCnt = stopCnt;
+    reverseReplayDone = false;
+    // limit the number of NICK slots in case the replay is not deterministic
+    int64_t nickCyclesRemaining =
+        int64_t(nickFrequency)
+        * (reverseCheckpointInterval * 4 + 1000000) / 1000000;
+    do {
+      if (EP128EMU_UNLIKELY(--nickCyclesRemaining < 0))
+        throw Ep128Emu::Exception("error replaying execution history");
+      Ep128VMCallback   *p = firstCallback;
+      while (p) {
+        Ep128VMCallback *nxt = p->nxt;
+        p->func(p->userData);
+        p = nxt;
+      }
+      daveCyclesRemaining += daveCyclesPerNickCycle;
+      while (daveCyclesRemaining >= 0L) {
+        daveCyclesRemaining -= (int64_t(1) << 32);
+        soundOutputSignal = dave.runOneCycle();
+      }
+      cpuCyclesRemaining += cpuCyclesPerNickCycle;
+      while (cpuCyclesRemaining >= 0L)
+        z80.executeInstruction();
+      nick.runOneSlot();
+    } while (!reverseReplayDone);
+  }
+
+  void Ep128VM::processReverseRequest()
+  {
+    bool    videoCaptureEnabled = bool(videoCapture);
+    if (videoCaptureEnabled)
+      setCallback(&videoCaptureCallback, this, false);
+    try {
+      if (reverseCheckpoints.empty() ||
+          (reverseCheckpoints.front().insnCnt + 1U) >= reverseRequestCnt) {
+        // the history has been cleared since the request
+        endReverseReplay();
+      }
+      else {
+        uint64_t  stopCnt = reverseRequestCnt - 1U;
+        if (reverseRequestType != 0) {
+          // search backwards, one checkpoint at a time
+          reverseDebugMode = 3;
+          reverseNextEventCnt = 0U;
+          reverseHitCnt = 0U;
+          if (reverseRequestType == 2)
+            memory.setWriteWatchAddress(reverseWatchAddr);
+          size_t    n = findReverseCheckpoint(stopCnt);
+          uint64_t  endCnt = stopCnt;
+          while (true) {
+            loadReverseCheckpoint(n);
+            runReverseReplay(endCnt + 1U);
+            if (reverseHitCnt != 0U || n == 0)
+              break;
+            endCnt = reverseCheckpoints[n].insnCnt;
+            n--;
+          }
+          memory.setWriteWatchAddress(0xFFFFFFFFU);
+          if (reverseHitCnt != 0U)
+            stopCnt = reverseHitCnt;
+          else
+            stopCnt = reverseCheckpoints.front().insnCnt + 1U;
+        }
+        reverseDebugMode = 4;
+        reverseNextEventCnt = 0U;
+        loadReverseCheckpoint(findReverseCheckpoint(stopCnt));
+        runReverseReplay(stopCnt);
+      }
+    }
+    catch (...) {
+      endReverseReplay();
+      reverseDebugMode = 0;
+      clearReverseHistory();
+      if (videoCaptureEnabled)
+        setCallback(&videoCaptureCallback, this, true);
+      nickCyclesRemainingH = 0;
+      throw;
+    }
+    if (videoCaptureEnabled)
+      setCallback(&videoCaptureCallback, this, true);
+    nickCyclesRemainingH = 0;
+  }
+
+  void Ep128VM::endReverseReplay()
+  {
+    if (reverseDebugMode < 2)
+      return;
+    reverseDebugMode = 1;
+    reverseNextEventCnt = ~(uint64_t(0));
+    memory.setWriteWatchAddress(0xFFFFFFFFU);
+    breakPointCallback = reverseSavedBreakPointCallback;
+    breakPointCallbackUserData = reverseSavedBreakPointUserData;
+    frameHookCallback = reverseSavedFrameHook;
+    ioHookCallback = reverseSavedIOHook;
+    profilerRunning = reverseSavedProfilerRunning;
+  }
+
+  void Ep128VM::clearReverseHistory()
+  {
+    if (reverseRestoreFlag)
+      return;           // called by loadState() or reset() on a checkpoint
+    for (size_t i = 0; i < reverseCheckpoints.size(); i++)
+      delete reverseCheckpoints[i].snapshot;
+    reverseCheckpoints.clear();
+    reverseInputEvents.clear();
+    reverseInputEventPos = 0;
+    reverseMemoryUsed = 0;
+    reverseInsnCnt = 0U;
+    // take a new checkpoint at the beginning of the next time slice
+    reverseCheckpointTime = reverseCheckpointInterval;
+  }
+
+  // --------------------------------------------------------------------------
+
+  void Ep128VM::setReverseDebugEnabled(bool isEnabled,
+                                       double checkpointInterval,
+                                       size_t maxMemoryMB)
+  {
+    if (!isEnabled) {
+      endReverseReplay();
+      reverseDebugMode = 0;
+      clearReverseHistory();
+      return;
+    }
+    checkpointInterval = (checkpointInterval > 0.001 ?
+                          (checkpointInterval < 10.0 ?
+                           checkpointInterval : 10.0) : 0.001);
+    maxMemoryMB = (maxMemoryMB > 1 ?
+                   (maxMemoryMB < 2048 ? maxMemoryMB : 2048) : 1);
+    reverseCheckpointInterval = int64_t(checkpointInterval * 1000000.0 + 0.5);
+    reverseMemoryLimit = maxMemoryMB << 20;
+    if (reverseDebugMode == 0) {
+      reverseDebugMode = 1;
+      reverseNextEventCnt = ~(uint64_t(0));
+      clearReverseHistory();
+    }
+  }
+
+  bool Ep128VM::getReverseDebugEnabled() const
+  {
+    return (reverseDebugMode != 0);
+  }
+
+  void Ep128VM::reverseExecute(int mode, uint32_t addr)
+  {
+    if (reverseDebugMode == 0)
+      throw Ep128Emu::Exception("reverse execution is not enabled");
+    if (mode < 0 || mode > 2)
+      throw Ep128Emu::Exception("invalid reverse execution mode");
+    if (reverseDebugMode != 1)
+      return;           // there is already a request pending
+    if (isRecordingDemo || isPlayingDemo || traceRecorder) {
+      throw Ep128Emu::Exception("reverse execution is not available while "
+                                "recording or playing a demo or trace");
+    }
+    if (reverseCheckpoints.empty() ||
+        (reverseCheckpoints.front().insnCnt + 1U) >= reverseInsnCnt) {
+      throw Ep128Emu::Exception("no execution history to go back to");
+    }
+    reverseRequestType = uint8_t(mode);
+    reverseWatchAddr = addr & 0x003FFFFFU;
+    reverseRequestCnt = reverseInsnCnt;
+    reverseDebugMode = 2;
+    // ignore breakpoints, and disable hooks and the profiler until the
+    // request is processed at the beginning of the next time slice
+    reverseSavedBreakPointCallback = breakPointCallback;
+    reverseSavedBreakPointUserData = breakPointCallbackUserData;
+    breakPointCallback = &reverseBreakPointCallback;
+    breakPointCallbackUserData = (void *) this;
+    reverseSavedFrameHook = frameHookCallback;
+    reverseSavedIOHook = ioHookCallback;
+    frameHookCallback = (void (*)(void *)) 0;
+    ioHookCallback = (void (*)(void *, int, uint16_t, uint8_t)) 0;
+    reverseSavedProfilerRunning = profilerRunning;
+    profilerRunning = false;
+    setSingleStepMode(0);
+    // end the current time slice after the instruction being executed
+    nickCyclesRemainingH = 0;
+  }
+
+}       // namespace Ep128
+
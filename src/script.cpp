@@ -45,8 +45,9 @@ static inline const char *lua_tolstring(lua_State *L, int idx, size_t *len)
 {
   const char  *s = lua_tostring(L, idx);
   if (len) {
+    // lua_strlen() also works with strings that contain '\0' characters
     if (s)
-      (*len) = std::strlen(s);
+      (*len) = lua_strlen(L, idx);
     else
       (*len) = 0;
   }
@@ -202,13 +203,15 @@ namespace Ep128Emu {
     LuaScript&  this_ =
         *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
                                                        lua_upvalueindex(1))));
-    if (lua_gettop(lst) != 3) {
+    int     argCnt = lua_gettop(lst);
+    if (argCnt != 3 && argCnt != 4) {
       this_.luaError("invalid number of arguments for setBreakPoint()");
       return 0;
     }
     if (!(lua_isnumber(lst, 1) &&
           lua_isnumber(lst, 2) &&
-          lua_isnumber(lst, 3))) {
+          lua_isnumber(lst, 3) &&
+          (argCnt < 4 || lua_isstring(lst, 4)))) {
       this_.luaError("invalid argument type for setBreakPoint()");
       return 0;
     }
@@ -233,9 +236,12 @@ namespace Ep128Emu {
           bpAddr = bpAddr & 0x3FFFU;
         }
       }
+      std::string bpCondition;
+      if (argCnt >= 4)
+        bpCondition = lua_tolstring(lst, 4, (size_t *) 0);
       BreakPoint  bp(ioFlag, addr22BitFlag, bool(bpType & 1), bool(bpType & 2),
                      bool(bpType & 4), bool(bpType & 16),
-                     bpSegment, uint16_t(bpAddr), bpPriority);
+                     bpSegment, uint16_t(bpAddr), bpPriority, bpCondition);
       this_.vm.setBreakPoint(bp, (bpPriority >= 0));
     }
     catch (std::exception& e) {
@@ -1286,6 +1292,328 @@ namespace Ep128Emu {
     return 0;
   }
 
+  // names of the fields in the table returned by getRegisters()
+  static const char *z80RegisterNames[25] = {
+    "PC", "A", "F", "AF", "B", "C", "BC", "D", "E", "DE", "H", "L", "HL",
+    "AF_", "BC_", "DE_", "HL_", "SP", "IX", "IY", "IM", "I", "R",
+    "IFF1", "IFF2"
+  };
+
+  int LuaScript::luaFunc_getRegisters(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 0) {
+      this_.luaError("invalid number of arguments for getRegisters()");
+      return 0;
+    }
+    const Ep128::Z80_REGISTERS& r = this_.z80Registers;
+    int     values[25];
+    values[0] = this_.vm.getProgramCounter();
+    values[1] = r.AF.B.h;
+    values[2] = r.AF.B.l;
+    values[3] = r.AF.W;
+    values[4] = r.BC.B.h;
+    values[5] = r.BC.B.l;
+    values[6] = r.BC.W;
+    values[7] = r.DE.B.h;
+    values[8] = r.DE.B.l;
+    values[9] = r.DE.W;
+    values[10] = r.HL.B.h;
+    values[11] = r.HL.B.l;
+    values[12] = r.HL.W;
+    values[13] = r.altAF.W;
+    values[14] = r.altBC.W;
+    values[15] = r.altDE.W;
+    values[16] = r.altHL.W;
+    values[17] = r.SP.W;
+    values[18] = r.IX.W;
+    values[19] = r.IY.W;
+    values[20] = r.IM;
+    values[21] = r.I;
+    values[22] = r.RBit7 | (r.R & 0x7F);
+    values[23] = int(bool(r.IFF1));
+    values[24] = int(bool(r.IFF2));
+    lua_newtable(lst);
+    for (int i = 0; i < 25; i++) {
+      lua_pushstring(lst, z80RegisterNames[i]);
+      lua_pushinteger(lst, lua_Integer(values[i]));
+      lua_settable(lst, -3);
+    }
+    return 1;
+  }
+
+  int LuaScript::luaFunc_setRegisters(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for setRegisters()");
+      return 0;
+    }
+    if (!lua_istable(lst, 1)) {
+      this_.luaError("invalid argument type for setRegisters()");
+      return 0;
+    }
+    // register pairs are set before the 8-bit registers, so that for
+    // example { HL = 0x1234, L = 0 } sets HL to 0x1200
+    static const int  fieldOrder[25] = {
+      0, 3, 6, 9, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+      1, 2, 4, 5, 7, 8, 10, 11
+    };
+    Ep128::Z80_REGISTERS& r = this_.vm.getZ80Registers();
+    for (int i = 0; i < 25; i++) {
+      int     n = fieldOrder[i];
+      lua_getfield(lst, 1, z80RegisterNames[n]);
+      if (lua_isnil(lst, -1)) {
+        lua_pop(lst, 1);
+        continue;
+      }
+      if (!lua_isnumber(lst, -1)) {
+        lua_pop(lst, 1);
+        this_.luaError("invalid register value for setRegisters()");
+        return 0;
+      }
+      uint16_t  value = uint16_t(lua_tointeger(lst, -1) & 0xFFFF);
+      lua_pop(lst, 1);
+      uint8_t   b = uint8_t(value & 0xFF);
+      switch (n) {
+      case 0:   this_.vm.setProgramCounter(value);                break;
+      case 1:   r.AF.B.h = b;                                     break;
+      case 2:   r.AF.B.l = b;                                     break;
+      case 3:   r.AF.W = value;                                   break;
+      case 4:   r.BC.B.h = b;                                     break;
+      case 5:   r.BC.B.l = b;                                     break;
+      case 6:   r.BC.W = value;                                   break;
+      case 7:   r.DE.B.h = b;                                     break;
+      case 8:   r.DE.B.l = b;                                     break;
+      case 9:   r.DE.W = value;                                   break;
+      case 10:  r.HL.B.h = b;                                     break;
+      case 11:  r.HL.B.l = b;                                     break;
+      case 12:  r.HL.W = value;                                   break;
+      case 13:  r.altAF.W = value;                                break;
+      case 14:  r.altBC.W = value;                                break;
+      case 15:  r.altDE.W = value;                                break;
+      case 16:  r.altHL.W = value;                                break;
+      case 17:  r.SP.W = value;                                   break;
+      case 18:  r.IX.W = value;                                   break;
+      case 19:  r.IY.W = value;                                   break;
+      case 20:  r.IM = Ep128::Z80_BYTE(b <= 2 ? b : 2);           break;
+      case 21:  r.I = b;                                          break;
+      case 22:  r.RBit7 = b & 0x80;
+                r.R = b & 0x7F;                                   break;
+      case 23:  r.IFF1 = Ep128::Z80_BYTE(b != 0);                 break;
+      case 24:  r.IFF2 = Ep128::Z80_BYTE(b != 0);                 break;
+      }
+    }
+    return 0;
+  }
+
+  int LuaScript::readMemoryBlock_(lua_State *lst, bool cpuAddressMode,
+                                  const char *funcName)
+  {
+    if (lua_gettop(lst) != 2) {
+      std::string msg("invalid number of arguments for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    if (!(lua_isnumber(lst, 1) && lua_isnumber(lst, 2))) {
+      std::string msg("invalid argument type for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    uint32_t  addrMask = (cpuAddressMode ? 0x0000FFFFU : 0x003FFFFFU);
+    uint32_t  addr = uint32_t(lua_tointeger(lst, 1)) & addrMask;
+    lua_Integer n = lua_tointeger(lst, 2);
+    if (n < 0 || n > lua_Integer(addrMask + 1U)) {
+      std::string msg("invalid length for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    try {
+      std::vector< char > buf(size_t(n) + 1);
+      for (size_t i = 0; i < size_t(n); i++) {
+        buf[i] = char(vm.readMemory(addr, cpuAddressMode));
+        addr = (addr + 1U) & addrMask;
+      }
+      lua_pushlstring(lst, &(buf.front()), size_t(n));
+    }
+    catch (std::exception& e) {
+      luaError(e.what());
+      return 0;
+    }
+    return 1;
+  }
+
+  int LuaScript::writeMemoryBlock_(lua_State *lst, bool cpuAddressMode,
+                                   const char *funcName)
+  {
+    if (lua_gettop(lst) != 2) {
+      std::string msg("invalid number of arguments for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    if (!(lua_isnumber(lst, 1) && lua_isstring(lst, 2))) {
+      std::string msg("invalid argument type for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    uint32_t  addrMask = (cpuAddressMode ? 0x0000FFFFU : 0x003FFFFFU);
+    uint32_t  addr = uint32_t(lua_tointeger(lst, 1)) & addrMask;
+    size_t    n = 0;
+    const char  *s = lua_tolstring(lst, 2, &n);
+    for (size_t i = 0; i < n; i++) {
+      vm.writeMemory(addr, uint8_t(s[i]), cpuAddressMode);
+      addr = (addr + 1U) & addrMask;
+    }
+    return 0;
+  }
+
+  int LuaScript::findMemory_(lua_State *lst, bool cpuAddressMode,
+                             const char *funcName)
+  {
+    int     argCnt = lua_gettop(lst);
+    if (argCnt != 3 && argCnt != 4) {
+      std::string msg("invalid number of arguments for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    if (!(lua_isstring(lst, 1) && lua_isnumber(lst, 2) &&
+          lua_isnumber(lst, 3) && (argCnt < 4 || lua_isstring(lst, 4)))) {
+      std::string msg("invalid argument type for ");
+      luaError((msg + funcName).c_str());
+      return 0;
+    }
+    size_t    patternLen = 0;
+    const uint8_t *pattern =
+        reinterpret_cast< const uint8_t * >(lua_tolstring(lst, 1,
+                                                          &patternLen));
+    const uint8_t *mask = (uint8_t *) 0;
+    if (argCnt >= 4) {
+      size_t  maskLen = 0;
+      mask = reinterpret_cast< const uint8_t * >(lua_tolstring(lst, 4,
+                                                               &maskLen));
+      if (maskLen != patternLen) {
+        std::string msg("pattern and mask length differ in ");
+        luaError((msg + funcName).c_str());
+        return 0;
+      }
+    }
+    uint32_t  addrMask = (cpuAddressMode ? 0x0000FFFFU : 0x003FFFFFU);
+    uint32_t  startAddr = uint32_t(lua_tointeger(lst, 2)) & addrMask;
+    uint32_t  endAddr = uint32_t(lua_tointeger(lst, 3)) & addrMask;
+    // the search range may wrap around the end of the address space
+    size_t    rangeLen = size_t((endAddr - startAddr) & addrMask) + 1;
+    if (patternLen < 1) {
+      lua_pushinteger(lst, lua_Integer(startAddr));
+      return 1;
+    }
+    if (rangeLen < patternLen) {
+      lua_pushnil(lst);
+      return 1;
+    }
+    try {
+      // read the whole range first, and then search it without calling
+      // the virtual machine for each byte of each possible match
+      std::vector< uint8_t >  buf(rangeLen);
+      uint32_t  addr = startAddr;
+      for (size_t i = 0; i < rangeLen; i++) {
+        buf[i] = vm.readMemory(addr, cpuAddressMode);
+        addr = (addr + 1U) & addrMask;
+      }
+      const uint8_t *p = &(buf.front());
+      size_t    lastPos = rangeLen - patternLen;
+      uint8_t   m0 = (mask ? mask[0] : 0xFF);
+      uint8_t   c0 = pattern[0] & m0;
+      for (size_t i = 0; i <= lastPos; i++) {
+        if (m0 == 0xFF) {
+          // skip to the next possible match quickly
+          const void  *q = std::memchr(p + i, c0, (lastPos + 1) - i);
+          if (!q)
+            break;
+          i = size_t(reinterpret_cast< const uint8_t * >(q) - p);
+        }
+        else if ((p[i] & m0) != c0) {
+          continue;
+        }
+        size_t  j = 1;
+        if (mask) {
+          for ( ; j < patternLen; j++) {
+            if (((p[i + j] ^ pattern[j]) & mask[j]) != 0)
+              break;
+          }
+        }
+        else {
+          for ( ; j < patternLen; j++) {
+            if (p[i + j] != pattern[j])
+              break;
+          }
+        }
+        if (j >= patternLen) {
+          lua_pushinteger(lst,
+                          lua_Integer((startAddr + uint32_t(i)) & addrMask));
+          return 1;
+        }
+      }
+    }
+    catch (std::exception& e) {
+      luaError(e.what());
+      return 0;
+    }
+    lua_pushnil(lst);
+    return 1;
+  }
+
+  int LuaScript::luaFunc_readMemoryBlock(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.readMemoryBlock_(lst, true, "readMemoryBlock()");
+  }
+
+  int LuaScript::luaFunc_writeMemoryBlock(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.writeMemoryBlock_(lst, true, "writeMemoryBlock()");
+  }
+
+  int LuaScript::luaFunc_readMemoryBlockRaw(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.readMemoryBlock_(lst, false, "readMemoryBlockRaw()");
+  }
+
+  int LuaScript::luaFunc_writeMemoryBlockRaw(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.writeMemoryBlock_(lst, false, "writeMemoryBlockRaw()");
+  }
+
+  int LuaScript::luaFunc_findMemory(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.findMemory_(lst, true, "findMemory()");
+  }
+
+  int LuaScript::luaFunc_findMemoryRaw(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    return this_.findMemory_(lst, false, "findMemoryRaw()");
+  }
+
   int LuaScript::luaFunc_getNextOpcodeAddr(lua_State *lst)
   {
     LuaScript&  this_ =
@@ -1459,6 +1787,224 @@ namespace Ep128Emu {
     return 0;
   }
 
+  int LuaScript::luaFunc_startProfiler(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    int     argCnt = lua_gettop(lst);
+    if (argCnt > 1) {
+      this_.luaError("invalid number of arguments for startProfiler()");
+      return 0;
+    }
+    if (argCnt == 1 && !lua_isboolean(lst, 1)) {
+      this_.luaError("invalid argument type for startProfiler()");
+      return 0;
+    }
+    try {
+      this_.vm.startProfiler(argCnt == 1 && bool(lua_toboolean(lst, 1)));
+    }
+    catch (std::exception& e) {
+      this_.luaError(e.what());
+      return 0;
+    }
+    return 0;
+  }
+
+  int LuaScript::luaFunc_stopProfiler(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 0) {
+      this_.luaError("invalid number of arguments for stopProfiler()");
+      return 0;
+    }
+    this_.vm.stopProfiler();
+    return 0;
+  }
+
+  int LuaScript::luaFunc_getProfilerData(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for getProfilerData()");
+      return 0;
+    }
+    if (!lua_isnumber(lst, 1)) {
+      this_.luaError("invalid argument type for getProfilerData()");
+      return 0;
+    }
+    uint64_t  insnCnt = 0U;
+    uint64_t  cycleCnt = 0U;
+    this_.vm.getProfilerData(uint32_t(lua_tointeger(lst, 1) & 0x003FFFFF),
+                             insnCnt, cycleCnt);
+    // use floating point numbers, the counts may not fit in 32 bits
+    lua_pushnumber(lst, lua_Number(double(insnCnt)));
+    lua_pushnumber(lst, lua_Number(double(cycleCnt)));
+    return 2;
+  }
+
+  int LuaScript::luaFunc_saveProfilerData(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    int     argCnt = lua_gettop(lst);
+    if (argCnt < 1 || argCnt > 2) {
+      this_.luaError("invalid number of arguments for saveProfilerData()");
+      return 0;
+    }
+    if (!(lua_isstring(lst, 1) && (argCnt < 2 || lua_isnumber(lst, 2)))) {
+      this_.luaError("invalid argument type for saveProfilerData()");
+      return 0;
+    }
+    try {
+      size_t  maxEntries = 0;
+      if (argCnt > 1 && lua_tointeger(lst, 2) > 0)
+        maxEntries = size_t(lua_tointeger(lst, 2));
+      this_.vm.saveProfilerData(lua_tolstring(lst, 1, (size_t *) 0),
+                                maxEntries);
+    }
+    catch (std::exception& e) {
+      this_.luaError(e.what());
+      return 0;
+    }
+    return 0;
+  }
+
+  int LuaScript::luaFunc_setAccessStatsEnabled(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for "
+                     "setAccessStatsEnabled()");
+      return 0;
+    }
+    try {
+      this_.vm.setAccessStatsEnabled(bool(lua_toboolean(lst, 1)));
+    }
+    catch (std::exception& e) {
+      this_.luaError(e.what());
+      return 0;
+    }
+    return 0;
+  }
+
+  int LuaScript::luaFunc_getMemoryAccessStats(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for "
+                     "getMemoryAccessStats()");
+      return 0;
+    }
+    if (!lua_isnumber(lst, 1)) {
+      this_.luaError("invalid argument type for getMemoryAccessStats()");
+      return 0;
+    }
+    uint64_t  readCnt = 0U;
+    uint64_t  writeCnt = 0U;
+    uint64_t  execCnt = 0U;
+    this_.vm.getMemoryAccessStats(
+        uint32_t(lua_tointeger(lst, 1) & 0x003FFFFF),
+        readCnt, writeCnt, execCnt);
+    lua_pushnumber(lst, lua_Number(double(readCnt)));
+    lua_pushnumber(lst, lua_Number(double(writeCnt)));
+    lua_pushnumber(lst, lua_Number(double(execCnt)));
+    return 3;
+  }
+
+  int LuaScript::luaFunc_getIOPortAccessStats(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for "
+                     "getIOPortAccessStats()");
+      return 0;
+    }
+    if (!lua_isnumber(lst, 1)) {
+      this_.luaError("invalid argument type for getIOPortAccessStats()");
+      return 0;
+    }
+    uint64_t  readCnt = 0U;
+    uint64_t  writeCnt = 0U;
+    this_.vm.getIOPortAccessStats(uint16_t(lua_tointeger(lst, 1) & 0xFFFF),
+                                  readCnt, writeCnt);
+    lua_pushnumber(lst, lua_Number(double(readCnt)));
+    lua_pushnumber(lst, lua_Number(double(writeCnt)));
+    return 2;
+  }
+
+  int LuaScript::luaFunc_saveAccessStats(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for saveAccessStats()");
+      return 0;
+    }
+    if (!lua_isstring(lst, 1)) {
+      this_.luaError("invalid argument type for saveAccessStats()");
+      return 0;
+    }
+    try {
+      this_.vm.saveAccessStats(lua_tolstring(lst, 1, (size_t *) 0));
+    }
+    catch (std::exception& e) {
+      this_.luaError(e.what());
+      return 0;
+    }
+    return 0;
+  }
+
+  int LuaScript::luaFunc_setHookTimeLimit(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for setHookTimeLimit()");
+      return 0;
+    }
+    if (!lua_isnumber(lst, 1)) {
+      this_.luaError("invalid argument type for setHookTimeLimit()");
+      return 0;
+    }
+    double  t = double(lua_tonumber(lst, 1)) * 0.001;
+    this_.hookTimeLimit = (t > 0.0 ? t : 0.0);
+    return 0;
+  }
+
+  int LuaScript::luaFunc_getHookStats(lua_State *lst)
+  {
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst,
+                                                       lua_upvalueindex(1))));
+    if (lua_gettop(lst) != 1) {
+      this_.luaError("invalid number of arguments for getHookStats()");
+      return 0;
+    }
+    if (!lua_isnumber(lst, 1)) {
+      this_.luaError("invalid argument type for getHookStats()");
+      return 0;
+    }
+    const HookStats&  s = this_.getHookStats(int(lua_tointeger(lst, 1)));
+    lua_pushnumber(lst, lua_Number(double(s.callCnt)));
+    lua_pushnumber(lst, lua_Number(s.totalTime * 1000.0));
+    lua_pushnumber(lst, lua_Number(s.maxTime * 1000.0));
+    return 3;
+  }
+
   int LuaScript::luaFunc_mprint(lua_State *lst)
   {
     LuaScript&  this_ =
@@ -1492,15 +2038,29 @@ namespace Ep128Emu {
       luaState((lua_State *) 0),
       z80Registers(((const VirtualMachine *) &vm_)->getZ80Registers()),
       errorMessage((char *) 0),
-      haveBreakPointCallback(false)
+      haveBreakPointCallback(false),
+      hookTimeLimit(0.0),
+      hookTimeLimitExceeded(false)
   {
+    for (int i = 0; i < 2; i++) {
+      hookStats[i].callCnt = 0U;
+      hookStats[i].totalTime = 0.0;
+      hookStats[i].maxTime = 0.0;
+      hookStats[i].isDefined = false;
+      hookStats[i].isDisabled = false;
+      hookFunctionRefs[i] = 0;
+    }
   }
 
   LuaScript::~LuaScript()
   {
 #ifdef HAVE_LUA_H
-    if (luaState)
+    if (luaState) {
+      vm.setHookCallbacks((void (*)(void *)) 0,
+                          (void (*)(void *, int, uint16_t, uint8_t)) 0,
+                          (void *) 0);
       lua_close(luaState);
+    }
 #endif  // HAVE_LUA_H
   }
 
@@ -1513,6 +2073,25 @@ namespace Ep128Emu {
     lua_setglobal(luaState, name);
   }
 
+  void LuaScript::scriptError_(int err)
+  {
+    messageCallback(lua_tolstring(luaState, -1, (size_t *) 0));
+    closeScript();
+    if (errorMessage) {
+      const char  *msg = errorMessage;
+      errorMessage = (char *) 0;
+      errorCallback(msg);
+    }
+    else if (err == LUA_ERRRUN)
+      errorCallback("runtime error while running Lua script");
+    else if (err == LUA_ERRMEM)
+      errorCallback("memory allocation failure while running Lua script");
+    else if (err == LUA_ERRERR)
+      errorCallback("error while running Lua error handler");
+    else
+      errorCallback("error running Lua script");
+  }
+
   bool LuaScript::runBreakPointCallback_(int type, uint16_t addr, uint8_t value)
   {
     lua_pushvalue(luaState, -1);
@@ -1521,21 +2100,7 @@ namespace Ep128Emu {
     lua_pushinteger(luaState, lua_Integer(value));
     int     err = lua_pcall(luaState, 3, 1, 0);
     if (err != 0) {
-      messageCallback(lua_tolstring(luaState, -1, (size_t *) 0));
-      closeScript();
-      if (errorMessage) {
-        const char  *msg = errorMessage;
-        errorMessage = (char *) 0;
-        errorCallback(msg);
-      }
-      else if (err == LUA_ERRRUN)
-        errorCallback("runtime error while running Lua script");
-      else if (err == LUA_ERRMEM)
-        errorCallback("memory allocation failure while running Lua script");
-      else if (err == LUA_ERRERR)
-        errorCallback("error while running Lua error handler");
-      else
-        errorCallback("error running Lua script");
+      scriptError_(err);
       return true;
     }
     if (!lua_isboolean(luaState, -1)) {
@@ -1548,6 +2113,105 @@ namespace Ep128Emu {
     return retval;
   }
 
+  void LuaScript::luaHookFunc(lua_State *lst, lua_Debug *ar)
+  {
+    (void) ar;
+    lua_getfield(lst, LUA_REGISTRYINDEX, "ep128emu_LuaScript");
+    LuaScript&  this_ =
+        *(reinterpret_cast<LuaScript *>(lua_touserdata(lst, -1)));
+    lua_pop(lst, 1);
+    if (this_.hookTimer.getRealTime() > this_.hookTimeLimit) {
+      this_.hookTimeLimitExceeded = true;
+      (void) luaL_error(lst, "time limit exceeded in Lua hook function");
+    }
+  }
+
+  void LuaScript::frameHookCallback(void *userData)
+  {
+    reinterpret_cast<LuaScript *>(userData)->runHook_(0, 0, 0, 0);
+  }
+
+  void LuaScript::ioHookCallback(void *userData, int type,
+                                 uint16_t addr, uint8_t value)
+  {
+    reinterpret_cast<LuaScript *>(userData)->runHook_(1, type, addr, value);
+  }
+
+  void LuaScript::runHook_(int n, int type, uint16_t addr, uint8_t value)
+  {
+    lua_rawgeti(luaState, LUA_REGISTRYINDEX, hookFunctionRefs[n]);
+    int     nArgs = 0;
+    if (n) {
+      lua_pushinteger(luaState, lua_Integer(type));
+      lua_pushinteger(luaState, lua_Integer(addr));
+      lua_pushinteger(luaState, lua_Integer(value));
+      nArgs = 3;
+    }
+    bool    timeLimitEnabled = (hookTimeLimit > 0.0);
+    hookTimeLimitExceeded = false;
+    if (timeLimitEnabled) {
+      // check the elapsed time every 1000 Lua instructions
+      lua_sethook(luaState, &luaHookFunc, LUA_MASKCOUNT, 1000);
+    }
+    hookTimer.reset();
+    int     err = lua_pcall(luaState, nArgs, 0, 0);
+    double  t = hookTimer.getRealTime();
+    if (timeLimitEnabled)
+      lua_sethook(luaState, (lua_Hook) 0, 0, 0);
+    HookStats&  s = hookStats[n];
+    s.callCnt++;
+    s.totalTime += t;
+    if (t > s.maxTime)
+      s.maxTime = t;
+    if (err != 0) {
+      if (!hookTimeLimitExceeded) {
+        scriptError_(err);
+        return;
+      }
+      lua_pop(luaState, 1);
+      errorMessage = (char *) 0;
+    }
+    else if (!(timeLimitEnabled && t > hookTimeLimit)) {
+      return;
+    }
+    disableHook_(n);
+  }
+
+  void LuaScript::disableHook_(int n)
+  {
+    if (hookStats[n].isDefined && !hookStats[n].isDisabled) {
+      hookStats[n].isDisabled = true;
+      luaL_unref(luaState, LUA_REGISTRYINDEX, hookFunctionRefs[n]);
+      hookFunctionRefs[n] = LUA_NOREF;
+      updateHookCallbacks_();
+      if (n == 0)
+        messageCallback("Lua frame hook disabled: time limit exceeded");
+      else
+        messageCallback("Lua I/O port hook disabled: time limit exceeded");
+    }
+  }
+
+  void LuaScript::updateHookCallbacks_()
+  {
+    bool    frameHookEnabled =
+        (hookStats[0].isDefined && !hookStats[0].isDisabled);
+    bool    ioHookEnabled =
+        (hookStats[1].isDefined && !hookStats[1].isDisabled);
+    if (frameHookEnabled || ioHookEnabled) {
+      vm.setHookCallbacks(frameHookEnabled ?
+                          &frameHookCallback : (void (*)(void *)) 0,
+                          ioHookEnabled ?
+                          &ioHookCallback
+                          : (void (*)(void *, int, uint16_t, uint8_t)) 0,
+                          (void *) this);
+    }
+    else {
+      vm.setHookCallbacks((void (*)(void *)) 0,
+                          (void (*)(void *, int, uint16_t, uint8_t)) 0,
+                          (void *) 0);
+    }
+  }
+
   void LuaScript::luaError(const char *msg)
   {
     if (!msg)
@@ -1561,6 +2225,14 @@ namespace Ep128Emu {
   void LuaScript::loadScript(const char *s)
   {
     closeScript();
+    for (int i = 0; i < 2; i++) {
+      hookStats[i].callCnt = 0U;
+      hookStats[i].totalTime = 0.0;
+      hookStats[i].maxTime = 0.0;
+      hookStats[i].isDefined = false;
+      hookStats[i].isDisabled = false;
+    }
+    hookTimeLimit = 0.0;
     if (s == (char *) 0 || s[0] == '\0')
       return;
 #ifdef HAVE_LUA_H
@@ -1656,32 +2328,52 @@ namespace Ep128Emu {
     registerLuaFunction(&luaFunc_setR, "setR");
     registerLuaFunction(&luaFunc_setIFF1, "setIFF1");
     registerLuaFunction(&luaFunc_setIFF2, "setIFF2");
+    registerLuaFunction(&luaFunc_getRegisters, "getRegisters");
+    registerLuaFunction(&luaFunc_setRegisters, "setRegisters");
+    registerLuaFunction(&luaFunc_readMemoryBlock, "readMemoryBlock");
+    registerLuaFunction(&luaFunc_writeMemoryBlock, "writeMemoryBlock");
+    registerLuaFunction(&luaFunc_readMemoryBlockRaw, "readMemoryBlockRaw");
+    registerLuaFunction(&luaFunc_writeMemoryBlockRaw, "writeMemoryBlockRaw");
+    registerLuaFunction(&luaFunc_findMemory, "findMemory");
+    registerLuaFunction(&luaFunc_findMemoryRaw, "findMemoryRaw");
     registerLuaFunction(&luaFunc_getNextOpcodeAddr, "getNextOpcodeAddr");
     registerLuaFunction(&luaFunc_getVideoPosition, "getVideoPosition");
     registerLuaFunction(&luaFunc_getRawAddress, "getRawAddress");
     registerLuaFunction(&luaFunc_loadMemory, "loadMemory");
     registerLuaFunction(&luaFunc_saveMemory, "saveMemory");
     registerLuaFunction(&luaFunc_loadROMSegment, "loadROMSegment");
+    registerLuaFunction(&luaFunc_startProfiler, "startProfiler");
+    registerLuaFunction(&luaFunc_stopProfiler, "stopProfiler");
+    registerLuaFunction(&luaFunc_getProfilerData, "getProfilerData");
+    registerLuaFunction(&luaFunc_saveProfilerData, "saveProfilerData");
+    registerLuaFunction(&luaFunc_setAccessStatsEnabled,
+                        "setAccessStatsEnabled");
+    registerLuaFunction(&luaFunc_getMemoryAccessStats,
+                        "getMemoryAccessStats");
+    registerLuaFunction(&luaFunc_getIOPortAccessStats,
+                        "getIOPortAccessStats");
+    registerLuaFunction(&luaFunc_saveAccessStats, "saveAccessStats");
+    registerLuaFunction(&luaFunc_setHookTimeLimit, "setHookTimeLimit");
+    registerLuaFunction(&luaFunc_getHookStats, "getHookStats");
     registerLuaFunction(&luaFunc_mprint, "mprint");
+    lua_pushlightuserdata(luaState, (void *) this);
+    lua_setfield(luaState, LUA_REGISTRYINDEX, "ep128emu_LuaScript");
     err = lua_pcall(luaState, 0, 0, 0);
     if (err != 0) {
-      messageCallback(lua_tolstring(luaState, -1, (size_t *) 0));
-      closeScript();
-      if (errorMessage) {
-        const char  *msg = errorMessage;
-        errorMessage = (char *) 0;
-        errorCallback(msg);
-      }
-      else if (err == LUA_ERRRUN)
-        errorCallback("runtime error while running Lua script");
-      else if (err == LUA_ERRMEM)
-        errorCallback("memory allocation failure while running Lua script");
-      else if (err == LUA_ERRERR)
-        errorCallback("error while running Lua error handler");
-      else
-        errorCallback("error running Lua script");
+      scriptError_(err);
       return;
     }
+    for (int i = 0; i < 2; i++) {
+      lua_getglobal(luaState, (i == 0 ? "frameCallback" : "ioPortCallback"));
+      if (!lua_isfunction(luaState, -1)) {
+        lua_pop(luaState, 1);
+      }
+      else {
+        hookFunctionRefs[i] = luaL_ref(luaState, LUA_REGISTRYINDEX);
+        hookStats[i].isDefined = true;
+      }
+    }
+    updateHookCallbacks_();
     lua_getglobal(luaState, "breakPointCallback");
     if (!lua_isfunction(luaState, -1))
       lua_pop(luaState, 1);
@@ -1697,6 +2389,9 @@ namespace Ep128Emu {
     haveBreakPointCallback = false;
 #ifdef HAVE_LUA_H
     if (luaState) {
+      vm.setHookCallbacks((void (*)(void *)) 0,
+                          (void (*)(void *, int, uint16_t, uint8_t)) 0,
+                          (void *) 0);
       lua_close(luaState);
       luaState = (lua_State *) 0;
     }
@@ -23,6 +23,7 @@
 #include "ep128emu.hpp"
 #include "vm.hpp"
 #include "ep128vm.hpp"
+#include "system.hpp"
 
 #ifdef HAVE_LUA_H
 extern "C" {
@@ -37,12 +38,28 @@ struct  lua_State;      // dummy declaration
 namespace Ep128Emu {
 
   class LuaScript {
+   public:
+    struct HookStats {
+      uint64_t  callCnt;
+      double    totalTime;              // in seconds
+      double    maxTime;                // longest single call in seconds
+      bool      isDefined;              // the script has the hook function
+      bool      isDisabled;             // disabled after exceeding time limit
+    };
    protected:
     VirtualMachine& vm;
     lua_State   *luaState;
     const Ep128::Z80_REGISTERS& z80Registers;
     const char  *errorMessage;
     bool        haveBreakPointCallback;
+    // statistics and Lua registry references for the frame (0) and
+    // I/O port (1) hooks
+    HookStats   hookStats[2];
+    int         hookFunctionRefs[2];
+    // time limit for a single call of a hook in seconds, 0.0: no limit
+    double      hookTimeLimit;
+    bool        hookTimeLimitExceeded;
+    Timer       hookTimer;
     // --------
 #ifdef HAVE_LUA_H
     static int luaFunc_AND(lua_State *lst);
@@ -115,15 +132,47 @@ namespace Ep128Emu {
     static int luaFunc_setR(lua_State *lst);
     static int luaFunc_setIFF1(lua_State *lst);
     static int luaFunc_setIFF2(lua_State *lst);
+    static int luaFunc_getRegisters(lua_State *lst);
+    static int luaFunc_setRegisters(lua_State *lst);
+    static int luaFunc_readMemoryBlock(lua_State *lst);
+    static int luaFunc_writeMemoryBlock(lua_State *lst);
+    static int luaFunc_readMemoryBlockRaw(lua_State *lst);
+    static int luaFunc_writeMemoryBlockRaw(lua_State *lst);
+    static int luaFunc_findMemory(lua_State *lst);
+    static int luaFunc_findMemoryRaw(lua_State *lst);
     static int luaFunc_getNextOpcodeAddr(lua_State *lst);
     static int luaFunc_getVideoPosition(lua_State *lst);
     static int luaFunc_getRawAddress(lua_State *lst);
     static int luaFunc_loadMemory(lua_State *lst);
     static int luaFunc_saveMemory(lua_State *lst);
     static int luaFunc_loadROMSegment(lua_State *lst);
+    static int luaFunc_startProfiler(lua_State *lst);
+    static int luaFunc_stopProfiler(lua_State *lst);
+    static int luaFunc_getProfilerData(lua_State *lst);
+    static int luaFunc_saveProfilerData(lua_State *lst);
+    static int luaFunc_setAccessStatsEnabled(lua_State *lst);
+    static int luaFunc_getMemoryAccessStats(lua_State *lst);
+    static int luaFunc_getIOPortAccessStats(lua_State *lst);
+    static int luaFunc_saveAccessStats(lua_State *lst);
+    static int luaFunc_setHookTimeLimit(lua_State *lst);
+    static int luaFunc_getHookStats(lua_State *lst);
     static int luaFunc_mprint(lua_State *lst);
+    static void luaHookFunc(lua_State *lst, lua_Debug *ar);
+    static void frameHookCallback(void *userData);
+    static void ioHookCallback(void *userData, int type,
+                               uint16_t addr, uint8_t value);
     void registerLuaFunction(lua_CFunction f, const char *name);
+    void scriptError_(int err);
     bool runBreakPointCallback_(int type, uint16_t addr, uint8_t value);
+    void runHook_(int n, int type, uint16_t addr, uint8_t value);
+    void disableHook_(int n);
+    void updateHookCallbacks_();
+    int readMemoryBlock_(lua_State *lst, bool cpuAddressMode,
+                         const char *funcName);
+    int writeMemoryBlock_(lua_State *lst, bool cpuAddressMode,
+                          const char *funcName);
+    int findMemory_(lua_State *lst, bool cpuAddressMode,
+                    const char *funcName);
     void luaError(const char *msg);
 #endif  // HAVE_LUA_H
    public:
@@ -143,6 +192,14 @@ namespace Ep128Emu {
 #endif  // HAVE_LUA_H
       return true;
     }
+    /*!
+     * Returns the number of calls and execution time of the frame (n = 0)
+     * or I/O port (n = 1) hook function of the current script.
+     */
+    inline const HookStats& getHookStats(int n) const
+    {
+      return hookStats[n & 1];
+    }
     virtual void errorCallback(const char *msg);
     virtual void messageCallback(const char *msg);
   };
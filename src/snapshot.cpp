@@ -181,17 +181,20 @@ namespace Ep128 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible ep128 snapshot version");
     }
-    remoteControlState = 0x00;
-    setTapeMotorState(false);
-    stopDemo();
-    snapshotLoadFlag = true;
-    // reset floppy and IDE emulation, as the state of these is not saved
-    resetFloppyDrives(true);
-    ideInterface->reset(3);
-    z80.closeAllFiles();
+    if (!reverseRestoreFlag) {
+      remoteControlState = 0x00;
+      setTapeMotorState(false);
+      stopDemo();
+      snapshotLoadFlag = true;
+      // reset floppy and IDE emulation, as the state of these is not saved
+      resetFloppyDrives(true);
+      ideInterface->reset(3);
+      z80.closeAllFiles();
 #ifdef ENABLE_MIDI_PORT
-    midiPortWriteCallback((void *) this, 0xF6, 0x00);
+      midiPortWriteCallback((void *) this, 0xF6, 0x00);
 #endif
+      clearReverseHistory();
+    }
     try {
 #ifdef ENABLE_SDEXT
       if (!(version & 0x00010000)) {
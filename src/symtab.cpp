@@ -0,0 +1,369 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "symtab.hpp"
+
+#include <vector>
+#include <algorithm>
+
+static inline bool isNameStartChar(char c)
+{
+  return ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+          c == '_' || c == '.' || c == '@' || c == '?');
+}
+
+static inline bool isNameChar(char c)
+{
+  return (isNameStartChar(c) || (c >= '0' && c <= '9') ||
+          c == '$' || c == '!');
+}
+
+static bool isValidName(const std::string& s)
+{
+  if (s.length() < 1 || !isNameStartChar(s[0]))
+    return false;
+  for (size_t i = 1; i < s.length(); i++) {
+    if (!isNameChar(s[i]))
+      return false;
+  }
+  return true;
+}
+
+// case insensitive comparison of symbol names
+static int compareNames(const char *a, const char *b)
+{
+  while (true) {
+    char    c1 = *(a++);
+    char    c2 = *(b++);
+    if (c1 >= 'a' && c1 <= 'z')
+      c1 = c1 - ('a' - 'A');
+    if (c2 >= 'a' && c2 <= 'z')
+      c2 = c2 - ('a' - 'A');
+    if (c1 != c2)
+      return (c1 < c2 ? -1 : 1);
+    if (c1 == '\0')
+      return 0;
+  }
+}
+
+static bool parseNumber(uint32_t& n, const char *s, size_t len, bool isHex)
+{
+  n = 0U;
+  if (len < 1 || len > 8)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    char    c = s[i];
+    if (c >= '0' && c <= '9')
+      n = n * (isHex ? 16U : 10U) + uint32_t(c - '0');
+    else if (isHex && c >= 'A' && c <= 'F')
+      n = (n << 4) + uint32_t(c - 'A') + 10U;
+    else if (isHex && c >= 'a' && c <= 'f')
+      n = (n << 4) + uint32_t(c - 'a') + 10U;
+    else
+      return false;
+  }
+  return true;
+}
+
+// parse symbol value 's'; 'isPhysical' is set to true if the value was
+// specified in segment:offset format
+
+static bool parseValue(uint32_t& n, bool& isPhysical, const std::string& s)
+{
+  n = 0U;
+  isPhysical = false;
+  size_t  len = s.length();
+  if (len < 1)
+    return false;
+  const char  *p = s.c_str();
+  size_t  sepPos = s.find(':');
+  bool    retval = false;
+  if (sepPos != std::string::npos) {
+    uint32_t  offs = 0U;
+    if (!(sepPos == 2 && parseNumber(n, p, 2, true) &&
+          parseNumber(offs, p + 3, len - 3, true) && offs <= 0xFFFFU)) {
+      return false;
+    }
+    n = (n << 14) | (offs & 0x3FFFU);
+    isPhysical = true;
+    return true;
+  }
+  else if (len > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    retval = parseNumber(n, p + 2, len - 2, true);
+  else if (p[0] == '$' || p[0] == '#' || p[0] == '&')
+    retval = parseNumber(n, p + 1, len - 1, true);
+  else if (p[len - 1] == 'h' || p[len - 1] == 'H')
+    retval = (p[0] >= '0' && p[0] <= '9' && parseNumber(n, p, len - 1, true));
+  else
+    retval = parseNumber(n, p, len, false);
+  return (retval && n <= 0x003FFFFFU);
+}
+
+namespace Ep128Emu {
+
+  bool SymbolTable::EntryNameCompare_::operator()(const Entry& a,
+                                                  const Entry& b) const
+  {
+    int     n = compareNames(&(names[a.nameOffs]), &(names[b.nameOffs]));
+    return (n < 0 || (n == 0 && a.nameOffs < b.nameOffs));
+  }
+
+  SymbolTable::SymbolTable()
+  {
+  }
+
+  SymbolTable::~SymbolTable()
+  {
+  }
+
+  void SymbolTable::clear()
+  {
+    addrIndex.clear();
+    nameIndex.clear();
+    nameBuf.clear();
+  }
+
+  void SymbolTable::addSymbol_(const char *name, uint32_t key)
+  {
+    Entry   e;
+    e.key = key;
+    e.nameOffs = uint32_t(nameBuf.size());
+    do {
+      nameBuf.push_back(*name);
+    } while (*(name++) != '\0');
+    // new entries are only added to addrIndex, and updateIndex() needs to
+    // be called before the table can be searched
+    addrIndex.push_back(e);
+  }
+
+  void SymbolTable::updateIndex()
+  {
+    if (addrIndex.size() < 1) {
+      clear();
+      return;
+    }
+    // sort by name, and remove duplicates; since names are stored in the
+    // order of definition, the entry with the highest offset is the most
+    // recent one
+    nameIndex = addrIndex;
+    std::sort(nameIndex.begin(), nameIndex.end(),
+              EntryNameCompare_(&(nameBuf.front())));
+    size_t  n = 0;
+    for (size_t i = 0; i < nameIndex.size(); i++) {
+      if ((i + 1) < nameIndex.size()) {
+        if (compareNames(&(nameBuf[nameIndex[i].nameOffs]),
+                         &(nameBuf[nameIndex[i + 1].nameOffs])) == 0) {
+          continue;
+        }
+      }
+      nameIndex[n++] = nameIndex[i];
+    }
+    nameIndex.resize(n);
+    // pack the names of the remaining entries, keeping their original order
+    std::vector< std::pair< uint32_t, size_t > >  tmp(n);
+    for (size_t i = 0; i < n; i++)
+      tmp[i] = std::pair< uint32_t, size_t >(nameIndex[i].nameOffs, i);
+    std::sort(tmp.begin(), tmp.end());
+    std::vector< char > newNameBuf;
+    newNameBuf.reserve(nameBuf.size());
+    for (size_t i = 0; i < n; i++) {
+      nameIndex[tmp[i].second].nameOffs = uint32_t(newNameBuf.size());
+      const char  *s = &(nameBuf[tmp[i].first]);
+      do {
+        newNameBuf.push_back(*s);
+      } while (*(s++) != '\0');
+    }
+    nameBuf.swap(newNameBuf);
+    // finally, create the address index from the updated entries
+    addrIndex = nameIndex;
+    std::sort(addrIndex.begin(), addrIndex.end(), EntryKeyCompare_());
+  }
+
+  void SymbolTable::addSymbol(const std::string& name, uint32_t addr,
+                              bool isCPUAddress, bool updateIndexFlag)
+  {
+    if (!isValidName(name))
+      throw Exception("invalid symbol name");
+    addSymbol_(name.c_str(), (isCPUAddress ?
+                              ((addr & 0xFFFFU) | cpuAddressFlag)
+                              : (addr & 0x003FFFFFU)));
+    if (updateIndexFlag)
+      updateIndex();
+  }
+
+  size_t SymbolTable::loadFile(std::FILE *f, int segment)
+  {
+    if (!f)
+      throw Exception("error opening symbol file");
+    size_t  nSymbols = 0;
+    std::string lineBuf;
+    std::vector< std::string >  args;
+    try {
+      bool    eofFlag = false;
+      do {
+        int     c = std::fgetc(f);
+        if (c != EOF && c != '\n' && c != '\r') {
+          lineBuf += char(c);
+          continue;
+        }
+        eofFlag = (c == EOF);
+        // split line to tokens, ignoring comments
+        args.clear();
+        std::string curToken;
+        for (size_t i = 0; i <= lineBuf.length(); i++) {
+          char    ch = (i < lineBuf.length() ? lineBuf[i] : ';');
+          if (ch == ' ' || ch == '\t' || ch == '=' || ch == ';') {
+            if (curToken.length() > 0) {
+              args.push_back(curToken);
+              curToken.clear();
+            }
+            if (ch == ';')
+              break;
+            if (ch == '=')
+              args.push_back("EQU");
+            continue;
+          }
+          curToken += ch;
+        }
+        lineBuf.clear();
+        if (args.size() < 2)
+          continue;
+        // remove colon after label name
+        if (args[0].length() > 1 && args[0][args[0].length() - 1] == ':')
+          args[0].resize(args[0].length() - 1);
+        const std::string *name = (std::string *) 0;
+        uint32_t  n = 0U;
+        bool      isPhysical = false;
+        if (args.size() >= 3) {
+          std::string tmp(args[1]);
+          for (size_t i = 0; i < tmp.length(); i++) {
+            if (tmp[i] >= 'a' && tmp[i] <= 'z')
+              tmp[i] = tmp[i] - ('a' - 'A');
+          }
+          if ((tmp == "EQU" || tmp == "DEFL") &&
+              parseValue(n, isPhysical, args[2])) {
+            name = &(args[0]);
+          }
+        }
+        else if (parseValue(n, isPhysical, args[0])) {
+          name = &(args[1]);
+        }
+        else if (parseValue(n, isPhysical, args[1])) {
+          name = &(args[0]);
+        }
+        if (!name || !isValidName(*name))
+          continue;
+        uint32_t  key = n;
+        if (!isPhysical && n <= 0xFFFFU) {
+          if (segment >= 0)
+            key = (uint32_t(segment & 0xFF) << 14) | (n & 0x3FFFU);
+          else
+            key = n | cpuAddressFlag;
+        }
+        addSymbol_(name->c_str(), key);
+        nSymbols++;
+      } while (!eofFlag);
+    }
+    catch (...) {
+      updateIndex();
+      throw;
+    }
+    // sort only once after loading all symbols
+    updateIndex();
+    return nSymbols;
+  }
+
+  const char * SymbolTable::findSymbol(uint32_t& offs,
+                                       uint32_t addr, bool isCPUAddress,
+                                       uint32_t maxOffs) const
+  {
+    offs = 0U;
+    if (addrIndex.size() < 1)
+      return (char *) 0;
+    Entry   e;
+    e.key = (isCPUAddress ?
+             ((addr & 0xFFFFU) | cpuAddressFlag) : (addr & 0x003FFFFFU));
+    e.nameOffs = 0xFFFFFFFFU;
+    // find the last entry at or below the address
+    std::vector< Entry >::const_iterator  i =
+        std::upper_bound(addrIndex.begin(), addrIndex.end(), e,
+                         EntryKeyCompare_());
+    if (i == addrIndex.begin())
+      return (char *) 0;
+    --i;
+    if (((i->key ^ e.key) & cpuAddressFlag) != 0U ||
+        (e.key - i->key) > maxOffs) {
+      return (char *) 0;
+    }
+    offs = e.key - i->key;
+    // if there are multiple symbols at the same address, return the first
+    e.key = i->key;
+    e.nameOffs = 0U;
+    i = std::lower_bound(addrIndex.begin(), i, e, EntryKeyCompare_());
+    return &(nameBuf[i->nameOffs]);
+  }
+
+  const char * SymbolTable::findMemorySymbol(uint32_t& offs,
+                                             uint32_t physAddr,
+                                             uint32_t cpuAddr,
+                                             uint32_t maxOffs) const
+  {
+    const char  *s = (char *) 0;
+    if (physAddr <= 0x003FFFFFU)
+      s = findSymbol(offs, physAddr, false, maxOffs);
+    if ((!s || offs > 0U) && cpuAddr <= 0xFFFFU) {
+      // use the CPU address symbol if it is nearer
+      uint32_t  tmp = 0U;
+      const char  *s2 = findSymbol(tmp, cpuAddr, true, maxOffs);
+      if (s2 && (!s || tmp < offs)) {
+        s = s2;
+        offs = tmp;
+      }
+    }
+    return s;
+  }
+
+  bool SymbolTable::findAddress(uint32_t& addr, bool& isCPUAddress,
+                                const std::string& name) const
+  {
+    addr = 0U;
+    isCPUAddress = false;
+    size_t  i = 0;
+    size_t  j = nameIndex.size();
+    while (i < j) {
+      size_t  k = (i + j) >> 1;
+      int     n = compareNames(&(nameBuf[nameIndex[k].nameOffs]),
+                               name.c_str());
+      if (n == 0) {
+        uint32_t  key = nameIndex[k].key;
+        isCPUAddress = bool(key & cpuAddressFlag);
+        addr = key & (isCPUAddress ? 0x0000FFFFU : 0x003FFFFFU);
+        return true;
+      }
+      if (n < 0)
+        i = k + 1;
+      else
+        j = k;
+    }
+    return false;
+  }
+
+}       // namespace Ep128Emu
+
@@ -0,0 +1,142 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_SYMTAB_HPP
+#define EP128EMU_SYMTAB_HPP
+
+#include "ep128emu.hpp"
+
+#include <vector>
+
+namespace Ep128Emu {
+
+  class SymbolTable {
+   private:
+    struct Entry {
+      // 22-bit physical address (segment * 0x4000 + offset), or 16-bit
+      // CPU address + 0x80000000
+      uint32_t  key;
+      uint32_t  nameOffs;               // position of the name in nameBuf
+    };
+    struct EntryKeyCompare_ {
+      inline bool operator()(const Entry& a, const Entry& b) const
+      {
+        return (a.key < b.key || (a.key == b.key && a.nameOffs < b.nameOffs));
+      }
+    };
+    struct EntryNameCompare_ {
+      const char  *names;
+      EntryNameCompare_(const char *names_)
+        : names(names_)
+      {
+      }
+      bool operator()(const Entry& a, const Entry& b) const;
+    };
+    static const uint32_t cpuAddressFlag = 0x80000000U;
+    // all entries, sorted by key (and then by the order of definition)
+    std::vector< Entry >  addrIndex;
+    // the same entries sorted by name
+    std::vector< Entry >  nameIndex;
+    // zero terminated symbol names
+    std::vector< char >   nameBuf;
+    // --------
+    void addSymbol_(const char *name, uint32_t key);
+   public:
+    SymbolTable();
+    virtual ~SymbolTable();
+    /*!
+     * Delete all symbols.
+     */
+    void clear();
+    inline size_t size() const
+    {
+      return addrIndex.size();
+    }
+    inline bool empty() const
+    {
+      return addrIndex.empty();
+    }
+    /*!
+     * Define symbol 'name' at 'addr', which is a 16-bit CPU address if
+     * 'isCPUAddress' is true, or a 22-bit physical address otherwise.
+     * An already existing symbol with the same name is replaced.
+     * If 'name' is not a valid symbol name, Ep128Emu::Exception is thrown.
+     * When adding a large number of symbols, 'updateIndexFlag' can be set
+     * to false, and updateIndex() called once after the last symbol.
+     */
+    void addSymbol(const std::string& name, uint32_t addr,
+                   bool isCPUAddress = true, bool updateIndexFlag = true);
+    /*!
+     * Sort the symbols added with addSymbol(), removing duplicate names.
+     * Must be called before searching the table if symbols were added with
+     * 'updateIndexFlag' set to false.
+     */
+    void updateIndex();
+    /*!
+     * Load symbol definitions from a text file, in any of the following
+     * formats (one symbol per line, anything after a ';' is ignored):
+     *   name EQU value     (pasmo, sjasm, or sjasmplus symbol/export file,
+     *   name: EQU value    the name may be followed by a colon)
+     *   name = value
+     *   value name
+     *   ss:oooo name       22-bit physical address as hexadecimal
+     *                      segment:offset
+     * 'value' can be decimal, or hexadecimal in any of the 0ABCDh, 0xABCD,
+     * $ABCD, #ABCD, or &ABCD formats. Values in the range 0 to 0xFFFF are
+     * CPU addresses, unless 'segment' is not negative, in which case they
+     * are offsets into that segment (for code assembled for a single 16K
+     * page), and values 0x10000 to 0x3FFFFF are 22-bit physical addresses.
+     * Lines that are not recognized are ignored. Symbols already defined
+     * with the same name are replaced.
+     * Returns the number of symbols loaded. On error, Ep128Emu::Exception
+     * is thrown.
+     */
+    size_t loadFile(std::FILE *f, int segment = -1);
+    /*!
+     * Find the symbol defined at 'addr' (16-bit CPU address if
+     * 'isCPUAddress' is true, 22-bit physical address otherwise), or the
+     * nearest one below it that is at most 'maxOffs' bytes away, in
+     * O(log n) time.
+     * Returns the name of the symbol, and stores the distance in 'offs',
+     * or returns NULL if there is no such symbol.
+     */
+    const char *findSymbol(uint32_t& offs, uint32_t addr, bool isCPUAddress,
+                           uint32_t maxOffs = 0U) const;
+    /*!
+     * Same as findSymbol(), but tries the 22-bit address 'physAddr' first,
+     * and then the 16-bit CPU address 'cpuAddr' at which it is mapped.
+     * Either address can be 0xFFFFFFFF if it is not known.
+     */
+    const char *findMemorySymbol(uint32_t& offs,
+                                 uint32_t physAddr, uint32_t cpuAddr,
+                                 uint32_t maxOffs = 0U) const;
+    /*!
+     * Find the symbol called 'name', and store its address in 'addr'.
+     * 'isCPUAddress' is set to true if 'addr' is a 16-bit CPU address,
+     * and to false if it is a 22-bit physical address.
+     * Returns false if the symbol is not defined.
+     */
+    bool findAddress(uint32_t& addr, bool& isCPUAddress,
+                     const std::string& name) const;
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_SYMTAB_HPP
+
@@ -526,6 +526,19 @@ namespace Ep128Emu {
 #endif
   }
 
+  int getProcessorCount()
+  {
+    int     n = 1;
+#if defined(WIN32)
+    SYSTEM_INFO   sysInfo;
+    GetSystemInfo(&sysInfo);
+    n = int(sysInfo.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = int(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+    return (n > 1 ? (n < 256 ? n : 256) : 1);
+  }
+
   void addFileNameExtension(std::string& fileName, const char *s)
   {
     if (s == (char *) 0 || s[0] == '\0')
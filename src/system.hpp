@@ -204,6 +204,12 @@ namespace Ep128Emu {
    */
   void setProcessPriority(int n);
 
+  /*!
+   * Returns the number of processors (cores) available, or 1 if it cannot
+   * be determined.
+   */
+  int getProcessorCount();
+
   /*!
    * If 'fileName' does not already have an extension (starting with a dot
    * character), append a dot character and 's' to the file name.
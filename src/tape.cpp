@@ -23,10 +23,84 @@
 
 #include <cmath>
 #include <sndfile.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#  define WIN32_LEAN_AND_MEAN   1
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <sys/mman.h>
+#endif
 
 static const char *epteFileMagic = "ENTERPRISE 128K TAPE FILE       ";
 static const char *tzxFileMagic = "ZXTape!\032\001";
 
+// pulse cache file header: magic number, version, and the parameters
+// of the sound file the pulse data was decoded from
+static const uint32_t pulseCacheMagic = 0x45505043U;
+static const size_t   pulseCacheHeaderSize = 16;
+
+static void *mapFileReadOnly(std::FILE *f, size_t nBytes)
+{
+  if (nBytes < 1)
+    return (void *) 0;
+#ifdef WIN32
+  HANDLE  h = CreateFileMapping((HANDLE) _get_osfhandle(_fileno(f)),
+                                NULL, PAGE_READONLY, 0, 0, NULL);
+  if (h == (HANDLE) 0)
+    return (void *) 0;
+  void    *p = MapViewOfFile(h, FILE_MAP_READ, 0, 0, nBytes);
+  CloseHandle(h);
+  return p;
+#else
+  void    *p = mmap((void *) 0, nBytes, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  if (p == MAP_FAILED)
+    return (void *) 0;
+  return p;
+#endif
+}
+
+static void unmapFile(void *p, size_t nBytes)
+{
+#ifdef WIN32
+  (void) nBytes;
+  UnmapViewOfFile(p);
+#else
+  munmap(p, nBytes);
+#endif
+}
+
+// find the nearest position in the sorted table 'tbl' that is after
+// (if isForward is true) or before 'pos', and store it in 'pos'; returns
+// false if there is no such position
+
+static bool findNearestPosition(const std::vector< size_t >& tbl,
+                                size_t& pos, bool isForward)
+{
+  size_t  n1 = 0;
+  size_t  n2 = tbl.size();
+  while (n1 < n2) {
+    size_t  n = (n1 + n2) >> 1;
+    if (isForward ? (tbl[n] <= pos) : (tbl[n] < pos))
+      n1 = n + 1;
+    else
+      n2 = n;
+  }
+  if (isForward) {
+    if (n1 >= tbl.size())
+      return false;
+    pos = tbl[n1];
+  }
+  else {
+    if (n1 < 1)
+      return false;
+    pos = tbl[n1 - 1];
+  }
+  return true;
+}
+
 static int cuePointCmpFunc(const void *p1, const void *p2)
 {
   if (*((uint32_t *) p1) < *((uint32_t *) p2))
@@ -98,6 +172,12 @@ namespace Ep128Emu {
   {
   }
 
+  bool Tape::readDataBlock(std::vector< uint8_t >& buf)
+  {
+    buf.clear();
+    return false;
+  }
+
   // --------------------------------------------------------------------------
 
   bool Tape_Ep128Emu::findCuePoint_(size_t& ndx_, size_t pos_)
@@ -589,7 +669,8 @@ namespace Ep128Emu {
       samplesRemaining(0),
       leaderSampleCnt(0),
       chunkBytesRemaining(0),
-      chunkCnt(0)
+      chunkCnt(0),
+      indexedTapeLength(0)
   {
     if (fileName == (char *) 0 || fileName[0] == '\0')
       throw Exception("invalid tape file name");
@@ -612,7 +693,13 @@ namespace Ep128Emu {
       std::fclose(f);
       throw Exception("invalid tape file header");
     }
-    this->seek(0.0);
+    try {
+      buildIndex_();
+    }
+    catch (...) {
+      std::fclose(f);
+      throw;
+    }
   }
 
   Tape_EPTE::~Tape_EPTE()
@@ -701,7 +788,8 @@ namespace Ep128Emu {
     if (samplesRemaining > 0)
       samplesRemaining--;
     tapePosition++;
-    tapeLength = tapePosition + (bytesRemaining * 80) + leaderSampleCnt + 1;
+    if (!indexedTapeLength)
+      tapeLength = tapePosition + (bytesRemaining * 80) + leaderSampleCnt + 1;
   }
 
   void Tape_EPTE::setIsMotorOn(bool newState)
@@ -715,37 +803,130 @@ namespace Ep128Emu {
     isRecordOn = false;
   }
 
-  void Tape_EPTE::seek(double t)
+  void Tape_EPTE::rewind_()
   {
-    if (t <= 0.0) {
-      tapeLength = 0;
-      tapePosition = 0;
-      outputState = 0;
-      bytesRemaining = 0;
-      endOfTape = false;
-      shiftReg = 0x00;
-      bitsRemaining = 0;
-      halfPeriodSamples = 5;
-      samplesRemaining = 0;
-      leaderSampleCnt = 0;
-      chunkBytesRemaining = 0;
-      chunkCnt = 0;
-      if (std::fseek(f, 0L, SEEK_END) >= 0) {
-        long    n = std::ftell(f);
-        if (n > 512L) {
-          bytesRemaining = size_t(n - 512L);
-          tapeLength = bytesRemaining * 80;
-          std::fseek(f, 512L, SEEK_SET);
-        }
+    tapeLength = 0;
+    tapePosition = 0;
+    outputState = 0;
+    bytesRemaining = 0;
+    endOfTape = false;
+    shiftReg = 0x00;
+    bitsRemaining = 0;
+    halfPeriodSamples = 5;
+    samplesRemaining = 0;
+    leaderSampleCnt = 0;
+    chunkBytesRemaining = 0;
+    chunkCnt = 0;
+    if (std::fseek(f, 0L, SEEK_END) >= 0) {
+      long    n = std::ftell(f);
+      if (n > 512L) {
+        bytesRemaining = size_t(n - 512L);
+        tapeLength = bytesRemaining * 80;
+        std::fseek(f, 512L, SEEK_SET);
       }
     }
+    if (indexedTapeLength)
+      tapeLength = indexedTapeLength;
+  }
+
+  void Tape_EPTE::saveState_(IndexEntry& e)
+  {
+    e.filePos = std::ftell(f);
+    e.tapePosition = tapePosition;
+    e.outputState = outputState;
+    e.bytesRemaining = bytesRemaining;
+    e.endOfTape = endOfTape;
+    e.shiftReg = shiftReg;
+    e.bitsRemaining = bitsRemaining;
+    e.halfPeriodSamples = halfPeriodSamples;
+    e.samplesRemaining = samplesRemaining;
+    e.leaderSampleCnt = leaderSampleCnt;
+    e.chunkBytesRemaining = chunkBytesRemaining;
+    e.chunkCnt = chunkCnt;
+  }
+
+  void Tape_EPTE::restoreState_(const IndexEntry& e)
+  {
+    std::fseek(f, e.filePos, SEEK_SET);
+    tapePosition = e.tapePosition;
+    outputState = e.outputState;
+    bytesRemaining = e.bytesRemaining;
+    endOfTape = e.endOfTape;
+    shiftReg = e.shiftReg;
+    bitsRemaining = e.bitsRemaining;
+    halfPeriodSamples = e.halfPeriodSamples;
+    samplesRemaining = e.samplesRemaining;
+    leaderSampleCnt = e.leaderSampleCnt;
+    chunkBytesRemaining = e.chunkBytesRemaining;
+    chunkCnt = e.chunkCnt;
+  }
+
+  void Tape_EPTE::buildIndex_()
+  {
+    // play the whole tape once, saving the state every 0.5 seconds
+    tapeIndex.clear();
+    chunkStartPositions.clear();
+    indexedTapeLength = 0;
+    rewind_();
+    size_t  indexInterval = size_t(sampleRate) >> 1;
+    size_t  nextIndexPos = 0;
+    while (!endOfTape) {
+      if (tapePosition >= nextIndexPos) {
+        IndexEntry  e;
+        saveState_(e);
+        if (e.filePos < 0L)
+          break;
+        tapeIndex.push_back(e);
+        nextIndexPos = tapePosition + indexInterval;
+      }
+      bool    noLeader = (leaderSampleCnt == 0);
+      runOneSample_();
+      if (noLeader && leaderSampleCnt != 0 && bytesRemaining != 0)
+        chunkStartPositions.push_back(tapePosition - 1);
+    }
+    indexedTapeLength = (tapeLength > 1 ? tapeLength : 1);
+    rewind_();
+  }
+
+  void Tape_EPTE::seek_(size_t pos_)
+  {
+    if (tapeIndex.size() < 1) {
+      rewind_();
+      return;
+    }
+    // find the last index entry at or before the requested position
+    size_t  n1 = 0;
+    size_t  n2 = tapeIndex.size();
+    while ((n2 - n1) > 1) {
+      size_t  n = (n1 + n2) >> 1;
+      if (tapeIndex[n].tapePosition <= pos_)
+        n1 = n;
+      else
+        n2 = n;
+    }
+    restoreState_(tapeIndex[n1]);
+    tapeLength = indexedTapeLength;
+    // play the remaining samples
+    while (tapePosition < pos_ && !endOfTape)
+      runOneSample_();
+  }
+
+  void Tape_EPTE::seek(double t)
+  {
+    this->seek_(size_t(long(t > 0.0 ? (t * double(sampleRate) + 0.5) : 0.0)));
   }
 
   void Tape_EPTE::seekToCuePoint(bool isForward, double t)
   {
-    (void) t;
-    if (!isForward)
-      this->seek(0.0);
+    size_t  pos = tapePosition;
+    if (findNearestPosition(chunkStartPositions, pos, isForward)) {
+      this->seek_(pos);
+      return;
+    }
+    if (isForward)
+      this->seek(getPosition() + (t > 0.0 ? t : 0.0));
+    else
+      this->seek(getPosition() - (t > 0.0 ? t : 0.0));
   }
 
   void Tape_EPTE::addCuePoint()
@@ -764,7 +945,8 @@ namespace Ep128Emu {
 
   Tape_TZX::Tape_TZX(const char *fileName, int bitsPerSample)
     : Tape(bitsPerSample),
-      f((std::FILE *) 0)
+      f((std::FILE *) 0),
+      indexedTapeLength(0)
   {
     tapeReset();
     if (fileName == (char *) 0 || fileName[0] == '\0')
@@ -812,7 +994,13 @@ namespace Ep128Emu {
       throw Exception("invalid tape file header");
     }
     sampleRate = (isTAPFile ? 53030L : 109375L);        // 3500000 / 66 or 32
-    this->seek(0.0);
+    try {
+      buildIndex_();
+    }
+    catch (...) {
+      std::fclose(f);
+      throw;
+    }
   }
 
   Tape_TZX::~Tape_TZX()
@@ -1363,6 +1551,154 @@ namespace Ep128Emu {
     pulseTimer = pulseLength;
   }
 
+  bool Tape_TZX::findStandardDataBlock(uint32_t& nBytes,
+                                       uint32_t& pauseLength_)
+  {
+    // check if the next block in the file is a standard speed data block,
+    // skipping any blocks that do not affect the signal; on success, the
+    // file position is left at the first byte of the block data
+    nBytes = 0U;
+    pauseLength_ = 0U;
+    if (isTAPFile) {
+      int     c1 = std::fgetc(f);
+      int     c2 = std::fgetc(f);
+      if (c1 == EOF || c2 == EOF)
+        return false;
+      nBytes = uint32_t(c1 & 0xFF) | (uint32_t(c2 & 0xFF) << 8);
+      pauseLength_ = 1500U;
+      return (nBytes > 0U);
+    }
+    while (true) {
+      int     blockType = std::fgetc(f);
+      int     c1 = 0;
+      int     c2 = 0;
+      switch (blockType) {
+      case 0x10:                        // standard speed data block
+        {
+          uint8_t tmp[4];
+          if (std::fread(&(tmp[0]), sizeof(uint8_t), 4, f) != 4)
+            return false;
+          pauseLength_ = uint32_t(tmp[0]) | (uint32_t(tmp[1]) << 8);
+          nBytes = uint32_t(tmp[2]) | (uint32_t(tmp[3]) << 8);
+        }
+        return (nBytes > 0U);
+      case 0x21:                        // group start
+      case 0x30:                        // text description
+        c1 = std::fgetc(f);
+        if (c1 == EOF)
+          return false;
+        if (std::fseek(f, long(c1 & 0xFF), SEEK_CUR) < 0)
+          return false;
+        break;
+      case 0x22:                        // group end
+        break;
+      case 0x32:                        // archive info
+        c1 = std::fgetc(f);
+        c2 = std::fgetc(f);
+        if (c1 == EOF || c2 == EOF)
+          return false;
+        if (std::fseek(f, long(c1 & 0xFF) | (long(c2 & 0xFF) << 8),
+                       SEEK_CUR) < 0) {
+          return false;
+        }
+        break;
+      default:                          // anything else is not supported
+        return false;
+      }
+    }
+    return false;
+  }
+
+  bool Tape_TZX::readDataBlock(std::vector< uint8_t >& buf)
+  {
+    buf.clear();
+    if (endOfTape || !isPlaybackOn || isRecordOn)
+      return false;
+    if (lastByteBits != 8 ||
+        !(currentMode == 0x00 || currentMode == 0x04)) {
+      return false;
+    }
+    long    savedFilePos = std::ftell(f);
+    if (savedFilePos < 0L)
+      return false;
+    uint32_t  nBytes = 0U;
+    uint32_t  newPauseLength = 0U;
+    // the remaining part of the current pilot tone or pause
+    size_t    nSamples = size_t(pulseTimer);
+    if (pulseCnt > 1U)
+      nSamples += (size_t(pulseCnt - 1U) * size_t(pulseLength));
+    if (currentMode == 0x00) {
+      // the pilot tone of a data block has already been started
+      if (!(isTAPFile || currentBlockType == 0x10 ||
+            (currentBlockType == 0x11 &&
+             pilotPulseLength == uint16_t(convertPulseLength(2168)) &&
+             syncPulseLength1 == uint16_t(convertPulseLength(667)) &&
+             syncPulseLength2 == uint16_t(convertPulseLength(735)) &&
+             bit0PulseLength == uint16_t(convertPulseLength(855)) &&
+             bit1PulseLength == uint16_t(convertPulseLength(1710))))) {
+        return false;
+      }
+      nBytes = dataBlockBytesLeft;
+      newPauseLength = pauseLength;
+      if (nBytes < 1U)
+        return false;
+    }
+    else {
+      if (currentBlockType == 0x12)     // pure tone, not a pause
+        return false;
+      if (!findStandardDataBlock(nBytes, newPauseLength)) {
+        std::fseek(f, savedFilePos, SEEK_SET);
+        return false;
+      }
+      nSamples += (size_t(5643) * convertPulseLength(2168));
+    }
+    try {
+      buf.resize(nBytes);
+    }
+    catch (...) {
+      std::fseek(f, savedFilePos, SEEK_SET);
+      throw;
+    }
+    if (std::fread(&(buf.front()), sizeof(uint8_t), nBytes, f) != nBytes) {
+      buf.clear();
+      std::fseek(f, savedFilePos, SEEK_SET);
+      return false;
+    }
+    // update tape state as if the block had been played normally
+    nSamples += (convertPulseLength(667) + convertPulseLength(735));
+    uint32_t  bit0Length = convertPulseLength(855) << 1;
+    uint32_t  bit1Length = convertPulseLength(1710) << 1;
+    for (uint32_t i = 0U; i < nBytes; i++) {
+      uint8_t c = buf[i];
+      for (int j = 0; j < 8; j++) {
+        nSamples += ((c & 0x80) == 0 ? bit0Length : bit1Length);
+        c = (c & 0x7F) << 1;
+      }
+    }
+    currentMode = 0x03;
+    if (currentBlockType != 0x11)
+      currentBlockType = 0x10;
+    pilotPulseLength = uint16_t(convertPulseLength(2168));
+    syncPulseLength1 = uint16_t(convertPulseLength(667));
+    syncPulseLength2 = uint16_t(convertPulseLength(735));
+    bit0PulseLength = uint16_t(convertPulseLength(855));
+    bit1PulseLength = uint16_t(convertPulseLength(1710));
+    bit0PulseCnt = 2;
+    bit1PulseCnt = 2;
+    dataBlockBytesLeft = 0U;
+    pauseLength = newPauseLength;
+    shiftReg = 0x00;
+    outputState = 0;
+    if (pauseLength > 0U)
+      setPauseMode();
+    else
+      readNextTZXBlock();
+    tapePosition += nSamples;
+    tapeLength = (tapeLength >= (tapePosition + (size_t(sampleRate) << 1)) ?
+                  tapeLength : (tapePosition + (size_t(sampleRate) << 1)));
+    return true;
+  }
+
   void Tape_TZX::runOneSample_()
   {
     if (endOfTape) {
@@ -1379,6 +1715,11 @@ namespace Ep128Emu {
       pulseTimer--;
       return;
     }
+    nextPulse();
+  }
+
+  void Tape_TZX::nextPulse()
+  {
     outputState = (outputState == 0 ? (1 << (requestedBitsPerSample - 1)) : 0);
     pulseTimer = pulseLength;
     if (currentMode == 0x04) {
@@ -1440,24 +1781,168 @@ namespace Ep128Emu {
     isRecordOn = false;
   }
 
-  void Tape_TZX::seek(double t)
+  void Tape_TZX::rewind_()
   {
-    if (t <= 0.0) {
-      tapeReset();
-      tapePosition = 0;
-      if (std::fseek(f, (isTAPFile ? 0L : 10L), SEEK_SET) >= 0) {
-        endOfTape = false;
-        outputState = 0;
-        setPauseMode(150U);
+    tapeReset();
+    tapePosition = 0;
+    if (std::fseek(f, (isTAPFile ? 0L : 10L), SEEK_SET) >= 0) {
+      endOfTape = false;
+      outputState = 0;
+      setPauseMode(150U);
+    }
+    if (indexedTapeLength)
+      tapeLength = indexedTapeLength;
+  }
+
+  void Tape_TZX::saveState_(IndexEntry& e)
+  {
+    e.filePos = std::ftell(f);
+    e.tapePosition = tapePosition;
+    e.outputState = outputState;
+    e.currentBlockType = currentBlockType;
+    e.currentMode = currentMode;
+    e.endOfTape = endOfTape;
+    e.shiftReg = shiftReg;
+    e.pulseTimer = pulseTimer;
+    e.pulseLength = pulseLength;
+    e.pulseCnt = pulseCnt;
+    e.pilotPulseLength = pilotPulseLength;
+    e.syncPulseLength1 = syncPulseLength1;
+    e.syncPulseLength2 = syncPulseLength2;
+    e.bit0PulseLength = bit0PulseLength;
+    e.bit1PulseLength = bit1PulseLength;
+    e.bit0PulseCnt = bit0PulseCnt;
+    e.bit1PulseCnt = bit1PulseCnt;
+    e.pilotPulseCnt = pilotPulseCnt;
+    e.lastByteBits = lastByteBits;
+    e.pulseSequencePulsesLeft = pulseSequencePulsesLeft;
+    e.pauseLength = pauseLength;
+    e.clockFrequency = clockFrequency;
+    e.dataBlockBytesLeft = dataBlockBytesLeft;
+    e.directRecordingSampleRate = directRecordingSampleRate;
+    e.directRecordingTimer = directRecordingTimer;
+    e.loopFilePos = loopFilePos;
+    e.loopStartTime = loopStartTime;
+    e.loopRepeatCnt = loopRepeatCnt;
+  }
+
+  void Tape_TZX::restoreState_(const IndexEntry& e)
+  {
+    std::fseek(f, e.filePos, SEEK_SET);
+    tapePosition = e.tapePosition;
+    outputState = e.outputState;
+    currentBlockType = e.currentBlockType;
+    currentMode = e.currentMode;
+    endOfTape = e.endOfTape;
+    shiftReg = e.shiftReg;
+    pulseTimer = e.pulseTimer;
+    pulseLength = e.pulseLength;
+    pulseCnt = e.pulseCnt;
+    pilotPulseLength = e.pilotPulseLength;
+    syncPulseLength1 = e.syncPulseLength1;
+    syncPulseLength2 = e.syncPulseLength2;
+    bit0PulseLength = e.bit0PulseLength;
+    bit1PulseLength = e.bit1PulseLength;
+    bit0PulseCnt = e.bit0PulseCnt;
+    bit1PulseCnt = e.bit1PulseCnt;
+    pilotPulseCnt = e.pilotPulseCnt;
+    lastByteBits = e.lastByteBits;
+    pulseSequencePulsesLeft = e.pulseSequencePulsesLeft;
+    pauseLength = e.pauseLength;
+    clockFrequency = e.clockFrequency;
+    dataBlockBytesLeft = e.dataBlockBytesLeft;
+    directRecordingSampleRate = e.directRecordingSampleRate;
+    directRecordingTimer = e.directRecordingTimer;
+    loopFilePos = e.loopFilePos;
+    loopStartTime = e.loopStartTime;
+    loopRepeatCnt = e.loopRepeatCnt;
+  }
+
+  void Tape_TZX::buildIndex_()
+  {
+    // play the whole tape once, one pulse at a time, saving the state
+    // every 0.5 seconds
+    tapeIndex.clear();
+    blockStartPositions.clear();
+    indexedTapeLength = 0;
+    rewind_();
+    size_t  indexInterval = size_t(sampleRate) >> 1;
+    size_t  nextIndexPos = 0;
+    while (!endOfTape && tapePosition < 0x7FFFFFFFUL) {
+      if (tapePosition >= nextIndexPos) {
+        IndexEntry  e;
+        saveState_(e);
+        if (e.filePos < 0L)
+          break;
+        tapeIndex.push_back(e);
+        nextIndexPos = tapePosition + indexInterval;
       }
+      uint8_t prvMode = currentMode;
+      tapePosition += size_t(pulseTimer > 1U ? pulseTimer : 1U);
+      nextPulse();
+      if (currentMode == 0x00 && prvMode != 0x00 && !endOfTape)
+        blockStartPositions.push_back(tapePosition);
     }
+    // the tape is stopped by block 0x20 with a zero pause length
+    isPlaybackOn = false;
+    isRecordOn = false;
+    indexedTapeLength = tapePosition + (size_t(sampleRate) << 1);
+    rewind_();
+  }
+
+  void Tape_TZX::seek_(size_t pos_)
+  {
+    if (tapeIndex.size() < 1 || pos_ < 1) {
+      rewind_();
+      return;
+    }
+    // find the last index entry at or before the requested position
+    size_t  n1 = 0;
+    size_t  n2 = tapeIndex.size();
+    while ((n2 - n1) > 1) {
+      size_t  n = (n1 + n2) >> 1;
+      if (tapeIndex[n].tapePosition <= pos_)
+        n1 = n;
+      else
+        n2 = n;
+    }
+    bool    savedPlaybackOn = isPlaybackOn;
+    bool    savedRecordOn = isRecordOn;
+    restoreState_(tapeIndex[n1]);
+    // skip the remaining pulses
+    while (!endOfTape) {
+      size_t  n = size_t(pulseTimer > 1U ? pulseTimer : 1U);
+      if ((tapePosition + n) > pos_) {
+        pulseTimer -= uint32_t(pos_ - tapePosition);
+        tapePosition = pos_;
+        break;
+      }
+      tapePosition += n;
+      nextPulse();
+    }
+    isPlaybackOn = savedPlaybackOn;
+    isRecordOn = savedRecordOn;
+    tapeLength = indexedTapeLength;
+    if (endOfTape)
+      tapePosition = (pos_ < tapeLength ? pos_ : tapeLength);
+  }
+
+  void Tape_TZX::seek(double t)
+  {
+    this->seek_(size_t(long(t > 0.0 ? (t * double(sampleRate) + 0.5) : 0.0)));
   }
 
   void Tape_TZX::seekToCuePoint(bool isForward, double t)
   {
-    (void) t;
-    if (!isForward)
-      this->seek(0.0);
+    size_t  pos = tapePosition;
+    if (findNearestPosition(blockStartPositions, pos, isForward)) {
+      this->seek_(pos);
+      return;
+    }
+    if (isForward)
+      this->seek(getPosition() + (t > 0.0 ? t : 0.0));
+    else
+      this->seek(getPosition() - (t > 0.0 ? t : 0.0));
   }
 
   void Tape_TZX::addCuePoint()
@@ -1651,8 +2136,194 @@ namespace Ep128Emu {
 
   // --------------------------------------------------------------------------
 
+  class Tape_SoundFile::PulseDecoderThread_ : public Thread {
+   private:
+    std::string fileName;
+    size_t      tapeLength;
+    int         nChannels;
+    int         requestedChannel;
+    int         requestedBitsPerSample;
+    bool        enableFIRFilter;
+    float       sampleRate;
+    float       filterMinFreq;
+    float       filterMaxFreq;
+    // the pulse data is saved to this file on success, if not empty
+    std::string cacheFileName;
+    uint32_t    cacheHeader[pulseCacheHeaderSize];
+    Mutex       mutex_;
+    bool        stopFlag;
+    bool        doneFlag;
+    std::vector< uint32_t > runs;
+    bool decodeFile_();
+    void writeCacheFile_();
+   protected:
+    virtual void run();
+   public:
+    PulseDecoderThread_(const Tape_SoundFile& tape_);
+    virtual ~PulseDecoderThread_();
+    // returns true if the thread has finished
+    bool isDone();
+    // stores the decoded runs in 'buf', or clears it on failure; should
+    // only be called after isDone() returned true
+    void getPulseData(std::vector< uint32_t >& buf);
+  };
+
+  Tape_SoundFile::PulseDecoderThread_::PulseDecoderThread_(
+      const Tape_SoundFile& tape_)
+    : Thread(),
+      fileName(tape_.fileName),
+      tapeLength(tape_.tapeLength),
+      nChannels(tape_.nChannels),
+      requestedChannel(tape_.requestedChannel),
+      requestedBitsPerSample(tape_.requestedBitsPerSample),
+      enableFIRFilter(tape_.enableFIRFilter),
+      sampleRate(float(tape_.sampleRate)),
+      filterMinFreq(tape_.filterMinFreq),
+      filterMaxFreq(tape_.filterMaxFreq),
+      cacheFileName(""),
+      stopFlag(false),
+      doneFlag(false)
+  {
+    if (tape_.pulseCacheHeader.size() == pulseCacheHeaderSize) {
+      for (size_t i = 0; i < pulseCacheHeaderSize; i++)
+        cacheHeader[i] = tape_.pulseCacheHeader[i];
+      cacheFileName = fileName;
+      cacheFileName += ".pulses";
+    }
+  }
+
+  Tape_SoundFile::PulseDecoderThread_::~PulseDecoderThread_()
+  {
+    mutex_.lock();
+    stopFlag = true;
+    mutex_.unlock();
+    join();
+  }
+
+  bool Tape_SoundFile::PulseDecoderThread_::isDone()
+  {
+    mutex_.lock();
+    bool    retval = doneFlag;
+    mutex_.unlock();
+    return retval;
+  }
+
+  void Tape_SoundFile::PulseDecoderThread_::getPulseData(
+      std::vector< uint32_t >& buf)
+  {
+    buf.clear();
+    buf.swap(runs);
+  }
+
+  void Tape_SoundFile::PulseDecoderThread_::run()
+  {
+    bool    err = true;
+    try {
+      err = !decodeFile_();
+      if (!err)
+        writeCacheFile_();
+    }
+    catch (...) {
+    }
+    if (err)
+      runs.clear();
+    mutex_.lock();
+    doneFlag = true;
+    mutex_.unlock();
+  }
+
+  bool Tape_SoundFile::PulseDecoderThread_::decodeFile_()
+  {
+    // decode the whole sound file once, using a separate file handle, and
+    // convert the output signal to (start position, level) pairs
+    SF_INFO sfinfo;
+    std::memset(&sfinfo, 0, sizeof(SF_INFO));
+    SNDFILE *sf = sf_open(fileName.c_str(), SFM_READ, &sfinfo);
+    if (!sf)
+      return false;
+    bool    retval = false;
+    TapeFilter  *filter_ = (TapeFilter *) 0;
+    try {
+      if (sfinfo.channels == nChannels) {
+        std::vector< short >  tmpBuf(size_t(nChannels * 1024));
+        if (enableFIRFilter) {
+          filter_ = new TapeFilter(2048);
+          filter_->setFilterParameters(sampleRate,
+                                       filterMinFreq, filterMaxFreq);
+        }
+        int     prvLevel = -1;
+        size_t  pos = 0;
+        while (pos < tapeLength) {
+          mutex_.lock();
+          bool    stopFlag_ = stopFlag;
+          mutex_.unlock();
+          if (stopFlag_)
+            break;
+          int     n = int(sf_readf_short(sf, &(tmpBuf.front()),
+                                         sf_count_t(1024)));
+          if (n <= 0)
+            break;
+          for (int i = 0; i < n && pos < tapeLength; i++, pos++) {
+            int     level =
+                convertSample_(tmpBuf[(i * nChannels) + requestedChannel],
+                               filter_, requestedBitsPerSample);
+            if (level != prvLevel) {
+              runs.push_back(uint32_t(pos));
+              runs.push_back(uint32_t(level));
+              prvLevel = level;
+            }
+          }
+        }
+        if (pos >= tapeLength) {
+          // the position is clamped to the end of the tape, where the
+          // buffer is filled with -1 samples
+          int     level = convertSample_(-1, (TapeFilter *) 0,
+                                         requestedBitsPerSample);
+          if (level != prvLevel) {
+            runs.push_back(uint32_t(tapeLength));
+            runs.push_back(uint32_t(level));
+          }
+          retval = (runs.size() >= 2);
+        }
+      }
+    }
+    catch (...) {
+      retval = false;
+    }
+    if (filter_)
+      delete filter_;
+    (void) sf_close(sf);
+    return retval;
+  }
+
+  void Tape_SoundFile::PulseDecoderThread_::writeCacheFile_()
+  {
+    if (cacheFileName.length() < 1 || runs.size() < 2)
+      return;
+    // remove any old cache file first, so that it is not truncated while
+    // it may still be mapped by another process
+    fileRemove(cacheFileName.c_str());
+    std::FILE *f = fileOpen(cacheFileName.c_str(), "wb");
+    if (!f)
+      return;
+    cacheHeader[pulseCacheHeaderSize - 2] = uint32_t(runs.size() >> 1);
+    bool    err =
+        (std::fwrite(&(cacheHeader[0]), sizeof(uint32_t),
+                     pulseCacheHeaderSize, f) != pulseCacheHeaderSize);
+    if (!err) {
+      err = (std::fwrite(&(runs.front()), sizeof(uint32_t), runs.size(), f)
+             != runs.size());
+    }
+    err = (std::fclose(f) != 0 || err);
+    if (err)
+      fileRemove(cacheFileName.c_str());
+  }
+
+  // --------------------------------------------------------------------------
+
   bool Tape_SoundFile::writeBuffer_()
   {
+    isFileChanged = true;
     sf_count_t  filePos = sf_count_t((tapePosition >> 10) << 10);
     if (sf_seek(sf, filePos, SEEK_SET) != filePos)
       return false;
@@ -1669,6 +2340,12 @@ namespace Ep128Emu {
   {
     // clamp position to tape length
     size_t  pos = (pos_ < tapeLength ? pos_ : tapeLength);
+    if (pulseData) {
+      // 'buf' is not used while playing decoded pulse data
+      tapePosition = pos;
+      findPulseRun_();
+      return;
+    }
     size_t  oldBlockNum = (tapePosition >> 10);
     size_t  newBlockNum = (pos >> 10);
 
@@ -1714,7 +2391,20 @@ namespace Ep128Emu {
       requestedChannel(0),
       enableFIRFilter(false),
       isBufferDirty(false),
-      firFilter(2048)
+      firFilter(2048),
+      filterMinFreq(0.0f),
+      filterMaxFreq(0.0f),
+      fileName(""),
+      pulseData((uint32_t *) 0),
+      pulseRunCnt(0),
+      pulseRunIndex(0),
+      pulseCacheMapping((void *) 0),
+      pulseCacheMapSize(0),
+      isFileChanged(false),
+      pulseDecoder((PulseDecoderThread_ *) 0),
+      pulseDecoderPollCnt(0),
+      pulseDataChecked(false),
+      pulseDecodingEnabled(true)
   {
     if (fileName == (char *) 0 || fileName[0] == '\0')
       throw Exception("invalid tape file name");
@@ -1788,6 +2478,7 @@ namespace Ep128Emu {
       n = (n >= 0 ? n : 0) * nChannels;
       for ( ; n < int(buf.size()); n++)
         buf[n] = 0;
+      this->fileName = fileName;
     }
     catch (...) {
       (void) sf_close(sf);
@@ -1804,11 +2495,266 @@ namespace Ep128Emu {
     }
     catch (...) {
     }
+    closePulseData_(false);
     (void) sf_close(sf);
+    // libsndfile may rewrite the header of a file opened for writing when
+    // closing it, so the cache is updated to the new modification time if
+    // no sample data has been written
+    try {
+      updatePulseCache_();
+    }
+    catch (...) {
+    }
+  }
+
+  void Tape_SoundFile::reloadBuffer_()
+  {
+    (void) sf_seek(sf, sf_count_t((tapePosition >> 10) << 10), SEEK_SET);
+    int   n = int(sf_readf_short(sf, &(buf.front()), sf_count_t(1024)));
+    n = (n >= 0 ? n : 0) * nChannels;
+    for ( ; n < int(buf.size()); n++)
+      buf[n] = short(-1);
+  }
+
+  int Tape_SoundFile::convertSample_(int n, TapeFilter *filter_,
+                                     int bitsPerSample)
+  {
+    if (filter_) {
+      float tmp = filter_->processSample(float(n));
+      n = int(tmp + (tmp >= 0.0f ? 0.5f : -0.5f));
+    }
+    n = n + 32768;
+    n = (n >= 0 ? (n <= 65535 ? n : 65535) : 0);
+    return (n >> (16 - bitsPerSample));
+  }
+
+  bool Tape_SoundFile::getPulseCacheHeader_(uint32_t *hdr) const
+  {
+    for (size_t i = 0; i < pulseCacheHeaderSize; i++)
+      hdr[i] = 0U;
+    hdr[0] = pulseCacheMagic;
+    hdr[1] = 1U;                        // version
+    {
+      // identify the sound file by its size and modification time
+#ifndef WIN32
+      struct stat   st;
+      int     err = stat(fileName.c_str(), &st);
+#else
+      struct _stat  st;
+      int     err = fileStat(fileName.c_str(), &st);
+#endif
+      if (err != 0)
+        return false;
+      uint64_t  tmp = uint64_t(st.st_size);
+      hdr[2] = uint32_t(tmp & 0xFFFFFFFFUL);
+      hdr[3] = uint32_t(tmp >> 32);
+      tmp = uint64_t(st.st_mtime);
+      hdr[4] = uint32_t(tmp & 0xFFFFFFFFUL);
+      hdr[5] = uint32_t(tmp >> 32);
+    }
+    hdr[6] = uint32_t(sampleRate);
+    hdr[7] = uint32_t(tapeLength);
+    hdr[8] = uint32_t(nChannels);
+    hdr[9] = uint32_t(requestedChannel);
+    hdr[10] = uint32_t(requestedBitsPerSample);
+    if (enableFIRFilter) {
+      hdr[11] = 1U;
+      std::memcpy(&(hdr[12]), &filterMinFreq, sizeof(uint32_t));
+      std::memcpy(&(hdr[13]), &filterMaxFreq, sizeof(uint32_t));
+    }
+    return true;
+  }
+
+  bool Tape_SoundFile::openPulseCache_()
+  {
+    const uint32_t  *hdr = &(pulseCacheHeader.front());
+    std::string cacheFileName(fileName);
+    cacheFileName += ".pulses";
+    std::FILE *f = fileOpen(cacheFileName.c_str(), "rb");
+    if (!f)
+      return false;
+    uint32_t  tmp[pulseCacheHeaderSize];
+    long      fileSize = -1L;
+    if (std::fread(&(tmp[0]), sizeof(uint32_t), pulseCacheHeaderSize, f)
+        == pulseCacheHeaderSize &&
+        std::memcmp(&(tmp[0]), hdr,
+                    sizeof(uint32_t) * (pulseCacheHeaderSize - 2)) == 0) {
+      if (std::fseek(f, 0L, SEEK_END) >= 0)
+        fileSize = std::ftell(f);
+    }
+    size_t  nRuns = size_t(tmp[pulseCacheHeaderSize - 2]);
+    size_t  nBytes = (pulseCacheHeaderSize + (nRuns << 1)) * sizeof(uint32_t);
+    if (fileSize > 0L && size_t(fileSize) == nBytes && nRuns > 0) {
+      pulseCacheMapping = mapFileReadOnly(f, nBytes);
+      if (pulseCacheMapping) {
+        pulseCacheMapSize = nBytes;
+        pulseData = reinterpret_cast< const uint32_t * >(pulseCacheMapping)
+                    + pulseCacheHeaderSize;
+        pulseRunCnt = nRuns;
+      }
+    }
+    std::fclose(f);
+    if (!pulseData)
+      return false;
+    findPulseRun_();
+    return true;
+  }
+
+  void Tape_SoundFile::updatePulseCache_()
+  {
+    if (pulseCacheHeader.size() != pulseCacheHeaderSize || isFileChanged)
+      return;
+    uint32_t  hdr[pulseCacheHeaderSize];
+    if (!getPulseCacheHeader_(&(hdr[0])))
+      return;
+    if (std::memcmp(&(hdr[0]), &(pulseCacheHeader.front()),
+                    sizeof(uint32_t) * (pulseCacheHeaderSize - 2)) == 0) {
+      return;                           // the file has not been touched
+    }
+    // only the size and modification time are allowed to change
+    for (size_t i = 6; i < (pulseCacheHeaderSize - 2); i++) {
+      if (hdr[i] != pulseCacheHeader[i])
+        return;
+    }
+    std::string cacheFileName(fileName);
+    cacheFileName += ".pulses";
+    std::FILE *f = fileOpen(cacheFileName.c_str(), "r+b");
+    if (!f)
+      return;
+    uint32_t  tmp[pulseCacheHeaderSize];
+    if (std::fread(&(tmp[0]), sizeof(uint32_t), pulseCacheHeaderSize, f)
+        == pulseCacheHeaderSize &&
+        std::memcmp(&(tmp[0]), &(pulseCacheHeader.front()),
+                    sizeof(uint32_t) * (pulseCacheHeaderSize - 2)) == 0) {
+      if (std::fseek(f, long(sizeof(uint32_t) * 2), SEEK_SET) >= 0)
+        (void) std::fwrite(&(hdr[2]), sizeof(uint32_t), 4, f);
+    }
+    std::fclose(f);
+  }
+
+  void Tape_SoundFile::startPulseDecoder_()
+  {
+    closePulseData_(false);
+    pulseCacheHeader.clear();
+    pulseDataChecked = true;
+    if (isRecordOn || fileName.length() < 1)
+      return;
+    try {
+      // make sure that the cache header and the decoder thread use the
+      // current file data
+      flushBuffer_();
+      if (isFileChanged) {
+        (void) sf_command(sf, SFC_UPDATE_HEADER_NOW, (void *) 0, 0);
+        isFileChanged = false;
+      }
+      pulseCacheHeader.resize(pulseCacheHeaderSize);
+      if (!getPulseCacheHeader_(&(pulseCacheHeader.front())))
+        pulseCacheHeader.clear();
+      // use the cache file if it is still valid
+      if (pulseCacheHeader.size() > 0 && openPulseCache_())
+        return;
+      if (!pulseDecodingEnabled)
+        return;
+      pulseDecoder = new PulseDecoderThread_(*this);
+    }
+    catch (...) {
+      // the signal is decoded directly from the file
+      return;
+    }
+    pulseDecoderPollCnt = 1024;
+    pulseDecoder->start();
+  }
+
+  void Tape_SoundFile::checkPulseDecoder_()
+  {
+    pulseDecoderPollCnt = 1024;
+    if (!pulseDecoder->isDone())
+      return;
+    pulseDecoder->getPulseData(pulseBuf);
+    delete pulseDecoder;
+    pulseDecoder = (PulseDecoderThread_ *) 0;
+    if (pulseBuf.size() < 2) {
+      pulseBuf.clear();
+      return;
+    }
+    // continue playback from the pulse data at the current position
+    pulseData = &(pulseBuf.front());
+    pulseRunCnt = pulseBuf.size() >> 1;
+    findPulseRun_();
+  }
+
+  void Tape_SoundFile::closePulseData_(bool removeCacheFile_)
+  {
+    if (pulseDecoder) {
+      delete pulseDecoder;
+      pulseDecoder = (PulseDecoderThread_ *) 0;
+    }
+    if (pulseCacheMapping) {
+      unmapFile(pulseCacheMapping, pulseCacheMapSize);
+      pulseCacheMapping = (void *) 0;
+      pulseCacheMapSize = 0;
+    }
+    pulseData = (uint32_t *) 0;
+    pulseRunCnt = 0;
+    pulseRunIndex = 0;
+    pulseBuf.clear();
+    if (removeCacheFile_ && fileName.length() > 0) {
+      std::string cacheFileName(fileName);
+      cacheFileName += ".pulses";
+      fileRemove(cacheFileName.c_str());
+    }
+  }
+
+  void Tape_SoundFile::findPulseRun_()
+  {
+    // binary search for the last run starting at or before tapePosition
+    size_t  n1 = 0;
+    size_t  n2 = pulseRunCnt;
+    while ((n2 - n1) > 1) {
+      size_t  n = (n1 + n2) >> 1;
+      if (size_t(pulseData[n << 1]) <= tapePosition)
+        n1 = n;
+      else
+        n2 = n;
+    }
+    pulseRunIndex = n1;
   }
 
   void Tape_SoundFile::runOneSample_()
   {
+    if (!isRecordOn) {
+      if (!pulseDataChecked) {
+        startPulseDecoder_();
+      }
+      else if (pulseDecoder) {
+        if (--pulseDecoderPollCnt == 0)
+          checkPulseDecoder_();
+      }
+      if (pulseData) {
+        // play back decoded pulse data
+        const uint32_t  *p = pulseData + (pulseRunIndex << 1);
+        while ((pulseRunIndex + 1) < pulseRunCnt &&
+               tapePosition >= size_t(p[2])) {
+          pulseRunIndex++;
+          p = p + 2;
+        }
+        outputState = int(p[1]);
+        if (tapePosition < tapeLength)
+          tapePosition++;
+        return;
+      }
+    }
+    else if (!isFileChanged) {
+      // recording changes the sound file, so the pulse data and the cache
+      // file are no longer valid
+      bool    reloadFlag = (pulseData != (uint32_t *) 0);
+      closePulseData_(true);
+      pulseCacheHeader.clear();
+      pulseDataChecked = false;
+      isFileChanged = true;
+      if (reloadFlag)
+        reloadBuffer_();
+    }
     int   bufPos = (int(tapePosition & 0x03FF) * nChannels) + requestedChannel;
     int   tmp = buf[bufPos];
     if (isRecordOn) {
@@ -1830,13 +2776,9 @@ namespace Ep128Emu {
       buf[bufPos] = short(tmp2);
       isBufferDirty = true;
     }
-    if (enableFIRFilter) {
-      float tmp2 = firFilter.processSample(float(tmp));
-      tmp = int(tmp2 + (tmp2 >= 0.0f ? 0.5f : -0.5f));
-    }
-    tmp = tmp + 32768;
-    tmp = (tmp >= 0 ? (tmp <= 65535 ? tmp : 65535) : 0);
-    outputState = tmp >> (16 - requestedBitsPerSample);
+    outputState =
+        convertSample_(tmp, (enableFIRFilter ? &firFilter : (TapeFilter *) 0),
+                       requestedBitsPerSample);
 
     size_t  pos = tapePosition + 1;
     // unless recording, clamp position to tape length
@@ -1917,10 +2859,38 @@ namespace Ep128Emu {
          (requestedChannel_ < nChannels ? requestedChannel_ : (nChannels - 1))
          : 0);
     enableFIRFilter = enableFIRFilter_;
+    filterMinFreq = filterMinFreq_;
+    filterMaxFreq = filterMaxFreq_;
     if (enableFIRFilter) {
       firFilter.setFilterParameters(float(sampleRate),
                                     filterMinFreq_, filterMaxFreq_);
     }
+    if (pulseData) {
+      closePulseData_(false);
+      reloadBuffer_();
+    }
+    else {
+      // stop the decoder thread if it is still running
+      closePulseData_(false);
+    }
+    // the pulse data is loaded or decoded again on the next playback
+    pulseCacheHeader.clear();
+    pulseDataChecked = false;
+  }
+
+  void Tape_SoundFile::setPulseDecodingEnabled(bool isEnabled)
+  {
+    if (isEnabled == pulseDecodingEnabled)
+      return;
+    pulseDecodingEnabled = isEnabled;
+    if (pulseData) {
+      closePulseData_(false);
+      reloadBuffer_();
+    }
+    else {
+      closePulseData_(false);
+    }
+    pulseDataChecked = false;
   }
 
   // --------------------------------------------------------------------------
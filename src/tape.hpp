@@ -169,6 +169,15 @@ namespace Ep128Emu {
      * Delete all cue points. Has no effect if the file is read-only.
      */
     virtual void deleteAllCuePoints();
+    /*!
+     * If the tape is being played, and it is currently at the pilot tone
+     * of (or in the pause before) a standard speed ZX Spectrum data block,
+     * store the bytes of the block (including the flag and parity bytes)
+     * in 'buf', advance the tape position to the end of the block, and
+     * return true. Otherwise, the tape is not changed, and false is
+     * returned. This is used by the fast tape loading ROM traps.
+     */
+    virtual bool readDataBlock(std::vector< uint8_t >& buf);
   };
 
   class Tape_Ep128Emu : public Tape {
@@ -270,6 +279,31 @@ namespace Ep128Emu {
     size_t    leaderSampleCnt;
     size_t    chunkBytesRemaining;
     size_t    chunkCnt;
+    struct IndexEntry {
+      long      filePos;
+      size_t    tapePosition;
+      int       outputState;
+      size_t    bytesRemaining;
+      bool      endOfTape;
+      uint8_t   shiftReg;
+      uint8_t   bitsRemaining;
+      uint8_t   halfPeriodSamples;
+      size_t    samplesRemaining;
+      size_t    leaderSampleCnt;
+      size_t    chunkBytesRemaining;
+      size_t    chunkCnt;
+    };
+    // tape state saved at regular intervals, sorted by tape position
+    std::vector< IndexEntry >   tapeIndex;
+    // start positions of the leader of each chunk
+    std::vector< size_t >       chunkStartPositions;
+    size_t    indexedTapeLength;
+    // ----------------
+    void rewind_();
+    void saveState_(IndexEntry& e);
+    void restoreState_(const IndexEntry& e);
+    void buildIndex_();
+    void seek_(size_t pos_);
    public:
     /*!
      * Open EPTE format tape file 'fileName' read-only.
@@ -345,6 +379,41 @@ namespace Ep128Emu {
     size_t    loopStartTime;
     uint16_t  loopRepeatCnt;
     bool      isTAPFile;
+    struct IndexEntry {
+      long      filePos;
+      size_t    tapePosition;
+      int       outputState;
+      uint8_t   currentBlockType;
+      uint8_t   currentMode;
+      bool      endOfTape;
+      uint8_t   shiftReg;
+      uint32_t  pulseTimer;
+      uint32_t  pulseLength;
+      uint32_t  pulseCnt;
+      uint16_t  pilotPulseLength;
+      uint16_t  syncPulseLength1;
+      uint16_t  syncPulseLength2;
+      uint16_t  bit0PulseLength;
+      uint16_t  bit1PulseLength;
+      uint8_t   bit0PulseCnt;
+      uint8_t   bit1PulseCnt;
+      uint16_t  pilotPulseCnt;
+      uint8_t   lastByteBits;
+      uint8_t   pulseSequencePulsesLeft;
+      uint32_t  pauseLength;
+      uint32_t  clockFrequency;
+      uint32_t  dataBlockBytesLeft;
+      uint32_t  directRecordingSampleRate;
+      uint32_t  directRecordingTimer;
+      uint32_t  loopFilePos;
+      size_t    loopStartTime;
+      uint16_t  loopRepeatCnt;
+    };
+    // tape state saved at regular intervals, sorted by tape position
+    std::vector< IndexEntry >   tapeIndex;
+    // start positions of the pilot tone of each data block
+    std::vector< size_t >       blockStartPositions;
+    size_t    indexedTapeLength;
    public:
     /*!
      * Open TZX or Spectrum TAP format tape file 'fileName' read-only.
@@ -365,6 +434,13 @@ namespace Ep128Emu {
     void readNextTZXBlock();
     void directRecordingNextBit();
     void dataBlockNextBit();
+    bool findStandardDataBlock(uint32_t& nBytes, uint32_t& pauseLength_);
+    void nextPulse();
+    void rewind_();
+    void saveState_(IndexEntry& e);
+    void restoreState_(const IndexEntry& e);
+    void buildIndex_();
+    void seek_(size_t pos_);
     virtual void runOneSample_();
    public:
     /*!
@@ -399,6 +475,10 @@ namespace Ep128Emu {
      * Delete all cue points. Has no effect if the file is read-only.
      */
     virtual void deleteAllCuePoints();
+    /*!
+     * Read the next standard speed data block (see Tape::readDataBlock()).
+     */
+    virtual bool readDataBlock(std::vector< uint8_t >& buf);
   };
 
   class Tape_SoundFile : public Tape {
@@ -425,10 +505,45 @@ namespace Ep128Emu {
     bool        isBufferDirty;  // true if 'buf' has been changed,
                                 // and not written to file yet
     TapeFilter  firFilter;
+    float       filterMinFreq;
+    float       filterMaxFreq;
+    std::string fileName;
+    // decoded signal for playback, stored as pairs of run start position
+    // (in samples) and output level; points either to the memory mapped
+    // pulse cache file, or to 'pulseBuf' after the decoder thread has
+    // finished, and is NULL while the signal is decoded directly from 'buf'
+    const uint32_t  *pulseData;
+    size_t      pulseRunCnt;
+    size_t      pulseRunIndex;
+    std::vector< uint32_t > pulseBuf;
+    void        *pulseCacheMapping;
+    size_t      pulseCacheMapSize;
+    // header of the pulse cache file for the current parameters and sound
+    // file size and modification time, empty if not known
+    std::vector< uint32_t > pulseCacheHeader;
+    // true if sample data has been recorded since the last header update
+    bool        isFileChanged;
+    class PulseDecoderThread_;
+    // decodes the whole sound file to pulse data in the background
+    PulseDecoderThread_ *pulseDecoder;
+    // samples until checking if the decoder thread has finished
+    size_t      pulseDecoderPollCnt;
+    // false if the decoder needs to be started on the next playback
+    bool        pulseDataChecked;
+    bool        pulseDecodingEnabled;
     // ----------------
     void seek_(size_t pos_);
     bool writeBuffer_();
     void flushBuffer_();
+    void reloadBuffer_();
+    static int convertSample_(int n, TapeFilter *filter_, int bitsPerSample);
+    bool getPulseCacheHeader_(uint32_t *hdr) const;
+    bool openPulseCache_();
+    void updatePulseCache_();
+    void startPulseDecoder_();
+    void checkPulseDecoder_();
+    void closePulseData_(bool removeCacheFile_);
+    void findPulseRun_();
    public:
     /*!
      * Open tape file 'fileName'.
@@ -479,9 +594,24 @@ namespace Ep128Emu {
     virtual void deleteAllCuePoints();
     /*!
      * Set parameters for sound file reading.
+     * On the first playback with a new set of parameters, the sound file
+     * is decoded to a run-length pulse stream by a background thread. Once
+     * that is finished, the pulse stream is used instead of filtering the
+     * audio data on every sample. The pulse stream is cached in a file
+     * named like the tape file with a ".pulses" suffix, and memory mapped
+     * if it is still valid (same sound file size, modification time, and
+     * parameters) the next time the tape is played. Recording to the tape
+     * invalidates and removes the cache.
      */
     void setParameters(int requestedChannel_, bool enableFIRFilter_,
                        float filterMinFreq_, float filterMaxFreq_);
+    /*!
+     * Enable or disable decoding the sound file to a pulse stream in the
+     * background (enabled by default). Programs that read the tape only
+     * once from start to end should disable it. A valid pulse cache file
+     * is still used if decoding is disabled.
+     */
+    void setPulseDecodingEnabled(bool isEnabled);
   };
 
   /*!
@@ -0,0 +1,180 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "system.hpp"
+#include "trace.hpp"
+
+namespace Ep128Emu {
+
+  TraceRecorder::TraceRecorder(std::FILE *f_, uint32_t clockFreq_,
+                               uint8_t flags_)
+    : Thread(),
+      f(f_),
+      buf((uint8_t *) 0),
+      curRecord((uint8_t *) 0),
+      curBlockEnd((uint8_t *) 0),
+      curBlock(0),
+      timeCnt(0U),
+      recordCnt(0U),
+      traceFlags(flags_ & (traceMemoryAccesses | traceIOAccesses)),
+      writeError(false),
+      exitFlag(false),
+      fullBlockReadPos(0),
+      fullBlockCnt(0),
+      freeBlockCnt(0)
+  {
+    if (!f)
+      throw Exception("TraceRecorder: invalid file pointer");
+    try {
+      buf = new uint8_t[blockCnt * blockRecords * recordSize];
+    }
+    catch (...) {
+      std::fclose(f);
+      f = (std::FILE *) 0;
+      throw;
+    }
+    uint8_t tmpBuf[headerSize];
+    const char  *magic = "EPTRACE";
+    for (size_t i = 0; i < 8; i++)
+      tmpBuf[i] = uint8_t(magic[i]);
+    for (size_t i = 0; i < 4; i++) {
+      tmpBuf[i + 8] = uint8_t((formatVersion >> (i * 8)) & 0xFFU);
+      tmpBuf[i + 12] = uint8_t((clockFreq_ >> (i * 8)) & 0xFFU);
+    }
+    if (std::fwrite(&(tmpBuf[0]), 1, headerSize, f) != headerSize) {
+      std::fclose(f);
+      f = (std::FILE *) 0;
+      delete[] buf;
+      buf = (uint8_t *) 0;
+      throw Exception("error writing trace file - is the disk full ?");
+    }
+    for (size_t i = 0; i < blockCnt; i++) {
+      fullBlocks[i] = 0;
+      fullBlockBytes[i] = 0;
+      freeBlocks[i] = 0;
+    }
+    // block 0 is used first, the others are free
+    for (size_t i = blockCnt - 1; i > 0; i--)
+      freeBlocks[freeBlockCnt++] = i;
+    curRecord = buf;
+    curBlockEnd = buf + (blockRecords * recordSize);
+    this->start();
+  }
+
+  TraceRecorder::~TraceRecorder()
+  {
+    flushBlock_(false);
+    mutex.lock();
+    exitFlag = true;
+    mutex.unlock();
+    fullBlockLock.notify();
+    this->join();
+    if (f) {
+      std::fclose(f);
+      f = (std::FILE *) 0;
+    }
+    if (buf) {
+      delete[] buf;
+      buf = (uint8_t *) 0;
+    }
+  }
+
+  void TraceRecorder::flushBlock_(bool getNewBlock)
+  {
+    uint8_t *blockStart = buf + (curBlock * (blockRecords * recordSize));
+    size_t  nBytes = size_t(curRecord - blockStart);
+    mutex.lock();
+    if (nBytes > 0) {
+      size_t  n = (fullBlockReadPos + fullBlockCnt) % blockCnt;
+      fullBlocks[n] = curBlock;
+      fullBlockBytes[n] = nBytes;
+      fullBlockCnt++;
+    }
+    else {
+      freeBlocks[freeBlockCnt++] = curBlock;
+    }
+    if (!getNewBlock) {
+      mutex.unlock();
+      fullBlockLock.notify();
+      curRecord = blockStart;
+      curBlockEnd = blockStart;
+      return;
+    }
+    while (freeBlockCnt < 1) {
+      // the writer thread is behind, wait until it releases a block
+      mutex.unlock();
+      fullBlockLock.notify();
+      freeBlockLock.wait(10);
+      mutex.lock();
+    }
+    curBlock = freeBlocks[--freeBlockCnt];
+    mutex.unlock();
+    fullBlockLock.notify();
+    curRecord = buf + (curBlock * (blockRecords * recordSize));
+    curBlockEnd = curRecord + (blockRecords * recordSize);
+  }
+
+  void TraceRecorder::run()
+  {
+    while (true) {
+      mutex.lock();
+      if (fullBlockCnt < 1) {
+        bool    doneFlag = exitFlag;
+        mutex.unlock();
+        if (doneFlag)
+          break;
+        fullBlockLock.wait(100);
+        continue;
+      }
+      size_t  n = fullBlocks[fullBlockReadPos];
+      size_t  nBytes = fullBlockBytes[fullBlockReadPos];
+      fullBlockReadPos = (fullBlockReadPos + 1) % blockCnt;
+      fullBlockCnt--;
+      mutex.unlock();
+      if (!writeError) {
+        // records are discarded after the first error
+        if (std::fwrite(buf + (n * (blockRecords * recordSize)), 1, nBytes, f)
+            != nBytes) {
+          mutex.lock();
+          writeError = true;
+          mutex.unlock();
+        }
+      }
+      mutex.lock();
+      freeBlocks[freeBlockCnt++] = n;
+      mutex.unlock();
+      freeBlockLock.notify();
+    }
+    if (std::fflush(f) != 0) {
+      mutex.lock();
+      writeError = true;
+      mutex.unlock();
+    }
+  }
+
+  bool TraceRecorder::getWriteError()
+  {
+    mutex.lock();
+    bool    retval = writeError;
+    mutex.unlock();
+    return retval;
+  }
+
+}       // namespace Ep128Emu
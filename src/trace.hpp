@@ -0,0 +1,181 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_TRACE_HPP
+#define EP128EMU_TRACE_HPP
+
+#include "ep128emu.hpp"
+#include "system.hpp"
+
+namespace Ep128Emu {
+
+  // Binary execution trace file format (all values are little endian):
+  //   uint8_t    magic[8]    "EPTRACE\0"
+  //   uint32_t   version     currently 1
+  //   uint32_t   clockFreq   frequency of the time stamps in Hz
+  // followed by any number of 16 byte records:
+  //   uint8_t    type        0: instruction, 1: memory read,
+  //                          2: memory write, 3: I/O read, 4: I/O write
+  //   uint8_t    segment     memory segment (0 for I/O records)
+  //   uint16_t   addr        CPU address or I/O port
+  //   uint8_t    data[4]     instruction: opcode bytes,
+  //                          otherwise: data[0] = value, data[1..3] = 0
+  //   uint64_t   time        time stamp in 'clockFreq' units
+
+  class TraceRecorder : public Thread {
+   public:
+    static const size_t   headerSize = 16;
+    static const size_t   recordSize = 16;
+    static const uint32_t formatVersion = 1U;
+    static const uint8_t  recordTypeInstruction = 0;
+    static const uint8_t  recordTypeMemoryRead = 1;
+    static const uint8_t  recordTypeMemoryWrite = 2;
+    static const uint8_t  recordTypeIORead = 3;
+    static const uint8_t  recordTypeIOWrite = 4;
+    // flags for the constructor
+    static const uint8_t  traceMemoryAccesses = 0x01;
+    static const uint8_t  traceIOAccesses = 0x02;
+   private:
+    static const size_t   blockRecords = 4096;
+    static const size_t   blockCnt = 16;
+    std::FILE   *f;
+    uint8_t     *buf;                   // blockCnt * blockRecords records
+    uint8_t     *curRecord;             // write position in the current block
+    uint8_t     *curBlockEnd;
+    size_t      curBlock;
+    uint64_t    timeCnt;
+    uint64_t    recordCnt;
+    uint8_t     traceFlags;
+    bool        writeError;
+    bool        exitFlag;
+    // blocks waiting to be written by the thread, and free blocks that
+    // can be filled by the emulation; only accessed with 'mutex' locked
+    size_t      fullBlocks[blockCnt];
+    size_t      fullBlockBytes[blockCnt];
+    size_t      fullBlockReadPos;
+    size_t      fullBlockCnt;
+    size_t      freeBlocks[blockCnt];
+    size_t      freeBlockCnt;
+    Mutex       mutex;
+    ThreadLock  fullBlockLock;          // signaled when a block is queued
+    ThreadLock  freeBlockLock;          // signaled when a block is released
+    // ----------------
+    void flushBlock_(bool getNewBlock);
+    EP128EMU_INLINE uint8_t *allocRecord_()
+    {
+      if (EP128EMU_UNLIKELY(curRecord >= curBlockEnd))
+        flushBlock_(true);
+      uint8_t *p = curRecord;
+      curRecord = curRecord + recordSize;
+      recordCnt++;
+      return p;
+    }
+    EP128EMU_INLINE void storeTime_(uint8_t *p)
+    {
+      uint64_t  t = timeCnt;
+      for (int i = 8; i < 16; i++) {
+        p[i] = uint8_t(t & 0xFFU);
+        t = t >> 8;
+      }
+    }
+   protected:
+    virtual void run();
+   public:
+    /*!
+     * Create trace recorder writing to 'f', which must be a file opened
+     * for writing in binary mode. The file is closed by the destructor.
+     * 'clockFreq_' is the frequency (in Hz) at which advanceTime() is
+     * called, and 'flags_' can be any combination of traceMemoryAccesses
+     * and traceIOAccesses.
+     */
+    TraceRecorder(std::FILE *f_, uint32_t clockFreq_, uint8_t flags_ = 0);
+    /*!
+     * Write any remaining records, stop the writer thread, and close
+     * the file.
+     */
+    virtual ~TraceRecorder();
+    EP128EMU_INLINE void advanceTime()
+    {
+      timeCnt++;
+    }
+    /*!
+     * Record the execution of an instruction at 'addr'. 'opcode' contains
+     * the first four bytes of the instruction, starting from the LSB.
+     */
+    EP128EMU_INLINE void addInstruction(uint16_t addr, uint8_t segment,
+                                        uint32_t opcode)
+    {
+      uint8_t *p = allocRecord_();
+      p[0] = recordTypeInstruction;
+      p[1] = segment;
+      p[2] = uint8_t(addr & 0xFF);
+      p[3] = uint8_t(addr >> 8);
+      p[4] = uint8_t(opcode & 0xFFU);
+      p[5] = uint8_t((opcode >> 8) & 0xFFU);
+      p[6] = uint8_t((opcode >> 16) & 0xFFU);
+      p[7] = uint8_t(opcode >> 24);
+      storeTime_(p);
+    }
+    /*!
+     * Record a memory (if enabled with traceMemoryAccesses) or I/O (if
+     * enabled with traceIOAccesses) access of type 'type_'.
+     */
+    EP128EMU_INLINE void addAccess(uint8_t type_, uint16_t addr,
+                                   uint8_t segment, uint8_t value)
+    {
+      if (!(traceFlags & (type_ < recordTypeIORead ?
+                          traceMemoryAccesses : traceIOAccesses))) {
+        return;
+      }
+      uint8_t *p = allocRecord_();
+      p[0] = type_;
+      p[1] = segment;
+      p[2] = uint8_t(addr & 0xFF);
+      p[3] = uint8_t(addr >> 8);
+      p[4] = value;
+      p[5] = 0;
+      p[6] = 0;
+      p[7] = 0;
+      storeTime_(p);
+    }
+    inline bool getTraceMemoryAccesses() const
+    {
+      return bool(traceFlags & traceMemoryAccesses);
+    }
+    inline bool getTraceIOAccesses() const
+    {
+      return bool(traceFlags & traceIOAccesses);
+    }
+    /*!
+     * Returns the number of records traced so far.
+     */
+    inline uint64_t getRecordCount() const
+    {
+      return recordCnt;
+    }
+    /*!
+     * Returns true if there was an error writing the file; in this case,
+     * all further records are discarded.
+     */
+    bool getWriteError();
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_TRACE_HPP
@@ -29,6 +29,7 @@
 #include "tvc64vm.hpp"
 #include "debuglib.hpp"
 #include "videorec.hpp"
+#include "profiler.hpp"
 #ifdef ENABLE_SDEXT
 #  include "sdext.hpp"
 #endif
@@ -229,6 +230,8 @@ namespace TVC64 {
   EP128EMU_REGPARM1 uint8_t TVC64VM::Z80_::readOpcodeFirstByte()
   {
     uint16_t  addr = uint16_t(R.PC.W.l);
+    if (EP128EMU_UNLIKELY(vm.profilerRunning))
+      vm.profileInstruction(addr);
     vm.memoryWaitM1(addr);
     if (!vm.singleStepMode) {
       uint8_t   retval = vm.memory.readOpcode(addr);
@@ -315,6 +318,8 @@ namespace TVC64 {
   EP128EMU_REGPARM3 void TVC64VM::Z80_::doOut(uint16_t addr, uint8_t value)
   {
     vm.ioPortWait(addr);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 6, addr, value);
     vm.ioPorts.write(addr, value);
     vm.updateCPUHalfCycles(1);
   }
@@ -324,6 +329,8 @@ namespace TVC64 {
     vm.ioPortWait(addr);
     uint8_t   retval = vm.ioPorts.read(addr);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 5, addr, retval);
     return retval;
   }
 
@@ -548,7 +555,7 @@ namespace TVC64 {
       int     bpType = int(isWrite) + 1;
       if (!isWrite && uint16_t(vm.z80.getReg().PC.W.l) == addr)
         bpType = 0;
-      vm.breakPointCallback(vm.breakPointCallbackUserData, bpType, addr, value);
+      vm.runBreakPointCallback(bpType, addr, value);
     }
   }
 
@@ -609,8 +616,7 @@ namespace TVC64 {
                                              uint16_t addr, uint8_t value)
   {
     if (!vm.memory.checkIgnoreBreakPoint(vm.z80.getReg().PC.W.l)) {
-      vm.breakPointCallback(vm.breakPointCallbackUserData,
-                            int(isWrite) + 5, addr, value);
+      vm.runBreakPointCallback(int(isWrite) + 5, addr, value);
     }
   }
 
@@ -643,6 +649,8 @@ namespace TVC64 {
       vm.display.vsyncStateChange(newState, currentSlot_);
     if (vm.videoCapture)
       vm.videoCapture->vsyncStateChange(newState, currentSlot_);
+    if (newState)
+      vm.runFrameHook();
   }
 
   // --------------------------------------------------------------------------
@@ -1112,6 +1120,15 @@ namespace TVC64 {
     vm.demoTimeCnt++;
   }
 
+  void TVC64VM::profileInstruction(uint16_t addr)
+  {
+    // z80HalfCycleCnt wraps around at 256, but no instruction is that long
+    profiler->addInstruction((uint32_t(memory.getPage(uint8_t(addr >> 14)))
+                              << 14) | uint32_t(addr & 0x3FFF),
+                             addr, uint16_t(z80.getReg().SP.W),
+                             uint32_t(z80HalfCycleCnt));
+  }
+
   void TVC64VM::videoCaptureCallback(void *userData)
   {
     TVC64VM&  vm = *(reinterpret_cast<TVC64VM *>(userData));
@@ -1556,6 +1573,7 @@ namespace TVC64 {
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
     vmStatus_.tapeSampleSize = getTapeSampleSize();
+    vmStatus_.tapeMotorOn = getIsTapeRunning();
     uint32_t  n = 0U;
     for (int i = 3; i >= 0; i--) {
       n = n << 8;
@@ -1573,16 +1591,31 @@ namespace TVC64 {
 
   void TVC64VM::openVideoCapture(
       int frameRate_,
-      bool yuvFormat_,
+      int videoFormat_,
+      int frameHashInterval_,
+      bool frameHashPNG_,
       void (*errorCallback_)(void *userData, const char *msg),
       void (*fileNameCallback_)(void *userData, std::string& fileName),
       void *userData_)
   {
     if (!videoCapture) {
-      if (yuvFormat_) {
+      if (videoFormat_ == 1) {
         videoCapture = new Ep128Emu::VideoCapture_YV12(
                                &TVCVideo::convertPixelToRGB, frameRate_);
       }
+      else if (videoFormat_ == 2) {
+        videoCapture = new Ep128Emu::VideoCapture_ZMBV(
+                               &TVCVideo::convertPixelToRGB, frameRate_);
+      }
+      else if (videoFormat_ == 3) {
+        videoCapture = new Ep128Emu::VideoCapture_Y4M(
+                               &TVCVideo::convertPixelToRGB, frameRate_);
+      }
+      else if (videoFormat_ == 4) {
+        videoCapture = new Ep128Emu::VideoCapture_FrameHash(
+                               &TVCVideo::convertPixelToRGB, frameRate_,
+                               frameHashInterval_, frameHashPNG_);
+      }
       else {
         videoCapture = new Ep128Emu::VideoCapture_RLE8(
                                &TVCVideo::convertPixelToRGB, frameRate_);
@@ -1688,6 +1721,7 @@ namespace TVC64 {
 
   void TVC64VM::setBreakPoint(const Ep128Emu::BreakPoint& bp, bool isEnabled)
   {
+    setBreakPointCondition(bp, isEnabled);
     if (EP128EMU_UNLIKELY(!isEnabled)) {
       if (bp.isIO()) {
         ioPorts.setBreakPoint(bp.addr(), 0, false, false);
@@ -1720,10 +1754,22 @@ namespace TVC64 {
 
   void TVC64VM::clearBreakPoints()
   {
+    clearBreakPointConditions();
     memory.clearAllBreakPoints();
     ioPorts.clearBreakPoints();
   }
 
+  void TVC64VM::startProfiler(bool callStackEnabled)
+  {
+    stopProfiler();
+    if (profiler) {
+      delete profiler;
+      profiler = (Ep128Emu::Profiler *) 0;
+    }
+    profiler = new Ep128Emu::Profiler(*this, 0x000000FFU, callStackEnabled);
+    profilerRunning = true;
+  }
+
   void TVC64VM::setBreakPointPriorityThreshold(int n)
   {
     breakPointPriorityThreshold = uint8_t(n > 0 ? (n < 4 ? n : 4) : 0);
@@ -1944,7 +1990,7 @@ namespace TVC64 {
                                            int32_t offs) const
   {
     return Ep128::Z80Disassembler::disassembleInstruction(
-               buf, (*this), addr, isCPUAddress, offs);
+               buf, (*this), addr, isCPUAddress, offs, &getSymbolTable());
   }
 
   void TVC64VM::getVideoPosition(int& xPos, int& yPos) const
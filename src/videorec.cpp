@@ -22,11 +22,25 @@
 #include "snd_conv.hpp"
 #include "videorec.hpp"
 #include "system.hpp"
+#include "pngwrite.hpp"
+
+#include <zlib.h>
 
 #include <cmath>
 
-static const size_t aviHeaderSize_RLE8 = 0x0546;
-static const size_t aviHeaderSize_YV12 = 0x0146;
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) && \
+    !(defined(__clang__) || defined(__ICC)) && \
+    ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// SSE2 and AVX2 versions of the YV12 frame resampling functions are
+// compiled with target attributes, and selected at run time
+#  define EP128EMU_YV12_SIMD 1
+#  include <immintrin.h>
+#endif
+
+#ifndef WIN32
+#  include <pthread.h>
+#  include <signal.h>
+#endif
 
 namespace Ep128Emu {
 
@@ -48,20 +62,43 @@ namespace Ep128Emu {
 
   void VideoCapture::AudioConverter_::audioOutput(int16_t left, int16_t right)
   {
+    // store the samples in the current queue entry, they are copied to
+    // audioBuf on the encoder thread
     const int   totalBufSize =
         videoCapture.audioBufSize * videoCapture.audioBuffers * 2;
-    if (videoCapture.audioBufSamples < totalBufSize) {
-      videoCapture.audioBuf[videoCapture.audioBufWritePos++] = left;
-      if (videoCapture.audioBufWritePos >= totalBufSize)
-        videoCapture.audioBufWritePos = 0;
-      videoCapture.audioBufSamples++;
-    }
-    if (videoCapture.audioBufSamples < totalBufSize) {
-      videoCapture.audioBuf[videoCapture.audioBufWritePos++] = right;
-      if (videoCapture.audioBufWritePos >= totalBufSize)
-        videoCapture.audioBufWritePos = 0;
-      videoCapture.audioBufSamples++;
-    }
+    int&    nSamples =
+        videoCapture.queueAudioSamples[videoCapture.queueWritePos];
+    int16_t *bufp = &(videoCapture.queueAudioBuf[videoCapture.queueWritePos
+                                                 * totalBufSize]);
+    if (nSamples < totalBufSize)
+      bufp[nSamples++] = left;
+    if (nSamples < totalBufSize)
+      bufp[nSamples++] = right;
+  }
+
+  // --------------------------------------------------------------------------
+
+  VideoCapture::EncoderThread::EncoderThread(VideoCapture& videoCapture_)
+    : Thread(),
+      videoCapture(videoCapture_)
+  {
+  }
+
+  VideoCapture::EncoderThread::~EncoderThread()
+  {
+  }
+
+  void VideoCapture::EncoderThread::run()
+  {
+#ifndef WIN32
+    // writing to a pipe of which the reader has exited should only be an
+    // error, instead of terminating the emulator
+    sigset_t  sigMask;
+    sigemptyset(&sigMask);
+    sigaddset(&sigMask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigMask, (sigset_t *) 0);
+#endif
+    videoCapture.runEncoder();
   }
 
   // --------------------------------------------------------------------------
@@ -124,11 +161,39 @@ namespace Ep128Emu {
       fileSize(0),
       audioConverter((AudioConverter *) 0),
       aviHeaderSize(0),
+      aviIndexBuf((AVIIndexEntry *) 0),
+      aviIndexFrames(0),
+      aviSuperIndex((AVISuperIndexEntry *) 0),
+      aviSuperIndexEntries(0),
+      riffCnt(0),
+      riffStartPos(0),
+      riff0EndPos(0),
+      riff0MoviEndPos(0),
+      riff0Frames(0),
       errorCallback(&defaultErrorCallback),
       errorCallbackUserData((void *) this),
       fileNameCallback(&defaultFileNameCallback),
-      fileNameCallbackUserData((void *) this)
+      fileNameCallbackUserData((void *) this),
+      queueAudioBuf((int16_t *) 0),
+      queueReadPos(0),
+      queueWritePos(0),
+      queueFrames(0),
+      encoderFileFull(false),
+      encoderErrorMessage(""),
+      errorMessageBuf(""),
+      framesDelayed(0),
+      encoderWaitTime(0.0),
+      encoderWarningFlag(false),
+      encoderExitFlag(false),
+      encoderThread((EncoderThread *) 0)
   {
+    aviVideoFormat.width = 0;
+    aviVideoFormat.height = 0;
+    aviVideoFormat.codec = "\0\0\0\0";
+    aviVideoFormat.bitsPerPixel = 0;
+    aviVideoFormat.imageSize = 0;
+    aviVideoFormat.maxFrameSize = 0;
+    aviVideoFormat.palette = (uint8_t *) 0;
     try {
       frameRate = (frameRate > 24 ? (frameRate < 60 ? frameRate : 60) : 24);
       while (((sampleRate / frameRate) * frameRate) != sampleRate)
@@ -137,12 +202,26 @@ namespace Ep128Emu {
       audioBuf = new int16_t[audioBufSize * audioBuffers * 2];
       for (int i = 0; i < (audioBufSize * audioBuffers * 2); i++)
         audioBuf[i] = int16_t(0);
+      queueAudioBuf =
+          new int16_t[audioBufSize * audioBuffers * 2 * encoderQueueSize];
+      for (int i = 0; i < encoderQueueSize; i++)
+        queueAudioSamples[i] = 0;
+      aviIndexBuf = new AVIIndexEntry[aviIndexChunkFrames];
+      aviSuperIndex = new AVISuperIndexEntry[aviSuperIndexSize];
       audioConverter =
           new AudioConverter_(*this, 222656.25f, float(sampleRate));
+      encoderThread = new EncoderThread(*this);
+      encoderThread->start();
     }
     catch (...) {
       if (audioBuf)
         delete[] audioBuf;
+      if (queueAudioBuf)
+        delete[] queueAudioBuf;
+      if (aviIndexBuf)
+        delete[] aviIndexBuf;
+      if (aviSuperIndex)
+        delete[] aviSuperIndex;
       if (audioConverter)
         delete audioConverter;
       throw;
@@ -151,7 +230,17 @@ namespace Ep128Emu {
 
   VideoCapture::~VideoCapture()
   {
+    // the derived classes have already called closeFile(), so the queue is
+    // empty, and the encoder thread only needs to be stopped
+    queueMutex.lock();
+    encoderExitFlag = true;
+    queueMutex.unlock();
+    frameQueuedLock.notify();
+    delete encoderThread;
     delete[] audioBuf;
+    delete[] queueAudioBuf;
+    delete[] aviIndexBuf;
+    delete[] aviSuperIndex;
     delete audioConverter;
   }
 
@@ -165,570 +254,301 @@ namespace Ep128Emu {
     }
   }
 
-  void VideoCapture::openFile(const char *fileName)
+  void VideoCapture::queueFrame()
   {
-    closeFile();
-    if (fileName == (char *) 0 || fileName[0] == '\0')
-      return;
-    aviFile = fileOpen(fileName, "wb");
-    if (!aviFile)
-      throw Exception("error opening AVI file");
-    framesWritten = 0;
-    duplicateFrames = 0;
-    fileSize = aviHeaderSize;
-    writeAVIHeader();
+    queueMutex.lock();
+    queueFrames++;
+    bool    queueFull = (queueFrames >= encoderQueueSize);
+    queueMutex.unlock();
+    frameQueuedLock.notify();
+    if (++queueWritePos >= encoderQueueSize)
+      queueWritePos = 0;
+    if (queueFull) {
+      // the encoder thread is falling behind, need to wait until the next
+      // queue entry is free
+      Timer   waitTimer;
+      do {
+        frameEncodedLock.wait();
+        queueMutex.lock();
+        queueFull = (queueFrames >= encoderQueueSize);
+        queueMutex.unlock();
+      } while (queueFull);
+      framesDelayed++;
+      encoderWaitTime += waitTimer.getRealTime();
+    }
+    queueAudioSamples[queueWritePos] = 0;
   }
 
-  void VideoCapture::closeFile()
+  void VideoCapture::updateEncoderStatus()
   {
-    if (aviFile) {
-      // FIXME: file I/O errors are ignored here
+    queueMutex.lock();
+    errorMessageBuf = encoderErrorMessage;
+    encoderErrorMessage.clear();
+    bool    fileFull = encoderFileFull;
+    queueMutex.unlock();
+    if (errorMessageBuf.length() > 0)
+      errorMessage(errorMessageBuf.c_str());
+    if (!encoderWarningFlag && encoderWaitTime >= 1.0) {
+      encoderWarningFlag = true;
+      char    tmpBuf[128];
+      std::sprintf(&(tmpBuf[0]),
+                   "video capture encoder is too slow, emulation was delayed "
+                   "by %.1f seconds in %lu frames",
+                   encoderWaitTime, (unsigned long) framesDelayed);
+      errorMessageBuf = &(tmpBuf[0]);
       try {
-        writeAVIHeader();
-        writeAVIIndex();
+        errorMessage(errorMessageBuf.c_str());
       }
       catch (...) {
       }
-      if (aviFile)
-        std::fclose(aviFile);
-      aviFile = (std::FILE *) 0;
-      framesWritten = 0;
-      duplicateFrames = 0;
-      fileSize = 0;
-    }
-  }
-
-  void VideoCapture::errorMessage(const char *msg)
-  {
-    if (msg == (char *) 0 || msg[0] == '\0')
-      msg = "unknown video capture error";
-    errorCallback(errorCallbackUserData, msg);
-  }
-
-  void VideoCapture::setErrorCallback(void (*func)(void *userData,
-                                                   const char *msg),
-                                      void *userData_)
-  {
-    if (func) {
-      errorCallback = func;
-      errorCallbackUserData = userData_;
     }
-    else {
-      errorCallback = &defaultErrorCallback;
-      errorCallbackUserData = (void *) this;
+    // the index is checked with a delay of up to 'encoderQueueSize' frames,
+    // but the limit leaves enough space for that
+    if (fileFull) {
+      flushEncoderQueue();
+      closeFile_();
+      try {
+        errorMessage("AVI file index is full, starting new output file");
+      }
+      catch (...) {
+      }
+      std::string fileName = "";
+      fileNameCallback(fileNameCallbackUserData, fileName);
+      if (fileName.length() < 1)
+        return;
+      try {
+        openFile_(fileName.c_str());
+      }
+      catch (std::exception& e) {
+        closeFile_();
+        errorMessageBuf = e.what();
+        errorMessage(errorMessageBuf.c_str());
+      }
     }
   }
 
-  void VideoCapture::setFileNameCallback(void (*func)(void *userData,
-                                                      std::string& fileName),
-                                         void *userData_)
+  void VideoCapture::flushEncoderQueue()
   {
-    if (func) {
-      fileNameCallback = func;
-      fileNameCallbackUserData = userData_;
-    }
-    else {
-      fileNameCallback = &defaultFileNameCallback;
-      fileNameCallbackUserData = (void *) this;
+    while (true) {
+      queueMutex.lock();
+      bool    queueEmpty = (queueFrames < 1);
+      queueMutex.unlock();
+      if (queueEmpty)
+        break;
+      frameEncodedLock.wait();
     }
   }
 
-  // --------------------------------------------------------------------------
-
-  VideoCapture_RLE8::VideoCaptureFrameBuffer::VideoCaptureFrameBuffer(int w,
-                                                                      int h)
-    : buf((uint32_t *) 0),
-      linePtrs((uint8_t **) 0),
-      lineBytes_((uint32_t *) 0)
+  void VideoCapture::runEncoder()
   {
-    try {
-      size_t  nBytes = (((((size_t(w) * 17) + 15) >> 4) + 3) >> 2) << 2;
-      buf = new uint32_t[(nBytes >> 2) * size_t(h)];
-      std::memset(buf, 0x00, nBytes * size_t(h));
-      linePtrs = new uint8_t*[h];
-      uint8_t *p = reinterpret_cast<uint8_t *>(buf);
-      for (int i = 0; i < h; i++) {
-        linePtrs[i] = p;
-        p = p + nBytes;
+    const int   totalBufSize = audioBufSize * audioBuffers * 2;
+    while (true) {
+      queueMutex.lock();
+      bool    queueEmpty = (queueFrames < 1);
+      bool    exitFlag = encoderExitFlag;
+      queueMutex.unlock();
+      if (queueEmpty) {
+        if (exitFlag)
+          break;
+        frameQueuedLock.wait();
+        continue;
       }
-      lineBytes_ = new uint32_t[h];
-      for (int i = 0; i < h; i++)
-        lineBytes_[i] = 0U;
-    }
-    catch (...) {
-      if (buf)
-        delete[] buf;
-      if (linePtrs)
-        delete[] linePtrs;
-      if (lineBytes_)
-        delete[] lineBytes_;
-      throw;
+      // copy the audio output of the frame to audioBuf
+      const int16_t *bufp = &(queueAudioBuf[queueReadPos * totalBufSize]);
+      for (int i = 0; i < queueAudioSamples[queueReadPos]; i++) {
+        if (audioBufSamples >= totalBufSize)
+          break;
+        audioBuf[audioBufWritePos++] = bufp[i];
+        if (audioBufWritePos >= totalBufSize)
+          audioBufWritePos = 0;
+        audioBufSamples++;
+      }
+      try {
+        encodeFrame(queueReadPos);
+      }
+      catch (std::exception& e) {
+        encoderError(e.what());
+      }
+      if (++queueReadPos >= encoderQueueSize)
+        queueReadPos = 0;
+      queueMutex.lock();
+      queueFrames--;
+      encoderFileFull =
+          (aviFile && aviSuperIndexEntries >= (aviSuperIndexSize - 4));
+      queueMutex.unlock();
+      frameEncodedLock.notify();
     }
   }
 
-  VideoCapture_RLE8::VideoCaptureFrameBuffer::~VideoCaptureFrameBuffer()
+  void VideoCapture::openFile(const char *fileName)
   {
-    delete[] buf;
-    delete[] linePtrs;
-    delete[] lineBytes_;
+    flushEncoderQueue();
+    openFile_(fileName);
   }
 
-  inline bool VideoCapture_RLE8::VideoCaptureFrameBuffer::compareLine(
-      long dstLine, const VideoCaptureFrameBuffer& src, long srcLine)
+  void VideoCapture::openFile_(const char *fileName)
   {
-    if (lineBytes_[dstLine] != src.lineBytes_[srcLine])
-      return false;
-    if (src.lineBytes_[srcLine] == 0U)
-      return true;
-    return (std::memcmp(linePtrs[dstLine], src.linePtrs[srcLine],
-                        src.lineBytes_[srcLine]) == 0);
+    closeFile_();
+    framesDelayed = 0;
+    encoderWaitTime = 0.0;
+    encoderWarningFlag = false;
+    if (fileName == (char *) 0 || fileName[0] == '\0')
+      return;
+    openOutputFile(fileName);
   }
 
-  inline void VideoCapture_RLE8::VideoCaptureFrameBuffer::copyLine(long dstLine,
-                                                                   long srcLine)
+  void VideoCapture::openOutputFile(const char *fileName)
   {
-    std::memcpy(linePtrs[dstLine], linePtrs[srcLine], lineBytes_[srcLine]);
-    lineBytes_[dstLine] = lineBytes_[srcLine];
+    // the file is also read when writing the legacy index
+    aviFile = fileOpen(fileName, "w+b");
+    if (!aviFile)
+      throw Exception("error opening AVI file");
+    framesWritten = 0;
+    duplicateFrames = 0;
+    aviIndexFrames = 0;
+    aviSuperIndexEntries = 0;
+    riffCnt = 1;
+    riffStartPos = 0;
+    riff0EndPos = 0;
+    riff0MoviEndPos = 0;
+    riff0Frames = 0;
+    // RIFF and LIST headers, "avih", the "strh", "strf", and "indx" chunks
+    // of the two streams, "dmlh", and the start of the "movi" list
+    aviHeaderSize = 12 + 12 + 64 + (12 + 64 + 48 + 32) + (12 + 64 + 26 + 32)
+                    + (12 + 256) + 12
+                    + (size_t(aviSuperIndexSize) * 32)
+                    + (aviVideoFormat.palette ? 1024 : 0);
+    fileSize = aviHeaderSize;
+    writeAVIHeader();
   }
 
-  inline void VideoCapture_RLE8::VideoCaptureFrameBuffer::copyLine(
-      long dstLine, const VideoCaptureFrameBuffer& src, long srcLine)
+  void VideoCapture::closeFile()
   {
-    std::memcpy(linePtrs[dstLine], src.linePtrs[srcLine],
-                src.lineBytes_[srcLine]);
-    lineBytes_[dstLine] = src.lineBytes_[srcLine];
+    flushEncoderQueue();
+    closeFile_();
   }
 
-  void VideoCapture_RLE8::VideoCaptureFrameBuffer::clearLine(long n)
+  void VideoCapture::closeFile_()
   {
-    uint8_t *p = linePtrs[n];
-    for (int i = 0; i < 48; i++) {      // FIXME: assumes videoWidth == 768
-      *(p++) = 0x01;
-      *(p++) = 0x00;
-    }
-    lineBytes_[n] = 96U;
+    if (aviFile)
+      closeOutputFile();
+    queueMutex.lock();
+    encoderFileFull = false;
+    queueMutex.unlock();
   }
 
-  // --------------------------------------------------------------------------
-
-  VideoCapture_RLE8::VideoCapture_RLE8(
-      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
-      int frameRate_)
-    : VideoCapture(frameRate_),
-      tmpFrameBuf(videoWidth, videoHeight),
-      outputFrameBuf(videoWidth, videoHeight),
-      frameSizes((uint32_t *) 0),
-      cycleCnt(2),
-      prvOddFrame(false),
-      colormap((uint8_t *) 0)
+  void VideoCapture::closeOutputFile()
   {
+    // FIXME: file I/O errors are ignored here
     try {
-      aviHeaderSize = aviHeaderSize_RLE8;
-      size_t  maxFrames = 0x20000000 / size_t(audioBufSize);
-      frameSizes = new uint32_t[maxFrames];
-      std::memset(frameSizes, 0x00, maxFrames * sizeof(uint32_t));
-      // initialize colormap
-      colormap = new uint8_t[256 * 4];
-      for (int i = 0; i < 256; i++) {
-        float   r = float(i) / 255.0f;
-        float   g = r;
-        float   b = r;
-        if (indexToRGBFunc)
-          indexToRGBFunc(uint8_t(i), r, g, b);
-        int ri = int((r > 0.0f ? (r < 1.0f ? r : 1.0f) : 0.0f) * 255.0f + 0.5f);
-        int gi = int((g > 0.0f ? (g < 1.0f ? g : 1.0f) : 0.0f) * 255.0f + 0.5f);
-        int bi = int((b > 0.0f ? (b < 1.0f ? b : 1.0f) : 0.0f) * 255.0f + 0.5f);
-        colormap[(i * 4) + 0] = uint8_t(bi);
-        colormap[(i * 4) + 1] = uint8_t(gi);
-        colormap[(i * 4) + 2] = uint8_t(ri);
-        colormap[(i * 4) + 3] = 0x00;
-      }
+      closeAVIRIFF(false);
+      writeAVIHeader();
     }
     catch (...) {
-      if (frameSizes)
-        delete[] frameSizes;
-      if (colormap)
-        delete[] colormap;
-      throw;
     }
-    setClockFrequency(890625);
-  }
-
-  VideoCapture_RLE8::~VideoCapture_RLE8()
-  {
-    closeFile();
-    delete[] frameSizes;
-    delete[] colormap;
+    if (aviFile)
+      std::fclose(aviFile);
+    aviFile = (std::FILE *) 0;
+    framesWritten = 0;
+    duplicateFrames = 0;
+    fileSize = 0;
   }
 
-  void VideoCapture_RLE8::runOneCycle(uint32_t audioInput)
+  void VideoCapture::writeAudioChunk()
   {
-    soundOutputAccumulatorL += uint32_t(audioInput & 0xFFFFU);
-    soundOutputAccumulatorR += uint32_t(audioInput >> 16);
-    if (--cycleCnt == 0) {
-      cycleCnt = 2;
-      uint32_t  tmpL = (soundOutputAccumulatorL + 1U) >> 1;
-      uint32_t  tmpR = (soundOutputAccumulatorR + 1U) >> 1;
-      soundOutputAccumulatorL = 0U;
-      soundOutputAccumulatorR = 0U;
-      audioConverter->sendInputSignal(tmpL | (tmpR << 16));
+    uint8_t headerBuf[8];
+    uint8_t *bufp = &(headerBuf[0]);
+    aviHeader_writeFourCC(bufp, "01wb");
+    aviHeader_writeUInt32(bufp, uint32_t(audioBufSize * 4));
+    fileSize = fileSize + 8;
+    if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
+      throw Exception("error writing AVI file");
+    int     bufPos = audioBufReadPos;
+    for (int i = 0; i < (audioBufSize * 2); i++) {
+      if (bufPos >= (audioBufSize * audioBuffers * 2))
+        bufPos = 0;
+      int16_t tmp = audioBuf[bufPos++];
+      fileSize++;
+      if (std::fputc(int(uint16_t(tmp) & 0xFF), aviFile) == EOF)
+        throw Exception("error writing AVI file");
+      fileSize++;
+      if (std::fputc(int((uint16_t(tmp) >> 8) & 0xFF), aviFile) == EOF)
+        throw Exception("error writing AVI file");
     }
   }
 
-  void VideoCapture_RLE8::setClockFrequency(size_t freq_)
+  void VideoCapture::writeAVIFrame(const uint8_t *buf, size_t nBytes,
+                                   bool isKeyFrame)
   {
-    if (freq_ == clockFrequency)
+    if (!aviFile)
       return;
-    clockFrequency = freq_;
-    audioConverter->setInputSampleRate(float(long(freq_)) * 0.5f);
-  }
-
-  void VideoCapture_RLE8::horizontalSync(const uint8_t *buf, size_t nBytes)
-  {
-    if (curLine >= 0 && curLine < videoHeight) {
-      uint8_t *p = &(tmpFrameBuf[curLine][0]);
-      for (size_t i = 0; i < nBytes; i++)
-        p[i] = buf[i];
-      tmpFrameBuf.lineBytes(curLine) = uint32_t(nBytes);
-      if (bool(curLine & 1) == prvOddFrame) {
-        // no interlace, need to duplicate line
-        tmpFrameBuf.copyLine(curLine ^ 1, curLine);
+    try {
+      if ((fileSize - riffStartPos) >= uint64_t(aviRIFFMaxSize))
+        closeAVIRIFF(true);
+      if (aviIndexFrames >= aviIndexChunkFrames)
+        writeAVIStandardIndex();
+      if (std::fseek(aviFile, 0L, SEEK_END) < 0)
+        throw Exception("error seeking AVI file");
+      uint8_t headerBuf[8];
+      uint8_t *bufp = &(headerBuf[0]);
+      aviHeader_writeFourCC(bufp, "00dc");
+      aviHeader_writeUInt32(bufp, uint32_t(nBytes));
+      if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
+        throw Exception("error writing AVI file");
+      fileSize = fileSize + 8;
+      AVIIndexEntry&  e = aviIndexBuf[aviIndexFrames];
+      e.offset = uint32_t(fileSize - riffStartPos);
+      e.size = uint32_t(nBytes) | (isKeyFrame ? 0U : 0x80000000U);
+      if (nBytes > 0) {
+        if (std::fwrite(buf, 1, nBytes, aviFile) != nBytes)
+          throw Exception("error writing AVI file");
+        fileSize = fileSize + nBytes;
+        if (nBytes & 1) {
+          // chunks are padded to an even number of bytes
+          if (std::fputc(0, aviFile) == EOF)
+            throw Exception("error writing AVI file");
+          fileSize++;
+        }
       }
+      writeAudioChunk();
+      aviIndexFrames++;
     }
-    if (vsyncCnt != 0) {
-      curLine += 2;
-      if (curLine < videoHeight)
-        tmpFrameBuf.lineBytes(curLine) = 0U;
-      if (vsyncCnt >= (EP128EMU_VSYNC_MIN_LINES - EP128EMU_VSYNC_OFFSET) &&
-          (vsyncState ||
-           vsyncCnt >= (EP128EMU_VSYNC_MAX_LINES - EP128EMU_VSYNC_OFFSET))) {
-        vsyncCnt = -(EP128EMU_VSYNC_OFFSET);
-      }
-      vsyncCnt++;
-    }
-    else {
-      for (int i = (curLine + 1); i < videoHeight; i++)
-        tmpFrameBuf.clearLine(i);
-      frameDone();
-      prvOddFrame = bool(curLine & 1);
-      curLine = (oddFrame ? -1 : 0);
-      if (curLine >= 0)
-        tmpFrameBuf.lineBytes(curLine) = 0U;
-      vsyncCnt++;
-      oddFrame = false;
-    }
-  }
-
-  void VideoCapture_RLE8::frameDone()
-  {
-    if (audioBufSamples >= (audioBufSize * 2)) {
-      bool    frameChanged = false;
-      for (int i = 0; i < videoHeight; i++) {
-        if (!tmpFrameBuf.compareLine(i, outputFrameBuf, i)) {
-          frameChanged = true;
-          outputFrameBuf.copyLine(i, tmpFrameBuf, i);
-        }
-      }
-      do {
-        audioBufSamples -= (audioBufSize * 2);
-        writeFrame(frameChanged);
-        frameChanged = false;
-        audioBufReadPos += (audioBufSize * 2);
-        while (audioBufReadPos >= (audioBufSize * audioBuffers * 2))
-          audioBufReadPos -= (audioBufSize * audioBuffers * 2);
-      } while (audioBufSamples >= (audioBufSize * 2));
-    }
-  }
-
-  void VideoCapture_RLE8::decodeLine(uint8_t *outBuf, const uint8_t *inBuf)
-  {
-    for (size_t i = 0; i < (videoWidth / 16); i++) {
-      uint8_t c = *(inBuf++);
-      switch (c) {
-      case 0x01:
-        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  =
-        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
-        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
-        break;
-      case 0x02:
-        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
-        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
-        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  = *(inBuf++);
-        break;
-      case 0x03:
-        {
-          uint8_t c0 = *(inBuf++);
-          uint8_t c1 = *(inBuf++);
-          uint8_t b = *(inBuf++);
-          outBuf[1]  = outBuf[0]  = ((b & 128) ? c1 : c0);
-          outBuf[3]  = outBuf[2]  = ((b &  64) ? c1 : c0);
-          outBuf[5]  = outBuf[4]  = ((b &  32) ? c1 : c0);
-          outBuf[7]  = outBuf[6]  = ((b &  16) ? c1 : c0);
-          outBuf[9]  = outBuf[8]  = ((b &   8) ? c1 : c0);
-          outBuf[11] = outBuf[10] = ((b &   4) ? c1 : c0);
-          outBuf[13] = outBuf[12] = ((b &   2) ? c1 : c0);
-          outBuf[15] = outBuf[14] = ((b &   1) ? c1 : c0);
-        }
-        break;
-      case 0x04:
-        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
-        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  = *(inBuf++);
-        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  = *(inBuf++);
-        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] = *(inBuf++);
-        break;
-      case 0x06:
-        {
-          uint8_t c0 = *(inBuf++);
-          uint8_t c1 = *(inBuf++);
-          uint8_t b = *(inBuf++);
-          outBuf[0]  = ((b & 128) ? c1 : c0);
-          outBuf[1]  = ((b &  64) ? c1 : c0);
-          outBuf[2]  = ((b &  32) ? c1 : c0);
-          outBuf[3]  = ((b &  16) ? c1 : c0);
-          outBuf[4]  = ((b &   8) ? c1 : c0);
-          outBuf[5]  = ((b &   4) ? c1 : c0);
-          outBuf[6]  = ((b &   2) ? c1 : c0);
-          outBuf[7]  = ((b &   1) ? c1 : c0);
-          c0 = *(inBuf++);
-          c1 = *(inBuf++);
-          b = *(inBuf++);
-          outBuf[8]  = ((b & 128) ? c1 : c0);
-          outBuf[9]  = ((b &  64) ? c1 : c0);
-          outBuf[10] = ((b &  32) ? c1 : c0);
-          outBuf[11] = ((b &  16) ? c1 : c0);
-          outBuf[12] = ((b &   8) ? c1 : c0);
-          outBuf[13] = ((b &   4) ? c1 : c0);
-          outBuf[14] = ((b &   2) ? c1 : c0);
-          outBuf[15] = ((b &   1) ? c1 : c0);
-        }
-        break;
-      case 0x08:
-        outBuf[1]  = outBuf[0]  = *(inBuf++);
-        outBuf[3]  = outBuf[2]  = *(inBuf++);
-        outBuf[5]  = outBuf[4]  = *(inBuf++);
-        outBuf[7]  = outBuf[6]  = *(inBuf++);
-        outBuf[9]  = outBuf[8]  = *(inBuf++);
-        outBuf[11] = outBuf[10] = *(inBuf++);
-        outBuf[13] = outBuf[12] = *(inBuf++);
-        outBuf[15] = outBuf[14] = *(inBuf++);
-        break;
-      case 0x10:
-        outBuf[0]  = *(inBuf++);
-        outBuf[1]  = *(inBuf++);
-        outBuf[2]  = *(inBuf++);
-        outBuf[3]  = *(inBuf++);
-        outBuf[4]  = *(inBuf++);
-        outBuf[5]  = *(inBuf++);
-        outBuf[6]  = *(inBuf++);
-        outBuf[7]  = *(inBuf++);
-        outBuf[8]  = *(inBuf++);
-        outBuf[9]  = *(inBuf++);
-        outBuf[10] = *(inBuf++);
-        outBuf[11] = *(inBuf++);
-        outBuf[12] = *(inBuf++);
-        outBuf[13] = *(inBuf++);
-        outBuf[14] = *(inBuf++);
-        outBuf[15] = *(inBuf++);
-        break;
-      default:
-        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  =
-        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
-        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = 0;
-        break;
-      }
-      outBuf = outBuf + 16;
-    }
-  }
-
-  size_t VideoCapture_RLE8::rleCompressLine(uint8_t *outBuf,
-                                            const uint8_t *inBuf)
-  {
-    uint8_t runLengths[1024];
-    uint8_t byteValues[1024];
-    size_t  nBytes = 0;
-    int     n = 0;
-    int     runLength = 1;
-    for (int i = 1; i < videoWidth; i++) {
-      if (inBuf[i] != inBuf[i - 1]) {
-        runLengths[n] = uint8_t(runLength);
-        byteValues[n++] = inBuf[i - 1];
-        runLength = 1;
-      }
-      else {
-        if (++runLength >= 256) {
-          runLengths[n] = 255;
-          byteValues[n++] = inBuf[i - 1];
-          runLength = 1;
-        }
-      }
-    }
-    runLengths[n] = uint8_t(runLength);
-    byteValues[n++] = inBuf[videoWidth - 1];
-    for (int i = 0; i < n; ) {
-      if (runLengths[i] >= 2 || (i + 1) >= n) {
-        outBuf[nBytes++] = runLengths[i];
-        outBuf[nBytes++] = byteValues[i];
-        i++;
-      }
-      else {
-        int     j = i + 1;
-        int     bytesToCopy = int(runLengths[i]);
-        int     minLength = 3;
-        do {
-          int     tmp = int(runLengths[j]);
-          if (tmp >= minLength || (bytesToCopy + tmp) > 255)
-            break;
-          bytesToCopy += tmp;
-          minLength = 4 | (bytesToCopy & 1);
-        } while (++j < n);
-        if (bytesToCopy >= 3) {
-          outBuf[nBytes++] = 0x00;
-          outBuf[nBytes++] = uint8_t(bytesToCopy);
-          do {
-            int     k = int(runLengths[i]);
-            uint8_t tmp = byteValues[i];
-            do {
-              outBuf[nBytes++] = tmp;
-            } while (--k != 0);
-          } while (++i < j);
-          if (bytesToCopy & 1)
-            outBuf[nBytes++] = 0x00;
-        }
-        else {
-          do {
-            outBuf[nBytes++] = runLengths[i];
-            outBuf[nBytes++] = byteValues[i];
-          } while (++i < j);
-        }
-      }
-    }
-    outBuf[nBytes++] = 0x00;    // end of line
-    outBuf[nBytes++] = 0x00;
-    return nBytes;
-  }
-
-  void VideoCapture_RLE8::writeFrame(bool frameChanged)
-  {
-    if (!aviFile)
-      return;
-    if (!frameChanged) {
-      if (framesWritten == 0 || duplicateFrames >= size_t(frameRate))
-        frameChanged = true;
-      else
-        duplicateFrames++;
-    }
-    if (frameChanged)
-      duplicateFrames = 0;
-    try {
-      if (fileSize >= 0x7F800000) {
-        closeFile();
-        try {
-          errorMessage("AVI file is too large, starting new output file");
-        }
-        catch (...) {
-        }
-        std::string fileName = "";
-        fileNameCallback(fileNameCallbackUserData, fileName);
-        if (fileName.length() < 1)
-          return;
-        openFile(fileName.c_str());
-      }
-      if (std::fseek(aviFile, 0L, SEEK_END) < 0)
-        throw Exception("error seeking AVI file");
-      uint8_t headerBuf[8];
-      uint8_t *bufp = &(headerBuf[0]);
-      size_t  nBytes = 0;
-      frameSizes[framesWritten] = 0U;
-      aviHeader_writeFourCC(bufp, "00dc");
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file");
-      if (frameChanged) {
-        long    savedFilePos = std::ftell(aviFile);
-        if (savedFilePos < 4L)
-          throw Exception("error seeking AVI file");
-        savedFilePos = savedFilePos - 4L;
-        uint8_t lineBuf[1024];
-        uint8_t rleBuf[1024];
-        size_t  n = 0;
-        for (int i = (videoHeight - 1); i >= 0; i--) {
-          if (i == (videoHeight - 1) ||
-              !outputFrameBuf.compareLine(i, outputFrameBuf, i + 1)) {
-            decodeLine(&(lineBuf[0]), outputFrameBuf[i]);
-            n = rleCompressLine(&(rleBuf[0]), &(lineBuf[0]));
-          }
-          nBytes += n;
-          fileSize += n;
-          if (std::fwrite(&(rleBuf[0]), 1, n, aviFile) != n)
-            throw Exception("error writing AVI file");
-        }
-        if (std::fseek(aviFile, savedFilePos, SEEK_SET) < 0)
-          throw Exception("error seeking AVI file");
-        bufp = &(headerBuf[4]);
-        frameSizes[framesWritten] = uint32_t(nBytes);
-        aviHeader_writeUInt32(bufp, uint32_t(nBytes));
-        if (std::fwrite(&(headerBuf[4]), 1, 4, aviFile) != 4)
-          throw Exception("error writing AVI file");
-        if (std::fseek(aviFile, 0L, SEEK_END) < 0)
-          throw Exception("error seeking AVI file");
-      }
-      bufp = &(headerBuf[0]);
-      nBytes = size_t(audioBufSize * 4);
-      aviHeader_writeFourCC(bufp, "01wb");
-      aviHeader_writeUInt32(bufp, uint32_t(nBytes));
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file");
-      int     bufPos = audioBufReadPos;
-      for (int i = 0; i < (audioBufSize * 2); i++) {
-        if (bufPos >= (audioBufSize * audioBuffers * 2))
-          bufPos = 0;
-        int16_t tmp = audioBuf[bufPos++];
-        fileSize++;
-        if (std::fputc(int(uint16_t(tmp) & 0xFF), aviFile) == EOF)
-          throw Exception("error writing AVI file");
-        fileSize++;
-        if (std::fputc(int((uint16_t(tmp) >> 8) & 0xFF), aviFile) == EOF)
-          throw Exception("error writing AVI file");
-      }
-    }
-    catch (std::exception& e) {
-      closeFile();
-      errorMessage(e.what());
-      return;
-    }
-    framesWritten++;
-    if (!(framesWritten & 31)) {
-      try {
-        writeAVIHeader();
-      }
-      catch (std::exception& e) {
-        errorMessage(e.what());
+    catch (std::exception& e) {
+      closeFile_();
+      encoderError(e.what());
+      return;
+    }
+    framesWritten++;
+    if (!(framesWritten & 31)) {
+      try {
+        writeAVIHeader();
+      }
+      catch (std::exception& e) {
+        encoderError(e.what());
       }
     }
   }
 
-  void VideoCapture_RLE8::writeAVIHeader()
+  void VideoCapture::writeAVIHeader()
   {
     if (!aviFile)
       return;
     try {
       if (std::fseek(aviFile, 0L, SEEK_SET) < 0)
         throw Exception("error seeking AVI file");
-      uint8_t   headerBuf[1536];
+      std::vector< uint8_t >  headerBuf(aviHeaderSize, 0x00);
       uint8_t   *bufp = &(headerBuf[0]);
-      size_t    maxVideoFrameSize = size_t((videoWidth + 16) * videoHeight);
-      size_t    maxFrameSize = size_t(maxVideoFrameSize + (audioBufSize * 4)
-                                      + 16);
+      const AVIVideoFormat& fmt = aviVideoFormat;
+      size_t    paletteSize = (fmt.palette ? 1024 : 0);
+      size_t    frameSize = size_t(fmt.maxFrameSize + (audioBufSize * 4) + 16);
+      size_t    superIndexSize = size_t(24 + (aviSuperIndexSize * 16));
+      uint64_t  riff0End = (riff0EndPos ? riff0EndPos : fileSize);
+      uint64_t  moviEnd = (riff0MoviEndPos ? riff0MoviEndPos : fileSize);
       aviHeader_writeFourCC(bufp, "RIFF");
-      aviHeader_writeUInt32(bufp, uint32_t(fileSize - 8));
+      aviHeader_writeUInt32(bufp, uint32_t(riff0End - 8));
       aviHeader_writeFourCC(bufp, "AVI ");
       aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x00000526U);
+      aviHeader_writeUInt32(bufp, uint32_t(aviHeaderSize - 32));
       aviHeader_writeFourCC(bufp, "hdrl");
       aviHeader_writeFourCC(bufp, "avih");
       aviHeader_writeUInt32(bufp, 0x00000038U);
@@ -736,36 +556,38 @@ namespace Ep128Emu {
       aviHeader_writeUInt32(bufp,
                             uint32_t((1000000 + (frameRate >> 1)) / frameRate));
       // max. bytes per second
-      aviHeader_writeUInt32(bufp, uint32_t(maxFrameSize * size_t(frameRate)));
+      aviHeader_writeUInt32(bufp, uint32_t(frameSize * size_t(frameRate)));
       // padding
       aviHeader_writeUInt32(bufp, 0x00000001U);
       // flags (AVIF_HASINDEX | AVIF_ISINTERLEAVED | AVIF_TRUSTCKTYPE)
       aviHeader_writeUInt32(bufp, 0x00000910U);
-      // total frames
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten));
+      // total frames (in the first RIFF list only)
+      aviHeader_writeUInt32(
+          bufp, uint32_t(riff0EndPos ? riff0Frames : framesWritten));
       // initial frames
       aviHeader_writeUInt32(bufp, 0x00000000U);
       // number of streams
       aviHeader_writeUInt32(bufp, 0x00000002U);
       // suggested buffer size
-      aviHeader_writeUInt32(bufp, uint32_t(maxFrameSize));
+      aviHeader_writeUInt32(bufp, uint32_t(frameSize));
       // width
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.width));
       // height
-      aviHeader_writeUInt32(bufp, uint32_t(videoHeight));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.height));
       // reserved
       aviHeader_writeUInt32(bufp, 0x00000000U);
       aviHeader_writeUInt32(bufp, 0x00000000U);
       aviHeader_writeUInt32(bufp, 0x00000000U);
       aviHeader_writeUInt32(bufp, 0x00000000U);
       aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x00000474U);
+      aviHeader_writeUInt32(bufp, uint32_t(0x0000007CU + paletteSize
+                                           + superIndexSize));
       aviHeader_writeFourCC(bufp, "strl");
       aviHeader_writeFourCC(bufp, "strh");
       aviHeader_writeUInt32(bufp, 0x00000038U);
       aviHeader_writeFourCC(bufp, "vids");
       // video codec
-      aviHeader_writeUInt32(bufp, 0x00000001U); // BI_RLE8
+      aviHeader_writeFourCC(bufp, fmt.codec);
       // flags
       aviHeader_writeUInt32(bufp, 0x00000000U);
       // priority
@@ -783,7 +605,7 @@ namespace Ep128Emu {
       // length
       aviHeader_writeUInt32(bufp, uint32_t(framesWritten));
       // suggested buffer size
-      aviHeader_writeUInt32(bufp, uint32_t(maxVideoFrameSize));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.maxFrameSize));
       // quality
       aviHeader_writeUInt32(bufp, 0x00000000U);
       // sample size
@@ -793,24 +615,24 @@ namespace Ep128Emu {
       // top
       aviHeader_writeUInt16(bufp, 0x0000);
       // right
-      aviHeader_writeUInt16(bufp, uint16_t(videoWidth));
+      aviHeader_writeUInt16(bufp, uint16_t(fmt.width));
       // bottom
-      aviHeader_writeUInt16(bufp, uint16_t(videoHeight));
+      aviHeader_writeUInt16(bufp, uint16_t(fmt.height));
       aviHeader_writeFourCC(bufp, "strf");
-      aviHeader_writeUInt32(bufp, 0x00000428U);
+      aviHeader_writeUInt32(bufp, uint32_t(0x00000028U + paletteSize));
       aviHeader_writeUInt32(bufp, 0x00000028U);
       // width
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.width));
       // height
-      aviHeader_writeUInt32(bufp, uint32_t(videoHeight));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.height));
       // planes
       aviHeader_writeUInt16(bufp, 0x0001);
       // bits per pixel
-      aviHeader_writeUInt16(bufp, 0x0008);
+      aviHeader_writeUInt16(bufp, uint16_t(fmt.bitsPerPixel));
       // compression
-      aviHeader_writeUInt32(bufp, 0x00000001U); // BI_RLE8
+      aviHeader_writeFourCC(bufp, fmt.codec);
       // image size in bytes
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth * videoHeight));
+      aviHeader_writeUInt32(bufp, uint32_t(fmt.imageSize));
       // X resolution
       aviHeader_writeUInt32(bufp, 0x00000000U);
       // Y resolution
@@ -819,11 +641,31 @@ namespace Ep128Emu {
       aviHeader_writeUInt32(bufp, 0x00000000U);
       // color indexes required
       aviHeader_writeUInt32(bufp, 0x00000000U);
-      // colormap (256 entries)
-      std::memcpy(bufp, colormap, 1024);
-      bufp = bufp + 1024;
-      aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x0000005EU);
+      if (fmt.palette) {
+        // colormap (256 entries)
+        std::memcpy(bufp, fmt.palette, 1024);
+        bufp = bufp + 1024;
+      }
+      // super index of the video stream
+      aviHeader_writeFourCC(bufp, "indx");
+      aviHeader_writeUInt32(bufp, uint32_t(superIndexSize));
+      // longs per entry, index sub-type, AVI_INDEX_OF_INDEXES
+      aviHeader_writeUInt16(bufp, 0x0004);
+      *(bufp++) = 0x00;
+      *(bufp++) = 0x00;
+      aviHeader_writeUInt32(bufp, uint32_t(aviSuperIndexEntries));
+      aviHeader_writeFourCC(bufp, "00dc");
+      bufp = bufp + 12;
+      for (int i = 0; i < aviSuperIndexEntries; i++) {
+        const AVISuperIndexEntry& e = aviSuperIndex[i];
+        aviHeader_writeUInt32(bufp, uint32_t(e.filePos & 0xFFFFFFFFU));
+        aviHeader_writeUInt32(bufp, uint32_t(e.filePos >> 32));
+        aviHeader_writeUInt32(bufp, uint32_t(32 + (e.frames * 8)));
+        aviHeader_writeUInt32(bufp, e.frames);
+      }
+      bufp = bufp + ((aviSuperIndexSize - aviSuperIndexEntries) * 16);
+      aviHeader_writeFourCC(bufp, "LIST");
+      aviHeader_writeUInt32(bufp, uint32_t(0x00000066U + superIndexSize));
       aviHeader_writeFourCC(bufp, "strl");
       aviHeader_writeFourCC(bufp, "strh");
       aviHeader_writeUInt32(bufp, 0x00000038U);
@@ -877,8 +719,35 @@ namespace Ep128Emu {
       aviHeader_writeUInt16(bufp, 0x0010);
       // additional format information size
       aviHeader_writeUInt16(bufp, 0x0000);
+      // super index of the audio stream
+      aviHeader_writeFourCC(bufp, "indx");
+      aviHeader_writeUInt32(bufp, uint32_t(superIndexSize));
+      aviHeader_writeUInt16(bufp, 0x0004);
+      *(bufp++) = 0x00;
+      *(bufp++) = 0x00;
+      aviHeader_writeUInt32(bufp, uint32_t(aviSuperIndexEntries));
+      aviHeader_writeFourCC(bufp, "01wb");
+      bufp = bufp + 12;
+      for (int i = 0; i < aviSuperIndexEntries; i++) {
+        // the "ix01" chunk follows "ix00"
+        const AVISuperIndexEntry& e = aviSuperIndex[i];
+        uint64_t  filePos = e.filePos + (32 + (e.frames * 8));
+        aviHeader_writeUInt32(bufp, uint32_t(filePos & 0xFFFFFFFFU));
+        aviHeader_writeUInt32(bufp, uint32_t(filePos >> 32));
+        aviHeader_writeUInt32(bufp, uint32_t(32 + (e.frames * 8)));
+        aviHeader_writeUInt32(bufp, e.frames * uint32_t(audioBufSize));
+      }
+      bufp = bufp + ((aviSuperIndexSize - aviSuperIndexEntries) * 16);
       aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, uint32_t((fileSize - aviHeaderSize) + 4));
+      aviHeader_writeUInt32(bufp, 0x00000104U);
+      aviHeader_writeFourCC(bufp, "odml");
+      aviHeader_writeFourCC(bufp, "dmlh");
+      aviHeader_writeUInt32(bufp, 0x000000F8U);
+      // total frames
+      aviHeader_writeUInt32(bufp, uint32_t(framesWritten));
+      bufp = bufp + 244;
+      aviHeader_writeFourCC(bufp, "LIST");
+      aviHeader_writeUInt32(bufp, uint32_t((moviEnd - aviHeaderSize) + 4));
       aviHeader_writeFourCC(bufp, "movi");
       size_t  nBytes = size_t(bufp - (&(headerBuf[0])));
       if (std::fwrite(&(headerBuf[0]), 1, nBytes, aviFile) != nBytes)
@@ -896,222 +765,1100 @@ namespace Ep128Emu {
     }
   }
 
-  void VideoCapture_RLE8::writeAVIIndex()
+  void VideoCapture::writeAVIStandardIndex()
+  {
+    if (!aviFile || aviIndexFrames < 1)
+      return;
+    if (aviSuperIndexEntries >= aviSuperIndexSize)
+      throw Exception("AVI file index is full");
+    if (std::fseek(aviFile, 0L, SEEK_END) < 0)
+      throw Exception("error seeking AVI file");
+    size_t  chunkSize = size_t(32 + (aviIndexFrames * 8));
+    std::vector< uint8_t >  tmpBuf(chunkSize * 2);
+    uint8_t *bufp = &(tmpBuf[0]);
+    for (int i = 0; i < 2; i++) {
+      aviHeader_writeFourCC(bufp, (i == 0 ? "ix00" : "ix01"));
+      aviHeader_writeUInt32(bufp, uint32_t(chunkSize - 8));
+      // longs per entry, index sub-type, AVI_INDEX_OF_CHUNKS
+      aviHeader_writeUInt16(bufp, 0x0002);
+      *(bufp++) = 0x00;
+      *(bufp++) = 0x01;
+      aviHeader_writeUInt32(bufp, uint32_t(aviIndexFrames));
+      aviHeader_writeFourCC(bufp, (i == 0 ? "00dc" : "01wb"));
+      // base offset
+      aviHeader_writeUInt32(bufp, uint32_t(riffStartPos & 0xFFFFFFFFU));
+      aviHeader_writeUInt32(bufp, uint32_t(riffStartPos >> 32));
+      aviHeader_writeUInt32(bufp, 0x00000000U);
+      for (int j = 0; j < aviIndexFrames; j++) {
+        const AVIIndexEntry&  e = aviIndexBuf[j];
+        if (i == 0) {
+          aviHeader_writeUInt32(bufp, e.offset);
+          aviHeader_writeUInt32(bufp, e.size);
+        }
+        else {
+          // the audio chunk follows the (padded) video chunk
+          uint32_t  videoBytes = (e.size & 0x7FFFFFFFU);
+          aviHeader_writeUInt32(bufp,
+                                e.offset + ((videoBytes + 1U) & (~1U)) + 8U);
+          aviHeader_writeUInt32(bufp, uint32_t(audioBufSize * 4));
+        }
+      }
+    }
+    if (std::fwrite(&(tmpBuf[0]), 1, chunkSize * 2, aviFile) != (chunkSize * 2))
+      throw Exception("error writing AVI file index");
+    aviSuperIndex[aviSuperIndexEntries].filePos = fileSize;
+    aviSuperIndex[aviSuperIndexEntries].frames = uint32_t(aviIndexFrames);
+    aviSuperIndexEntries++;
+    fileSize = fileSize + (chunkSize * 2);
+    aviIndexFrames = 0;
+  }
+
+  void VideoCapture::writeAVILegacyIndex()
   {
     if (!aviFile)
       return;
-    try {
+    size_t  nFrames = 0;
+    for (int i = 0; i < aviSuperIndexEntries; i++)
+      nFrames += size_t(aviSuperIndex[i].frames);
+    if (std::fseek(aviFile, 0L, SEEK_END) < 0)
+      throw Exception("error seeking AVI file");
+    uint8_t tmpBuf[32];
+    uint8_t *bufp = &(tmpBuf[0]);
+    aviHeader_writeFourCC(bufp, "idx1");
+    aviHeader_writeUInt32(bufp, uint32_t(nFrames << 5));
+    if (std::fwrite(&(tmpBuf[0]), 1, 8, aviFile) != 8)
+      throw Exception("error writing AVI file index");
+    fileSize = fileSize + 8;
+    // the offsets are relative to the "movi" FourCC, and are read back from
+    // the "ix00" chunks (all of which are in the first 1 GB of the file)
+    uint32_t  moviPos = uint32_t(aviHeaderSize - 4);
+    std::vector< uint8_t >  ixBuf(size_t(aviIndexChunkFrames * 8));
+    for (int i = 0; i < aviSuperIndexEntries; i++) {
+      size_t  n = size_t(aviSuperIndex[i].frames);
+      if (std::fseek(aviFile, long(aviSuperIndex[i].filePos + 32), SEEK_SET)
+          < 0) {
+        throw Exception("error seeking AVI file");
+      }
+      if (std::fread(&(ixBuf[0]), 8, n, aviFile) != n)
+        throw Exception("error reading AVI file index");
       if (std::fseek(aviFile, 0L, SEEK_END) < 0)
         throw Exception("error seeking AVI file");
-      uint8_t   tmpBuf[32];
-      uint8_t   *bufp = &(tmpBuf[0]);
-      aviHeader_writeFourCC(bufp, "idx1");
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten << 5));
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(tmpBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file index");
-      size_t    filePos = 4;
-      for (size_t i = 0; i < framesWritten; i++) {
+      for (size_t j = 0; j < n; j++) {
+        const uint8_t *p = &(ixBuf[j * 8]);
+        uint32_t  offset = uint32_t(p[0]) | (uint32_t(p[1]) << 8)
+                           | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+        uint32_t  size = uint32_t(p[4]) | (uint32_t(p[5]) << 8)
+                         | (uint32_t(p[6]) << 16) | (uint32_t(p[7]) << 24);
+        bool      isKeyFrame = !(size & 0x80000000U);
+        size = size & 0x7FFFFFFFU;
         bufp = &(tmpBuf[0]);
         aviHeader_writeFourCC(bufp, "00dc");
-        size_t    frameBytes = size_t(frameSizes[i]);
-        if (frameBytes > 0)
-          aviHeader_writeUInt32(bufp, 0x00000010U);     // AVIIF_KEYFRAME
-        else
-          aviHeader_writeUInt32(bufp, 0x00000000U);
-        aviHeader_writeUInt32(bufp, uint32_t(filePos));
-        filePos = filePos + frameBytes + 8;
-        aviHeader_writeUInt32(bufp, uint32_t(frameBytes));
+        aviHeader_writeUInt32(bufp, (isKeyFrame ? 0x00000010U : 0U));
+        aviHeader_writeUInt32(bufp, (offset - 8U) - moviPos);
+        aviHeader_writeUInt32(bufp, size);
         aviHeader_writeFourCC(bufp, "01wb");
         aviHeader_writeUInt32(bufp, 0x00000010U);       // AVIIF_KEYFRAME
-        aviHeader_writeUInt32(bufp, uint32_t(filePos));
-        frameBytes = size_t(audioBufSize) << 2;
-        filePos = filePos + frameBytes + 8;
-        aviHeader_writeUInt32(bufp, uint32_t(frameBytes));
-        fileSize = fileSize + 32;
+        aviHeader_writeUInt32(bufp,
+                              (offset + ((size + 1U) & (~1U))) - moviPos);
+        aviHeader_writeUInt32(bufp, uint32_t(audioBufSize * 4));
         if (std::fwrite(&(tmpBuf[0]), 1, 32, aviFile) != 32)
           throw Exception("error writing AVI file index");
+        fileSize = fileSize + 32;
       }
-      if (std::fseek(aviFile, 0L, SEEK_SET) < 0)
+    }
+  }
+
+  void VideoCapture::closeAVIRIFF(bool startNewRIFF)
+  {
+    if (!aviFile)
+      return;
+    writeAVIStandardIndex();
+    if (riffCnt == 1) {
+      // the header is updated later
+      riff0MoviEndPos = fileSize;
+      riff0Frames = framesWritten;
+      writeAVILegacyIndex();
+      riff0EndPos = fileSize;
+    }
+    else {
+      // update the sizes of the "AVIX" RIFF and "movi" LIST; seeking from
+      // the end of the file avoids the 2 GB limit of std::fseek()
+      uint8_t tmpBuf[4];
+      uint8_t *bufp = &(tmpBuf[0]);
+      aviHeader_writeUInt32(bufp, uint32_t(fileSize - (riffStartPos + 8)));
+      if (std::fseek(aviFile, -long(fileSize - (riffStartPos + 4)), SEEK_END)
+          < 0) {
         throw Exception("error seeking AVI file");
+      }
+      if (std::fwrite(&(tmpBuf[0]), 1, 4, aviFile) != 4)
+        throw Exception("error writing AVI file");
       bufp = &(tmpBuf[0]);
-      aviHeader_writeFourCC(bufp, "RIFF");
-      aviHeader_writeUInt32(bufp, uint32_t(fileSize - 8));
-      if (std::fwrite(&(tmpBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file index");
-      if (std::fflush(aviFile) != 0)
-        throw Exception("error writing AVI file index");
+      aviHeader_writeUInt32(bufp, uint32_t(fileSize - (riffStartPos + 20)));
+      if (std::fseek(aviFile, -long(fileSize - (riffStartPos + 16)), SEEK_END)
+          < 0) {
+        throw Exception("error seeking AVI file");
+      }
+      if (std::fwrite(&(tmpBuf[0]), 1, 4, aviFile) != 4)
+        throw Exception("error writing AVI file");
     }
-    catch (...) {
-      std::fclose(aviFile);
-      aviFile = (std::FILE *) 0;
-      framesWritten = 0;
-      duplicateFrames = 0;
-      fileSize = 0;
-      throw;
+    if (!startNewRIFF)
+      return;
+    if (std::fseek(aviFile, 0L, SEEK_END) < 0)
+      throw Exception("error seeking AVI file");
+    uint8_t headerBuf[24];
+    uint8_t *bufp = &(headerBuf[0]);
+    aviHeader_writeFourCC(bufp, "RIFF");
+    aviHeader_writeUInt32(bufp, 0x00000010U);
+    aviHeader_writeFourCC(bufp, "AVIX");
+    aviHeader_writeFourCC(bufp, "LIST");
+    aviHeader_writeUInt32(bufp, 0x00000004U);
+    aviHeader_writeFourCC(bufp, "movi");
+    if (std::fwrite(&(headerBuf[0]), 1, 24, aviFile) != 24)
+      throw Exception("error writing AVI file");
+    riffCnt++;
+    riffStartPos = fileSize;
+    fileSize = fileSize + 24;
+  }
+
+  void VideoCapture::errorMessage(const char *msg)
+  {
+    if (msg == (char *) 0 || msg[0] == '\0')
+      msg = "unknown video capture error";
+    errorCallback(errorCallbackUserData, msg);
+  }
+
+  void VideoCapture::encoderError(const char *msg)
+  {
+    if (msg == (char *) 0 || msg[0] == '\0')
+      msg = "unknown video capture error";
+    queueMutex.lock();
+    // only the first error is reported until updateEncoderStatus() is called
+    if (encoderErrorMessage.length() < 1)
+      encoderErrorMessage = msg;
+    queueMutex.unlock();
+  }
+
+  void VideoCapture::getEncoderStatistics(size_t& framesDelayed_,
+                                          double& encoderWaitTime_) const
+  {
+    framesDelayed_ = framesDelayed;
+    encoderWaitTime_ = encoderWaitTime;
+  }
+
+  void VideoCapture::setErrorCallback(void (*func)(void *userData,
+                                                   const char *msg),
+                                      void *userData_)
+  {
+    if (func) {
+      errorCallback = func;
+      errorCallbackUserData = userData_;
+    }
+    else {
+      errorCallback = &defaultErrorCallback;
+      errorCallbackUserData = (void *) this;
+    }
+  }
+
+  void VideoCapture::setFileNameCallback(void (*func)(void *userData,
+                                                      std::string& fileName),
+                                         void *userData_)
+  {
+    if (func) {
+      fileNameCallback = func;
+      fileNameCallbackUserData = userData_;
+    }
+    else {
+      fileNameCallback = &defaultFileNameCallback;
+      fileNameCallbackUserData = (void *) this;
     }
   }
 
   // --------------------------------------------------------------------------
 
-  VideoCapture_YV12::VideoCapture_YV12(
-      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
-      int frameRate_)
-    : VideoCapture(frameRate_),
-      lineBuf((uint8_t *) 0),
-      frameBuf0Y((uint8_t *) 0),
-      frameBuf0V((uint8_t *) 0),
-      frameBuf0U((uint8_t *) 0),
-      frameBuf1Y((uint8_t *) 0),
-      frameBuf1V((uint8_t *) 0),
-      frameBuf1U((uint8_t *) 0),
-      interpBufY((int32_t *) 0),
-      interpBufV((int32_t *) 0),
-      interpBufU((int32_t *) 0),
-      outBufY((uint8_t *) 0),
-      outBufV((uint8_t *) 0),
-      outBufU((uint8_t *) 0),
-      duplicateFrameBitmap((uint8_t *) 0),
-      timesliceLength(0L),
-      curTime(0L),
-      frame0Time(-1L),
-      frame1Time(0L),
-      cycleCnt(2),
-      interpTime(0),
-      lineBufBytes(0),
-      colormap((uint32_t *) 0)
+  VideoCapture_RLE8::VideoCaptureFrameBuffer::VideoCaptureFrameBuffer(int w,
+                                                                      int h)
+    : buf((uint32_t *) 0),
+      linePtrs((uint8_t **) 0),
+      lineBytes_((uint32_t *) 0)
   {
     try {
-      aviHeaderSize = aviHeaderSize_YV12;
-      size_t    bufSize1 = size_t(videoWidth * videoHeight);
-      size_t    bufSize2 = 1024 / 4;
-      size_t    bufSize3 = (bufSize1 + 3) >> 2;
-      size_t    bufSize4 = (bufSize3 + 3) >> 2;
-      size_t    totalSize = bufSize2;
-      totalSize += (3 * (bufSize3 + bufSize4 + bufSize4));
-      totalSize += (bufSize1 + bufSize3 + bufSize3);
-      uint32_t  *videoBuf = new uint32_t[totalSize];
-      totalSize = 0;
-      lineBuf = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(lineBuf, 0x00, 1024);
-      totalSize += bufSize2;
-      frameBuf0Y = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf0Y, 0x10, bufSize1);
-      totalSize += bufSize3;
-      frameBuf0V = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf0V, 0x80, bufSize3);
-      totalSize += bufSize4;
-      frameBuf0U = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf0U, 0x80, bufSize3);
-      totalSize += bufSize4;
-      frameBuf1Y = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf1Y, 0x10, bufSize1);
-      totalSize += bufSize3;
-      frameBuf1V = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf1V, 0x80, bufSize3);
-      totalSize += bufSize4;
-      frameBuf1U = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(frameBuf1U, 0x80, bufSize3);
-      totalSize += bufSize4;
-      interpBufY = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
-      for (size_t i = 0; i < bufSize1; i++)
-        interpBufY[i] = 0;
-      totalSize += bufSize1;
-      interpBufV = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
-      for (size_t i = 0; i < bufSize3; i++)
-        interpBufV[i] = 0;
-      totalSize += bufSize3;
-      interpBufU = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
-      for (size_t i = 0; i < bufSize3; i++)
-        interpBufU[i] = 0;
-      totalSize += bufSize3;
-      outBufY = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(outBufY, 0x10, bufSize1);
-      totalSize += bufSize3;
-      outBufV = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(outBufV, 0x80, bufSize3);
-      totalSize += bufSize4;
-      outBufU = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
-      std::memset(outBufU, 0x80, bufSize3);
-      size_t  nBytes = 0x04000000 / size_t(audioBufSize);
-      duplicateFrameBitmap = new uint8_t[nBytes];
-      std::memset(duplicateFrameBitmap, 0x00, nBytes);
-      // initialize colormap
-      colormap = new uint32_t[256];
-      for (int i = 0; i < 256; i++) {
-        float   r = float(i) / 255.0f;
-        float   g = r;
-        float   b = r;
-        if (indexToRGBFunc)
-          indexToRGBFunc(uint8_t(i), r, g, b);
-        float   y = (0.299f * r) + (0.587f * g) + (0.114f * b);
-        float   u = 0.492f * (b - y);
-        float   v = 0.877f * (r - y);
-        // scale video signal to YCrCb range
-        y = 16.0f + (y * 219.5f);
-        u = 128.0f + (u * (111.5f / (0.886f * 0.492f)));
-        v = 128.0f + (v * (111.5f / (0.701f * 0.877f)));
-        y = (y > 16.0f ? (y < 235.0f ? y : 235.0f) : 16.0f);
-        u = (u > 16.0f ? (u < 239.0f ? u : 239.0f) : 16.0f);
-        v = (v > 16.0f ? (v < 239.0f ? v : 239.0f) : 16.0f);
-        // change pixel format for more efficient processing
-        colormap[i] = uint32_t(int32_t(y + 0.5f)
-                               | (int32_t(u + 0.5f) << 10)
-                               | (int32_t(v + 0.5f) << 20));
+      size_t  nBytes = (((((size_t(w) * 17) + 15) >> 4) + 3) >> 2) << 2;
+      buf = new uint32_t[(nBytes >> 2) * size_t(h)];
+      std::memset(buf, 0x00, nBytes * size_t(h));
+      linePtrs = new uint8_t*[h];
+      uint8_t *p = reinterpret_cast<uint8_t *>(buf);
+      for (int i = 0; i < h; i++) {
+        linePtrs[i] = p;
+        p = p + nBytes;
       }
+      lineBytes_ = new uint32_t[h];
+      for (int i = 0; i < h; i++)
+        lineBytes_[i] = 0U;
     }
     catch (...) {
-      if (lineBuf)
-        delete[] reinterpret_cast<uint32_t *>(lineBuf);
-      if (duplicateFrameBitmap)
-        delete[] duplicateFrameBitmap;
-      if (colormap)
-        delete[] colormap;
+      if (buf)
+        delete[] buf;
+      if (linePtrs)
+        delete[] linePtrs;
+      if (lineBytes_)
+        delete[] lineBytes_;
       throw;
     }
-    setClockFrequency(890625);
   }
 
-  VideoCapture_YV12::~VideoCapture_YV12()
+  VideoCapture_RLE8::VideoCaptureFrameBuffer::~VideoCaptureFrameBuffer()
   {
-    closeFile();
-    delete[] reinterpret_cast<uint32_t *>(lineBuf);
-    delete[] duplicateFrameBitmap;
-    delete[] colormap;
+    delete[] buf;
+    delete[] linePtrs;
+    delete[] lineBytes_;
   }
 
-  void VideoCapture_YV12::runOneCycle(uint32_t audioInput)
+  inline bool VideoCapture_RLE8::VideoCaptureFrameBuffer::compareLine(
+      long dstLine, const VideoCaptureFrameBuffer& src, long srcLine)
   {
-    soundOutputAccumulatorL += uint32_t(audioInput & 0xFFFFU);
-    soundOutputAccumulatorR += uint32_t(audioInput >> 16);
-    if (--cycleCnt == 0) {
-      cycleCnt = 2;
-      uint32_t  tmpL = (soundOutputAccumulatorL + 1U) >> 1;
-      uint32_t  tmpR = (soundOutputAccumulatorR + 1U) >> 1;
-      soundOutputAccumulatorL = 0U;
-      soundOutputAccumulatorR = 0U;
-      audioConverter->sendInputSignal(tmpL | (tmpR << 16));
-    }
-    curTime += timesliceLength;
+    if (lineBytes_[dstLine] != src.lineBytes_[srcLine])
+      return false;
+    if (src.lineBytes_[srcLine] == 0U)
+      return true;
+    return (std::memcmp(linePtrs[dstLine], src.linePtrs[srcLine],
+                        src.lineBytes_[srcLine]) == 0);
   }
 
-  void VideoCapture_YV12::setClockFrequency(size_t freq_)
+  inline void VideoCapture_RLE8::VideoCaptureFrameBuffer::copyLine(long dstLine,
+                                                                   long srcLine)
   {
-    if (freq_ == clockFrequency)
-      return;
-    clockFrequency = freq_;
-    timesliceLength = (int64_t(1000000) << 32) / int64_t(freq_);
-    audioConverter->setInputSampleRate(float(long(freq_)) * 0.5f);
+    std::memcpy(linePtrs[dstLine], linePtrs[srcLine], lineBytes_[srcLine]);
+    lineBytes_[dstLine] = lineBytes_[srcLine];
   }
 
-  void VideoCapture_YV12::horizontalSync(const uint8_t *buf, size_t nBytes)
+  inline void VideoCapture_RLE8::VideoCaptureFrameBuffer::copyLine(
+      long dstLine, const VideoCaptureFrameBuffer& src, long srcLine)
   {
-    if (curLine >= 0 && curLine < (videoHeight * 2)) {
+    std::memcpy(linePtrs[dstLine], src.linePtrs[srcLine],
+                src.lineBytes_[srcLine]);
+    lineBytes_[dstLine] = src.lineBytes_[srcLine];
+  }
+
+  void VideoCapture_RLE8::VideoCaptureFrameBuffer::clearLine(long n)
+  {
+    uint8_t *p = linePtrs[n];
+    for (int i = 0; i < 48; i++) {      // FIXME: assumes videoWidth == 768
+      *(p++) = 0x01;
+      *(p++) = 0x00;
+    }
+    lineBytes_[n] = 96U;
+  }
+
+  // --------------------------------------------------------------------------
+
+  VideoCapture_RLE8::VideoCapture_RLE8(
+      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
+      int frameRate_)
+    : VideoCapture(frameRate_),
+      tmpFrameBuf(videoWidth, videoHeight),
+      outputFrameBuf(videoWidth, videoHeight),
+      frameDataBuf((uint8_t *) 0),
+      cycleCnt(2),
+      prvOddFrame(false),
+      colormap((uint8_t *) 0)
+  {
+    for (int i = 0; i < encoderQueueSize; i++)
+      queueFrameBufs[i] = (VideoCaptureFrameBuffer *) 0;
+    try {
+      for (int i = 0; i < encoderQueueSize; i++) {
+        queueFrameBufs[i] =
+            new VideoCaptureFrameBuffer(videoWidth, videoHeight);
+      }
+      frameDataBuf = new uint8_t[size_t(videoHeight) * 1024];
+      // initialize colormap
+      colormap = new uint8_t[256 * 4];
+      for (int i = 0; i < 256; i++) {
+        float   r = float(i) / 255.0f;
+        float   g = r;
+        float   b = r;
+        if (indexToRGBFunc)
+          indexToRGBFunc(uint8_t(i), r, g, b);
+        int ri = int((r > 0.0f ? (r < 1.0f ? r : 1.0f) : 0.0f) * 255.0f + 0.5f);
+        int gi = int((g > 0.0f ? (g < 1.0f ? g : 1.0f) : 0.0f) * 255.0f + 0.5f);
+        int bi = int((b > 0.0f ? (b < 1.0f ? b : 1.0f) : 0.0f) * 255.0f + 0.5f);
+        colormap[(i * 4) + 0] = uint8_t(bi);
+        colormap[(i * 4) + 1] = uint8_t(gi);
+        colormap[(i * 4) + 2] = uint8_t(ri);
+        colormap[(i * 4) + 3] = 0x00;
+      }
+      aviVideoFormat.width = videoWidth;
+      aviVideoFormat.height = videoHeight;
+      aviVideoFormat.codec = "\001\0\0\0";        // BI_RLE8
+      aviVideoFormat.bitsPerPixel = 8;
+      aviVideoFormat.imageSize = size_t(videoWidth * videoHeight);
+      aviVideoFormat.maxFrameSize = size_t((videoWidth + 16) * videoHeight);
+      aviVideoFormat.palette = colormap;
+    }
+    catch (...) {
+      for (int i = 0; i < encoderQueueSize; i++) {
+        if (queueFrameBufs[i])
+          delete queueFrameBufs[i];
+      }
+      if (frameDataBuf)
+        delete[] frameDataBuf;
+      if (colormap)
+        delete[] colormap;
+      throw;
+    }
+    setClockFrequency(890625);
+  }
+
+  VideoCapture_RLE8::~VideoCapture_RLE8()
+  {
+    closeFile();
+    for (int i = 0; i < encoderQueueSize; i++)
+      delete queueFrameBufs[i];
+    delete[] frameDataBuf;
+    delete[] colormap;
+  }
+
+  void VideoCapture_RLE8::runOneCycle(uint32_t audioInput)
+  {
+    soundOutputAccumulatorL += uint32_t(audioInput & 0xFFFFU);
+    soundOutputAccumulatorR += uint32_t(audioInput >> 16);
+    if (--cycleCnt == 0) {
+      cycleCnt = 2;
+      uint32_t  tmpL = (soundOutputAccumulatorL + 1U) >> 1;
+      uint32_t  tmpR = (soundOutputAccumulatorR + 1U) >> 1;
+      soundOutputAccumulatorL = 0U;
+      soundOutputAccumulatorR = 0U;
+      audioConverter->sendInputSignal(tmpL | (tmpR << 16));
+    }
+  }
+
+  void VideoCapture_RLE8::setClockFrequency(size_t freq_)
+  {
+    if (freq_ == clockFrequency)
+      return;
+    clockFrequency = freq_;
+    audioConverter->setInputSampleRate(float(long(freq_)) * 0.5f);
+  }
+
+  void VideoCapture_RLE8::horizontalSync(const uint8_t *buf, size_t nBytes)
+  {
+    if (curLine >= 0 && curLine < videoHeight) {
+      uint8_t *p = &(tmpFrameBuf[curLine][0]);
+      for (size_t i = 0; i < nBytes; i++)
+        p[i] = buf[i];
+      tmpFrameBuf.lineBytes(curLine) = uint32_t(nBytes);
+      if (bool(curLine & 1) == prvOddFrame) {
+        // no interlace, need to duplicate line
+        tmpFrameBuf.copyLine(curLine ^ 1, curLine);
+      }
+    }
+    if (vsyncCnt != 0) {
+      curLine += 2;
+      if (curLine < videoHeight)
+        tmpFrameBuf.lineBytes(curLine) = 0U;
+      if (vsyncCnt >= (EP128EMU_VSYNC_MIN_LINES - EP128EMU_VSYNC_OFFSET) &&
+          (vsyncState ||
+           vsyncCnt >= (EP128EMU_VSYNC_MAX_LINES - EP128EMU_VSYNC_OFFSET))) {
+        vsyncCnt = -(EP128EMU_VSYNC_OFFSET);
+      }
+      vsyncCnt++;
+    }
+    else {
+      for (int i = (curLine + 1); i < videoHeight; i++)
+        tmpFrameBuf.clearLine(i);
+      // pass a copy of the frame to the encoder thread
+      VideoCaptureFrameBuffer&  frameBuf = *(queueFrameBufs[queueWritePos]);
+      for (int i = 0; i < videoHeight; i++)
+        frameBuf.copyLine(i, tmpFrameBuf, i);
+      queueFrame();
+      prvOddFrame = bool(curLine & 1);
+      curLine = (oddFrame ? -1 : 0);
+      if (curLine >= 0)
+        tmpFrameBuf.lineBytes(curLine) = 0U;
+      vsyncCnt++;
+      oddFrame = false;
+      updateEncoderStatus();
+    }
+  }
+
+  void VideoCapture_RLE8::encodeFrame(int n)
+  {
+    frameDone(*(queueFrameBufs[n]));
+  }
+
+  void VideoCapture_RLE8::frameDone(const VideoCaptureFrameBuffer& frameBuf)
+  {
+    if (audioBufSamples >= (audioBufSize * 2)) {
+      bool    frameChanged = false;
+      for (int i = 0; i < videoHeight; i++) {
+        if (!outputFrameBuf.compareLine(i, frameBuf, i)) {
+          frameChanged = true;
+          outputFrameBuf.copyLine(i, frameBuf, i);
+        }
+      }
+      do {
+        audioBufSamples -= (audioBufSize * 2);
+        writeFrame(frameChanged);
+        frameChanged = false;
+        audioBufReadPos += (audioBufSize * 2);
+        while (audioBufReadPos >= (audioBufSize * audioBuffers * 2))
+          audioBufReadPos -= (audioBufSize * audioBuffers * 2);
+      } while (audioBufSamples >= (audioBufSize * 2));
+    }
+  }
+
+  void VideoCapture_RLE8::decodeLine(uint8_t *outBuf, const uint8_t *inBuf)
+  {
+    for (size_t i = 0; i < (videoWidth / 16); i++) {
+      uint8_t c = *(inBuf++);
+      switch (c) {
+      case 0x01:
+        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  =
+        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
+        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
+        break;
+      case 0x02:
+        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
+        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
+        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  = *(inBuf++);
+        break;
+      case 0x03:
+        {
+          uint8_t c0 = *(inBuf++);
+          uint8_t c1 = *(inBuf++);
+          uint8_t b = *(inBuf++);
+          outBuf[1]  = outBuf[0]  = ((b & 128) ? c1 : c0);
+          outBuf[3]  = outBuf[2]  = ((b &  64) ? c1 : c0);
+          outBuf[5]  = outBuf[4]  = ((b &  32) ? c1 : c0);
+          outBuf[7]  = outBuf[6]  = ((b &  16) ? c1 : c0);
+          outBuf[9]  = outBuf[8]  = ((b &   8) ? c1 : c0);
+          outBuf[11] = outBuf[10] = ((b &   4) ? c1 : c0);
+          outBuf[13] = outBuf[12] = ((b &   2) ? c1 : c0);
+          outBuf[15] = outBuf[14] = ((b &   1) ? c1 : c0);
+        }
+        break;
+      case 0x04:
+        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = *(inBuf++);
+        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  = *(inBuf++);
+        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  = *(inBuf++);
+        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] = *(inBuf++);
+        break;
+      case 0x06:
+        {
+          uint8_t c0 = *(inBuf++);
+          uint8_t c1 = *(inBuf++);
+          uint8_t b = *(inBuf++);
+          outBuf[0]  = ((b & 128) ? c1 : c0);
+          outBuf[1]  = ((b &  64) ? c1 : c0);
+          outBuf[2]  = ((b &  32) ? c1 : c0);
+          outBuf[3]  = ((b &  16) ? c1 : c0);
+          outBuf[4]  = ((b &   8) ? c1 : c0);
+          outBuf[5]  = ((b &   4) ? c1 : c0);
+          outBuf[6]  = ((b &   2) ? c1 : c0);
+          outBuf[7]  = ((b &   1) ? c1 : c0);
+          c0 = *(inBuf++);
+          c1 = *(inBuf++);
+          b = *(inBuf++);
+          outBuf[8]  = ((b & 128) ? c1 : c0);
+          outBuf[9]  = ((b &  64) ? c1 : c0);
+          outBuf[10] = ((b &  32) ? c1 : c0);
+          outBuf[11] = ((b &  16) ? c1 : c0);
+          outBuf[12] = ((b &   8) ? c1 : c0);
+          outBuf[13] = ((b &   4) ? c1 : c0);
+          outBuf[14] = ((b &   2) ? c1 : c0);
+          outBuf[15] = ((b &   1) ? c1 : c0);
+        }
+        break;
+      case 0x08:
+        outBuf[1]  = outBuf[0]  = *(inBuf++);
+        outBuf[3]  = outBuf[2]  = *(inBuf++);
+        outBuf[5]  = outBuf[4]  = *(inBuf++);
+        outBuf[7]  = outBuf[6]  = *(inBuf++);
+        outBuf[9]  = outBuf[8]  = *(inBuf++);
+        outBuf[11] = outBuf[10] = *(inBuf++);
+        outBuf[13] = outBuf[12] = *(inBuf++);
+        outBuf[15] = outBuf[14] = *(inBuf++);
+        break;
+      case 0x10:
+        outBuf[0]  = *(inBuf++);
+        outBuf[1]  = *(inBuf++);
+        outBuf[2]  = *(inBuf++);
+        outBuf[3]  = *(inBuf++);
+        outBuf[4]  = *(inBuf++);
+        outBuf[5]  = *(inBuf++);
+        outBuf[6]  = *(inBuf++);
+        outBuf[7]  = *(inBuf++);
+        outBuf[8]  = *(inBuf++);
+        outBuf[9]  = *(inBuf++);
+        outBuf[10] = *(inBuf++);
+        outBuf[11] = *(inBuf++);
+        outBuf[12] = *(inBuf++);
+        outBuf[13] = *(inBuf++);
+        outBuf[14] = *(inBuf++);
+        outBuf[15] = *(inBuf++);
+        break;
+      default:
+        outBuf[15] = outBuf[14] = outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] = outBuf[9]  = outBuf[8]  =
+        outBuf[7]  = outBuf[6]  = outBuf[5]  = outBuf[4]  =
+        outBuf[3]  = outBuf[2]  = outBuf[1]  = outBuf[0]  = 0;
+        break;
+      }
+      outBuf = outBuf + 16;
+    }
+  }
+
+  size_t VideoCapture_RLE8::rleCompressLine(uint8_t *outBuf,
+                                            const uint8_t *inBuf)
+  {
+    uint8_t runLengths[1024];
+    uint8_t byteValues[1024];
+    size_t  nBytes = 0;
+    int     n = 0;
+    int     runLength = 1;
+    for (int i = 1; i < videoWidth; i++) {
+      if (inBuf[i] != inBuf[i - 1]) {
+        runLengths[n] = uint8_t(runLength);
+        byteValues[n++] = inBuf[i - 1];
+        runLength = 1;
+      }
+      else {
+        if (++runLength >= 256) {
+          runLengths[n] = 255;
+          byteValues[n++] = inBuf[i - 1];
+          runLength = 1;
+        }
+      }
+    }
+    runLengths[n] = uint8_t(runLength);
+    byteValues[n++] = inBuf[videoWidth - 1];
+    for (int i = 0; i < n; ) {
+      if (runLengths[i] >= 2 || (i + 1) >= n) {
+        outBuf[nBytes++] = runLengths[i];
+        outBuf[nBytes++] = byteValues[i];
+        i++;
+      }
+      else {
+        int     j = i + 1;
+        int     bytesToCopy = int(runLengths[i]);
+        int     minLength = 3;
+        do {
+          int     tmp = int(runLengths[j]);
+          if (tmp >= minLength || (bytesToCopy + tmp) > 255)
+            break;
+          bytesToCopy += tmp;
+          minLength = 4 | (bytesToCopy & 1);
+        } while (++j < n);
+        if (bytesToCopy >= 3) {
+          outBuf[nBytes++] = 0x00;
+          outBuf[nBytes++] = uint8_t(bytesToCopy);
+          do {
+            int     k = int(runLengths[i]);
+            uint8_t tmp = byteValues[i];
+            do {
+              outBuf[nBytes++] = tmp;
+            } while (--k != 0);
+          } while (++i < j);
+          if (bytesToCopy & 1)
+            outBuf[nBytes++] = 0x00;
+        }
+        else {
+          do {
+            outBuf[nBytes++] = runLengths[i];
+            outBuf[nBytes++] = byteValues[i];
+          } while (++i < j);
+        }
+      }
+    }
+    outBuf[nBytes++] = 0x00;    // end of line
+    outBuf[nBytes++] = 0x00;
+    return nBytes;
+  }
+
+  void VideoCapture_RLE8::writeFrame(bool frameChanged)
+  {
+    if (!aviFile)
+      return;
+    if (!frameChanged) {
+      if (framesWritten == 0 || duplicateFrames >= size_t(frameRate))
+        frameChanged = true;
+      else
+        duplicateFrames++;
+    }
+    if (frameChanged)
+      duplicateFrames = 0;
+    size_t  nBytes = 0;
+    if (frameChanged) {
+      uint8_t lineBuf[1024];
+      size_t  n = 0;
+      for (int i = (videoHeight - 1); i >= 0; i--) {
+        if (i == (videoHeight - 1) ||
+            !outputFrameBuf.compareLine(i, outputFrameBuf, i + 1)) {
+          decodeLine(&(lineBuf[0]), outputFrameBuf[i]);
+          n = rleCompressLine(&(frameDataBuf[nBytes]), &(lineBuf[0]));
+        }
+        else {
+          // same as the previous line
+          std::memmove(&(frameDataBuf[nBytes]), &(frameDataBuf[nBytes - n]),
+                       n);
+        }
+        nBytes += n;
+      }
+    }
+    writeAVIFrame(frameDataBuf, nBytes, frameChanged);
+  }
+
+  // --------------------------------------------------------------------------
+
+  // add (buf0[i] + buf1[i]) * scaleFac to interpBuf[i] for 'n' samples
+  static void yv12ResampleScalar(int32_t *interpBuf,
+                                 const uint8_t *buf0, const uint8_t *buf1,
+                                 int32_t scaleFac, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      interpBuf[i] += ((int32_t(buf0[i]) + int32_t(buf1[i])) * scaleFac);
+  }
+
+  // calculate 'n' output samples from the interpolation buffer and the
+  // current frames, and store the new interpolation buffer state;
+  // returns true if any output sample has changed
+  static bool yv12InterpolateScalar(uint8_t *outBuf, int32_t *interpBuf,
+                                    const uint8_t *buf0, const uint8_t *buf1,
+                                    int32_t scaleFac0, int32_t scaleFac1,
+                                    int32_t outScale, size_t n)
+  {
+    uint8_t   frameChanged = 0x00;
+    for (size_t i = 0; i < n; i++) {
+      int32_t   tmp = (int32_t(buf0[i]) * scaleFac0)
+                      + (int32_t(buf1[i]) * scaleFac1);
+      uint8_t   tmp2 = uint8_t(((((interpBuf[i] - tmp) >> 8) * outScale)
+                                 + 0x00200000) >> 22);
+      interpBuf[i] = tmp;
+      frameChanged |= (tmp2 ^ outBuf[i]);
+      outBuf[i] = tmp2;
+    }
+    return bool(frameChanged);
+  }
+
+#ifdef EP128EMU_YV12_SIMD
+
+  // SSE2 has no 32-bit multiply, so the products of 16-bit samples and
+  // 32-bit factors are calculated from the 16-bit halves of the factor
+
+  static EP128EMU_INLINE __attribute__ ((__target__ ("sse2")))
+  void yv12MulSSE2(__m128i& r0, __m128i& r1, __m128i x, __m128i l, __m128i h)
+  {
+    __m128i lo = _mm_mullo_epi16(x, l);
+    __m128i hi = _mm_add_epi16(_mm_mulhi_epu16(x, l), _mm_mullo_epi16(x, h));
+    r0 = _mm_unpacklo_epi16(lo, hi);
+    r1 = _mm_unpackhi_epi16(lo, hi);
+  }
+
+  static EP128EMU_INLINE __attribute__ ((__target__ ("sse2")))
+  __m128i yv12MulLo32SSE2(__m128i a, __m128i b)
+  {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, 0x08),
+                              _mm_shuffle_epi32(odd, 0x08));
+  }
+
+  static __attribute__ ((__target__ ("sse2")))
+  void yv12ResampleSSE2(int32_t *interpBuf,
+                        const uint8_t *buf0, const uint8_t *buf1,
+                        int32_t scaleFac, size_t n)
+  {
+    __m128i l = _mm_set1_epi16(short(uint32_t(scaleFac) & 0xFFFFU));
+    __m128i h = _mm_set1_epi16(short(uint32_t(scaleFac) >> 16));
+    __m128i z = _mm_setzero_si128();
+    size_t  i = 0;
+    for ( ; (i + 16) <= n; i += 16) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf0 + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf1 + i));
+      __m128i x[4];
+      yv12MulSSE2(x[0], x[1],
+                  _mm_add_epi16(_mm_unpacklo_epi8(a, z),
+                                _mm_unpacklo_epi8(b, z)), l, h);
+      yv12MulSSE2(x[2], x[3],
+                  _mm_add_epi16(_mm_unpackhi_epi8(a, z),
+                                _mm_unpackhi_epi8(b, z)), l, h);
+      for (int j = 0; j < 4; j++) {
+        __m128i *p = reinterpret_cast<__m128i *>(interpBuf + (i + (j << 2)));
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), x[j]));
+      }
+    }
+    yv12ResampleScalar(interpBuf + i, buf0 + i, buf1 + i, scaleFac, n - i);
+  }
+
+  static __attribute__ ((__target__ ("sse2")))
+  bool yv12InterpolateSSE2(uint8_t *outBuf, int32_t *interpBuf,
+                           const uint8_t *buf0, const uint8_t *buf1,
+                           int32_t scaleFac0, int32_t scaleFac1,
+                           int32_t outScale, size_t n)
+  {
+    __m128i l0 = _mm_set1_epi16(short(uint32_t(scaleFac0) & 0xFFFFU));
+    __m128i h0 = _mm_set1_epi16(short(uint32_t(scaleFac0) >> 16));
+    __m128i l1 = _mm_set1_epi16(short(uint32_t(scaleFac1) & 0xFFFFU));
+    __m128i h1 = _mm_set1_epi16(short(uint32_t(scaleFac1) >> 16));
+    __m128i s = _mm_set1_epi32(outScale);
+    __m128i r = _mm_set1_epi32(0x00200000);
+    __m128i m = _mm_set1_epi32(0xFF);
+    __m128i z = _mm_setzero_si128();
+    __m128i changed = z;
+    size_t  i = 0;
+    for ( ; (i + 16) <= n; i += 16) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf0 + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf1 + i));
+      __m128i x[4];
+      __m128i y[4];
+      yv12MulSSE2(x[0], x[1], _mm_unpacklo_epi8(a, z), l0, h0);
+      yv12MulSSE2(x[2], x[3], _mm_unpackhi_epi8(a, z), l0, h0);
+      yv12MulSSE2(y[0], y[1], _mm_unpacklo_epi8(b, z), l1, h1);
+      yv12MulSSE2(y[2], y[3], _mm_unpackhi_epi8(b, z), l1, h1);
+      for (int j = 0; j < 4; j++) {
+        __m128i *p = reinterpret_cast<__m128i *>(interpBuf + (i + (j << 2)));
+        __m128i tmp = _mm_add_epi32(x[j], y[j]);
+        __m128i d = _mm_srai_epi32(_mm_sub_epi32(_mm_loadu_si128(p), tmp), 8);
+        d = _mm_srai_epi32(_mm_add_epi32(yv12MulLo32SSE2(d, s), r), 22);
+        _mm_storeu_si128(p, tmp);
+        x[j] = _mm_and_si128(d, m);
+      }
+      __m128i o = _mm_packus_epi16(_mm_packs_epi32(x[0], x[1]),
+                                   _mm_packs_epi32(x[2], x[3]));
+      __m128i *q = reinterpret_cast<__m128i *>(outBuf + i);
+      changed = _mm_or_si128(changed, _mm_xor_si128(o, _mm_loadu_si128(q)));
+      _mm_storeu_si128(q, o);
+    }
+    bool    frameChanged = (_mm_movemask_epi8(_mm_cmpeq_epi8(changed, z))
+                            != 0xFFFF);
+    frameChanged |= yv12InterpolateScalar(outBuf + i, interpBuf + i,
+                                          buf0 + i, buf1 + i,
+                                          scaleFac0, scaleFac1, outScale,
+                                          n - i);
+    return frameChanged;
+  }
+
+  static __attribute__ ((__target__ ("avx2")))
+  void yv12ResampleAVX2(int32_t *interpBuf,
+                        const uint8_t *buf0, const uint8_t *buf1,
+                        int32_t scaleFac, size_t n)
+  {
+    __m256i s = _mm256_set1_epi32(scaleFac);
+    size_t  i = 0;
+    for ( ; (i + 8) <= n; i += 8) {
+      __m256i a = _mm256_cvtepu8_epi32(
+                      _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                                          buf0 + i)));
+      __m256i b = _mm256_cvtepu8_epi32(
+                      _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                                          buf1 + i)));
+      __m256i *p = reinterpret_cast<__m256i *>(interpBuf + i);
+      _mm256_storeu_si256(
+          p, _mm256_add_epi32(_mm256_loadu_si256(p),
+                              _mm256_mullo_epi32(_mm256_add_epi32(a, b), s)));
+    }
+    yv12ResampleScalar(interpBuf + i, buf0 + i, buf1 + i, scaleFac, n - i);
+  }
+
+  static __attribute__ ((__target__ ("avx2")))
+  bool yv12InterpolateAVX2(uint8_t *outBuf, int32_t *interpBuf,
+                           const uint8_t *buf0, const uint8_t *buf1,
+                           int32_t scaleFac0, int32_t scaleFac1,
+                           int32_t outScale, size_t n)
+  {
+    __m256i s0 = _mm256_set1_epi32(scaleFac0);
+    __m256i s1 = _mm256_set1_epi32(scaleFac1);
+    __m256i s = _mm256_set1_epi32(outScale);
+    __m256i r = _mm256_set1_epi32(0x00200000);
+    __m256i m = _mm256_set1_epi32(0xFF);
+    // restores the order of the samples after packing
+    __m256i perm = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i changed = _mm256_setzero_si256();
+    size_t  i = 0;
+    for ( ; (i + 32) <= n; i += 32) {
+      __m256i x[4];
+      for (int j = 0; j < 4; j++) {
+        size_t  k = i + size_t(j << 3);
+        __m256i a = _mm256_cvtepu8_epi32(
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                                            buf0 + k)));
+        __m256i b = _mm256_cvtepu8_epi32(
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                                            buf1 + k)));
+        __m256i tmp = _mm256_add_epi32(_mm256_mullo_epi32(a, s0),
+                                       _mm256_mullo_epi32(b, s1));
+        __m256i *p = reinterpret_cast<__m256i *>(interpBuf + k);
+        __m256i d = _mm256_srai_epi32(
+                        _mm256_sub_epi32(_mm256_loadu_si256(p), tmp), 8);
+        d = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(d, s), r),
+                              22);
+        _mm256_storeu_si256(p, tmp);
+        x[j] = _mm256_and_si256(d, m);
+      }
+      __m256i o = _mm256_packus_epi16(_mm256_packs_epi32(x[0], x[1]),
+                                      _mm256_packs_epi32(x[2], x[3]));
+      o = _mm256_permutevar8x32_epi32(o, perm);
+      __m256i *q = reinterpret_cast<__m256i *>(outBuf + i);
+      changed = _mm256_or_si256(changed,
+                                _mm256_xor_si256(o, _mm256_loadu_si256(q)));
+      _mm256_storeu_si256(q, o);
+    }
+    bool    frameChanged = !_mm256_testz_si256(changed, changed);
+    frameChanged |= yv12InterpolateScalar(outBuf + i, interpBuf + i,
+                                          buf0 + i, buf1 + i,
+                                          scaleFac0, scaleFac1, outScale,
+                                          n - i);
+    return frameChanged;
+  }
+
+#endif  // EP128EMU_YV12_SIMD
+
+  // compare the results of the selected resample and interpolate functions
+  // with the scalar versions on pseudo-random input; returns false if they
+  // are not identical
+  static bool yv12CheckFunctions(
+      void (*resampleFunc)(int32_t *, const uint8_t *, const uint8_t *,
+                           int32_t, size_t),
+      bool (*interpolateFunc)(uint8_t *, int32_t *,
+                              const uint8_t *, const uint8_t *,
+                              int32_t, int32_t, int32_t, size_t))
+  {
+    // not a multiple of the vector size, so that the scalar code that
+    // processes the remaining samples is also tested
+    const size_t  n = 1000;
+    std::vector< uint8_t >  buf0(n);
+    std::vector< uint8_t >  buf1(n);
+    std::vector< uint8_t >  outBuf1(n);
+    std::vector< uint8_t >  outBuf2(n);
+    std::vector< int32_t >  interpBuf1(n);
+    std::vector< int32_t >  interpBuf2(n);
+    uint32_t  seed = 0x12345678U;
+    for (size_t i = 0; i < n; i++) {
+      seed = (seed * 1103515245U) + 12345U;
+      buf0[i] = uint8_t(seed >> 24);
+      buf1[i] = uint8_t(seed >> 16);
+      outBuf1[i] = outBuf2[i] = uint8_t(seed >> 8);
+      interpBuf1[i] = interpBuf2[i] = int32_t(seed & 0x00FFFFFFU);
+    }
+    // test small and large factors, including some that do not fit in
+    // 16 bits
+    static const int32_t  scaleFacs[8] = {
+      0, 1, 255, 20000, 33333, 66667, 0x01234567, -40000
+    };
+    for (int j = 0; j < 8; j++) {
+      int32_t scaleFac0 = scaleFacs[j];
+      int32_t scaleFac1 = scaleFacs[7 - j];
+      int32_t outScale = int32_t(0x20000000) / ((j << 12) + 1);
+      yv12ResampleScalar(&(interpBuf1.front()),
+                         &(buf0.front()), &(buf1.front()), scaleFac0, n);
+      resampleFunc(&(interpBuf2.front()),
+                   &(buf0.front()), &(buf1.front()), scaleFac0, n);
+      bool    changed1 =
+          yv12InterpolateScalar(&(outBuf1.front()), &(interpBuf1.front()),
+                                &(buf0.front()), &(buf1.front()),
+                                scaleFac0, scaleFac1, outScale, n);
+      bool    changed2 =
+          interpolateFunc(&(outBuf2.front()), &(interpBuf2.front()),
+                          &(buf0.front()), &(buf1.front()),
+                          scaleFac0, scaleFac1, outScale, n);
+      if (changed1 != changed2 || outBuf1 != outBuf2 ||
+          interpBuf1 != interpBuf2) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  VideoCapture_YV12::VideoCapture_YV12(
+      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
+      int frameRate_)
+    : VideoCapture(frameRate_),
+      lineBuf((uint8_t *) 0),
+      frameBuf0Y((uint8_t *) 0),
+      frameBuf0V((uint8_t *) 0),
+      frameBuf0U((uint8_t *) 0),
+      frameBuf1Y((uint8_t *) 0),
+      frameBuf1V((uint8_t *) 0),
+      frameBuf1U((uint8_t *) 0),
+      queueFrameBuf((uint8_t *) 0),
+      queueLineFlags((uint8_t *) 0),
+      interpBufY((int32_t *) 0),
+      interpBufV((int32_t *) 0),
+      interpBufU((int32_t *) 0),
+      outBufY((uint8_t *) 0),
+      outBufV((uint8_t *) 0),
+      outBufU((uint8_t *) 0),
+      timesliceLength(0L),
+      curTime(0L),
+      frame0Time(-1L),
+      frame1Time(0L),
+      cycleCnt(2),
+      interpTime(0),
+      lineBufBytes(0),
+      colormap((uint32_t *) 0),
+      resampleFunc(&yv12ResampleScalar),
+      interpolateFunc(&yv12InterpolateScalar)
+  {
+#ifdef EP128EMU_YV12_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      resampleFunc = &yv12ResampleAVX2;
+      interpolateFunc = &yv12InterpolateAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+      resampleFunc = &yv12ResampleSSE2;
+      interpolateFunc = &yv12InterpolateSSE2;
+    }
+    if (!yv12CheckFunctions(resampleFunc, interpolateFunc)) {
+      resampleFunc = &yv12ResampleScalar;
+      interpolateFunc = &yv12InterpolateScalar;
+    }
+#endif
+    try {
+      size_t    bufSize1 = size_t(videoWidth * videoHeight);
+      size_t    bufSize2 = 1024 / 4;
+      size_t    bufSize3 = (bufSize1 + 3) >> 2;
+      size_t    bufSize4 = (bufSize3 + 3) >> 2;
+      size_t    totalSize = bufSize2;
+      totalSize += (3 * (bufSize3 + bufSize4 + bufSize4));
+      totalSize += (bufSize1 + bufSize3 + bufSize3);
+      uint32_t  *videoBuf = new uint32_t[totalSize];
+      totalSize = 0;
+      lineBuf = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(lineBuf, 0x00, 1024);
+      totalSize += bufSize2;
+      frameBuf0Y = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(frameBuf0Y, 0x10, bufSize1);
+      totalSize += bufSize3;
+      frameBuf0V = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(frameBuf0V, 0x80, bufSize3);
+      totalSize += bufSize4;
+      frameBuf0U = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(frameBuf0U, 0x80, bufSize3);
+      totalSize += bufSize4;
+      frameBuf1Y = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      totalSize += bufSize3;
+      frameBuf1V = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      totalSize += bufSize4;
+      frameBuf1U = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      totalSize += bufSize4;
+      interpBufY = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
+      for (size_t i = 0; i < bufSize1; i++)
+        interpBufY[i] = 0;
+      totalSize += bufSize1;
+      interpBufV = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
+      for (size_t i = 0; i < bufSize3; i++)
+        interpBufV[i] = 0;
+      totalSize += bufSize3;
+      interpBufU = reinterpret_cast<int32_t *>(&(videoBuf[totalSize]));
+      for (size_t i = 0; i < bufSize3; i++)
+        interpBufU[i] = 0;
+      totalSize += bufSize3;
+      outBufY = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(outBufY, 0x10, bufSize1);
+      totalSize += bufSize3;
+      outBufV = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(outBufV, 0x80, bufSize3);
+      totalSize += bufSize4;
+      outBufU = reinterpret_cast<uint8_t *>(&(videoBuf[totalSize]));
+      std::memset(outBufU, 0x80, bufSize3);
+      for (int i = 0; i < encoderQueueSize; i++)
+        queueFrameTimes[i] = 0L;
+      // the line flags are stored after the line data
+      size_t    queueLines = size_t(encoderQueueSize * videoHeight);
+      queueFrameBuf =
+          new uint8_t[queueLines * (size_t(lineDataBytes) + 1)];
+      queueLineFlags = queueFrameBuf + (queueLines * size_t(lineDataBytes));
+      clearQueueFrame();
+      // initialize colormap
+      colormap = new uint32_t[256];
+      for (int i = 0; i < 256; i++) {
+        float   r = float(i) / 255.0f;
+        float   g = r;
+        float   b = r;
+        if (indexToRGBFunc)
+          indexToRGBFunc(uint8_t(i), r, g, b);
+        float   y = (0.299f * r) + (0.587f * g) + (0.114f * b);
+        float   u = 0.492f * (b - y);
+        float   v = 0.877f * (r - y);
+        // scale video signal to YCrCb range
+        y = 16.0f + (y * 219.5f);
+        u = 128.0f + (u * (111.5f / (0.886f * 0.492f)));
+        v = 128.0f + (v * (111.5f / (0.701f * 0.877f)));
+        y = (y > 16.0f ? (y < 235.0f ? y : 235.0f) : 16.0f);
+        u = (u > 16.0f ? (u < 239.0f ? u : 239.0f) : 16.0f);
+        v = (v > 16.0f ? (v < 239.0f ? v : 239.0f) : 16.0f);
+        // change pixel format for more efficient processing
+        colormap[i] = uint32_t(int32_t(y + 0.5f)
+                               | (int32_t(u + 0.5f) << 10)
+                               | (int32_t(v + 0.5f) << 20));
+      }
+      aviVideoFormat.width = videoWidth;
+      aviVideoFormat.height = videoHeight;
+      aviVideoFormat.codec = "YV12";
+      aviVideoFormat.bitsPerPixel = 24;
+      aviVideoFormat.imageSize = size_t(videoWidth * videoHeight * 3);
+      aviVideoFormat.maxFrameSize = size_t((videoWidth * videoHeight * 3) / 2);
+    }
+    catch (...) {
+      if (lineBuf)
+        delete[] reinterpret_cast<uint32_t *>(lineBuf);
+      if (queueFrameBuf)
+        delete[] queueFrameBuf;
+      if (colormap)
+        delete[] colormap;
+      throw;
+    }
+    setClockFrequency(890625);
+  }
+
+  VideoCapture_YV12::~VideoCapture_YV12()
+  {
+    closeFile();
+    delete[] reinterpret_cast<uint32_t *>(lineBuf);
+    delete[] queueFrameBuf;
+    delete[] colormap;
+  }
+
+  void VideoCapture_YV12::runOneCycle(uint32_t audioInput)
+  {
+    soundOutputAccumulatorL += uint32_t(audioInput & 0xFFFFU);
+    soundOutputAccumulatorR += uint32_t(audioInput >> 16);
+    if (--cycleCnt == 0) {
+      cycleCnt = 2;
+      uint32_t  tmpL = (soundOutputAccumulatorL + 1U) >> 1;
+      uint32_t  tmpR = (soundOutputAccumulatorR + 1U) >> 1;
+      soundOutputAccumulatorL = 0U;
+      soundOutputAccumulatorR = 0U;
+      audioConverter->sendInputSignal(tmpL | (tmpR << 16));
+    }
+    queueFrameTimes[queueWritePos] += timesliceLength;
+  }
+
+  void VideoCapture_YV12::setClockFrequency(size_t freq_)
+  {
+    if (freq_ == clockFrequency)
+      return;
+    clockFrequency = freq_;
+    timesliceLength = (int64_t(1000000) << 32) / int64_t(freq_);
+    audioConverter->setInputSampleRate(float(long(freq_)) * 0.5f);
+  }
+
+  void VideoCapture_YV12::horizontalSync(const uint8_t *buf, size_t nBytes)
+  {
+    if (curLine >= 0 && curLine < (videoHeight * 2)) {
       uint8_t *p = lineBuf;
       for (size_t i = 0; i < nBytes; i++)
         p[i] = buf[i];
       lineBufBytes = nBytes;
-      decodeLine();
+      // store the line for decoding on the encoder thread; lineBuf is
+      // copied (rather than 'buf') because decodeLine() may read more
+      // than 'nBytes' bytes
+      size_t  n = size_t(queueWritePos * videoHeight + (curLine >> 1));
+      std::memcpy(&(queueFrameBuf[n * size_t(lineDataBytes)]), lineBuf,
+                  size_t(lineDataBytes));
+      queueLineFlags[n] = 1;
     }
     lineBufBytes = 0;
     if (vsyncCnt != 0) {
@@ -1127,19 +1874,46 @@ namespace Ep128Emu {
       curLine = (oddFrame ? -1 : 0);
       vsyncCnt++;
       oddFrame = false;
-      frameDone();
+      queueFrame();
+      clearQueueFrame();
+      updateEncoderStatus();
+    }
+  }
+
+  void VideoCapture_YV12::clearQueueFrame()
+  {
+    std::memset(&(queueLineFlags[queueWritePos * videoHeight]), 0,
+                size_t(videoHeight));
+    queueFrameTimes[queueWritePos] = 0L;
+  }
+
+  void VideoCapture_YV12::encodeFrame(int n)
+  {
+    size_t  bufSize1 = size_t(videoWidth * videoHeight);
+    size_t  bufSize3 = size_t((videoWidth >> 1) * (videoHeight >> 1));
+    std::memset(frameBuf1Y, 0x10, bufSize1);
+    std::memset(frameBuf1V, 0x80, bufSize3);
+    std::memset(frameBuf1U, 0x80, bufSize3);
+    // the lines are decoded in order, since the odd lines are averaged
+    // with the chroma of the even ones
+    const uint8_t *lineFlags = &(queueLineFlags[n * videoHeight]);
+    const uint8_t *lineData =
+        &(queueFrameBuf[size_t(n * videoHeight) * size_t(lineDataBytes)]);
+    for (int i = 0; i < videoHeight; i++) {
+      if (lineFlags[i])
+        decodeLine(i, &(lineData[size_t(i) * size_t(lineDataBytes)]));
     }
+    curTime += queueFrameTimes[n];
+    frameDone();
   }
 
-  void VideoCapture_YV12::decodeLine()
+  void VideoCapture_YV12::decodeLine(int lineNum, const uint8_t *bufp)
   {
-    int       lineNum = curLine >> 1;
     int       offs = lineNum * videoWidth;
     uint8_t   *yPtr = &(frameBuf1Y[offs]);
     offs = (lineNum >> 1) * (videoWidth >> 1);
     uint8_t   *vPtr = &(frameBuf1V[offs]);
     uint8_t   *uPtr = &(frameBuf1U[offs]);
-    const uint8_t   *bufp = lineBuf;
 
     if (!(lineNum & 1)) {
       for (size_t i = 0; i < 48; i++) {
@@ -1646,29 +2420,11 @@ namespace Ep128Emu {
       int32_t   scaleFac1 = int32_t(double(t1) * (2.0 - tt) + 0.5);
       int32_t   outScale = int32_t(0x20000000) / (interpTime - t1);
       interpTime = t1;
-      int       n = (videoWidth * videoHeight * 3) / 2;
-      int       i = 0;
-      uint8_t   frameChanged = 0x00;
-      do {
-        int32_t   tmp;
-        uint8_t   tmp2;
-        tmp = (int32_t(frameBuf0Y[i]) * scaleFac0)
-              + (int32_t(frameBuf1Y[i]) * scaleFac1);
-        tmp2 = uint8_t(((((interpBufY[i] - tmp) >> 8) * outScale)
-                        + 0x00200000) >> 22);
-        interpBufY[i] = tmp;
-        frameChanged |= (tmp2 ^ outBufY[i]);
-        outBufY[i] = tmp2;
-        i++;
-        tmp = (int32_t(frameBuf0Y[i]) * scaleFac0)
-              + (int32_t(frameBuf1Y[i]) * scaleFac1);
-        tmp2 = uint8_t(((((interpBufY[i] - tmp) >> 8) * outScale)
-                        + 0x00200000) >> 22);
-        interpBufY[i] = tmp;
-        frameChanged |= (tmp2 ^ outBufY[i]);
-        outBufY[i] = tmp2;
-      } while (++i < n);
-      writeFrame(bool(frameChanged));
+      bool      frameChanged =
+          interpolateFunc(outBufY, interpBufY, frameBuf0Y, frameBuf1Y,
+                          scaleFac0, scaleFac1, outScale,
+                          size_t((videoWidth * videoHeight * 3) / 2));
+      writeFrame(frameChanged);
       audioBufReadPos += (audioBufSize * 2);
       while (audioBufReadPos >= (audioBufSize * audioBuffers * 2))
         audioBufReadPos -= (audioBufSize * audioBuffers * 2);
@@ -1682,6 +2438,8 @@ namespace Ep128Emu {
     curTime += (frameTime - frame1Time);
     frame0Time += (frameTime - frame1Time);
     frame1Time = frameTime;
+    // the current frame becomes the previous one, and the buffer of that
+    // is reused for decoding the next frame
     uint8_t   *tmp = frameBuf0Y;
     frameBuf0Y = frameBuf1Y;
     frameBuf1Y = tmp;
@@ -1691,11 +2449,6 @@ namespace Ep128Emu {
     tmp = frameBuf0U;
     frameBuf0U = frameBuf1U;
     frameBuf1U = tmp;
-    std::memset(frameBuf1Y, 0x10, size_t(videoWidth * videoHeight));
-    std::memset(frameBuf1V, 0x80,
-                size_t((videoWidth >> 1) * (videoHeight >> 1)));
-    std::memset(frameBuf1U, 0x80,
-                size_t((videoWidth >> 1) * (videoHeight >> 1)));
   }
 
   void VideoCapture_YV12::resampleFrame()
@@ -1705,340 +2458,667 @@ namespace Ep128Emu {
     int32_t   scaleFac =
         int32_t(((frame1Time - frame0Time) + int64_t(0x80000000UL)) >> 32);
     interpTime += scaleFac;
-    int       n = (videoWidth * videoHeight * 3) / 2;
-    int       i = 0;
+    resampleFunc(interpBufY, frameBuf0Y, frameBuf1Y, scaleFac,
+                 size_t((videoWidth * videoHeight * 3) / 2));
+  }
+
+  void VideoCapture_YV12::writeFrame(bool frameChanged)
+  {
+    if (!aviFile)
+      return;
+    if (!frameChanged) {
+      if (framesWritten == 0 || duplicateFrames >= size_t(frameRate))
+        frameChanged = true;
+      else
+        duplicateFrames++;
+    }
+    size_t  nBytes = 0;
+    if (frameChanged) {
+      duplicateFrames = 0;
+      nBytes = size_t((videoWidth * videoHeight * 3) / 2);
+    }
+    writeAVIFrame(&(outBufY[0]), nBytes, frameChanged);
+  }
+
+  // --------------------------------------------------------------------------
+
+  VideoCapture_ZMBV::VideoCapture_ZMBV(
+      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
+      int frameRate_)
+    : VideoCapture_RLE8(indexToRGBFunc, frameRate_),
+      curFrameBuf((uint8_t *) 0),
+      prvFrameBuf((uint8_t *) 0),
+      blockVectors((int8_t *) 0),
+      zStream((z_stream *) 0),
+      framesSinceKeyFrame(0)
+  {
+    try {
+      size_t  frameBytes = size_t(videoWidth * videoHeight);
+      curFrameBuf = new uint8_t[frameBytes];
+      std::memset(curFrameBuf, 0x00, frameBytes);
+      prvFrameBuf = new uint8_t[frameBytes];
+      std::memset(prvFrameBuf, 0x00, frameBytes);
+      blockVectors = new int8_t[blocksX * blocksY * 2];
+      std::memset(blockVectors, 0x00, size_t(blocksX * blocksY * 2));
+      // the uncompressed frame data (at most 768x576 bytes and the palette)
+      // is stored in frameDataBuf
+      compressedBuf.resize(frameBytes + 4096);
+      // motion vectors to search, in order of increasing distance: vertical
+      // and horizontal scrolling
+      for (int i = 1; i <= 24; i++) {
+        searchVectors.push_back(int8_t(0));
+        searchVectors.push_back(int8_t(-i));
+        searchVectors.push_back(int8_t(0));
+        searchVectors.push_back(int8_t(i));
+        if (i <= 16) {
+          searchVectors.push_back(int8_t(-i));
+          searchVectors.push_back(int8_t(0));
+          searchVectors.push_back(int8_t(i));
+          searchVectors.push_back(int8_t(0));
+        }
+      }
+      z_stream  *zStream_ = new z_stream;
+      std::memset(zStream_, 0, sizeof(z_stream));
+      zStream_->zalloc = Z_NULL;
+      zStream_->zfree = Z_NULL;
+      zStream_->opaque = Z_NULL;
+      if (deflateInit(zStream_, 4) != Z_OK) {
+        delete zStream_;
+        throw Exception("error initializing video compression");
+      }
+      zStream = zStream_;
+      aviVideoFormat.codec = "ZMBV";
+      aviVideoFormat.bitsPerPixel = 24;
+      aviVideoFormat.imageSize = frameBytes * 4;
+      // a key frame, with the palette and the ZMBV and zlib headers
+      aviVideoFormat.maxFrameSize = frameBytes + 1024;
+      aviVideoFormat.palette = (uint8_t *) 0;
+    }
+    catch (...) {
+      if (curFrameBuf)
+        delete[] curFrameBuf;
+      if (prvFrameBuf)
+        delete[] prvFrameBuf;
+      if (blockVectors)
+        delete[] blockVectors;
+      if (zStream) {
+        deflateEnd(zStream);
+        delete zStream;
+      }
+      throw;
+    }
+  }
+
+  VideoCapture_ZMBV::~VideoCapture_ZMBV()
+  {
+    // the file needs to be closed here, while writeFrame() of this class
+    // can still be called
+    closeFile();
+    if (zStream) {
+      deflateEnd(zStream);
+      delete zStream;
+    }
+    delete[] curFrameBuf;
+    delete[] prvFrameBuf;
+    delete[] blockVectors;
+  }
+
+  inline int VideoCapture_ZMBV::compareBlock(int x, int y, int dx, int dy,
+                                             int maxDiff, int step) const
+  {
+    const uint8_t *p1 = &(curFrameBuf[(y * videoWidth) + x]);
+    const uint8_t *p2 = &(prvFrameBuf[((y + dy) * videoWidth) + (x + dx)]);
+    int     n = 0;
+    for (int i = 0; i < blockSize; i += step) {
+      for (int j = 0; j < blockSize; j++)
+        n += int(p1[j] != p2[j]);
+      if (n > maxDiff)
+        break;
+      p1 = p1 + (videoWidth * step);
+      p2 = p2 + (videoWidth * step);
+    }
+    return n;
+  }
+
+  size_t VideoCapture_ZMBV::encodeKeyFrame()
+  {
+    // palette (256 * R, G, B), followed by the color indices
+    uint8_t *bufp = frameDataBuf;
+    for (int i = 0; i < 256; i++) {
+      *(bufp++) = colormap[(i * 4) + 2];
+      *(bufp++) = colormap[(i * 4) + 1];
+      *(bufp++) = colormap[(i * 4) + 0];
+    }
+    std::memcpy(bufp, curFrameBuf, size_t(videoWidth * videoHeight));
+    std::memset(blockVectors, 0x00, size_t(blocksX * blocksY * 2));
+    return (size_t(videoWidth * videoHeight) + 768);
+  }
+
+  size_t VideoCapture_ZMBV::encodeDeltaFrame()
+  {
+    // two bytes per block (X vector * 2 + XOR flag, Y vector * 2), padded
+    // to a multiple of 4 bytes, followed by the XOR data of the blocks that
+    // have the flag set
+    size_t  nBytes = size_t(((blocksX * blocksY * 2) + 3) & (~3));
+    std::memset(frameDataBuf, 0x00, nBytes);
+    const int maxDiff = blockSize * blockSize;
+    for (int yc = 0; yc < blocksY; yc++) {
+      for (int xc = 0; xc < blocksX; xc++) {
+        int     n = (yc * blocksX) + xc;
+        int     x = xc * blockSize;
+        int     y = yc * blockSize;
+        int     bestX = 0;
+        int     bestY = 0;
+        int     bestDiff = compareBlock(x, y, 0, 0, maxDiff);
+        if (bestDiff > 0) {
+          // try the vector of this block in the previous frame, and the
+          // vectors of the blocks on the left and above in this frame
+          int     prvBlocks[3];
+          prvBlocks[0] = n;
+          prvBlocks[1] = (xc > 0 ? (n - 1) : -1);
+          prvBlocks[2] = (yc > 0 ? (n - blocksX) : -1);
+          for (int i = 0; i < 3 && bestDiff > 0; i++) {
+            if (prvBlocks[i] < 0)
+              continue;
+            int     dx = blockVectors[prvBlocks[i] * 2];
+            int     dy = blockVectors[prvBlocks[i] * 2 + 1];
+            if ((dx | dy) == 0 ||
+                (x + dx) < 0 || (x + dx + blockSize) > videoWidth ||
+                (y + dy) < 0 || (y + dy + blockSize) > videoHeight) {
+              continue;
+            }
+            int     d = compareBlock(x, y, dx, dy, bestDiff - 1);
+            if (d < bestDiff) {
+              bestX = dx;
+              bestY = dy;
+              bestDiff = d;
+            }
+          }
+        }
+        if (bestDiff > 0) {
+          // search for scrolling, comparing only every 5th line of the
+          // block first, and then the whole block for the best match
+          int     sampleX = 0;
+          int     sampleY = 0;
+          int     sampleDiff = maxDiff;
+          for (size_t i = 0; i < searchVectors.size(); i += 2) {
+            int     dx = searchVectors[i];
+            int     dy = searchVectors[i + 1];
+            if ((x + dx) < 0 || (x + dx + blockSize) > videoWidth ||
+                (y + dy) < 0 || (y + dy + blockSize) > videoHeight) {
+              continue;
+            }
+            int     d = compareBlock(x, y, dx, dy, sampleDiff - 1, 5);
+            if (d < sampleDiff) {
+              sampleX = dx;
+              sampleY = dy;
+              sampleDiff = d;
+              if (d == 0)
+                break;
+            }
+          }
+          if ((sampleX | sampleY) != 0) {
+            int     d = compareBlock(x, y, sampleX, sampleY, bestDiff - 1);
+            if (d < bestDiff) {
+              bestX = sampleX;
+              bestY = sampleY;
+              bestDiff = d;
+            }
+          }
+        }
+        blockVectors[n * 2] = int8_t(bestX);
+        blockVectors[n * 2 + 1] = int8_t(bestY);
+        frameDataBuf[n * 2] = uint8_t((bestX * 2) | int(bestDiff > 0));
+        frameDataBuf[n * 2 + 1] = uint8_t(bestY * 2);
+        if (bestDiff > 0) {
+          const uint8_t *p1 = &(curFrameBuf[(y * videoWidth) + x]);
+          const uint8_t *p2 =
+              &(prvFrameBuf[((y + bestY) * videoWidth) + (x + bestX)]);
+          uint8_t *bufp = &(frameDataBuf[nBytes]);
+          for (int i = 0; i < blockSize; i++) {
+            for (int j = 0; j < blockSize; j++)
+              *(bufp++) = p1[j] ^ p2[j];
+            p1 = p1 + videoWidth;
+            p2 = p2 + videoWidth;
+          }
+          nBytes = nBytes + size_t(blockSize * blockSize);
+        }
+      }
+    }
+    return nBytes;
+  }
+
+  size_t VideoCapture_ZMBV::compressFrame(bool isKeyFrame, size_t nBytes)
+  {
+    size_t  outBytes = 0;
+    if (isKeyFrame) {
+      // flags (key frame), version 0.1, zlib compression, 8 bits per pixel,
+      // block width and height; the zlib stream is restarted
+      if (deflateReset(zStream) != Z_OK)
+        throw Exception("error compressing video frame");
+      compressedBuf[0] = 0x01;
+      compressedBuf[1] = 0x00;
+      compressedBuf[2] = 0x01;
+      compressedBuf[3] = 0x01;
+      compressedBuf[4] = 0x04;
+      compressedBuf[5] = uint8_t(blockSize);
+      compressedBuf[6] = uint8_t(blockSize);
+      outBytes = 7;
+    }
+    else {
+      // flags (delta frame); the data continues the zlib stream of the
+      // previous frames
+      compressedBuf[0] = 0x00;
+      outBytes = 1;
+    }
+    zStream->next_in = reinterpret_cast< Bytef * >(frameDataBuf);
+    zStream->avail_in = uInt(nBytes);
     do {
-      interpBufY[i] +=
-          ((int32_t(frameBuf0Y[i]) + int32_t(frameBuf1Y[i])) * scaleFac);
-      i++;
-      interpBufY[i] +=
-          ((int32_t(frameBuf0Y[i]) + int32_t(frameBuf1Y[i])) * scaleFac);
-    } while (++i < n);
+      if (outBytes >= compressedBuf.size())
+        compressedBuf.resize(compressedBuf.size() * 2);
+      zStream->next_out =
+          reinterpret_cast< Bytef * >(&(compressedBuf[0]) + outBytes);
+      zStream->avail_out = uInt(compressedBuf.size() - outBytes);
+      int     err = deflate(zStream, Z_SYNC_FLUSH);
+      if (err != Z_OK && err != Z_BUF_ERROR)
+        throw Exception("error compressing video frame");
+      outBytes = compressedBuf.size() - size_t(zStream->avail_out);
+    } while (zStream->avail_out == 0);
+    return outBytes;
+  }
+
+  void VideoCapture_ZMBV::writeFrame(bool frameChanged)
+  {
+    if (!aviFile)
+      return;
+    bool    isKeyFrame = (framesWritten == 0 ||
+                          framesSinceKeyFrame >= size_t(frameRate * 10));
+    if (!(frameChanged || isKeyFrame)) {
+      if (duplicateFrames >= size_t(frameRate))
+        frameChanged = true;
+      else
+        duplicateFrames++;
+    }
+    if (frameChanged || isKeyFrame)
+      duplicateFrames = 0;
+    size_t  nBytes = 0;
+    if (frameChanged || isKeyFrame) {
+      for (int i = 0; i < videoHeight; i++)
+        decodeLine(&(curFrameBuf[i * videoWidth]), outputFrameBuf[i]);
+      try {
+        if (isKeyFrame)
+          nBytes = compressFrame(true, encodeKeyFrame());
+        else
+          nBytes = compressFrame(false, encodeDeltaFrame());
+      }
+      catch (std::exception& e) {
+        closeFile_();
+        encoderError(e.what());
+        return;
+      }
+      uint8_t *tmp = curFrameBuf;
+      curFrameBuf = prvFrameBuf;
+      prvFrameBuf = tmp;
+      if (isKeyFrame)
+        framesSinceKeyFrame = 0;
+    }
+    framesSinceKeyFrame++;
+    writeAVIFrame(&(compressedBuf[0]), nBytes, isKeyFrame);
+  }
+
+  // --------------------------------------------------------------------------
+
+  static void removeFileNameExtension(std::string& fileName)
+  {
+    size_t  n = fileName.length();
+    while (n > 0 && fileName[n - 1] != '.' &&
+           fileName[n - 1] != '/' && fileName[n - 1] != '\\') {
+      n--;
+    }
+    if (n > 1 && fileName[n - 1] == '.' &&
+        fileName[n - 2] != '/' && fileName[n - 2] != '\\') {
+      fileName.resize(n - 1);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+
+  VideoCapture_Y4M::VideoCapture_Y4M(
+      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
+      int frameRate_)
+    : VideoCapture_RLE8(indexToRGBFunc, frameRate_),
+      wavFile((std::FILE *) 0),
+      yuvFrameBuf((uint8_t *) 0),
+      yuvColormap((uint8_t *) 0),
+      wavDataBytes(0)
+  {
+    try {
+      size_t  frameBytes = size_t(videoWidth * videoHeight);
+      yuvFrameBuf = new uint8_t[frameBytes * 3];
+      yuvColormap = new uint8_t[256 * 3];
+      for (int i = 0; i < 256; i++) {
+        float   r = float(i) / 255.0f;
+        float   g = r;
+        float   b = r;
+        if (indexToRGBFunc)
+          indexToRGBFunc(uint8_t(i), r, g, b);
+        float   y = (0.299f * r) + (0.587f * g) + (0.114f * b);
+        float   u = 0.492f * (b - y);
+        float   v = 0.877f * (r - y);
+        // scale video signal to YCrCb range
+        y = 16.0f + (y * 219.5f);
+        u = 128.0f + (u * (111.5f / (0.886f * 0.492f)));
+        v = 128.0f + (v * (111.5f / (0.701f * 0.877f)));
+        y = (y > 16.0f ? (y < 235.0f ? y : 235.0f) : 16.0f);
+        u = (u > 16.0f ? (u < 239.0f ? u : 239.0f) : 16.0f);
+        v = (v > 16.0f ? (v < 239.0f ? v : 239.0f) : 16.0f);
+        yuvColormap[i] = uint8_t(int(y + 0.5f));
+        yuvColormap[i + 256] = uint8_t(int(u + 0.5f));
+        yuvColormap[i + 512] = uint8_t(int(v + 0.5f));
+      }
+    }
+    catch (...) {
+      if (yuvFrameBuf)
+        delete[] yuvFrameBuf;
+      throw;
+    }
+  }
+
+  VideoCapture_Y4M::~VideoCapture_Y4M()
+  {
+    // the files need to be closed here, while the functions of this class
+    // can still be called
+    closeFile();
+    delete[] yuvFrameBuf;
+    delete[] yuvColormap;
+  }
+
+  void VideoCapture_Y4M::writeWAVHeader(uint32_t dataBytes)
+  {
+    uint8_t headerBuf[44];
+    uint8_t *bufp = &(headerBuf[0]);
+    aviHeader_writeFourCC(bufp, "RIFF");
+    aviHeader_writeUInt32(bufp, (dataBytes < 0xFFFFFFDBU ?
+                                 (dataBytes + 36U) : 0xFFFFFFFFU));
+    aviHeader_writeFourCC(bufp, "WAVE");
+    aviHeader_writeFourCC(bufp, "fmt ");
+    aviHeader_writeUInt32(bufp, 16);
+    aviHeader_writeUInt16(bufp, 1);             // PCM
+    aviHeader_writeUInt16(bufp, 2);             // stereo
+    aviHeader_writeUInt32(bufp, uint32_t(sampleRate));
+    aviHeader_writeUInt32(bufp, uint32_t(sampleRate * 4));
+    aviHeader_writeUInt16(bufp, 4);
+    aviHeader_writeUInt16(bufp, 16);
+    aviHeader_writeFourCC(bufp, "data");
+    aviHeader_writeUInt32(bufp, dataBytes);
+    if (std::fwrite(&(headerBuf[0]), 1, 44, wavFile) != 44)
+      throw Exception("error writing WAV file");
+  }
+
+  void VideoCapture_Y4M::openOutputFile(const char *fileName)
+  {
+    // the WAV file has the same name as the video, with the extension
+    // replaced
+    std::string wavFileName(fileName);
+    removeFileNameExtension(wavFileName);
+    wavFileName += ".wav";
+    if (wavFileName == fileName)
+      throw Exception("video and audio output file names are the same");
+    framesWritten = 0;
+    duplicateFrames = 0;
+    aviSuperIndexEntries = 0;
+    wavDataBytes = 0;
+    aviFile = fileOpen(fileName, "wb");
+    if (!aviFile)
+      throw Exception("error opening video file");
+    char    tmpBuf[64];
+    std::sprintf(&(tmpBuf[0]), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                 int(videoWidth), int(videoHeight), int(frameRate));
+    size_t  nBytes = std::strlen(&(tmpBuf[0]));
+    if (std::fwrite(&(tmpBuf[0]), 1, nBytes, aviFile) != nBytes ||
+        std::fflush(aviFile) != 0) {
+      closeOutputFile();
+      throw Exception("error writing video file");
+    }
+    fileSize = nBytes;
+    wavFile = fileOpen(wavFileName.c_str(), "wb");
+    if (!wavFile) {
+      closeOutputFile();
+      throw Exception("error opening WAV file");
+    }
+    try {
+      // the data size is not known yet
+      writeWAVHeader(0xFFFFFFFFU);
+      if (std::fflush(wavFile) != 0)
+        throw Exception("error writing WAV file");
+    }
+    catch (...) {
+      closeOutputFile();
+      throw;
+    }
+    fileSize = fileSize + 44;
+  }
+
+  void VideoCapture_Y4M::closeOutputFile()
+  {
+    if (wavFile) {
+      // if the file is not a pipe, store the final data size in the header
+      // FIXME: file I/O errors are ignored here
+      if (std::fseek(wavFile, 0L, SEEK_SET) >= 0) {
+        try {
+          writeWAVHeader(wavDataBytes < 0xFFFFFFFFUL ?
+                         uint32_t(wavDataBytes) : 0xFFFFFFFFU);
+        }
+        catch (...) {
+        }
+      }
+      std::fclose(wavFile);
+      wavFile = (std::FILE *) 0;
+    }
+    if (aviFile) {
+      std::fclose(aviFile);
+      aviFile = (std::FILE *) 0;
+    }
+    framesWritten = 0;
+    duplicateFrames = 0;
+    fileSize = 0;
   }
 
-  void VideoCapture_YV12::writeFrame(bool frameChanged)
+  void VideoCapture_Y4M::writeFrame(bool frameChanged)
   {
     if (!aviFile)
       return;
-    if (!frameChanged) {
-      if (framesWritten == 0 || duplicateFrames >= size_t(frameRate))
-        frameChanged = true;
-      else
-        duplicateFrames++;
-    }
-    if (frameChanged) {
-      duplicateFrames = 0;
-      duplicateFrameBitmap[framesWritten >> 3] &=
-          uint8_t((1 << (framesWritten & 7)) ^ 0xFF);
-    }
-    else {
-      duplicateFrameBitmap[framesWritten >> 3] |=
-          uint8_t(1 << (framesWritten & 7));
+    const size_t  frameBytes = size_t(videoWidth * videoHeight);
+    if (frameChanged || framesWritten == 0) {
+      // the color indices are decoded to frameDataBuf
+      for (int i = 0; i < videoHeight; i++)
+        decodeLine(&(frameDataBuf[i * videoWidth]), outputFrameBuf[i]);
+      for (size_t i = 0; i < frameBytes; i++) {
+        uint8_t c = frameDataBuf[i];
+        yuvFrameBuf[i] = yuvColormap[c];
+        yuvFrameBuf[i + frameBytes] = yuvColormap[c + 256];
+        yuvFrameBuf[i + (frameBytes << 1)] = yuvColormap[c + 512];
+      }
     }
     try {
-      if (fileSize >= 0x7F800000) {
-        closeFile();
-        try {
-          errorMessage("AVI file is too large, starting new output file");
-        }
-        catch (...) {
-        }
-        std::string fileName = "";
-        fileNameCallback(fileNameCallbackUserData, fileName);
-        if (fileName.length() < 1)
-          return;
-        openFile(fileName.c_str());
-      }
-      if (std::fseek(aviFile, 0L, SEEK_END) < 0)
-        throw Exception("error seeking AVI file");
-      uint8_t headerBuf[8];
-      uint8_t *bufp = &(headerBuf[0]);
-      size_t  nBytes = 0;
-      if (frameChanged)
-        nBytes = size_t((videoWidth * videoHeight * 3) / 2);
-      aviHeader_writeFourCC(bufp, "00dc");
-      aviHeader_writeUInt32(bufp, uint32_t(nBytes));
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file");
-      if (nBytes > 0) {
-        fileSize = fileSize + nBytes;
-        if (std::fwrite(&(outBufY[0]), 1, nBytes, aviFile) != nBytes)
-          throw Exception("error writing AVI file");
+      if (std::fwrite("FRAME\n", 1, 6, aviFile) != 6 ||
+          std::fwrite(yuvFrameBuf, 1, frameBytes * 3, aviFile)
+          != (frameBytes * 3) ||
+          std::fflush(aviFile) != 0) {
+        throw Exception("error writing video file");
       }
-      bufp = &(headerBuf[0]);
-      nBytes = size_t(audioBufSize * 4);
-      aviHeader_writeFourCC(bufp, "01wb");
-      aviHeader_writeUInt32(bufp, uint32_t(nBytes));
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(headerBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file");
+      fileSize = fileSize + (frameBytes * 3 + 6);
+      // the audio samples of the frame are converted in frameDataBuf
+      // (at most 8000 bytes at 24 frames per second)
+      uint8_t *bufp = frameDataBuf;
       int     bufPos = audioBufReadPos;
       for (int i = 0; i < (audioBufSize * 2); i++) {
         if (bufPos >= (audioBufSize * audioBuffers * 2))
           bufPos = 0;
-        int16_t tmp = audioBuf[bufPos++];
-        fileSize++;
-        if (std::fputc(int(uint16_t(tmp) & 0xFF), aviFile) == EOF)
-          throw Exception("error writing AVI file");
-        fileSize++;
-        if (std::fputc(int((uint16_t(tmp) >> 8) & 0xFF), aviFile) == EOF)
-          throw Exception("error writing AVI file");
+        uint16_t  tmp = uint16_t(audioBuf[bufPos++]);
+        *(bufp++) = uint8_t(tmp & 0xFF);
+        *(bufp++) = uint8_t(tmp >> 8);
       }
+      size_t  nBytes = size_t(audioBufSize * 4);
+      if (std::fwrite(frameDataBuf, 1, nBytes, wavFile) != nBytes ||
+          std::fflush(wavFile) != 0) {
+        throw Exception("error writing WAV file");
+      }
+      fileSize = fileSize + nBytes;
+      wavDataBytes = wavDataBytes + nBytes;
     }
     catch (std::exception& e) {
-      closeFile();
-      errorMessage(e.what());
+      closeFile_();
+      encoderError(e.what());
       return;
     }
     framesWritten++;
-    if (!(framesWritten & 31)) {
-      try {
-        writeAVIHeader();
-      }
-      catch (std::exception& e) {
-        errorMessage(e.what());
-      }
+  }
+
+  // --------------------------------------------------------------------------
+
+  VideoCapture_FrameHash::VideoCapture_FrameHash(
+      void (*indexToRGBFunc)(uint8_t color, float& r, float& g, float& b),
+      int frameRate_, int hashInterval_, bool writePNGFiles_)
+    : VideoCapture_RLE8(indexToRGBFunc, frameRate_),
+      hashInterval(hashInterval_ > 1 ? hashInterval_ : 1),
+      writePNGFiles(writePNGFiles_),
+      frameDecoded(false),
+      frameHash(0ULL),
+      pngBuf((uint8_t *) 0)
+  {
+    pngBuf = new uint8_t[256 * 3 + size_t(videoWidth * videoHeight)];
+    // convert the BGRx colormap of VideoCapture_RLE8
+    for (int i = 0; i < 256; i++) {
+      pngBuf[(i * 3) + 0] = colormap[(i * 4) + 2];
+      pngBuf[(i * 3) + 1] = colormap[(i * 4) + 1];
+      pngBuf[(i * 3) + 2] = colormap[(i * 4) + 0];
+    }
+  }
+
+  VideoCapture_FrameHash::~VideoCapture_FrameHash()
+  {
+    // the file needs to be closed here, while the functions of this class
+    // can still be called
+    closeFile();
+    delete[] pngBuf;
+  }
+
+  uint64_t VideoCapture_FrameHash::calculateFrameHash(const uint8_t *buf,
+                                                      size_t nBytes)
+  {
+    // multiply and rotate each 64-bit little endian word into the hash,
+    // and mix the final value with the finalizer of MurmurHash3
+    uint64_t  h = 0x9E3779B97F4A7C15ULL ^ uint64_t(nBytes);
+    size_t    i = 0;
+    for ( ; (i + 8) <= nBytes; i += 8) {
+      uint64_t  w = uint64_t(buf[i])
+                    | (uint64_t(buf[i + 1]) << 8)
+                    | (uint64_t(buf[i + 2]) << 16)
+                    | (uint64_t(buf[i + 3]) << 24)
+                    | (uint64_t(buf[i + 4]) << 32)
+                    | (uint64_t(buf[i + 5]) << 40)
+                    | (uint64_t(buf[i + 6]) << 48)
+                    | (uint64_t(buf[i + 7]) << 56);
+      h = h ^ (w * 0x87C37B91114253D5ULL);
+      h = ((h << 27) | (h >> 37)) * 5ULL + 0x52DCE729ULL;
+    }
+    if (i < nBytes) {
+      uint64_t  w = 0ULL;
+      for (int j = 0; i < nBytes; i++, j += 8)
+        w = w | (uint64_t(buf[i]) << j);
+      h = h ^ (w * 0x87C37B91114253D5ULL);
+      h = ((h << 27) | (h >> 37)) * 5ULL + 0x52DCE729ULL;
     }
+    h = h ^ (h >> 33);
+    h = h * 0xFF51AFD7ED558CCDULL;
+    h = h ^ (h >> 33);
+    h = h * 0xC4CEB9FE1A85EC53ULL;
+    h = h ^ (h >> 33);
+    return h;
   }
 
-  void VideoCapture_YV12::writeAVIHeader()
+  void VideoCapture_FrameHash::openOutputFile(const char *fileName)
   {
+    // the PNG files are named after the log file, without the extension
+    pngFileNameBase = fileName;
+    removeFileNameExtension(pngFileNameBase);
+    framesWritten = 0;
+    duplicateFrames = 0;
+    aviSuperIndexEntries = 0;
+    frameDecoded = false;
+    aviFile = fileOpen(fileName, "wb");
     if (!aviFile)
-      return;
-    try {
-      if (std::fseek(aviFile, 0L, SEEK_SET) < 0)
-        throw Exception("error seeking AVI file");
-      uint8_t   headerBuf[512];
-      uint8_t   *bufp = &(headerBuf[0]);
-      size_t    frameSize = size_t(((videoWidth * videoHeight * 3) / 2)
-                                   + (audioBufSize * 4) + 16);
-      aviHeader_writeFourCC(bufp, "RIFF");
-      aviHeader_writeUInt32(bufp, uint32_t(fileSize - 8));
-      aviHeader_writeFourCC(bufp, "AVI ");
-      aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x00000126U);
-      aviHeader_writeFourCC(bufp, "hdrl");
-      aviHeader_writeFourCC(bufp, "avih");
-      aviHeader_writeUInt32(bufp, 0x00000038U);
-      // microseconds per frame
-      aviHeader_writeUInt32(bufp,
-                            uint32_t((1000000 + (frameRate >> 1)) / frameRate));
-      // max. bytes per second
-      aviHeader_writeUInt32(bufp, uint32_t(frameSize * size_t(frameRate)));
-      // padding
-      aviHeader_writeUInt32(bufp, 0x00000001U);
-      // flags (AVIF_HASINDEX | AVIF_ISINTERLEAVED | AVIF_TRUSTCKTYPE)
-      aviHeader_writeUInt32(bufp, 0x00000910U);
-      // total frames
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten));
-      // initial frames
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // number of streams
-      aviHeader_writeUInt32(bufp, 0x00000002U);
-      // suggested buffer size
-      aviHeader_writeUInt32(bufp, uint32_t(frameSize));
-      // width
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth));
-      // height
-      aviHeader_writeUInt32(bufp, uint32_t(videoHeight));
-      // reserved
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x00000074U);
-      aviHeader_writeFourCC(bufp, "strl");
-      aviHeader_writeFourCC(bufp, "strh");
-      aviHeader_writeUInt32(bufp, 0x00000038U);
-      aviHeader_writeFourCC(bufp, "vids");
-      // video codec
-      aviHeader_writeFourCC(bufp, "YV12");
-      // flags
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // priority
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // language
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // initial frames
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // scale
-      aviHeader_writeUInt32(bufp, 0x00000001U);
-      // rate
-      aviHeader_writeUInt32(bufp, uint32_t(frameRate));
-      // start time
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // length
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten));
-      // suggested buffer size
-      aviHeader_writeUInt32(bufp, uint32_t((videoWidth * videoHeight * 3) / 2));
-      // quality
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // sample size
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // left
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // top
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // right
-      aviHeader_writeUInt16(bufp, uint16_t(videoWidth));
-      // bottom
-      aviHeader_writeUInt16(bufp, uint16_t(videoHeight));
-      aviHeader_writeFourCC(bufp, "strf");
-      aviHeader_writeUInt32(bufp, 0x00000028U);
-      aviHeader_writeUInt32(bufp, 0x00000028U);
-      // width
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth));
-      // height
-      aviHeader_writeUInt32(bufp, uint32_t(videoHeight));
-      // planes
-      aviHeader_writeUInt16(bufp, 0x0001);
-      // bits per pixel
-      aviHeader_writeUInt16(bufp, 0x0018);
-      // compression
-      aviHeader_writeFourCC(bufp, "YV12");
-      // image size in bytes
-      aviHeader_writeUInt32(bufp, uint32_t(videoWidth * videoHeight * 3));
-      // X resolution
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // Y resolution
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // color indexes used
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // color indexes required
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, 0x0000005EU);
-      aviHeader_writeFourCC(bufp, "strl");
-      aviHeader_writeFourCC(bufp, "strh");
-      aviHeader_writeUInt32(bufp, 0x00000038U);
-      aviHeader_writeFourCC(bufp, "auds");
-      // audio codec (WAVE_FORMAT_PCM)
-      aviHeader_writeUInt32(bufp, 0x00000001U);
-      // flags
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // priority
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // language
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // initial frames
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // scale
-      aviHeader_writeUInt32(bufp, 0x00000001U);
-      // rate
-      aviHeader_writeUInt32(bufp, uint32_t(sampleRate));
-      // start time
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // length
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten
-                                           * size_t(audioBufSize)));
-      // suggested buffer size
-      aviHeader_writeUInt32(bufp, uint32_t(audioBufSize * 4));
-      // quality
-      aviHeader_writeUInt32(bufp, 0x00000000U);
-      // sample size
-      aviHeader_writeUInt32(bufp, 0x00000004U);
-      // left
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // top
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // right
-      aviHeader_writeUInt16(bufp, 0x0000);
-      // bottom
-      aviHeader_writeUInt16(bufp, 0x0000);
-      aviHeader_writeFourCC(bufp, "strf");
-      aviHeader_writeUInt32(bufp, 0x00000012U);
-      // audio format (WAVE_FORMAT_PCM)
-      aviHeader_writeUInt16(bufp, 0x0001);
-      // audio channels
-      aviHeader_writeUInt16(bufp, 0x0002);
-      // samples per second
-      aviHeader_writeUInt32(bufp, uint32_t(sampleRate));
-      // bytes per second
-      aviHeader_writeUInt32(bufp, uint32_t(sampleRate * 4));
-      // block alignment
-      aviHeader_writeUInt16(bufp, 0x0004);
-      // bits per sample
-      aviHeader_writeUInt16(bufp, 0x0010);
-      // additional format information size
-      aviHeader_writeUInt16(bufp, 0x0000);
-      aviHeader_writeFourCC(bufp, "LIST");
-      aviHeader_writeUInt32(bufp, uint32_t((fileSize - aviHeaderSize) + 4));
-      aviHeader_writeFourCC(bufp, "movi");
-      size_t  nBytes = size_t(bufp - (&(headerBuf[0])));
-      if (std::fwrite(&(headerBuf[0]), 1, nBytes, aviFile) != nBytes)
-        throw Exception("error writing AVI file header");
-      if (std::fflush(aviFile) != 0)
-        throw Exception("error writing AVI file header");
+      throw Exception("error opening frame hash log file");
+    char    tmpBuf[80];
+    std::sprintf(&(tmpBuf[0]), "# %dx%d %d:1 interval %d\n",
+                 int(videoWidth), int(videoHeight), int(frameRate),
+                 hashInterval);
+    size_t  nBytes = std::strlen(&(tmpBuf[0]));
+    if (std::fwrite(&(tmpBuf[0]), 1, nBytes, aviFile) != nBytes ||
+        std::fflush(aviFile) != 0) {
+      closeOutputFile();
+      throw Exception("error writing frame hash log file");
     }
-    catch (...) {
+    fileSize = nBytes;
+  }
+
+  void VideoCapture_FrameHash::closeOutputFile()
+  {
+    if (aviFile) {
       std::fclose(aviFile);
       aviFile = (std::FILE *) 0;
-      framesWritten = 0;
-      duplicateFrames = 0;
-      fileSize = 0;
-      throw;
     }
+    framesWritten = 0;
+    duplicateFrames = 0;
+    fileSize = 0;
   }
 
-  void VideoCapture_YV12::writeAVIIndex()
+  void VideoCapture_FrameHash::writeFrame(bool frameChanged)
   {
     if (!aviFile)
       return;
+    if (frameChanged)
+      frameDecoded = false;
+    if ((framesWritten % size_t(hashInterval)) != 0) {
+      framesWritten++;
+      return;
+    }
+    uint8_t *frameBuf = pngBuf + (256 * 3);
+    if (!frameDecoded) {
+      for (int i = 0; i < videoHeight; i++)
+        decodeLine(&(frameBuf[i * videoWidth]), outputFrameBuf[i]);
+      frameHash = calculateFrameHash(frameBuf,
+                                     size_t(videoWidth * videoHeight));
+      frameDecoded = true;
+    }
     try {
-      if (std::fseek(aviFile, 0L, SEEK_END) < 0)
-        throw Exception("error seeking AVI file");
-      uint8_t   tmpBuf[32];
-      uint8_t   *bufp = &(tmpBuf[0]);
-      aviHeader_writeFourCC(bufp, "idx1");
-      aviHeader_writeUInt32(bufp, uint32_t(framesWritten << 5));
-      fileSize = fileSize + 8;
-      if (std::fwrite(&(tmpBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file index");
-      size_t    filePos = 4;
-      for (size_t i = 0; i < framesWritten; i++) {
-        bufp = &(tmpBuf[0]);
-        aviHeader_writeFourCC(bufp, "00dc");
-        size_t    frameBytes = 0;
-        if (!(duplicateFrameBitmap[i >> 3] & uint8_t(1 << (i & 7)))) {
-          aviHeader_writeUInt32(bufp, 0x00000010U);     // AVIIF_KEYFRAME
-          frameBytes = size_t((videoWidth * videoHeight * 3) / 2);
-        }
-        else {
-          aviHeader_writeUInt32(bufp, 0x00000000U);
-        }
-        aviHeader_writeUInt32(bufp, uint32_t(filePos));
-        filePos = filePos + frameBytes + 8;
-        aviHeader_writeUInt32(bufp, uint32_t(frameBytes));
-        aviHeader_writeFourCC(bufp, "01wb");
-        aviHeader_writeUInt32(bufp, 0x00000010U);       // AVIIF_KEYFRAME
-        aviHeader_writeUInt32(bufp, uint32_t(filePos));
-        frameBytes = size_t(audioBufSize) << 2;
-        filePos = filePos + frameBytes + 8;
-        aviHeader_writeUInt32(bufp, uint32_t(frameBytes));
-        fileSize = fileSize + 32;
-        if (std::fwrite(&(tmpBuf[0]), 1, 32, aviFile) != 32)
-          throw Exception("error writing AVI file index");
+      char    tmpBuf[64];
+      std::sprintf(&(tmpBuf[0]), "%8lu %08X%08X\n",
+                   (unsigned long) framesWritten,
+                   (unsigned int) ((frameHash >> 32) & 0xFFFFFFFFU),
+                   (unsigned int) (frameHash & 0xFFFFFFFFU));
+      size_t  nBytes = std::strlen(&(tmpBuf[0]));
+      if (std::fwrite(&(tmpBuf[0]), 1, nBytes, aviFile) != nBytes ||
+          std::fflush(aviFile) != 0) {
+        throw Exception("error writing frame hash log file");
+      }
+      fileSize = fileSize + nBytes;
+      if (writePNGFiles) {
+        std::string fileName(pngFileNameBase);
+        std::sprintf(&(tmpBuf[0]), "_%06lu.png",
+                     (unsigned long) framesWritten);
+        fileName += &(tmpBuf[0]);
+        writePNGImage(fileName.c_str(), pngBuf, videoWidth, videoHeight, 256,
+                      true, 32768, true);
       }
-      if (std::fseek(aviFile, 0L, SEEK_SET) < 0)
-        throw Exception("error seeking AVI file");
-      bufp = &(tmpBuf[0]);
-      aviHeader_writeFourCC(bufp, "RIFF");
-      aviHeader_writeUInt32(bufp, uint32_t(fileSize - 8));
-      if (std::fwrite(&(tmpBuf[0]), 1, 8, aviFile) != 8)
-        throw Exception("error writing AVI file index");
-      if (std::fflush(aviFile) != 0)
-        throw Exception("error writing AVI file index");
     }
-    catch (...) {
-      std::fclose(aviFile);
-      aviFile = (std::FILE *) 0;
-      framesWritten = 0;
-      duplicateFrames = 0;
-      fileSize = 0;
-      throw;
+    catch (std::exception& e) {
+      closeFile_();
+      encoderError(e.what());
+      return;
     }
+    framesWritten++;
   }
 
 }       // namespace Ep128Emu
@@ -21,16 +21,56 @@
 #define EP128EMU_VIDEOREC_HPP
 
 #include "ep128emu.hpp"
+#include "system.hpp"
 #include "display.hpp"
 #include "snd_conv.hpp"
 
+#include <vector>
+
+// zlib stream state, defined in <zlib.h>
+struct z_stream_s;
+
 namespace Ep128Emu {
 
   class VideoCapture {
    public:
     static const int  sampleRate = 48000;
     static const int  audioBuffers = 8;
+    // number of frames that can be waiting for the encoder thread
+    static const int  encoderQueueSize = 8;
+    // Files are written in the OpenDML (AVI 2.0) format. The first RIFF
+    // list ("AVI ") contains the header, up to aviRIFFMaxSize bytes of
+    // "movi" data, and a legacy "idx1" index for that data, and it is
+    // followed by any number of "AVIX" RIFF lists of the same size. The
+    // chunks of up to aviIndexChunkFrames frames are indexed by a pair of
+    // standard index chunks ("ix00" and "ix01") in the "movi" lists, which
+    // are in turn referenced by the super index ("indx") of each stream in
+    // the header. A new file is only started if the super index is full.
+    static const size_t aviRIFFMaxSize = 0x3F000000;
+    static const int  aviIndexChunkFrames = 4096;
+    static const int  aviSuperIndexSize = 1024;
    protected:
+    struct AVIIndexEntry {
+      // position of the video chunk data relative to the start of the RIFF
+      // list, the audio chunk of the frame is assumed to follow it
+      uint32_t  offset;
+      // size of the video chunk, bit 31 is set if it is not a key frame
+      uint32_t  size;
+    };
+    struct AVISuperIndexEntry {
+      uint64_t  filePos;                // position of the "ix00" chunk
+      uint32_t  frames;                 // number of frames indexed
+    };
+    // video stream format, set by the constructors of the derived classes
+    struct AVIVideoFormat {
+      int       width;
+      int       height;
+      const char  *codec;               // FourCC ("\001\0\0\0" = BI_RLE8)
+      int       bitsPerPixel;
+      size_t    imageSize;              // uncompressed image size in bytes
+      size_t    maxFrameSize;           // largest video chunk in bytes
+      const uint8_t *palette;           // 256 BGRx colors, or NULL
+    };
     class AudioConverter_ : public AudioConverterHighQuality {
      private:
       VideoCapture& videoCapture;
@@ -43,8 +83,17 @@ namespace Ep128Emu {
      protected:
       virtual void audioOutput(int16_t left, int16_t right);
     };
+    class EncoderThread : public Thread {
+     private:
+      VideoCapture& videoCapture;
+     public:
+      EncoderThread(VideoCapture& videoCapture_);
+      virtual ~EncoderThread();
+     protected:
+      virtual void run();
+    };
     // --------
-    std::FILE   *aviFile;
+    std::FILE   *aviFile;               // output file, NULL if not recording
     int16_t     *audioBuf;              // 8 * (sampleRate / frameRate) frames
     int         frameRate;              // video frames per second
     int         audioBufSize;           // = (sampleRate / frameRate)
@@ -60,23 +109,99 @@ namespace Ep128Emu {
     bool        oddFrame;
     size_t      framesWritten;
     size_t      duplicateFrames;
-    size_t      fileSize;
+    uint64_t    fileSize;
     AudioConverter  *audioConverter;
     size_t      aviHeaderSize;
+    AVIVideoFormat  aviVideoFormat;
+    AVIIndexEntry *aviIndexBuf;         // aviIndexChunkFrames entries
+    int         aviIndexFrames;         // number of entries in aviIndexBuf
+    AVISuperIndexEntry  *aviSuperIndex; // aviSuperIndexSize entries
+    int         aviSuperIndexEntries;
+    int         riffCnt;                // number of RIFF lists started
+    uint64_t    riffStartPos;           // position of the current RIFF list
+    // end of the first RIFF list and of its "movi" list, or zero if it is
+    // not closed yet, and the number of frames in it
+    uint64_t    riff0EndPos;
+    uint64_t    riff0MoviEndPos;
+    size_t      riff0Frames;
     void        (*errorCallback)(void *userData, const char *msg);
     void        *errorCallbackUserData;
     void        (*fileNameCallback)(void *userData, std::string& fileName);
     void        *fileNameCallbackUserData;
+    // Frames are passed from the emulation thread to the encoder thread
+    // through a ring buffer of 'encoderQueueSize' entries. The entry at
+    // queueWritePos is being filled by the emulation thread, and is not
+    // counted in queueFrames. Each entry has the audio output of the frame
+    // (up to audioBufSize * audioBuffers * 2 samples), the video data is
+    // stored by the derived classes.
+    int16_t     *queueAudioBuf;
+    int         queueAudioSamples[encoderQueueSize];
+    int         queueReadPos;           // used by the encoder thread only
+    int         queueWritePos;          // used by the emulation thread only
+    int         queueFrames;            // frames waiting or being encoded
+    // set by the encoder thread if the super index is almost full, and a
+    // new file needs to be started
+    bool        encoderFileFull;
+    std::string encoderErrorMessage;    // error to be reported by queueFrame()
+    std::string errorMessageBuf;
+    size_t      framesDelayed;
+    double      encoderWaitTime;
+    bool        encoderWarningFlag;
+    bool        encoderExitFlag;
+    Mutex       queueMutex;
+    ThreadLock  frameQueuedLock;        // notified when a frame is queued
+    ThreadLock  frameEncodedLock;       // notified when a frame is done
+    EncoderThread *encoderThread;
     // ----------------
     static void aviHeader_writeFourCC(uint8_t*& bufp, const char *s);
     static void aviHeader_writeUInt16(uint8_t*& bufp, uint16_t n);
     static void aviHeader_writeUInt32(uint8_t*& bufp, uint32_t n);
     static void defaultErrorCallback(void *userData, const char *msg);
     static void defaultFileNameCallback(void *userData, std::string& fileName);
-    virtual void writeAVIHeader() = 0;
-    virtual void writeAVIIndex() = 0;
+    void writeAVIHeader();
+    // write the "ix00" and "ix01" chunks for the frames in aviIndexBuf
+    void writeAVIStandardIndex();
+    // write the "idx1" chunk of the first RIFF list, from the standard
+    // index chunks already written to the file
+    void writeAVILegacyIndex();
+    // end the current RIFF list (with its index), and optionally start a
+    // new "AVIX" list
+    void closeAVIRIFF(bool startNewRIFF);
+    // called on the encoder thread to process the queue entry at 'n', after
+    // its audio samples have been copied to audioBuf
+    virtual void encodeFrame(int n) = 0;
+    // pass the current queue entry to the encoder thread, and wait until
+    // the next one can be filled, if the queue is full
+    void queueFrame();
+    // report errors from the encoder thread and slow encoding, and start a
+    // new file if the current one is too large; called on the emulation
+    // thread after queueFrame(), when it is safe to throw exceptions
+    void updateEncoderStatus();
+    // wait until all queued frames have been encoded
+    void flushEncoderQueue();
+    void runEncoder();
+    void openFile_(const char *fileName);
+    // closeFile() waits for the encoder thread first, closeFile_() can be
+    // called on the encoder thread
     void closeFile();
+    void closeFile_();
+    // open the output file, and write its header (the default is an AVI
+    // file); called by openFile_()
+    virtual void openOutputFile(const char *fileName);
+    // finish and close the output file if aviFile is not NULL; called by
+    // closeFile_()
+    virtual void closeOutputFile();
+    // write the next audioBufSize samples from audioBuf as a "01wb" chunk
+    void writeAudioChunk();
+    // write 'nBytes' bytes of video data from 'buf' as a "00dc" chunk
+    // (which is empty if 'nBytes' is zero), followed by the audio chunk,
+    // and add the frame to the index; on errors, the file is closed and
+    // the error is reported with encoderError()
+    void writeAVIFrame(const uint8_t *buf, size_t nBytes, bool isKeyFrame);
     void errorMessage(const char *msg);
+    // store an error message on the encoder thread, to be reported later
+    // through errorMessage() on the emulation thread
+    void encoderError(const char *msg);
    public:
     VideoCapture(int frameRate_ = 50);
     virtual ~VideoCapture();
@@ -109,6 +234,15 @@ namespace Ep128Emu {
      */
     void vsyncStateChange(bool newState, unsigned int currentSlot_);
     void openFile(const char *fileName);
+    /*!
+     * Returns the number of frames for which the emulation had to wait,
+     * because the encoder thread was falling behind, and the total time
+     * spent waiting in seconds, since the output file was opened.
+     * If the time exceeds one second, this is also reported once per file
+     * through the error callback.
+     */
+    void getEncoderStatistics(size_t& framesDelayed_,
+                              double& encoderWaitTime_) const;
     void setErrorCallback(void (*func)(void *userData, const char *msg),
                           void *userData_);
     void setFileNameCallback(void (*func)(void *userData,
@@ -122,7 +256,7 @@ namespace Ep128Emu {
    public:
     static const int  videoWidth = 768;
     static const int  videoHeight = 576;
-   private:
+   protected:
     class VideoCaptureFrameBuffer {
      private:
       uint32_t  *buf;
@@ -158,17 +292,18 @@ namespace Ep128Emu {
     // --------
     VideoCaptureFrameBuffer tmpFrameBuf;    // 768x576
     VideoCaptureFrameBuffer outputFrameBuf; // 768x576
-    uint32_t    *frameSizes;
+    // copies of tmpFrameBuf waiting for the encoder thread
+    VideoCaptureFrameBuffer *queueFrameBufs[encoderQueueSize];
+    uint8_t     *frameDataBuf;          // encoded frame (1024 bytes per line)
     int         cycleCnt;
     bool        prvOddFrame;
     uint8_t     *colormap;
     // ----------------
-    void frameDone();
+    void frameDone(const VideoCaptureFrameBuffer& frameBuf);
+    virtual void encodeFrame(int n);
     void decodeLine(uint8_t *outBuf, const uint8_t *inBuf);
     size_t rleCompressLine(uint8_t *outBuf, const uint8_t *inBuf);
-    void writeFrame(bool frameChanged);
-    virtual void writeAVIHeader();
-    virtual void writeAVIIndex();
+    virtual void writeFrame(bool frameChanged);
    public:
     VideoCapture_RLE8(void indexToRGBFunc(uint8_t color,
                                           float& r, float& g, float& b) =
@@ -182,25 +317,151 @@ namespace Ep128Emu {
 
   // --------------------------------------------------------------------------
 
+  /*!
+   * Lossless video capture in the ZMBV (DOSBox capture codec) format, at the
+   * resolution and with the color palette of VideoCapture_RLE8. Frames are
+   * stored as motion vectors and XOR differences of 16x16 pixel blocks
+   * relative to the previous frame, compressed with zlib, and there is a
+   * key frame every 10 seconds.
+   */
+  class VideoCapture_ZMBV : public VideoCapture_RLE8 {
+   private:
+    static const int  blockSize = 16;
+    static const int  blocksX = videoWidth / blockSize;
+    static const int  blocksY = videoHeight / blockSize;
+    uint8_t     *curFrameBuf;           // 768x576 color indices
+    uint8_t     *prvFrameBuf;           // 768x576 (last frame written)
+    // X and Y motion vector of each block (in the frame being encoded for
+    // the blocks already done, and in the previous frame for the others)
+    int8_t      *blockVectors;
+    // motion vectors searched for each block in addition to the vectors of
+    // the same and adjacent blocks, sorted by distance
+    std::vector< int8_t > searchVectors;
+    std::vector< uint8_t >  compressedBuf;
+    struct z_stream_s *zStream;        // NULL if not initialized
+    size_t      framesSinceKeyFrame;
+    // ----------------
+    // returns the number of different pixels (checking only every 'step'th
+    // line) between the block at x, y of curFrameBuf and the block at
+    // x + dx, y + dy of prvFrameBuf, or any value greater than 'maxDiff'
+    // if the difference is more than that
+    inline int compareBlock(int x, int y, int dx, int dy,
+                            int maxDiff, int step = 1) const;
+    size_t encodeKeyFrame();
+    size_t encodeDeltaFrame();
+    size_t compressFrame(bool isKeyFrame, size_t nBytes);
+    virtual void writeFrame(bool frameChanged);
+   public:
+    VideoCapture_ZMBV(void indexToRGBFunc(uint8_t color,
+                                          float& r, float& g, float& b) =
+                          (void (*)(uint8_t, float&, float&, float&)) 0,
+                      int frameRate_ = 50);
+    virtual ~VideoCapture_ZMBV();
+  };
+
+  // --------------------------------------------------------------------------
+
+  /*!
+   * Uncompressed video capture for external encoders: the frames (768x576,
+   * YUV 4:4:4) are written to a YUV4MPEG2 stream, and the audio to a 16-bit
+   * stereo PCM WAV stream with the same name and a ".wav" extension. Both
+   * files are written sequentially, without seeking back, so they can be
+   * named pipes (read by separate processes); all frames are written,
+   * including duplicates, and the WAV file has exactly (sampleRate /
+   * frameRate) samples for each frame. The size fields of the WAV header
+   * are only updated on closing the file if it is seekable.
+   */
+  class VideoCapture_Y4M : public VideoCapture_RLE8 {
+   private:
+    std::FILE   *wavFile;
+    uint8_t     *yuvFrameBuf;           // 768x576 Y, U, and V planes
+    uint8_t     *yuvColormap;           // 256 Y, U, and V values
+    uint64_t    wavDataBytes;
+    // ----------------
+    void writeWAVHeader(uint32_t dataBytes);
+    virtual void openOutputFile(const char *fileName);
+    virtual void closeOutputFile();
+    virtual void writeFrame(bool frameChanged);
+   public:
+    VideoCapture_Y4M(void indexToRGBFunc(uint8_t color,
+                                         float& r, float& g, float& b) =
+                         (void (*)(uint8_t, float&, float&, float&)) 0,
+                     int frameRate_ = 50);
+    virtual ~VideoCapture_Y4M();
+  };
+
+  // --------------------------------------------------------------------------
+
+  /*!
+   * Frame hash log for automated testing: every 'hashInterval'th frame
+   * (768x576 color indices, at the frame rate of VideoCapture_RLE8) is
+   * hashed with calculateFrameHash(), and a line with the frame number and
+   * the hash as 16 hexadecimal digits is written to a text file. If
+   * 'writePNGFiles' is true, the hashed frames are also saved as PNG images
+   * named after the log file, with the extension replaced by "_NNNNNN.png"
+   * where NNNNNN is the frame number. The hashing and PNG compression run
+   * on the encoder thread. Audio is not written.
+   */
+  class VideoCapture_FrameHash : public VideoCapture_RLE8 {
+   private:
+    int         hashInterval;
+    bool        writePNGFiles;
+    // true if pngBuf has the frame in outputFrameBuf
+    bool        frameDecoded;
+    uint64_t    frameHash;
+    // RGB palette (256 * 3 bytes) followed by 768x576 color indices, in
+    // the format expected by writePNGImage()
+    uint8_t     *pngBuf;
+    std::string pngFileNameBase;
+    // ----------------
+    virtual void openOutputFile(const char *fileName);
+    virtual void closeOutputFile();
+    virtual void writeFrame(bool frameChanged);
+   public:
+    VideoCapture_FrameHash(void indexToRGBFunc(uint8_t color,
+                                               float& r, float& g, float& b) =
+                               (void (*)(uint8_t, float&, float&, float&)) 0,
+                           int frameRate_ = 50, int hashInterval_ = 1,
+                           bool writePNGFiles_ = false);
+    virtual ~VideoCapture_FrameHash();
+    /*!
+     * Returns a 64-bit hash of 'nBytes' bytes of data, which does not
+     * depend on the byte order or word size of the host.
+     */
+    static uint64_t calculateFrameHash(const uint8_t *buf, size_t nBytes);
+  };
+
+  // --------------------------------------------------------------------------
+
   class VideoCapture_YV12 : public VideoCapture {
    public:
     static const int  videoWidth = 384;
     static const int  videoHeight = 288;
    private:
+    // maximum number of bytes of line data read by decodeLine()
+    static const int  lineDataBytes = 48 * 17;
     uint8_t     *lineBuf;               // 1024 bytes
     uint8_t     *frameBuf0Y;            // 384x288
     uint8_t     *frameBuf0V;            // 192x144
     uint8_t     *frameBuf0U;            // 192x144
+    // frame decoded from the queue by encodeFrame()
     uint8_t     *frameBuf1Y;            // 384x288
     uint8_t     *frameBuf1V;            // 192x144
     uint8_t     *frameBuf1U;            // 192x144
+    // 'encoderQueueSize' frames of 288 lines of undecoded line data
+    // ('lineDataBytes' bytes per line), the lines are converted to YV12 on
+    // the encoder thread
+    uint8_t     *queueFrameBuf;
+    // non-zero for each line of the queued frames that has been stored
+    uint8_t     *queueLineFlags;
+    // emulated time of each queued frame
+    int64_t     queueFrameTimes[encoderQueueSize];
     int32_t     *interpBufY;            // 384x288
     int32_t     *interpBufV;            // 192x144
     int32_t     *interpBufU;            // 192x144
     uint8_t     *outBufY;               // 384x288
     uint8_t     *outBufV;               // 192x144
     uint8_t     *outBufU;               // 192x144
-    uint8_t     *duplicateFrameBitmap;
     int64_t     timesliceLength;
     int64_t     curTime;
     int64_t     frame0Time;
@@ -209,13 +470,24 @@ namespace Ep128Emu {
     int32_t     interpTime;
     size_t      lineBufBytes;
     uint32_t    *colormap;
+    // resampling and interpolation functions, using SIMD instructions if
+    // they are supported by the CPU
+    void        (*resampleFunc)(int32_t *interpBuf,
+                                const uint8_t *buf0, const uint8_t *buf1,
+                                int32_t scaleFac, size_t n);
+    bool        (*interpolateFunc)(uint8_t *outBuf, int32_t *interpBuf,
+                                   const uint8_t *buf0, const uint8_t *buf1,
+                                   int32_t scaleFac0, int32_t scaleFac1,
+                                   int32_t outScale, size_t n);
     // ----------------
-    void decodeLine();
+    // convert line 'lineNum' (0 to 287) from 'bufp' to frameBuf1
+    void decodeLine(int lineNum, const uint8_t *bufp);
     void frameDone();
+    virtual void encodeFrame(int n);
+    // reset the queue entry at queueWritePos for storing a new frame
+    void clearQueueFrame();
     void resampleFrame();
     void writeFrame(bool frameChanged);
-    virtual void writeAVIHeader();
-    virtual void writeAVIIndex();
    public:
     VideoCapture_YV12(void indexToRGBFunc(uint8_t color,
                                           float& r, float& g, float& b) =
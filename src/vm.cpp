@@ -24,8 +24,11 @@
 #include "snd_conv.hpp"
 #include "soundio.hpp"
 #include "tape.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
 #include "vm.hpp"
 #include "debuglib.hpp"
+#include "bpcond.hpp"
 
 #include <typeinfo>
 
@@ -121,6 +124,7 @@ namespace Ep128Emu {
       audioOutputEnabled(true),
       audioOutputHighQuality(false),
       displayEnabled(true),
+      warpModeEnabled(false),
       audioConverterSampleRate(0.0f),
       audioOutputSampleRate(0.0f),
       audioOutputVolume(0.7071f),
@@ -132,6 +136,7 @@ namespace Ep128Emu {
       audioOutputEQ_Q(0.7071f),
       tapePlaybackOn(false),
       tapeRecordOn(false),
+      fastTapeLoadEnabled(false),
       tapeMotorOn(false),
       tapeMotorState(0x00),
       tape((Tape *) 0),
@@ -142,6 +147,13 @@ namespace Ep128Emu {
       tapeSoundFileFilterMaxFreq(5000.0f),
       breakPointCallback(&defaultBreakPointCallback),
       breakPointCallbackUserData((void *) 0),
+      breakPointConditionCnt(0),
+      traceRecorder((TraceRecorder *) 0),
+      profiler((Profiler *) 0),
+      profilerRunning(false),
+      frameHookCallback((void (*)(void *)) 0),
+      ioHookCallback((void (*)(void *, int, uint16_t, uint8_t)) 0),
+      hookCallbackUserData((void *) 0),
       fileIOEnabled(false),
 #ifndef WIN32
       fileIOWorkingDirectory("./"),
@@ -155,6 +167,16 @@ namespace Ep128Emu {
 
   VirtualMachine::~VirtualMachine()
   {
+    if (traceRecorder) {
+      delete traceRecorder;
+      traceRecorder = (TraceRecorder *) 0;
+    }
+    profilerRunning = false;
+    if (profiler) {
+      delete profiler;
+      profiler = (Profiler *) 0;
+    }
+    clearBreakPointConditions();
     if (tape) {
       delete tape;
       tape = (Tape *) 0;
@@ -197,7 +219,8 @@ namespace Ep128Emu {
       audioConverter->setOutputSampleRate(audioOutputSampleRate);
     }
     writingAudioOutput =
-        (audioConverter != (AudioConverter *) 0 && audioOutputEnabled);
+        (audioConverter != (AudioConverter *) 0 && audioOutputEnabled &&
+         !warpModeEnabled);
     if (haveTape() && getIsTapeMotorOn() && getTapeButtonState() != 0)
       stopDemo();
   }
@@ -274,7 +297,8 @@ namespace Ep128Emu {
                                                audioOutputEQ_Q);
       }
       writingAudioOutput =
-          (audioConverter != (AudioConverter *) 0 && audioOutputEnabled);
+          (audioConverter != (AudioConverter *) 0 && audioOutputEnabled &&
+           !warpModeEnabled);
     }
   }
 
@@ -328,7 +352,8 @@ namespace Ep128Emu {
   {
     audioOutputEnabled = isEnabled;
     writingAudioOutput =
-        (audioConverter != (AudioConverter *) 0 && audioOutputEnabled);
+        (audioConverter != (AudioConverter *) 0 && audioOutputEnabled &&
+         !warpModeEnabled);
   }
 
   void VirtualMachine::setEnableDisplay(bool isEnabled)
@@ -336,6 +361,17 @@ namespace Ep128Emu {
     displayEnabled = isEnabled;
   }
 
+  void VirtualMachine::setWarpMode(bool isEnabled)
+  {
+    if (isEnabled == warpModeEnabled)
+      return;
+    warpModeEnabled = isEnabled;
+    writingAudioOutput =
+        (audioConverter != (AudioConverter *) 0 && audioOutputEnabled &&
+         !warpModeEnabled);
+    display.setWarpMode(isEnabled);
+  }
+
   void VirtualMachine::setCPUFrequency(size_t freq_)
   {
     (void) freq_;
@@ -379,19 +415,24 @@ namespace Ep128Emu {
     vmStatus_.tapeSampleRate = getTapeSampleRate();
     vmStatus_.tapeSampleSize = getTapeSampleSize();
     vmStatus_.floppyDriveLEDState = getFloppyDriveLEDState();
+    vmStatus_.tapeMotorOn = getIsTapeRunning();
     vmStatus_.isPlayingDemo = getIsPlayingDemo();
     vmStatus_.isRecordingDemo = getIsRecordingDemo();
   }
 
   void VirtualMachine::openVideoCapture(
       int frameRate_,
-      bool yuvFormat_,
+      int videoFormat_,
+      int frameHashInterval_,
+      bool frameHashPNG_,
       void (*errorCallback_)(void *userData, const char *msg),
       void (*fileNameCallback_)(void *userData, std::string& fileName),
       void *userData_)
   {
     (void) frameRate_;
-    (void) yuvFormat_;
+    (void) videoFormat_;
+    (void) frameHashInterval_;
+    (void) frameHashPNG_;
     (void) errorCallback_;
     (void) fileNameCallback_;
     (void) userData_;
@@ -626,20 +667,278 @@ namespace Ep128Emu {
       tape->setIsMotorOn(tapeMotorOn);
   }
 
+  void VirtualMachine::setEnableFastTapeLoad(bool isEnabled)
+  {
+    fastTapeLoadEnabled = isEnabled;
+  }
+
   void VirtualMachine::setBreakPoints(const BreakPointList& bpList)
   {
     for (size_t i = 0; i < bpList.getBreakPointCnt(); i++)
       setBreakPoint(bpList.getBreakPoint(i), true);
   }
 
+  void VirtualMachine::openTraceFile(std::FILE *f, uint8_t flags)
+  {
+    (void) flags;
+    if (f)
+      std::fclose(f);
+    throw Exception("execution trace is not supported by this machine");
+  }
+
+  void VirtualMachine::closeTraceFile()
+  {
+    if (traceRecorder) {
+      delete traceRecorder;
+      traceRecorder = (TraceRecorder *) 0;
+    }
+  }
+
+  void VirtualMachine::startProfiler(bool callStackEnabled)
+  {
+    (void) callStackEnabled;
+    throw Exception("profiling is not supported by this machine");
+  }
+
+  void VirtualMachine::stopProfiler()
+  {
+    profilerRunning = false;
+  }
+
+  bool VirtualMachine::getProfilerData(uint32_t addr,
+                                       uint64_t& insnCnt,
+                                       uint64_t& cycleCnt) const
+  {
+    insnCnt = 0U;
+    cycleCnt = 0U;
+    if (!profiler)
+      return false;
+    profiler->getInstructionStats(addr, insnCnt, cycleCnt);
+    return true;
+  }
+
+  void VirtualMachine::saveProfilerData(const char *fileName,
+                                        size_t maxEntries)
+  {
+    if (!profiler)
+      throw Exception("no profiler data");
+    std::FILE *f = (std::FILE *) 0;
+    try {
+      if (!fileName)
+        fileName = "";
+      std::string fileName_(fileName);
+      int       err = openFileInWorkingDirectory(f, fileName_, "w");
+      if (err)
+        throw Exception(getFileOpenErrorMessage(err));
+      profiler->writeReport(f, maxEntries);
+      if (std::ferror(f) || std::fflush(f) != 0)
+        throw Exception("error writing file - is the disk full ?");
+      std::fclose(f);
+      f = (std::FILE *) 0;
+    }
+    catch (...) {
+      if (f)
+        std::fclose(f);
+      throw;
+    }
+  }
+
+  void VirtualMachine::setAccessStatsEnabled(bool isEnabled)
+  {
+    if (isEnabled) {
+      throw Exception("memory access statistics are not supported "
+                      "by this machine");
+    }
+  }
+
+  bool VirtualMachine::getAccessStatsEnabled() const
+  {
+    return false;
+  }
+
+  void VirtualMachine::getMemoryAccessStats(uint32_t addr, uint64_t& readCnt,
+                                            uint64_t& writeCnt,
+                                            uint64_t& execCnt) const
+  {
+    (void) addr;
+    readCnt = 0U;
+    writeCnt = 0U;
+    execCnt = 0U;
+  }
+
+  void VirtualMachine::getIOPortAccessStats(uint16_t addr, uint64_t& readCnt,
+                                            uint64_t& writeCnt) const
+  {
+    (void) addr;
+    readCnt = 0U;
+    writeCnt = 0U;
+  }
+
+  void VirtualMachine::saveAccessStats(const char *fileName)
+  {
+    if (!getAccessStatsEnabled())
+      throw Exception("memory access statistics are not enabled");
+    std::FILE *f = (std::FILE *) 0;
+    try {
+      if (!fileName)
+        fileName = "";
+      std::string fileName_(fileName);
+      int       err = openFileInWorkingDirectory(f, fileName_, "w");
+      if (err)
+        throw Exception(getFileOpenErrorMessage(err));
+      // counts are printed as floating point numbers, because printf()
+      // support for 64-bit integers is not portable
+      std::fprintf(f, "; memory accesses per 256 byte block\n"
+                      "; address           reads          writes"
+                      "        executes\n");
+      for (uint32_t addr = 0U; addr < 0x00400000U; addr += 0x0100U) {
+        uint64_t  r, w, x;
+        getMemoryAccessStats(addr, r, w, x);
+        if ((r | w | x) != 0U) {
+          std::fprintf(f, "  %06X  %14.0f  %14.0f  %14.0f\n",
+                       (unsigned int) addr, double(r), double(w), double(x));
+        }
+      }
+      std::fprintf(f, ";\n; I/O port accesses\n"
+                      "; port              reads          writes\n");
+      for (uint16_t addr = 0; addr < 0x0100; addr++) {
+        uint64_t  r, w;
+        getIOPortAccessStats(addr, r, w);
+        if ((r | w) != 0U) {
+          std::fprintf(f, "  %02X      %14.0f  %14.0f\n",
+                       (unsigned int) addr, double(r), double(w));
+        }
+      }
+      if (std::ferror(f) || std::fflush(f) != 0)
+        throw Exception("error writing file - is the disk full ?");
+      std::fclose(f);
+      f = (std::FILE *) 0;
+    }
+    catch (...) {
+      if (f)
+        std::fclose(f);
+      throw;
+    }
+  }
+
+  void VirtualMachine::setReverseDebugEnabled(bool isEnabled,
+                                              double checkpointInterval,
+                                              size_t maxMemoryMB)
+  {
+    (void) checkpointInterval;
+    (void) maxMemoryMB;
+    if (isEnabled)
+      throw Exception("reverse execution is not supported by this machine");
+  }
+
+  bool VirtualMachine::getReverseDebugEnabled() const
+  {
+    return false;
+  }
+
+  void VirtualMachine::reverseExecute(int mode, uint32_t addr)
+  {
+    (void) mode;
+    (void) addr;
+    throw Exception("reverse execution is not enabled");
+  }
+
   void VirtualMachine::setBreakPoint(const BreakPoint& bp, bool isEnabled)
   {
     (void) bp;
     (void) isEnabled;
   }
 
+  void VirtualMachine::setBreakPointCondition(const BreakPoint& bp,
+                                              bool isEnabled)
+  {
+    uint32_t  n = bp.addr();
+    if (bp.isIO())
+      n = 0x80000000U | (n & 0xFFU);
+    else if (bp.haveSegment())
+      n = 0x40000000U | (uint32_t(bp.segment()) << 14) | (n & 0x3FFFU);
+    std::map< uint32_t, BreakPointCondition * >::iterator i =
+        breakPointConditions.find(n);
+    if (i != breakPointConditions.end()) {
+      if ((*i).second) {
+        delete (*i).second;
+        breakPointConditionCnt--;
+      }
+      breakPointConditions.erase(i);
+    }
+    // ignore breakpoints never trigger the callback
+    if (!isEnabled || !(bp.isRead() || bp.isWrite() || bp.isExecute()))
+      return;
+    BreakPointCondition *p = (BreakPointCondition *) 0;
+    if (bp.condition().length() > 0)
+      p = new BreakPointCondition(bp.condition());
+    try {
+      breakPointConditions.insert(
+          std::pair< uint32_t, BreakPointCondition * >(n, p));
+    }
+    catch (...) {
+      if (p)
+        delete p;
+      throw;
+    }
+    if (p)
+      breakPointConditionCnt++;
+  }
+
+  void VirtualMachine::clearBreakPointConditions()
+  {
+    std::map< uint32_t, BreakPointCondition * >::iterator i;
+    for (i = breakPointConditions.begin();
+         i != breakPointConditions.end();
+         i++) {
+      if ((*i).second)
+        delete (*i).second;
+    }
+    breakPointConditions.clear();
+    breakPointConditionCnt = 0;
+  }
+
+  bool VirtualMachine::checkBreakPointCondition_(int type, uint16_t addr,
+                                                 uint8_t value)
+  {
+    // single step mode always stops
+    if (type == 3)
+      return true;
+    std::map< uint32_t, BreakPointCondition * >::const_iterator i, j;
+    if (type >= 5) {
+      i = breakPointConditions.find(0x80000000U | uint32_t(addr & 0xFF));
+      j = breakPointConditions.end();
+    }
+    else {
+      // a memory access can match both a CPU address and a 22-bit breakpoint
+      i = breakPointConditions.find(uint32_t(addr));
+      j = breakPointConditions.find(
+              0x40000000U | (uint32_t(getMemoryPage(int(addr >> 14))) << 14)
+              | uint32_t(addr & 0x3FFF));
+    }
+    if (i == breakPointConditions.end() && j == breakPointConditions.end()) {
+      // not a tracked breakpoint
+      return true;
+    }
+    // break if either breakpoint is unconditional, or any condition is true
+    if (i != breakPointConditions.end() && !((*i).second))
+      return true;
+    if (j != breakPointConditions.end() && !((*j).second))
+      return true;
+    if (i != breakPointConditions.end() &&
+        (*i).second->evaluate(*this, type, addr, value)) {
+      return true;
+    }
+    if (j != breakPointConditions.end() &&
+        (*j).second->evaluate(*this, type, addr, value)) {
+      return true;
+    }
+    return false;
+  }
+
   void VirtualMachine::clearBreakPoints()
   {
+    clearBreakPointConditions();
   }
 
   void VirtualMachine::setBreakPointPriorityThreshold(int n)
@@ -669,6 +968,17 @@ namespace Ep128Emu {
     breakPointCallbackUserData = userData_;
   }
 
+  void VirtualMachine::setHookCallbacks(
+      void (*frameHookCallback_)(void *userData),
+      void (*ioHookCallback_)(void *userData, int type,
+                              uint16_t addr, uint8_t value),
+      void *userData_)
+  {
+    frameHookCallback = frameHookCallback_;
+    ioHookCallback = ioHookCallback_;
+    hookCallbackUserData = userData_;
+  }
+
   uint8_t VirtualMachine::getMemoryPage(int n) const
   {
     (void) n;
@@ -852,6 +1162,15 @@ namespace Ep128Emu {
       tape->setIsMotorOn(tapeMotorOn);
   }
 
+  bool VirtualMachine::readTapeDataBlock(std::vector< uint8_t >& buf)
+  {
+    if (!(fastTapeLoadEnabled && getIsTapeRunning() && !tapeRecordOn)) {
+      buf.clear();
+      return false;
+    }
+    return tape->readDataBlock(buf);
+  }
+
   void VirtualMachine::setAudioConverterSampleRate(float sampleRate_)
   {
     if (sampleRate_ != audioConverterSampleRate) {
@@ -881,7 +1200,8 @@ namespace Ep128Emu {
                                                audioOutputEQ_Q);
       }
       writingAudioOutput =
-          (audioConverter != (AudioConverter *) 0 && audioOutputEnabled);
+          (audioConverter != (AudioConverter *) 0 && audioOutputEnabled &&
+           !warpModeEnabled);
     }
   }
 
@@ -1161,5 +1481,54 @@ namespace Ep128Emu {
     }
   }
 
+  size_t VirtualMachine::loadSymbolFile(const char *fileName, int segment)
+  {
+    std::FILE *f = (std::FILE *) 0;
+    size_t    nSymbols = 0;
+    try {
+      if (!fileName)
+        fileName = "";
+      std::string fileName_(fileName);
+      int       err = openFileInWorkingDirectory(f, fileName_, "rb");
+      if (err)
+        throw Exception(getFileOpenErrorMessage(err));
+      nSymbols = symbolTable.loadFile(f, segment);
+      std::fclose(f);
+      f = (std::FILE *) 0;
+    }
+    catch (...) {
+      if (f)
+        std::fclose(f);
+      throw;
+    }
+    return nSymbols;
+  }
+
+  const char * VirtualMachine::findSymbol(uint32_t& offs,
+                                          uint32_t addr, bool isCPUAddress,
+                                          uint32_t maxOffs) const
+  {
+    offs = 0U;
+    if (symbolTable.empty())
+      return (char *) 0;
+    uint32_t  physAddr = 0xFFFFFFFFU;
+    uint32_t  cpuAddr = 0xFFFFFFFFU;
+    if (isCPUAddress) {
+      cpuAddr = addr & 0xFFFFU;
+      physAddr = (uint32_t(getMemoryPage(int(cpuAddr >> 14))) << 14)
+                 | (cpuAddr & 0x3FFFU);
+    }
+    else {
+      physAddr = addr & 0x003FFFFFU;
+      for (int i = 0; i < 4; i++) {
+        if (uint32_t(getMemoryPage(i)) == (physAddr >> 14)) {
+          cpuAddr = (uint32_t(i) << 14) | (physAddr & 0x3FFFU);
+          break;
+        }
+      }
+    }
+    return symbolTable.findMemorySymbol(offs, physAddr, cpuAddr, maxOffs);
+  }
+
 }       // namespace Ep128Emu
 
@@ -27,6 +27,9 @@
 #include "snd_conv.hpp"
 #include "soundio.hpp"
 #include "tape.hpp"
+#include "symtab.hpp"
+
+#include <map>
 
 namespace Ep128 {
   struct Z80_REGISTERS;
@@ -34,6 +37,10 @@ namespace Ep128 {
 
 namespace Ep128Emu {
 
+  class TraceRecorder;
+  class Profiler;
+  class BreakPointCondition;
+
   class VirtualMachine {
    protected:
     VideoDisplay&   display;
@@ -44,6 +51,7 @@ namespace Ep128Emu {
     bool            audioOutputEnabled;
     bool            audioOutputHighQuality;
     bool            displayEnabled;
+    bool            warpModeEnabled;
     float           audioConverterSampleRate;
     float           audioOutputSampleRate;
     float           audioOutputVolume;
@@ -55,6 +63,7 @@ namespace Ep128Emu {
     float           audioOutputEQ_Q;
     bool            tapePlaybackOn;
     bool            tapeRecordOn;
+    bool            fastTapeLoadEnabled;
     // true if tapeMotorState is non-zero
     bool            tapeMotorOn;
     // bit 0: 1 if tape motor is turned on by remote control
@@ -70,11 +79,30 @@ namespace Ep128Emu {
     void            (*breakPointCallback)(void *userData, int type,
                                           uint16_t addr, uint8_t value);
     void            *breakPointCallbackUserData;
+    // compiled breakpoint conditions, indexed by the breakpoint address
+    // (+ 0x40000000 + segment * 0x4000 for 22-bit addresses, or
+    // 0x80000000 for I/O ports); NULL for unconditional breakpoints
+    std::map< uint32_t, BreakPointCondition * > breakPointConditions;
+    // number of non-NULL entries in breakPointConditions
+    size_t          breakPointConditionCnt;
+    // non-NULL while recording a binary execution trace
+    TraceRecorder   *traceRecorder;
+    // Z80 code profiler, NULL if it has not been started yet
+    Profiler        *profiler;
+    // true if profiler data is being collected
+    bool            profilerRunning;
+    // optional callbacks for scripts, called at the beginning of each
+    // video frame, and on every I/O port read (type 5) or write (type 6)
+    void            (*frameHookCallback)(void *userData);
+    void            (*ioHookCallback)(void *userData, int type,
+                                      uint16_t addr, uint8_t value);
+    void            *hookCallbackUserData;
     bool            fileIOEnabled;
    private:
     std::string     fileIOWorkingDirectory;
     void            (*fileNameCallback)(void *userData, std::string& fileName);
     void            *fileNameCallbackUserData;
+    SymbolTable     symbolTable;
    public:
     struct VMStatus {
       bool      isRecordingDemo;
@@ -102,6 +130,8 @@ namespace Ep128Emu {
       //   0x04000000: IDE drive 3 red LED is on (low priority)
       //   0x0C000000: IDE drive 3 red LED is on (high priority)
       uint32_t  floppyDriveLEDState;
+      // true if the tape is playing or recording, and the motor is on
+      bool      tapeMotorOn;
     };
     // --------
     VirtualMachine(VideoDisplay& display_, AudioOutput& audioOutput_);
@@ -187,6 +217,13 @@ namespace Ep128Emu {
      * Set if video data is sent to the associated VideoDisplay object.
      */
     virtual void setEnableDisplay(bool isEnabled);
+    /*!
+     * Set if the emulation is running in warp mode (faster than real time,
+     * with no speed limit). While enabled, audio output is suppressed, and
+     * the number of frames sent to the display is limited, without changing
+     * the settings made with setEnableAudioOutput() and setEnableDisplay().
+     */
+    virtual void setWarpMode(bool isEnabled);
     /*!
      * Set CPU clock frequency (in Hz).
      */
@@ -234,13 +271,18 @@ namespace Ep128Emu {
     virtual void getVMStatus(VMStatus& vmStatus_);
     /*!
      * Create video capture object with the specified frame rate (24 to 60)
-     * and format (768x576 RLE8 or 384x288 YV12) if it does not exist yet,
-     * and optionally set callbacks for printing error messages and asking
-     * for a new output file on reaching 2 GB file size.
+     * and format (0: 768x576 RLE8, 1: 384x288 YV12, 2: 768x576 ZMBV,
+     * 3: 768x576 YUV4MPEG2 and WAV, 4: frame hash log) if it does not exist
+     * yet, and optionally set callbacks for printing error messages and
+     * asking for a new output file when the index of the AVI file is full.
+     * For the frame hash log, every 'frameHashInterval_'th frame is hashed,
+     * and also saved as a PNG image if 'frameHashPNG_' is true.
      */
     virtual void openVideoCapture(
         int frameRate_ = 50,
-        bool yuvFormat_ = false,
+        int videoFormat_ = 0,
+        int frameHashInterval_ = 1,
+        bool frameHashPNG_ = false,
         void (*errorCallback_)(void *userData, const char *msg) =
             (void (*)(void *, const char *)) 0,
         void (*fileNameCallback_)(void *userData, std::string& fileName) =
@@ -411,12 +453,132 @@ namespace Ep128Emu {
      * control from the emulated machine.
      */
     virtual void setForceTapeMotorOn(bool isEnabled);
+    /*!
+     * If enabled, the ROM tape loading routines of the emulated machine are
+     * trapped where supported, and standard speed data blocks are read
+     * directly from the tape file instead of decoding the signal.
+     */
+    virtual void setEnableFastTapeLoad(bool isEnabled);
     // ------------------------------ DEBUGGING -------------------------------
     /*!
      * Add breakpoints from the specified breakpoint list (see also
      * bplist.hpp).
      */
     virtual void setBreakPoints(const BreakPointList& bpList);
+    /*!
+     * Start recording a binary execution trace (see trace.hpp) to 'f',
+     * which should be opened for writing in binary mode, and is closed by
+     * the virtual machine. 'flags' can be any combination of
+     * TraceRecorder::traceMemoryAccesses and TraceRecorder::traceIOAccesses.
+     * An exception is thrown if the machine does not support tracing.
+     */
+    virtual void openTraceFile(std::FILE *f, uint8_t flags = 0);
+    /*!
+     * Stop recording the execution trace, and close the file.
+     */
+    virtual void closeTraceFile();
+    /*!
+     * Returns true if an execution trace is being recorded.
+     */
+    inline bool getIsRecordingTrace() const
+    {
+      return (traceRecorder != (TraceRecorder *) 0);
+    }
+    /*!
+     * Start collecting the number of times each instruction is executed,
+     * and the total number of CPU cycles spent on it. Any previously
+     * collected data is discarded. If 'callStackEnabled' is true, the
+     * number of calls and the time spent in functions (including the
+     * functions called by them) is also recorded.
+     * An exception is thrown if the machine does not support profiling.
+     */
+    virtual void startProfiler(bool callStackEnabled = false);
+    /*!
+     * Stop collecting profiler data. The data collected so far remains
+     * available until the profiler is restarted.
+     */
+    virtual void stopProfiler();
+    /*!
+     * Returns true if the profiler is running.
+     */
+    inline bool getIsProfilerRunning() const
+    {
+      return profilerRunning;
+    }
+    /*!
+     * Get the number of times the instruction at 22-bit physical address
+     * 'addr' was executed, and the number of CPU cycles it took in total.
+     * Returns false if there is no profiler data.
+     */
+    bool getProfilerData(uint32_t addr,
+                         uint64_t& insnCnt, uint64_t& cycleCnt) const;
+    /*!
+     * Write a text report of the profiler data to 'fileName', listing the
+     * 'maxEntries' (0: all) instructions and functions that took the most
+     * CPU time.
+     */
+    void saveProfilerData(const char *fileName, size_t maxEntries = 0);
+    /*!
+     * Start (if 'isEnabled' is true) or stop counting the CPU memory
+     * accesses in each 256 byte block of every segment, and the reads and
+     * writes of each I/O port. Starting clears any previous counts, and
+     * stopping discards them. An exception is thrown if the machine does
+     * not support collecting access statistics.
+     */
+    virtual void setAccessStatsEnabled(bool isEnabled);
+    /*!
+     * Returns true if memory and I/O port accesses are being counted.
+     */
+    virtual bool getAccessStatsEnabled() const;
+    /*!
+     * Get the number of CPU reads, writes, and opcode reads in the 256 byte
+     * block at 22-bit physical address 'addr'.
+     */
+    virtual void getMemoryAccessStats(uint32_t addr, uint64_t& readCnt,
+                                      uint64_t& writeCnt,
+                                      uint64_t& execCnt) const;
+    /*!
+     * Get the number of reads and writes of I/O port 'addr'.
+     */
+    virtual void getIOPortAccessStats(uint16_t addr, uint64_t& readCnt,
+                                      uint64_t& writeCnt) const;
+    /*!
+     * Write all non-zero memory block and I/O port access counts to a text
+     * file.
+     */
+    void saveAccessStats(const char *fileName);
+    /*!
+     * Enable or disable recording the execution history for reverse
+     * debugging. While enabled, a snapshot of the machine state is stored
+     * in memory every 'checkpointInterval' seconds of emulated time, using
+     * up to 'maxMemoryMB' megabytes (older checkpoints are deleted), and
+     * keyboard events are logged so that any instruction since the oldest
+     * checkpoint can be reached by loading a snapshot and replaying from
+     * there. An exception is thrown if the machine does not support
+     * reverse execution.
+     */
+    virtual void setReverseDebugEnabled(bool isEnabled,
+                                        double checkpointInterval = 0.1,
+                                        size_t maxMemoryMB = 64);
+    /*!
+     * Returns true if the execution history is being recorded.
+     */
+    virtual bool getReverseDebugEnabled() const;
+    /*!
+     * Request going back in the execution history; can only be called from
+     * the breakpoint callback, and takes effect after it returns. The next
+     * break will be at the beginning of the selected instruction, which is
+     *   mode = 0: the previous instruction (step back)
+     *   mode = 1: the last one before the current position at which a
+     *             breakpoint was triggered (reverse continue)
+     *   mode = 2: the last one that wrote the byte at 22-bit physical
+     *             address 'addr'
+     * If no such instruction is found in the recorded history, the break
+     * is at the oldest available position. An exception is thrown if
+     * reverse debugging is not enabled, or there is no history to go back
+     * to.
+     */
+    virtual void reverseExecute(int mode, uint32_t addr = 0U);
     /*!
      * Add or delete a single breakpoint.
      */
@@ -463,6 +625,17 @@ namespace Ep128Emu {
                                            void *userData, int type,
                                            uint16_t addr, uint8_t value),
                                        void *userData_);
+    /*!
+     * Set functions to be called at the start of each video frame (vertical
+     * sync), and on every I/O port read or write ('type' is 5 or 6, as in
+     * the case of the breakpoint callback). Either function can be NULL to
+     * disable the hook.
+     */
+    void setHookCallbacks(void (*frameHookCallback_)(void *userData),
+                          void (*ioHookCallback_)(void *userData, int type,
+                                                  uint16_t addr,
+                                                  uint8_t value),
+                          void *userData_);
     /*!
      * Returns the segment at page 'n' (0 to 3).
      */
@@ -540,6 +713,36 @@ namespace Ep128Emu {
     virtual uint32_t disassembleInstruction(std::string& buf, uint32_t addr,
                                             bool isCPUAddress = false,
                                             int32_t offs = 0) const;
+    /*!
+     * Returns the symbol table used for annotating disassembly, profiler
+     * reports, and breakpoint lists.
+     */
+    inline SymbolTable& getSymbolTable()
+    {
+      return this->symbolTable;
+    }
+    inline const SymbolTable& getSymbolTable() const
+    {
+      return this->symbolTable;
+    }
+    /*!
+     * Open 'fileName' with openFileInWorkingDirectory(), and load symbol
+     * definitions from it (see SymbolTable::loadFile()). If 'segment' is
+     * not negative, 16-bit symbol values are offsets into that segment.
+     * Returns the number of symbols loaded. On error, an exception is
+     * thrown.
+     */
+    virtual size_t loadSymbolFile(const char *fileName, int segment = -1);
+    /*!
+     * Find the symbol at memory address 'addr' (16-bit CPU address if
+     * 'isCPUAddress' is true, 22-bit physical address otherwise), or the
+     * nearest one below it within 'maxOffs' bytes. Symbols defined for both
+     * the physical and the currently mapped CPU address are searched.
+     * Returns the name, and stores the distance in 'offs', or returns NULL
+     * if no symbol is found.
+     */
+    const char *findSymbol(uint32_t& offs, uint32_t addr, bool isCPUAddress,
+                           uint32_t maxOffs = 0U) const;
     /*!
      * Returns a reference to a structure containing all Z80 registers;
      * see z80/z80.hpp for more information.
@@ -697,7 +900,56 @@ namespace Ep128Emu {
     {
       return this->displayEnabled;
     }
+    inline bool getIsTapeRunning() const
+    {
+      return (this->tape != (Tape *) 0 &&
+              this->tapeMotorOn && this->tapePlaybackOn);
+    }
+    /*!
+     * If fast tape loading is enabled, and the tape is playing, read the
+     * next standard speed data block to 'buf' (see Tape::readDataBlock()).
+     * Returns false if the block cannot be loaded this way, in which case
+     * the tape is not changed, and the signal should be decoded normally.
+     */
+    bool readTapeDataBlock(std::vector< uint8_t >& buf);
     void setAudioConverterSampleRate(float sampleRate_);
+    /*!
+     * Compile and store (if 'isEnabled' is true and the breakpoint has a
+     * condition), or delete the condition for breakpoint 'bp'. Enabled
+     * unconditional breakpoints are also recorded, so that a condition
+     * that evaluates to false cannot suppress them. Should be called by
+     * setBreakPoint() in derived classes.
+     */
+    void setBreakPointCondition(const BreakPoint& bp, bool isEnabled);
+    /*!
+     * Delete all breakpoint conditions. Should be called by
+     * clearBreakPoints() in derived classes.
+     */
+    void clearBreakPointConditions();
+   private:
+    bool checkBreakPointCondition_(int type, uint16_t addr, uint8_t value);
+   protected:
+    /*!
+     * Call the breakpoint callback if the breakpoint at 'addr' has no
+     * condition, or it evaluates to true.
+     */
+    inline void runBreakPointCallback(int type, uint16_t addr, uint8_t value)
+    {
+      if (EP128EMU_UNLIKELY(breakPointConditionCnt != 0)) {
+        if (!checkBreakPointCondition_(type, addr, value))
+          return;
+      }
+      breakPointCallback(breakPointCallbackUserData, type, addr, value);
+    }
+    /*!
+     * Call the frame hook, if any. Should be called by derived classes
+     * at the start of the vertical sync.
+     */
+    inline void runFrameHook()
+    {
+      if (EP128EMU_UNLIKELY(bool(frameHookCallback)))
+        frameHookCallback(hookCallbackUserData);
+    }
    public:
     /*!
      * Open a file in the user specified working directory. 'fileName_' is the
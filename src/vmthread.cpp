@@ -49,10 +49,13 @@ namespace Ep128Emu {
       joinFlag(false),
       errorFlag(false),
       pauseFlag(true),
+      warpModeFlag(false),
+      autoWarpMode(0),
       timesliceLength(0.0f),
       avgTimesliceLength(0.002f),
       prvTime(0.0),
       nxtTime(0.0),
+      warpEndTime(0.0),
       userData(userData_),
       errorCallback(&defaultErrorCallback),
       processCallback((void (*)(void *)) 0)
@@ -65,6 +68,7 @@ namespace Ep128Emu {
     vmStatus.tapeSampleRate = 0L;
     vmStatus.tapeSampleSize = 0;
     vmStatus.floppyDriveLEDState = 0U;
+    vmStatus.tapeMotorOn = false;
     for (int i = 0; i < 128; i++)
       keyboardState[i] = false;
     this->start();
@@ -100,6 +104,7 @@ namespace Ep128Emu {
     vmStatus.tapeSampleRate = 0L;
     vmStatus.tapeSampleSize = 0;
     vmStatus.floppyDriveLEDState = 0U;
+    vmStatus.tapeMotorOn = false;
     while (messageQueue) {
       Message *m = messageQueue;
       messageQueue = m->nextMessage;
@@ -165,7 +170,9 @@ namespace Ep128Emu {
       if (!pauseFlag) {
         vm.run(2000);
         curTime = speedTimer.getRealTime();
-        if (curTime < nxtTime)
+        if (warpModeFlag)
+          nxtTime = curTime;
+        else if (curTime < nxtTime)
           Timer::wait(nxtTime - curTime);
         else if (curTime > (nxtTime + 0.25))
           nxtTime = curTime;
@@ -198,6 +205,21 @@ namespace Ep128Emu {
     avgTimesliceLength = (avgTimesliceLength * 0.995f) + (deltaTime * 0.005f);
     try {
       vm.getVMStatus(vmStatus);
+      // enable warp mode while the tape or disk is active
+      if (!pauseFlag &&
+          (((autoWarpMode & 0x01) != 0 && vmStatus.tapeMotorOn) ||
+           ((autoWarpMode & 0x02) != 0 &&
+            vmStatus.floppyDriveLEDState != 0U))) {
+        warpEndTime = curTime + 0.5;
+      }
+      bool    newWarpModeFlag =
+          (autoWarpMode != 0 && !pauseFlag && curTime < warpEndTime);
+      if (newWarpModeFlag != warpModeFlag) {
+        warpModeFlag = newWarpModeFlag;
+        vm.setWarpMode(warpModeFlag);
+        if (!warpModeFlag)
+          nxtTime = curTime;
+      }
     }
     catch (...) {
       errorFlag = true;
@@ -234,6 +256,7 @@ namespace Ep128Emu {
     else
       speedPercentage = 1000000.0f;
     isPaused = vmThread_.pauseFlag;
+    isWarpModeOn = vmThread_.warpModeFlag;
     isRecordingDemo = vmThread_.vmStatus.isRecordingDemo;
     isPlayingDemo = vmThread_.vmStatus.isPlayingDemo;
     tapeReadOnly = vmThread_.vmStatus.tapeReadOnly;
@@ -402,6 +425,13 @@ namespace Ep128Emu {
     mutex_.unlock();
   }
 
+  void VMThread::setAutoWarpMode(bool tapeEnabled_, bool diskEnabled_)
+  {
+    mutex_.lock();
+    autoWarpMode = uint8_t(tapeEnabled_) | (uint8_t(diskEnabled_) << 1);
+    mutex_.unlock();
+  }
+
   VMThread::Message * VMThread::allocateMessage_()
   {
     mutex_.lock();
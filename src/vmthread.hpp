@@ -36,6 +36,8 @@ namespace Ep128Emu {
       int       threadStatus;
       float     speedPercentage;
       bool      isPaused;
+      // true if the emulation is currently running in automatic warp mode
+      bool      isWarpModeOn;
       // --------
       VMThreadStatus(VMThread& vmThread_);
     };
@@ -54,10 +56,15 @@ namespace Ep128Emu {
     bool            joinFlag;
     bool            errorFlag;
     bool            pauseFlag;
+    bool            warpModeFlag;
+    // bit 0: enable warp mode while the tape is running
+    // bit 1: enable warp mode while any disk drive LED is on
+    uint8_t         autoWarpMode;
     float           timesliceLength;
     float           avgTimesliceLength;
     double          prvTime;
     double          nxtTime;
+    double          warpEndTime;
     VirtualMachine::VMStatus  vmStatus;
     void            *userData;
     void            (*errorCallback)(void *userData_, const char *msg);
@@ -177,6 +184,15 @@ namespace Ep128Emu {
      * A zero or negative value means no limit.
      */
     void setSpeedPercentage(int speedPercentage_);
+    /*!
+     * Set if the emulation should automatically run with no speed limit
+     * while the tape motor is on ('tapeEnabled_' = true) and/or while any
+     * disk drive LED is on ('diskEnabled_' = true). In warp mode, audio
+     * output is suppressed and the display frame rate is limited (see also
+     * VirtualMachine::setWarpMode()). Normal speed is restored half a second
+     * after the tape or disk activity has stopped.
+     */
+    void setAutoWarpMode(bool tapeEnabled_, bool diskEnabled_);
   // --------------------------------------------------------------------------
    private:
     virtual void run();
@@ -29,6 +29,8 @@
 #include "zx128vm.hpp"
 #include "debuglib.hpp"
 #include "videorec.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
 
 #include <vector>
 
@@ -190,6 +192,9 @@ namespace ZX128 {
     vm.memoryWait(addr);
     uint8_t   retval = vm.memory.read(addr);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     addr, retval);
     return retval;
   }
 
@@ -203,6 +208,12 @@ namespace ZX128 {
     vm.memoryWait(addr);
     retval |= (uint16_t(vm.memory.read(addr) << 8));
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     (addr - 1) & 0xFFFF, uint8_t(retval & 0xFF));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryRead,
+                     addr, uint8_t(retval >> 8));
+    }
     return retval;
   }
 
@@ -210,11 +221,19 @@ namespace ZX128 {
   {
     addressBusState.B.h = R.I;
     uint16_t  addr = uint16_t(R.PC.W.l);
+    if (EP128EMU_UNLIKELY(vm.profilerRunning))
+      vm.profileInstruction(addr);
     vm.memoryWaitM1(addr);
     if (addr == 0x05E7) {
       readTapeFile();
       addr = uint16_t(R.PC.W.l);
     }
+    else if (addr == 0x056C) {
+      if (fastLoadTapeBlock())
+        addr = uint16_t(R.PC.W.l);
+    }
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceInstruction(addr);
     if (!vm.singleStepMode) {
       uint8_t   retval = vm.memory.readOpcode(addr);
       vm.updateCPUHalfCycles(4);
@@ -275,6 +294,9 @@ namespace ZX128 {
       vm.runOneCycle();
     vm.memory.write(addr, value);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, value);
   }
 
   EP128EMU_REGPARM3 void ZX128VM::Z80_::writeMemoryWord(uint16_t addr,
@@ -292,6 +314,12 @@ namespace ZX128 {
       vm.runOneCycle();
     vm.memory.write(addr, uint8_t(value >> 8));
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     (addr - 1) & 0xFFFF, uint8_t(value & 0xFF));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, uint8_t(value >> 8));
+    }
   }
 
   EP128EMU_REGPARM2 void ZX128VM::Z80_::pushWord(uint16_t value)
@@ -313,6 +341,12 @@ namespace ZX128 {
       vm.runOneCycle();
     vm.memory.write(addr, uint8_t(value) & 0xFF);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder))) {
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     (addr + 1) & 0xFFFF, uint8_t(value >> 8));
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeMemoryWrite,
+                     addr, uint8_t(value & 0xFF));
+    }
   }
 
   EP128EMU_REGPARM3 void ZX128VM::Z80_::doOut(uint16_t addr, uint8_t value)
@@ -321,6 +355,10 @@ namespace ZX128 {
     vm.ioPortWait(addr);
     while (vm.z80OpcodeHalfCycles >= 8)
       vm.runOneCycle();
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeIOWrite, addr, value);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 6, addr, value);
     vm.ioPorts.write(addr, value);
     vm.updateCPUHalfCycles(1);
   }
@@ -331,6 +369,10 @@ namespace ZX128 {
     vm.ioPortWait(addr);
     uint8_t   retval = vm.ioPorts.read(addr);
     vm.updateCPUHalfCycles(1);
+    if (EP128EMU_UNLIKELY(bool(vm.traceRecorder)))
+      vm.traceAccess(Ep128Emu::TraceRecorder::recordTypeIORead, addr, retval);
+    if (EP128EMU_UNLIKELY(bool(vm.ioHookCallback)))
+      vm.ioHookCallback(vm.hookCallbackUserData, 5, addr, retval);
     return retval;
   }
 
@@ -431,6 +473,76 @@ namespace ZX128 {
     }
   }
 
+  bool ZX128VM::Z80_::fastLoadTapeBlock()
+  {
+    // LD-START in the 48K ROM, called from LD-BYTES with SA/LD-RET (0x053F)
+    // on the stack, and the flag byte and LOAD/VERIFY flag in AF'
+    if (vm.spectrum128Mode && (vm.spectrum128PageRegister & 0x10) == 0)
+      return false;
+    if (vm.isRecordingDemo | vm.isPlayingDemo | (!vm.haveTape()))
+      return false;
+    if (vm.memory.readNoDebug(0x056C) != 0xCD ||
+        vm.memory.readNoDebug(0x056D) != 0xE7 ||
+        vm.memory.readNoDebug(0x056E) != 0x05 ||
+        vm.memory.readNoDebug(0x0556) != 0x14) {
+      return false;
+    }
+    uint16_t  sp = uint16_t(R.SP.W);
+    if (vm.memory.readNoDebug(sp) != 0x3F ||
+        vm.memory.readNoDebug((sp + 1) & 0xFFFF) != 0x05) {
+      return false;
+    }
+    std::vector< uint8_t >  buf;
+    if (!vm.readTapeDataBlock(buf))
+      return false;
+    // emulate LD-BYTES using the data read from the tape
+    bool    isLoad = bool(R.altAF.B.l & 0x01);
+    uint8_t parity = buf[0];
+    uint8_t tmp = buf[0] ^ R.altAF.B.h;
+    uint8_t flags = 0x40;               // error (timeout): set Z, clear C
+    if (tmp != 0x00) {
+      R.AF.B.h = tmp;                   // wrong flag byte: clear Z and C
+      flags = 0x00;
+    }
+    else {
+      size_t  i = 1;
+      while (R.DE.W != 0) {
+        if (i >= buf.size())
+          break;
+        uint8_t b = buf[i++];
+        parity = parity ^ b;
+        if (isLoad) {
+          vm.memory.write(uint16_t(R.IX.W), b);
+        }
+        else {
+          tmp = vm.memory.readNoDebug(uint16_t(R.IX.W)) ^ b;
+          if (tmp != 0x00) {
+            R.AF.B.h = tmp;             // verify error: clear Z and C
+            flags = 0x00;
+            break;
+          }
+        }
+        R.IX.W = (R.IX.W + 1) & 0xFFFF;
+        R.DE.W = (R.DE.W - 1) & 0xFFFF;
+      }
+      if (R.DE.W == 0 && i < buf.size()) {
+        parity = parity ^ buf[i];
+        R.HL.B.h = parity;
+        R.HL.B.l = buf[i];
+        R.AF.B.h = parity;
+        if (parity == 0x00)
+          flags = 0x93;                 // CP 01 with A = 0: success, set C
+        else
+          flags = 0x02;                 // parity error: clear Z and C
+      }
+    }
+    R.AF.B.l = flags;
+    // return to SA/LD-RET
+    R.SP.W = (sp + 2) & 0xFFFF;
+    R.PC.W.l = 0x053F;
+    return true;
+  }
+
   void ZX128VM::Z80_::rewindTapeFile()
   {
     tapeBlockBytesLeft = 0;
@@ -472,7 +584,7 @@ namespace ZX128 {
       int     bpType = int(isWrite) + 1;
       if (!isWrite && uint16_t(vm.z80.getReg().PC.W.l) == addr)
         bpType = 0;
-      vm.breakPointCallback(vm.breakPointCallbackUserData, bpType, addr, value);
+      vm.runBreakPointCallback(bpType, addr, value);
     }
   }
 
@@ -492,8 +604,7 @@ namespace ZX128 {
                                              uint16_t addr, uint8_t value)
   {
     if (!vm.memory.checkIgnoreBreakPoint(vm.z80.getReg().PC.W.l)) {
-      vm.breakPointCallback(vm.breakPointCallbackUserData,
-                            int(isWrite) + 5, addr, value);
+      vm.runBreakPointCallback(int(isWrite) + 5, addr, value);
     }
   }
 
@@ -523,6 +634,8 @@ namespace ZX128 {
       vm.display.vsyncStateChange(newState, currentSlot_);
     if (vm.videoCapture)
       vm.videoCapture->vsyncStateChange(newState, currentSlot_);
+    if (newState)
+      vm.runFrameHook();
   }
 
   void ZX128VM::ULA_::irqPollEnableCallback(bool isEnabled)
@@ -703,6 +816,45 @@ namespace ZX128 {
     vm.demoTimeCnt++;
   }
 
+  void ZX128VM::traceCallback(void *userData)
+  {
+    ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
+    vm.traceRecorder->advanceTime();
+  }
+
+  void ZX128VM::traceInstruction(uint16_t addr)
+  {
+    uint32_t  opcode = 0U;
+    for (int i = 3; i >= 0; i--) {
+      opcode = (opcode << 8)
+               | uint32_t(memory.readNoDebug(uint16_t((addr + i) & 0xFFFF)));
+    }
+    traceRecorder->addInstruction(addr, memory.getPage(uint8_t(addr >> 14)),
+                                  opcode);
+  }
+
+  void ZX128VM::traceAccess(uint8_t type_, uint16_t addr, uint8_t value)
+  {
+    uint8_t   segment = 0;
+    if (type_ < Ep128Emu::TraceRecorder::recordTypeIORead)
+      segment = memory.getPage(uint8_t(addr >> 14));
+    traceRecorder->addAccess(type_, addr, segment, value);
+  }
+
+  void ZX128VM::profilerCallback(void *userData)
+  {
+    ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
+    vm.profilerTimeBase = vm.profilerTimeBase + 8U;
+  }
+
+  void ZX128VM::profileInstruction(uint16_t addr)
+  {
+    profiler->addInstruction((uint32_t(memory.getPage(uint8_t(addr >> 14)))
+                              << 14) | uint32_t(addr & 0x3FFF),
+                             addr, uint16_t(z80.getReg().SP.W),
+                             profilerTimeBase + uint32_t(z80OpcodeHalfCycles));
+  }
+
   void ZX128VM::videoCaptureCallback(void *userData)
   {
     ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
@@ -904,6 +1056,7 @@ namespace ZX128 {
       ayRegisterSelected(0x00),
       ayCycleCnt(2),
       z80OpcodeHalfCycles(0),
+      profilerTimeBase(0U),
       joystickState(0x00),
       tapeCallbackFlag(false),
       singleStepMode(0),
@@ -948,6 +1101,8 @@ namespace ZX128 {
 
   ZX128VM::~ZX128VM()
   {
+    closeTraceFile();
+    stopProfiler();
     if (videoCapture) {
       delete videoCapture;
       videoCapture = (Ep128Emu::VideoCapture *) 0;
@@ -1120,6 +1275,7 @@ namespace ZX128 {
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
     vmStatus_.tapeSampleSize = getTapeSampleSize();
+    vmStatus_.tapeMotorOn = getIsTapeRunning();
     vmStatus_.isPlayingDemo = isPlayingDemo;
     if (demoFile != (Ep128Emu::File *) 0 && !isRecordingDemo)
       stopDemoRecording(true);
@@ -1128,16 +1284,31 @@ namespace ZX128 {
 
   void ZX128VM::openVideoCapture(
       int frameRate_,
-      bool yuvFormat_,
+      int videoFormat_,
+      int frameHashInterval_,
+      bool frameHashPNG_,
       void (*errorCallback_)(void *userData, const char *msg),
       void (*fileNameCallback_)(void *userData, std::string& fileName),
       void *userData_)
   {
     if (!videoCapture) {
-      if (yuvFormat_) {
+      if (videoFormat_ == 1) {
         videoCapture = new Ep128Emu::VideoCapture_YV12(&ULA::convertPixelToRGB,
                                                        frameRate_);
       }
+      else if (videoFormat_ == 2) {
+        videoCapture = new Ep128Emu::VideoCapture_ZMBV(&ULA::convertPixelToRGB,
+                                                       frameRate_);
+      }
+      else if (videoFormat_ == 3) {
+        videoCapture = new Ep128Emu::VideoCapture_Y4M(&ULA::convertPixelToRGB,
+                                                      frameRate_);
+      }
+      else if (videoFormat_ == 4) {
+        videoCapture = new Ep128Emu::VideoCapture_FrameHash(
+                               &ULA::convertPixelToRGB, frameRate_,
+                               frameHashInterval_, frameHashPNG_);
+      }
       else {
         videoCapture = new Ep128Emu::VideoCapture_RLE8(&ULA::convertPixelToRGB,
                                                        frameRate_);
@@ -1211,6 +1382,7 @@ namespace ZX128 {
 
   void ZX128VM::setBreakPoint(const Ep128Emu::BreakPoint& bp, bool isEnabled)
   {
+    setBreakPointCondition(bp, isEnabled);
     if (EP128EMU_UNLIKELY(!isEnabled)) {
       if (bp.isIO()) {
         ioPorts.setBreakPoint(bp.addr(), 0, false, false);
@@ -1243,10 +1415,48 @@ namespace ZX128 {
 
   void ZX128VM::clearBreakPoints()
   {
+    clearBreakPointConditions();
     memory.clearAllBreakPoints();
     ioPorts.clearBreakPoints();
   }
 
+  void ZX128VM::openTraceFile(std::FILE *f, uint8_t flags)
+  {
+    closeTraceFile();
+    traceRecorder =
+        new Ep128Emu::TraceRecorder(f, uint32_t(ulaFrequency), flags);
+    setCallback(&traceCallback, this, true);
+  }
+
+  void ZX128VM::closeTraceFile()
+  {
+    if (traceRecorder) {
+      setCallback(&traceCallback, this, false);
+      Ep128Emu::VirtualMachine::closeTraceFile();
+    }
+  }
+
+  void ZX128VM::startProfiler(bool callStackEnabled)
+  {
+    stopProfiler();
+    if (profiler) {
+      delete profiler;
+      profiler = (Ep128Emu::Profiler *) 0;
+    }
+    profiler = new Ep128Emu::Profiler(*this, 0xFFFFFFFFU, callStackEnabled);
+    profilerTimeBase = 0U;
+    setCallback(&profilerCallback, this, true);
+    profilerRunning = true;
+  }
+
+  void ZX128VM::stopProfiler()
+  {
+    if (profilerRunning) {
+      setCallback(&profilerCallback, this, false);
+      profilerRunning = false;
+    }
+  }
+
   void ZX128VM::setBreakPointPriorityThreshold(int n)
   {
     breakPointPriorityThreshold = uint8_t(n > 0 ? (n < 4 ? n : 4) : 0);
@@ -1448,7 +1658,7 @@ namespace ZX128 {
                                            int32_t offs) const
   {
     return Ep128::Z80Disassembler::disassembleInstruction(
-               buf, (*this), addr, isCPUAddress, offs);
+               buf, (*this), addr, isCPUAddress, offs, &getSymbolTable());
   }
 
   void ZX128VM::getVideoPosition(int& xPos, int& yPos) const
@@ -71,6 +71,7 @@ namespace ZX128 {
       virtual EP128EMU_REGPARM2 void updateCycles(int cycles);
      private:
       void readTapeFile();
+      bool fastLoadTapeBlock();
      public:
       void rewindTapeFile();
       void closeTapeFile();
@@ -119,6 +120,7 @@ namespace ZX128 {
     uint8_t   ayRegisterSelected;       // value written to I/O port 0xFFFD
     uint8_t   ayCycleCnt;
     uint8_t   z80OpcodeHalfCycles;      // time since the last ULA slot
+    uint32_t  profilerTimeBase;         // in Z80 half cycles
     uint8_t   joystickState;            // Kempston joystick state
     bool      tapeCallbackFlag;
     // 0: normal mode, 1: single step, 2: step over, 3: trace
@@ -183,6 +185,11 @@ namespace ZX128 {
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
     uint8_t checkSingleStepModeBreak();
+    static void traceCallback(void *userData);
+    void traceInstruction(uint16_t addr);
+    void traceAccess(uint8_t type_, uint16_t addr, uint8_t value);
+    static void profilerCallback(void *userData);
+    void profileInstruction(uint16_t addr);
     void convertKeyboardState();
     void resetKeyboard();
     void initializeMemoryPaging();
@@ -226,13 +233,18 @@ namespace ZX128 {
     virtual void getVMStatus(VirtualMachine::VMStatus& vmStatus_);
     /*!
      * Create video capture object with the specified frame rate (24 to 60)
-     * and format (768x576 RLE8 or 384x288 YV12) if it does not exist yet,
-     * and optionally set callbacks for printing error messages and asking
-     * for a new output file on reaching 2 GB file size.
+     * and format (0: 768x576 RLE8, 1: 384x288 YV12, 2: 768x576 ZMBV,
+     * 3: 768x576 YUV4MPEG2 and WAV, 4: frame hash log) if it does not exist
+     * yet, and optionally set callbacks for printing error messages and
+     * asking for a new output file when the index of the AVI file is full.
+     * For the frame hash log, every 'frameHashInterval_'th frame is hashed,
+     * and also saved as a PNG image if 'frameHashPNG_' is true.
      */
     virtual void openVideoCapture(
         int frameRate_ = 50,
-        bool yuvFormat_ = false,
+        int videoFormat_ = 0,
+        int frameHashInterval_ = 1,
+        bool frameHashPNG_ = false,
         void (*errorCallback_)(void *userData, const char *msg) =
             (void (*)(void *, const char *)) 0,
         void (*fileNameCallback_)(void *userData, std::string& fileName) =
@@ -277,6 +289,22 @@ namespace ZX128 {
      */
     virtual void setBreakPoint(const Ep128Emu::BreakPoint& bp,
                                bool isEnabled = true);
+    /*!
+     * Start recording a binary execution trace to 'f' (see vm.hpp).
+     */
+    virtual void openTraceFile(std::FILE *f, uint8_t flags = 0);
+    /*!
+     * Stop recording the execution trace, and close the file.
+     */
+    virtual void closeTraceFile();
+    /*!
+     * Start collecting profiler data (see vm.hpp).
+     */
+    virtual void startProfiler(bool callStackEnabled = false);
+    /*!
+     * Stop collecting profiler data.
+     */
+    virtual void stopProfiler();
     /*!
      * Clear all breakpoints.
      */
@@ -90,12 +90,13 @@ namespace ZX128 {
       breakPointCnt(0),
       segmentBreakPointTable((uint8_t **) 0),
       segmentBreakPointCntTable((size_t *) 0),
-      haveBreakPoints(false),
       breakPointPriorityThreshold(0),
       dummyMemory((uint8_t *) 0)
   {
     for (int i = 0; i < 4; i++) {
       pageTable[i] = 0;
+      pageBreakPointCntTable[i] = 0;
+      pageBreakPointFlags[i] = false;
       pageAddressTableR[i] = (uint8_t *) 0;
       pageAddressTableW[i] = (uint8_t *) 0;
     }
@@ -175,7 +176,6 @@ namespace ZX128 {
         for (int i = 0; i < 16384; i++)
           segmentBreakPointTable[segment][i] = 0;
       }
-      haveBreakPoints = true;
       uint8_t&  bp = segmentBreakPointTable[segment][addr & 0x3FFF];
       if (!bp)
         segmentBreakPointCntTable[segment]++;
@@ -183,14 +183,18 @@ namespace ZX128 {
         mode = (bp & 56) + (mode & 7);
       mode |= (bp & 7);
       bp = mode;
+      updatePageBreakPointFlags();
     }
     else if (segmentBreakPointTable[segment]) {
-      if (segmentBreakPointTable[segment][addr & 0x3FFF]) {
+      uint8_t&  bp = segmentBreakPointTable[segment][addr & 0x3FFF];
+      if (bp) {
         // remove a previously existing breakpoint
+        bp = 0;
         segmentBreakPointCntTable[segment]--;
         if (!segmentBreakPointCntTable[segment]) {
           delete[] segmentBreakPointTable[segment];
           segmentBreakPointTable[segment] = (uint8_t *) 0;
+          updatePageBreakPointFlags();
         }
       }
     }
@@ -209,19 +213,25 @@ namespace ZX128 {
         for (int i = 0; i < 65536; i++)
           breakPointTable[i] = 0;
       }
-      haveBreakPoints = true;
       uint8_t&  bp = breakPointTable[addr];
-      if (!bp)
+      if (!bp) {
         breakPointCnt++;
+        if (!(pageBreakPointCntTable[addr >> 14]++))
+          updatePageBreakPointFlags();
+      }
       if (bp > mode)
         mode = (bp & 56) + (mode & 7);
       mode |= (bp & 7);
       bp = mode;
     }
     else if (breakPointTable) {
-      if (breakPointTable[addr]) {
+      uint8_t&  bp = breakPointTable[addr];
+      if (bp) {
         // remove a previously existing breakpoint
+        bp = 0;
         breakPointCnt--;
+        if (!(--pageBreakPointCntTable[addr >> 14]))
+          updatePageBreakPointFlags();
         if (!breakPointCnt) {
           delete[] breakPointTable;
           breakPointTable = (uint8_t *) 0;
@@ -247,7 +257,17 @@ namespace ZX128 {
     clearBreakPoints();
     for (unsigned int segment = 0; segment < 256; segment++)
       clearBreakPoints((uint8_t) segment);
-    haveBreakPoints = false;
+  }
+
+  void Memory::updatePageBreakPointFlags()
+  {
+    // memory accesses check for breakpoints only on pages where this is
+    // true, so that breakpoints elsewhere do not slow down emulation
+    for (int i = 0; i < 4; i++) {
+      pageBreakPointFlags[i] =
+          (pageBreakPointCntTable[i] != 0 ||
+           segmentBreakPointTable[pageTable[i]] != (uint8_t *) 0);
+    }
   }
 
   void Memory::breakPointCallback(bool isWrite, uint16_t addr, uint8_t value)
@@ -316,6 +336,9 @@ namespace ZX128 {
   {
     page = page & 3;
     pageTable[page] = segment;
+    pageBreakPointFlags[page] =
+        (pageBreakPointCntTable[page] != 0 ||
+         segmentBreakPointTable[segment] != (uint8_t *) 0);
     long    offs = -(long(page) << 14);
     if (segmentTable[segment] != (uint8_t *) 0) {
       pageAddressTableR[page] = segmentTable[segment] + offs;
@@ -34,7 +34,11 @@ namespace ZX128 {
     size_t  breakPointCnt;
     uint8_t **segmentBreakPointTable;
     size_t  *segmentBreakPointCntTable;
-    bool    haveBreakPoints;
+    // number of breakpoints in 'breakPointTable' for each 16K page
+    size_t  pageBreakPointCntTable[4];
+    // true if there are any breakpoints on the page, either by address,
+    // or in the segment currently mapped to it
+    bool    pageBreakPointFlags[4];
     uint8_t breakPointPriorityThreshold;
     uint8_t *dummyMemory;   // 2*16K dummy memory for invalid reads and writes
     uint8_t *pageAddressTableR[4];
@@ -43,6 +47,7 @@ namespace ZX128 {
     void checkExecuteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkReadBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkWriteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
+    void updatePageBreakPointFlags();
    public:
     Memory();
     virtual ~Memory();
@@ -87,7 +92,7 @@ namespace ZX128 {
   {
     uint8_t page = uint8_t(addr >> 14);
     uint8_t value = pageAddressTableR[page][addr];
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkReadBreakPoint(addr, page, value);
     return value;
   }
@@ -96,7 +101,7 @@ namespace ZX128 {
   {
     uint8_t page = uint8_t(addr >> 14);
     uint8_t value = pageAddressTableR[page][addr];
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkExecuteBreakPoint(addr, page, value);
     return value;
   }
@@ -121,7 +126,7 @@ namespace ZX128 {
   inline void Memory::write(uint16_t addr, uint8_t value)
   {
     uint8_t page = uint8_t(addr >> 14);
-    if (haveBreakPoints)
+    if (pageBreakPointFlags[page])
       checkWriteBreakPoint(addr, page, value);
     pageAddressTableW[page][addr] = value;
   }
@@ -0,0 +1,428 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2016 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// command line tool for validating, converting, and extracting files from
+// a large number of Enterprise tape images in parallel
+
+#include "ep128emu.hpp"
+#include "system.hpp"
+#include "tape.hpp"
+#include "tapeio.hpp"
+
+#include <vector>
+#include <set>
+
+using Ep128Emu::Exception;
+
+#define TAPECONV_MAX_THREADS    64
+
+struct TapeConvParameters {
+  std::string convertDir;       // write ep128emu format tapes here if set
+  std::string extractDir;       // write the files on the tapes here if set
+  bool        allowOverwrite;
+  int         soundFileChannel;
+  float       soundFileMinFreq;
+  float       soundFileMaxFreq;
+  // --------
+  TapeConvParameters()
+    : convertDir(""),
+      extractDir(""),
+      allowOverwrite(false),
+      soundFileChannel(0),
+      soundFileMinFreq(500.0f),
+      soundFileMaxFreq(5000.0f)
+  {
+  }
+};
+
+class TapeConvJobQueue {
+ public:
+  const TapeConvParameters&   cfg;
+  std::vector< std::string >  fileNames;
+  // unique prefix of the output file names for each tape
+  std::vector< std::string >  baseNames;
+  size_t        nextJob;
+  size_t        jobsDone;
+  size_t        tapesWithErrors;
+  size_t        totalFiles;
+  size_t        filesWithErrors;
+  Ep128Emu::Mutex mutex_;       // protects all members except cfg
+  // --------
+  TapeConvJobQueue(const TapeConvParameters& cfg_)
+    : cfg(cfg_),
+      nextJob(0),
+      jobsDone(0),
+      tapesWithErrors(0),
+      totalFiles(0),
+      filesWithErrors(0)
+  {
+  }
+  // returns false if there are no more jobs
+  bool getJob(size_t& n)
+  {
+    bool    retval = false;
+    mutex_.lock();
+    if (nextJob < fileNames.size()) {
+      n = nextJob++;
+      retval = true;
+    }
+    mutex_.unlock();
+    return retval;
+  }
+  void jobDone(size_t n, const std::string& msg, bool errorFlag,
+               size_t nFiles, size_t nFileErrors)
+  {
+    mutex_.lock();
+    jobsDone++;
+    if (errorFlag)
+      tapesWithErrors++;
+    totalFiles += nFiles;
+    filesWithErrors += nFileErrors;
+    std::fprintf((errorFlag ? stderr : stdout), "[%lu/%lu] %s: %s\n",
+                 (unsigned long) jobsDone, (unsigned long) fileNames.size(),
+                 fileNames[n].c_str(), msg.c_str());
+    std::fflush(errorFlag ? stderr : stdout);
+    mutex_.unlock();
+  }
+};
+
+class TapeConvThread : public Ep128Emu::Thread {
+ private:
+  TapeConvJobQueue& jobQueue;
+  void processTape(size_t n);
+ public:
+  TapeConvThread(TapeConvJobQueue& jobQueue_)
+    : Ep128Emu::Thread(),
+      jobQueue(jobQueue_)
+  {
+  }
+  virtual ~TapeConvThread()
+  {
+  }
+ protected:
+  virtual void run()
+  {
+    size_t  n = 0;
+    while (jobQueue.getJob(n))
+      processTape(n);
+  }
+};
+
+static std::string getOutputFileName(const std::string& dirName,
+                                     const std::string& fileName)
+{
+  std::string s(dirName);
+  if (s.length() > 0) {
+    char    c = s[s.length() - 1];
+    if (c != '/' && c != '\\')
+      s += '/';
+  }
+  s += fileName;
+  return s;
+}
+
+// returns the base name of 'fileName' without the directory and extension
+
+static std::string getBaseName(const std::string& fileName)
+{
+  std::string dirName;
+  std::string baseName;
+  Ep128Emu::splitPath(fileName, dirName, baseName);
+  size_t  i = baseName.rfind('.');
+  if (i != std::string::npos && i > 0)
+    baseName.resize(i);
+  return baseName;
+}
+
+// converts 's' to lower case, for comparing file names on file systems
+// that are not case sensitive
+
+static std::string getLowerCaseName(const std::string& s)
+{
+  std::string tmp(s);
+  for (size_t i = 0; i < tmp.length(); i++) {
+    if (tmp[i] >= 'A' && tmp[i] <= 'Z')
+      tmp[i] = tmp[i] - 'A' + 'a';
+  }
+  return tmp;
+}
+
+// set the output file name prefix of each tape in jobQueue.baseNames;
+// tapes with the same base name (e.g. a/game.wav and b/game.tap) would
+// be written to the same output files by different threads, so a numeric
+// suffix is appended to the names of all but the first one
+
+static void createOutputBaseNames(TapeConvJobQueue& jobQueue)
+{
+  std::set< std::string > usedNames;
+  std::set< std::string > assignedNames;
+  jobQueue.baseNames.resize(jobQueue.fileNames.size());
+  for (size_t i = 0; i < jobQueue.fileNames.size(); i++) {
+    jobQueue.baseNames[i] = getBaseName(jobQueue.fileNames[i]);
+    usedNames.insert(getLowerCaseName(jobQueue.baseNames[i]));
+  }
+  for (size_t i = 0; i < jobQueue.fileNames.size(); i++) {
+    if (assignedNames.insert(getLowerCaseName(jobQueue.baseNames[i])).second)
+      continue;
+    std::string newName;
+    for (unsigned long j = 2UL; true; j++) {
+      char    tmpBuf[32];
+      std::sprintf(&(tmpBuf[0]), "_%lu", j);
+      newName = jobQueue.baseNames[i];
+      newName += &(tmpBuf[0]);
+      if (usedNames.insert(getLowerCaseName(newName)).second)
+        break;
+    }
+    assignedNames.insert(getLowerCaseName(newName));
+    if (jobQueue.cfg.convertDir.length() > 0 ||
+        jobQueue.cfg.extractDir.length() > 0) {
+      std::fprintf(stderr,
+                   " *** tapeconv: duplicate output name, using %s for %s\n",
+                   newName.c_str(), jobQueue.fileNames[i].c_str());
+    }
+    jobQueue.baseNames[i] = newName;
+  }
+}
+
+void TapeConvThread::processTape(size_t n)
+{
+  const TapeConvParameters& cfg = jobQueue.cfg;
+  const std::string&  fileName = jobQueue.fileNames[n];
+  std::string msg;
+  bool        errorFlag = false;
+  size_t      nFiles = 0;
+  size_t      nFileErrors = 0;
+  try {
+    Ep128Emu::TapeFiles tapeFiles;
+    tapeFiles.readTapeImage(fileName.c_str(), (Fl_Progress *) 0,
+                            cfg.soundFileChannel,
+                            cfg.soundFileMinFreq, cfg.soundFileMaxFreq);
+    nFiles = tapeFiles.getFileCnt();
+    size_t  nBytes = 0;
+    for (size_t i = 0; i < nFiles; i++) {
+      nBytes += tapeFiles[i]->fileData.size();
+      if (tapeFiles[i]->hasErrors || !tapeFiles[i]->isComplete)
+        nFileErrors++;
+    }
+    // base name of the tape image without extension (made unique in
+    // main()), used as the prefix of output file names
+    const std::string&  baseName = jobQueue.baseNames[n];
+    char    tmpBuf[64];
+    if (cfg.convertDir.length() > 0 && nFiles > 0) {
+      std::string outName(getOutputFileName(cfg.convertDir, baseName));
+      outName += ".tap";
+      if (!tapeFiles.writeTapeImage(outName.c_str(), cfg.allowOverwrite))
+        throw Exception("output tape file already exists");
+    }
+    if (cfg.extractDir.length() > 0) {
+      for (size_t i = 0; i < nFiles; i++) {
+        std::sprintf(&(tmpBuf[0]), "_%02u_", (unsigned int) (i + 1));
+        std::string outName(baseName);
+        outName += &(tmpBuf[0]);
+        outName += tapeFiles[i]->getFileName();
+        outName = getOutputFileName(cfg.extractDir, outName);
+        if (!tapeFiles.exportFile(int(i), outName.c_str(), cfg.allowOverwrite))
+          throw Exception("extracted file already exists");
+      }
+    }
+    std::sprintf(&(tmpBuf[0]), "%lu file(s), %lu bytes",
+                 (unsigned long) nFiles, (unsigned long) nBytes);
+    msg = &(tmpBuf[0]);
+    if (nFileErrors > 0) {
+      std::sprintf(&(tmpBuf[0]), ", %lu with errors",
+                   (unsigned long) nFileErrors);
+      msg += &(tmpBuf[0]);
+      errorFlag = true;
+    }
+    else if (nFiles < 1) {
+      msg += " - no files found";
+      errorFlag = true;
+    }
+  }
+  catch (std::exception& e) {
+    msg = "error: ";
+    msg += e.what();
+    errorFlag = true;
+  }
+  jobQueue.jobDone(n, msg, errorFlag, nFiles, nFileErrors);
+}
+
+static void printUsage()
+{
+  std::printf("Usage:\n");
+  std::printf("    tapeconv [OPTIONS...] <TAPEFILE1> [TAPEFILE2...]\n");
+  std::printf("        read the specified Enterprise tape images (ep128emu, "
+              "EPTE, or sound\n"
+              "        files) in parallel, and report the number of files "
+              "and errors\n"
+              "        found on each tape\n");
+  std::printf("Options:\n");
+  std::printf("    -c <DIR>\n"
+              "        convert each tape to an ep128emu format tape file "
+              "(.tap) in DIR\n");
+  std::printf("    -x <DIR>\n"
+              "        extract the files from each tape to DIR, using the "
+              "tape file name,\n"
+              "        and the index of the file on the tape as prefix\n");
+  std::printf("        if several tapes have the same name without the "
+              "directory and\n"
+              "        extension, a numeric suffix (_2, _3, ...) is appended "
+              "to the output\n"
+              "        file names of all but the first one\n");
+  std::printf("    -f\n"
+              "        overwrite existing output files\n");
+  std::printf("    -j <N>\n"
+              "        use N threads (default: number of processors)\n");
+  std::printf("    -ch <N>\n"
+              "        sound file channel to read (default: 0)\n");
+  std::printf("    -min <F>\n"
+              "        sound file filter minimum frequency "
+              "(default: 500 Hz)\n");
+  std::printf("    -max <F>\n"
+              "        sound file filter maximum frequency "
+              "(default: 5000 Hz)\n");
+  std::printf("    --\n"
+              "        end of options, treat all remaining arguments as "
+              "file names\n");
+}
+
+static double parseNumber(const char *s, const char *optName,
+                          double minVal, double maxVal)
+{
+  char    *endPtr = (char *) 0;
+  double  n = 0.0;
+  if (s != (char *) 0 && s[0] != '\0')
+    n = std::strtod(s, &endPtr);
+  if (s == (char *) 0 || s[0] == '\0' ||
+      endPtr == (char *) 0 || endPtr[0] != '\0') {
+    printUsage();
+    std::fprintf(stderr, " *** tapeconv: invalid argument for %s\n", optName);
+    throw Exception("invalid command line argument");
+  }
+  if (n < minVal || n > maxVal) {
+    printUsage();
+    std::fprintf(stderr, " *** tapeconv: %s parameter is out of range\n",
+                 optName);
+    throw Exception("invalid command line argument");
+  }
+  return n;
+}
+
+int main(int argc, char **argv)
+{
+  TapeConvParameters  cfg;
+  TapeConvJobQueue    jobQueue(cfg);
+  TapeConvThread  *threads[TAPECONV_MAX_THREADS];
+  int     nThreads = Ep128Emu::getProcessorCount();
+  if (nThreads > TAPECONV_MAX_THREADS)
+    nThreads = TAPECONV_MAX_THREADS;
+  for (int i = 0; i < TAPECONV_MAX_THREADS; i++)
+    threads[i] = (TapeConvThread *) 0;
+  try {
+    bool    endOfOptions = false;
+    for (int i = 1; i < argc; i++) {
+      if (argv[i] == (char *) 0 || argv[i][0] == '\0')
+        continue;
+      if (endOfOptions || argv[i][0] != '-') {
+        jobQueue.fileNames.push_back(std::string(argv[i]));
+        continue;
+      }
+      std::string s(argv[i]);
+      if (s == "--") {
+        endOfOptions = true;
+      }
+      else if (s == "-h" || s == "-help" || s == "--help") {
+        printUsage();
+        return 0;
+      }
+      else if (s == "-c" || s == "-x") {
+        if (++i >= argc) {
+          printUsage();
+          if (s == "-c")
+            throw Exception("missing argument for -c");
+          throw Exception("missing argument for -x");
+        }
+        if (s == "-c")
+          cfg.convertDir = argv[i];
+        else
+          cfg.extractDir = argv[i];
+      }
+      else if (s == "-f") {
+        cfg.allowOverwrite = true;
+      }
+      else if (s == "-j") {
+        nThreads = int(parseNumber((++i < argc ? argv[i] : (char *) 0),
+                                   "-j", 1.0, double(TAPECONV_MAX_THREADS)));
+      }
+      else if (s == "-ch") {
+        cfg.soundFileChannel =
+            int(parseNumber((++i < argc ? argv[i] : (char *) 0),
+                            "-ch", 0.0, 15.0));
+      }
+      else if (s == "-min") {
+        cfg.soundFileMinFreq =
+            float(parseNumber((++i < argc ? argv[i] : (char *) 0),
+                              "-min", 0.0, 2000.0));
+      }
+      else if (s == "-max") {
+        cfg.soundFileMaxFreq =
+            float(parseNumber((++i < argc ? argv[i] : (char *) 0),
+                              "-max", 1000.0, 20000.0));
+      }
+      else {
+        printUsage();
+        std::fprintf(stderr, " *** tapeconv: invalid option: %s\n", argv[i]);
+        throw Exception("invalid command line argument");
+      }
+    }
+    if (jobQueue.fileNames.size() < 1) {
+      printUsage();
+      return -1;
+    }
+    createOutputBaseNames(jobQueue);
+    if (size_t(nThreads) > jobQueue.fileNames.size())
+      nThreads = int(jobQueue.fileNames.size());
+    for (int i = 0; i < nThreads; i++)
+      threads[i] = new TapeConvThread(jobQueue);
+    for (int i = 0; i < nThreads; i++)
+      threads[i]->start();
+    for (int i = 0; i < nThreads; i++) {
+      delete threads[i];                // this also waits for the thread
+      threads[i] = (TapeConvThread *) 0;
+    }
+    std::printf("%lu tape(s) processed, %lu with errors; "
+                "%lu file(s) found, %lu with errors\n",
+                (unsigned long) jobQueue.fileNames.size(),
+                (unsigned long) jobQueue.tapesWithErrors,
+                (unsigned long) jobQueue.totalFiles,
+                (unsigned long) jobQueue.filesWithErrors);
+    if (jobQueue.tapesWithErrors > 0)
+      return 1;
+  }
+  catch (std::exception& e) {
+    for (int i = 0; i < TAPECONV_MAX_THREADS; i++) {
+      if (threads[i])
+        delete threads[i];
+    }
+    std::fprintf(stderr, " *** tapeconv: %s\n", e.what());
+    return -1;
+  }
+  return 0;
+}
+
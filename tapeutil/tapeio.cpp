@@ -440,8 +440,11 @@ namespace Ep128Emu {
       throw Exception("invalid file name");
     Tape      *f = openTapeFile(fileName_, 2, 24000L, 1);
     if (typeid(*f) == typeid(Tape_SoundFile)) {
-      dynamic_cast<Tape_SoundFile *>(f)->setParameters(channel_, true,
-                                                       minFreq_, maxFreq_);
+      Tape_SoundFile  *sf = dynamic_cast<Tape_SoundFile *>(f);
+      sf->setParameters(channel_, true, minFreq_, maxFreq_);
+      // the tape is read only once, so decoding it in the background
+      // would just do the same work twice
+      sf->setPulseDecodingEnabled(false);
     }
     TapeInput *t = (TapeInput *) 0;
     try {
@@ -0,0 +1,580 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// command line tool for disassembling ROM or segment images, separating
+// code from data by following the code flow from a set of entry points
+
+#include "ep128emu.hpp"
+#include "debuglib.hpp"
+#include "symtab.hpp"
+#include "system.hpp"
+
+#include <vector>
+
+using Ep128Emu::Exception;
+
+struct RomDisParameters {
+  std::string inFileName;
+  std::string outFileName;
+  int       firstSegment;
+  uint32_t  cpuBaseAddr;                // CPU address of the segments
+  // entry points as 16-bit CPU addresses (in all segments),
+  // or segment * 0x10000 + CPU address
+  std::vector< uint32_t >   entryPoints;
+  int       nThreads;
+  Ep128Emu::SymbolTable symbols;
+  // --------
+  RomDisParameters()
+    : firstSegment(0),
+      cpuBaseAddr(0xC000U),
+      nThreads(0)
+  {
+  }
+};
+
+static void printUsage()
+{
+  std::printf("Usage:\n");
+  std::printf("    romdis [OPTIONS...] <IMAGEFILE>\n");
+  std::printf("        disassemble a ROM or segment image file, following "
+              "the code flow\n"
+              "        from the entry points, and printing data areas as "
+              "DB lines\n");
+  std::printf("Options:\n");
+  std::printf("    -o <FILE>\n"
+              "        write output to FILE instead of the standard "
+              "output\n");
+  std::printf("    -s <SEGMENT>\n"
+              "        the segment number of the first 16K of the image "
+              "(hexadecimal,\n"
+              "        default: 0)\n");
+  std::printf("    -a <ADDR>\n"
+              "        the CPU address at which the segments run "
+              "(hexadecimal,\n"
+              "        0000, 4000, 8000, or C000, default: C000)\n");
+  std::printf("    -e <ADDR>\n"
+              "        add entry point at CPU address ADDR in all segments, "
+              "or at\n"
+              "        segment:address if written as SS:ADDR "
+              "(hexadecimal); can be\n"
+              "        used multiple times, the default is the start of "
+              "each segment\n");
+  std::printf("    -y <FILE>\n"
+              "        load symbol definitions from FILE (e.g. a pasmo or "
+              "sjasm symbol\n"
+              "        file)\n");
+  std::printf("    -ys <SEGMENT> <FILE>\n"
+              "        same as -y, but 16-bit symbol values are offsets into "
+              "SEGMENT\n"
+              "        (hexadecimal)\n");
+  std::printf("    -j <N>\n"
+              "        use N threads (default: the number of processors)\n");
+}
+
+static uint32_t parseHexArgument(const char *s, uint32_t maxValue)
+{
+  uint32_t  n = 0U;
+  if (!Ep128Emu::parseHexNumber(n, s) || n > maxValue)
+    throw Exception("invalid hexadecimal argument");
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+
+class SegmentDisassembler {
+ public:
+  // flags for each byte of the segment
+  static const uint8_t  byteIsCode = 0x01;
+  static const uint8_t  byteIsOpcode = 0x02;    // first byte of instruction
+  static const uint8_t  byteIsTarget = 0x04;    // jump or call target
+ private:
+  const std::vector< uint8_t >& imageData;
+  size_t    startPos;                   // position of the segment in image
+  uint8_t   segment;
+  uint32_t  cpuBaseAddr;
+  std::vector< uint8_t >  flags;
+  std::vector< uint16_t > entryPoints;
+  // --------
+  void readOpcode(uint8_t *buf, size_t offs) const;
+  void printDataLine(std::string& buf, size_t offs, size_t nBytes) const;
+ public:
+  std::string listing;
+  // --------
+  SegmentDisassembler(const std::vector< uint8_t >& imageData_,
+                      size_t startPos_, uint8_t segment_,
+                      uint32_t cpuBaseAddr_)
+    : imageData(imageData_),
+      startPos(startPos_),
+      segment(segment_),
+      cpuBaseAddr(cpuBaseAddr_),
+      flags(16384, 0)
+  {
+  }
+  inline uint8_t getSegment() const
+  {
+    return segment;
+  }
+  inline uint32_t getCPUBaseAddress() const
+  {
+    return cpuBaseAddr;
+  }
+  inline uint8_t getFlags(size_t offs) const
+  {
+    return flags[offs];
+  }
+  void addEntryPoint(uint32_t cpuAddr);
+  // find code by following all paths from the entry points
+  void analyzeCodeFlow();
+  // write the annotated disassembly to 'listing'
+  void createListing(const Ep128Emu::SymbolTable& symbols);
+};
+
+void SegmentDisassembler::readOpcode(uint8_t *buf, size_t offs) const
+{
+  // instructions at the end of the segment may continue in the next one
+  for (size_t i = 0; i < 4; i++) {
+    size_t  n = startPos + offs + i;
+    buf[i] = (n < imageData.size() ? imageData[n] : uint8_t(0xFF));
+  }
+}
+
+void SegmentDisassembler::addEntryPoint(uint32_t cpuAddr)
+{
+  uint32_t  offs = (cpuAddr - cpuBaseAddr) & 0xFFFFU;
+  if (offs < 0x4000U)
+    entryPoints.push_back(uint16_t(offs));
+}
+
+void SegmentDisassembler::analyzeCodeFlow()
+{
+  std::vector< uint16_t > pendingAddrs(entryPoints);
+  for (size_t i = 0; i < entryPoints.size(); i++)
+    flags[entryPoints[i]] |= byteIsTarget;
+  while (pendingAddrs.size() > 0) {
+    size_t  offs = pendingAddrs.back();
+    pendingAddrs.pop_back();
+    while (offs < 0x4000 && !(flags[offs] & byteIsOpcode)) {
+      uint8_t   opcodeBuf[4];
+      readOpcode(&(opcodeBuf[0]), offs);
+      int       flowType = 0;
+      uint32_t  targetAddr = 0xFFFFFFFFU;
+      uint32_t  addr = uint32_t(offs) + cpuBaseAddr;
+      uint32_t  nextAddr = Ep128::Z80Disassembler::getInstructionFlow(
+                               flowType, targetAddr, &(opcodeBuf[0]), addr);
+      if (flowType == 5)
+        break;
+      size_t    len = size_t((nextAddr - addr) & 0xFFFFU);
+      // stop if the instruction would overlap already decoded code
+      bool      overlapFlag = false;
+      for (size_t i = 1; i < len && (offs + i) < 0x4000; i++) {
+        if (flags[offs + i] & byteIsOpcode)
+          overlapFlag = true;
+      }
+      if (overlapFlag)
+        break;
+      flags[offs] |= (byteIsCode | byteIsOpcode);
+      for (size_t i = 1; i < len && (offs + i) < 0x4000; i++)
+        flags[offs + i] |= byteIsCode;
+      if (targetAddr <= 0xFFFFU && flowType != 0) {
+        uint32_t  targetOffs = (targetAddr - cpuBaseAddr) & 0xFFFFU;
+        if (targetOffs < 0x4000U) {
+          flags[targetOffs] |= byteIsTarget;
+          if (!(flags[targetOffs] & byteIsOpcode))
+            pendingAddrs.push_back(uint16_t(targetOffs));
+        }
+      }
+      if (flowType == 1 || flowType == 4)
+        break;
+      offs = offs + len;
+    }
+  }
+}
+
+void SegmentDisassembler::printDataLine(std::string& buf,
+                                        size_t offs, size_t nBytes) const
+{
+  char    tmpBuf[96];
+  char    *bufp = &(tmpBuf[0]);
+  bufp = Ep128Emu::printHexNumber(bufp, segment, 2, 2, 0);
+  *(bufp++) = ':';
+  bufp = Ep128Emu::printHexNumber(bufp, uint32_t(offs) + cpuBaseAddr,
+                                  0, 4, 15);
+  bufp = bufp + std::sprintf(bufp, "DB    ");
+  char    asciiBuf[12];
+  for (size_t i = 0; i < nBytes; i++) {
+    uint8_t c = imageData[startPos + offs + i];
+    if (i > 0) {
+      *(bufp++) = ',';
+      *(bufp++) = ' ';
+    }
+    bufp = Ep128Emu::printHexNumber(bufp, c, 0, 2, 0);
+    asciiBuf[i] = ((c >= 0x20 && c < 0x7F) ? char(c) : '.');
+  }
+  asciiBuf[nBytes] = '\0';
+  bufp = Ep128Emu::printHexNumber(bufp, 0U, 0, 0, (8 - nBytes) * 4 + 2);
+  std::sprintf(bufp, "; %s\n", &(asciiBuf[0]));
+  buf += &(tmpBuf[0]);
+}
+
+void SegmentDisassembler::createListing(const Ep128Emu::SymbolTable& symbols)
+{
+  listing.clear();
+  char    tmpBuf[64];
+  std::sprintf(&(tmpBuf[0]), ";\n; segment %02X, %04X-%04X\n;\n",
+               (unsigned int) segment, (unsigned int) cpuBaseAddr,
+               (unsigned int) (cpuBaseAddr + 0x3FFFU));
+  listing += &(tmpBuf[0]);
+  std::string disasmBuf;
+  size_t  offs = 0;
+  while (offs < 0x4000) {
+    uint32_t  addr = uint32_t(offs) + cpuBaseAddr;
+    uint32_t  physAddr = (uint32_t(segment) << 14) | uint32_t(offs);
+    uint32_t  symOffs = 0U;
+    const char  *name = symbols.findMemorySymbol(symOffs, physAddr, addr);
+    if (name) {
+      listing += name;
+      listing += ":\n";
+    }
+    if (flags[offs] & byteIsOpcode) {
+      uint8_t   opcodeBuf[4];
+      readOpcode(&(opcodeBuf[0]), offs);
+      uint32_t  nextAddr = Ep128::Z80Disassembler::disassembleInstruction(
+                               disasmBuf, &(opcodeBuf[0]), addr, true, 0,
+                               &symbols, int(segment));
+      char    *bufp = Ep128Emu::printHexNumber(&(tmpBuf[0]), segment, 2, 2, 0);
+      *(bufp++) = ':';
+      *bufp = '\0';
+      listing += &(tmpBuf[0]);
+      listing += (disasmBuf.c_str() + 2);
+      listing += '\n';
+      offs = offs + size_t((nextAddr - addr) & 0xFFFFU);
+      continue;
+    }
+    // data: up to 8 bytes per line, until the next code or symbol
+    size_t  nBytes = 1;
+    while (nBytes < 8 && (offs + nBytes) < 0x4000) {
+      if (flags[offs + nBytes] & byteIsOpcode)
+        break;
+      if (symbols.findMemorySymbol(symOffs, physAddr + uint32_t(nBytes),
+                                   addr + uint32_t(nBytes))) {
+        break;
+      }
+      nBytes++;
+    }
+    if ((startPos + offs + nBytes) > imageData.size())
+      break;
+    printDataLine(listing, offs, nBytes);
+    offs = offs + nBytes;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+class RomDisThread : public Ep128Emu::Thread {
+ private:
+  std::vector< SegmentDisassembler * >& segments;
+  const Ep128Emu::SymbolTable&  symbols;
+  Ep128Emu::Mutex&  mutex;
+  size_t&   nextSegment;
+  bool      listingMode;
+ public:
+  bool      errorFlag;
+  // --------
+  RomDisThread(std::vector< SegmentDisassembler * >& segments_,
+               const Ep128Emu::SymbolTable& symbols_,
+               Ep128Emu::Mutex& mutex_, size_t& nextSegment_,
+               bool listingMode_)
+    : Thread(),
+      segments(segments_),
+      symbols(symbols_),
+      mutex(mutex_),
+      nextSegment(nextSegment_),
+      listingMode(listingMode_),
+      errorFlag(false)
+  {
+  }
+  virtual ~RomDisThread()
+  {
+  }
+ protected:
+  virtual void run()
+  {
+    try {
+      while (true) {
+        mutex.lock();
+        size_t  n = nextSegment++;
+        mutex.unlock();
+        if (n >= segments.size())
+          break;
+        if (!listingMode)
+          segments[n]->analyzeCodeFlow();
+        else
+          segments[n]->createListing(symbols);
+      }
+    }
+    catch (...) {
+      errorFlag = true;
+    }
+  }
+};
+
+// process all segments, using multiple threads if there is more than one
+
+static void processSegments(std::vector< SegmentDisassembler * >& segments,
+                            const Ep128Emu::SymbolTable& symbols,
+                            int nThreads, bool listingMode)
+{
+  if (size_t(nThreads) > segments.size())
+    nThreads = int(segments.size());
+  Ep128Emu::Mutex mutex;
+  size_t    nextSegment = 0;
+  std::vector< RomDisThread * > threads;
+  bool      errorFlag = false;
+  try {
+    for (int i = 0; i < nThreads; i++) {
+      threads.push_back(new RomDisThread(segments, symbols, mutex,
+                                         nextSegment, listingMode));
+      threads.back()->start();
+    }
+  }
+  catch (...) {
+    errorFlag = true;
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    errorFlag = errorFlag || threads[i]->errorFlag;
+    delete threads[i];
+  }
+  if (errorFlag)
+    throw Exception("error disassembling image");
+}
+
+// add labels for jump and call targets that do not have a symbol yet
+
+static void addAutoLabels(Ep128Emu::SymbolTable& symbols,
+                          const std::vector< SegmentDisassembler * >& segments)
+{
+  char    tmpBuf[16];
+  for (size_t i = 0; i < segments.size(); i++) {
+    const SegmentDisassembler&  s = *(segments[i]);
+    for (size_t j = 0; j < 0x4000; j++) {
+      uint8_t   f = s.getFlags(j);
+      if ((f & SegmentDisassembler::byteIsTarget) == 0)
+        continue;
+      // no label in the middle of an instruction, it would not be printed
+      if ((f & (SegmentDisassembler::byteIsCode
+                | SegmentDisassembler::byteIsOpcode))
+          == SegmentDisassembler::byteIsCode) {
+        continue;
+      }
+      uint32_t  physAddr = (uint32_t(s.getSegment()) << 14) | uint32_t(j);
+      uint32_t  cpuAddr = s.getCPUBaseAddress() + uint32_t(j);
+      uint32_t  symOffs = 0U;
+      if (symbols.findMemorySymbol(symOffs, physAddr, cpuAddr))
+        continue;
+      std::sprintf(&(tmpBuf[0]), "L%02X_%04X",
+                   (unsigned int) s.getSegment(), (unsigned int) cpuAddr);
+      symbols.addSymbol(&(tmpBuf[0]), physAddr, false, false);
+    }
+  }
+  symbols.updateIndex();
+}
+
+static void disassembleImage(RomDisParameters& cfg, std::FILE *inFile,
+                             std::FILE *outFile)
+{
+  std::vector< uint8_t >  imageData;
+  while (true) {
+    int     c = std::fgetc(inFile);
+    if (c == EOF)
+      break;
+    imageData.push_back(uint8_t(c & 0xFF));
+  }
+  if (imageData.size() < 1)
+    throw Exception("image file is empty");
+  size_t  nSegments = (imageData.size() + 0x3FFF) >> 14;
+  if ((size_t(cfg.firstSegment) + nSegments) > 256)
+    throw Exception("image file is too large");
+  std::vector< SegmentDisassembler * >  segments;
+  try {
+    for (size_t i = 0; i < nSegments; i++) {
+      segments.push_back(new SegmentDisassembler(
+                             imageData, i << 14,
+                             uint8_t(cfg.firstSegment + int(i)),
+                             cfg.cpuBaseAddr));
+      SegmentDisassembler&  s = *(segments.back());
+      if (cfg.entryPoints.size() < 1)
+        s.addEntryPoint(cfg.cpuBaseAddr);
+      for (size_t j = 0; j < cfg.entryPoints.size(); j++) {
+        uint32_t  n = cfg.entryPoints[j];
+        if (n <= 0xFFFFU || (n >> 16) == (uint32_t(s.getSegment()) | 0x100U))
+          s.addEntryPoint(n & 0xFFFFU);
+      }
+    }
+    processSegments(segments, cfg.symbols, cfg.nThreads, false);
+    addAutoLabels(cfg.symbols, segments);
+    processSegments(segments, cfg.symbols, cfg.nThreads, true);
+    for (size_t i = 0; i < segments.size(); i++) {
+      const std::string&  s = segments[i]->listing;
+      if (std::fwrite(s.c_str(), sizeof(char), s.length(), outFile)
+          != s.length()) {
+        throw Exception("error writing output file - is the disk full ?");
+      }
+    }
+  }
+  catch (...) {
+    for (size_t i = 0; i < segments.size(); i++)
+      delete segments[i];
+    throw;
+  }
+  for (size_t i = 0; i < segments.size(); i++)
+    delete segments[i];
+}
+
+int main(int argc, char **argv)
+{
+  RomDisParameters  cfg;
+  std::FILE *inFile = (std::FILE *) 0;
+  std::FILE *outFile = (std::FILE *) 0;
+  try {
+    bool    endOfOptions = false;
+    for (int i = 1; i < argc; i++) {
+      if (argv[i] == (char *) 0 || argv[i][0] == '\0')
+        continue;
+      if (endOfOptions || argv[i][0] != '-') {
+        if (!cfg.inFileName.empty()) {
+          printUsage();
+          throw Exception("too many image file names");
+        }
+        cfg.inFileName = argv[i];
+        continue;
+      }
+      std::string s(argv[i]);
+      if (s == "--") {
+        endOfOptions = true;
+      }
+      else if (s == "-h" || s == "-help" || s == "--help") {
+        printUsage();
+        return 0;
+      }
+      else if (s == "-o") {
+        if (++i >= argc)
+          throw Exception("missing argument for -o");
+        cfg.outFileName = argv[i];
+      }
+      else if (s == "-s") {
+        if (++i >= argc)
+          throw Exception("missing argument for -s");
+        cfg.firstSegment = int(parseHexArgument(argv[i], 0xFFU));
+      }
+      else if (s == "-a") {
+        if (++i >= argc)
+          throw Exception("missing argument for -a");
+        cfg.cpuBaseAddr = parseHexArgument(argv[i], 0xFFFFU);
+        if ((cfg.cpuBaseAddr & 0x3FFFU) != 0U)
+          throw Exception("CPU address must be a multiple of 4000h");
+      }
+      else if (s == "-e") {
+        if (++i >= argc)
+          throw Exception("missing argument for -e");
+        std::string tmp(argv[i]);
+        size_t  n = tmp.find(':');
+        if (n == std::string::npos) {
+          cfg.entryPoints.push_back(parseHexArgument(argv[i], 0xFFFFU));
+        }
+        else {
+          // segment:address, stored with bit 24 set so that segment 0
+          // differs from a plain CPU address
+          uint32_t  segment =
+              parseHexArgument(tmp.substr(0, n).c_str(), 0xFFU);
+          uint32_t  addr =
+              parseHexArgument(tmp.substr(n + 1).c_str(), 0xFFFFU);
+          cfg.entryPoints.push_back(((segment | 0x100U) << 16) | addr);
+        }
+      }
+      else if (s == "-y" || s == "-ys") {
+        int     segment = -1;
+        if (s == "-ys") {
+          if (++i >= argc)
+            throw Exception("missing argument for -ys");
+          segment = int(parseHexArgument(argv[i], 0xFFU));
+        }
+        if (++i >= argc)
+          throw Exception("missing symbol file name");
+        std::FILE *f = std::fopen(argv[i], "rb");
+        if (!f)
+          throw Exception("error opening symbol file");
+        try {
+          cfg.symbols.loadFile(f, segment);
+        }
+        catch (...) {
+          std::fclose(f);
+          throw;
+        }
+        std::fclose(f);
+      }
+      else if (s == "-j") {
+        if (++i >= argc)
+          throw Exception("missing argument for -j");
+        char    *endp = (char *) 0;
+        long    n = std::strtol(argv[i], &endp, 10);
+        if (!endp || *endp != '\0' || n < 1L || n > 64L)
+          throw Exception("invalid number of threads");
+        cfg.nThreads = int(n);
+      }
+      else {
+        printUsage();
+        throw Exception("invalid option");
+      }
+    }
+    if (cfg.inFileName.empty()) {
+      printUsage();
+      return 0;
+    }
+    if (cfg.nThreads < 1)
+      cfg.nThreads = Ep128Emu::getProcessorCount();
+    inFile = std::fopen(cfg.inFileName.c_str(), "rb");
+    if (!inFile)
+      throw Exception("error opening image file");
+    if (!cfg.outFileName.empty()) {
+      outFile = std::fopen(cfg.outFileName.c_str(), "w");
+      if (!outFile)
+        throw Exception("error opening output file");
+    }
+    disassembleImage(cfg, inFile, (outFile ? outFile : stdout));
+    std::fclose(inFile);
+    inFile = (std::FILE *) 0;
+    if (outFile) {
+      int     err = std::fclose(outFile);
+      outFile = (std::FILE *) 0;
+      if (err != 0)
+        throw Exception("error writing output file - is the disk full ?");
+    }
+  }
+  catch (std::exception& e) {
+    if (inFile)
+      std::fclose(inFile);
+    if (outFile)
+      std::fclose(outFile);
+    std::fprintf(stderr, " *** romdis: %s\n", e.what());
+    return -1;
+  }
+  return 0;
+}
+
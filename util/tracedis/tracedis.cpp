@@ -0,0 +1,412 @@
+
+// ep128emu -- portable Enterprise 128 emulator
+// Copyright (C) 2003-2017 Istvan Varga <istvanv@users.sourceforge.net>
+// https://sourceforge.net/projects/ep128emu/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// command line tool for disassembling and filtering binary execution traces
+// recorded by the emulator (see src/trace.hpp for the file format)
+
+#include "ep128emu.hpp"
+#include "debuglib.hpp"
+#include "trace.hpp"
+#include "symtab.hpp"
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using Ep128Emu::Exception;
+using Ep128Emu::TraceRecorder;
+
+struct TraceDisParameters {
+  std::string inFileName;
+  std::string outFileName;
+  uint32_t  startAddr;
+  uint32_t  endAddr;
+  int       segment;                    // -1: any segment
+  uint64_t  maxInsns;                   // 0: no limit
+  bool      printMemoryAccesses;
+  bool      printIOAccesses;
+  bool      profileMode;
+  Ep128Emu::SymbolTable symbols;
+  // --------
+  TraceDisParameters()
+    : startAddr(0x0000U),
+      endAddr(0xFFFFU),
+      segment(-1),
+      maxInsns(0U),
+      printMemoryAccesses(false),
+      printIOAccesses(false),
+      profileMode(false)
+  {
+  }
+};
+
+static char * printUInt64(char *bufp, uint64_t n, size_t fieldWidth)
+{
+  char    tmpBuf[24];
+  size_t  len = 0;
+  do {
+    tmpBuf[len++] = char('0' + int(n % 10U));
+    n = n / 10U;
+  } while (n);
+  while (fieldWidth > len) {
+    *(bufp++) = ' ';
+    fieldWidth--;
+  }
+  while (len > 0)
+    *(bufp++) = tmpBuf[--len];
+  *bufp = '\0';
+  return bufp;
+}
+
+static void printUsage()
+{
+  std::printf("Usage:\n");
+  std::printf("    tracedis [OPTIONS...] <TRACEFILE>\n");
+  std::printf("        disassemble a binary execution trace written by "
+              "the emulator\n");
+  std::printf("Options:\n");
+  std::printf("    -o <FILE>\n"
+              "        write output to FILE instead of the standard "
+              "output\n");
+  std::printf("    -a <START> <END>\n"
+              "        print only instructions in the CPU address range "
+              "START to END\n"
+              "        (hexadecimal, inclusive)\n");
+  std::printf("    -s <SEGMENT>\n"
+              "        print only instructions in the specified segment "
+              "(hexadecimal)\n");
+  std::printf("    -n <N>\n"
+              "        stop after printing N instructions\n");
+  std::printf("    -m\n"
+              "        print the memory accesses of each instruction\n");
+  std::printf("    -io\n"
+              "        print the I/O port accesses of each instruction\n");
+  std::printf("    -p\n"
+              "        instead of the disassembly, print the number of "
+              "times each\n"
+              "        instruction was executed, in decreasing order\n");
+  std::printf("    -y <FILE>\n"
+              "        load symbol definitions from FILE (e.g. a pasmo or "
+              "sjasm symbol\n"
+              "        file), and print labels and symbol names in the "
+              "disassembly\n");
+  std::printf("    -ys <SEGMENT> <FILE>\n"
+              "        same as -y, but 16-bit symbol values are offsets into "
+              "SEGMENT\n"
+              "        (hexadecimal)\n");
+}
+
+static uint32_t parseHexArgument(const char *s, uint32_t maxValue)
+{
+  uint32_t  n = 0U;
+  if (!Ep128Emu::parseHexNumber(n, s) || n > maxValue)
+    throw Exception("invalid hexadecimal argument");
+  return n;
+}
+
+static void readTraceHeader(std::FILE *f, uint32_t& clockFreq)
+{
+  uint8_t tmpBuf[TraceRecorder::headerSize];
+  if (std::fread(&(tmpBuf[0]), 1, TraceRecorder::headerSize, f)
+      != TraceRecorder::headerSize) {
+    throw Exception("error reading trace file header");
+  }
+  const char  *magic = "EPTRACE";
+  for (size_t i = 0; i < 8; i++) {
+    if (tmpBuf[i] != uint8_t(magic[i]))
+      throw Exception("invalid trace file header");
+  }
+  uint32_t  version = 0U;
+  clockFreq = 0U;
+  for (size_t i = 4; i > 0; i--) {
+    version = (version << 8) | uint32_t(tmpBuf[i + 7]);
+    clockFreq = (clockFreq << 8) | uint32_t(tmpBuf[i + 11]);
+  }
+  if (version != TraceRecorder::formatVersion)
+    throw Exception("unsupported trace file version");
+}
+
+static void printProfile(std::FILE *outFile,
+                         const std::map< uint32_t, uint64_t >& insnCounts,
+                         const std::map< uint32_t, uint32_t >& opcodes,
+                         const Ep128Emu::SymbolTable& symbols)
+{
+  std::vector< std::pair< uint64_t, uint32_t > >  tmp;
+  tmp.reserve(insnCounts.size());
+  for (std::map< uint32_t, uint64_t >::const_iterator i = insnCounts.begin();
+       i != insnCounts.end(); i++) {
+    tmp.push_back(std::pair< uint64_t, uint32_t >(i->second, i->first));
+  }
+  std::sort(tmp.begin(), tmp.end());
+  std::string disasmBuf;
+  char    lineBuf[96];
+  for (size_t i = tmp.size(); i > 0; i--) {
+    uint32_t  addr = tmp[i - 1].second;
+    uint8_t   opcodeBuf[4];
+    uint32_t  opcode = opcodes.find(addr)->second;
+    for (int j = 0; j < 4; j++)
+      opcodeBuf[j] = uint8_t((opcode >> (j * 8)) & 0xFFU);
+    Ep128::Z80Disassembler::disassembleInstruction(
+        disasmBuf, &(opcodeBuf[0]), addr & 0xFFFFU, true, 0,
+        &symbols, int(addr >> 16));
+    char    *bufp = printUInt64(&(lineBuf[0]), tmp[i - 1].first, 12);
+    bufp = Ep128Emu::printHexNumber(bufp, addr >> 16, 2, 2, 0);
+    *(bufp++) = ':';
+    *bufp = '\0';
+    std::fprintf(outFile, "%s%s\n", &(lineBuf[0]), disasmBuf.c_str() + 2);
+  }
+}
+
+static void processTraceFile(const TraceDisParameters& cfg,
+                             std::FILE *inFile, std::FILE *outFile)
+{
+  uint32_t  clockFreq = 0U;
+  readTraceHeader(inFile, clockFreq);
+  if (!cfg.profileMode)
+    std::fprintf(outFile, "; clock frequency: %lu Hz\n",
+                 (unsigned long) clockFreq);
+  std::vector< uint8_t >  buf(size_t(TraceRecorder::recordSize) * 65536);
+  std::map< uint32_t, uint64_t >  insnCounts;
+  std::map< uint32_t, uint32_t >  opcodes;
+  std::string disasmBuf;
+  char      lineBuf[96];
+  uint64_t  insnCnt = 0U;
+  bool      insnSelected = false;
+  bool      doneFlag = false;
+  while (!doneFlag) {
+    size_t  nRecords = std::fread(&(buf.front()),
+                                  TraceRecorder::recordSize, 65536, inFile);
+    if (nRecords < 1)
+      break;
+    for (size_t i = 0; i < nRecords; i++) {
+      const uint8_t *p = &(buf[i * TraceRecorder::recordSize]);
+      uint8_t   recordType = p[0];
+      uint8_t   segment = p[1];
+      uint32_t  addr = uint32_t(p[2]) | (uint32_t(p[3]) << 8);
+      uint64_t  t = 0U;
+      for (int j = 15; j >= 8; j--)
+        t = (t << 8) | uint64_t(p[j]);
+      if (recordType == TraceRecorder::recordTypeInstruction) {
+        insnSelected = (addr >= cfg.startAddr && addr <= cfg.endAddr &&
+                        (cfg.segment < 0 || int(segment) == cfg.segment));
+        if (!insnSelected)
+          continue;
+        if (cfg.maxInsns > 0U && insnCnt >= cfg.maxInsns) {
+          doneFlag = true;
+          break;
+        }
+        insnCnt++;
+        if (cfg.profileMode) {
+          uint32_t  n = (uint32_t(segment) << 16) | addr;
+          insnCounts[n]++;
+          opcodes[n] = uint32_t(p[4]) | (uint32_t(p[5]) << 8)
+                       | (uint32_t(p[6]) << 16) | (uint32_t(p[7]) << 24);
+          continue;
+        }
+        uint32_t  physAddr = (uint32_t(segment) << 14) | (addr & 0x3FFFU);
+        if (!cfg.symbols.empty()) {
+          uint32_t    symOffs = 0U;
+          const char  *name =
+              cfg.symbols.findMemorySymbol(symOffs, physAddr, addr);
+          if (name)
+            std::fprintf(outFile, "%s:\n", name);
+        }
+        Ep128::Z80Disassembler::disassembleInstruction(
+            disasmBuf, &(p[4]), addr, true, 0, &cfg.symbols, int(segment));
+        char    *bufp = printUInt64(&(lineBuf[0]), t, 12);
+        bufp = Ep128Emu::printHexNumber(bufp, segment, 2, 2, 0);
+        *(bufp++) = ':';
+        *bufp = '\0';
+        std::fprintf(outFile, "%s%s\n", &(lineBuf[0]), disasmBuf.c_str() + 2);
+        continue;
+      }
+      if (!insnSelected || cfg.profileMode)
+        continue;
+      const char  *accessType = (const char *) 0;
+      switch (recordType) {
+      case TraceRecorder::recordTypeMemoryRead:
+        if (cfg.printMemoryAccesses)
+          accessType = "RD";
+        break;
+      case TraceRecorder::recordTypeMemoryWrite:
+        if (cfg.printMemoryAccesses)
+          accessType = "WR";
+        break;
+      case TraceRecorder::recordTypeIORead:
+        if (cfg.printIOAccesses)
+          accessType = "IN";
+        break;
+      case TraceRecorder::recordTypeIOWrite:
+        if (cfg.printIOAccesses)
+          accessType = "OUT";
+        break;
+      }
+      if (!accessType)
+        continue;
+      char    *bufp = printUInt64(&(lineBuf[0]), t, 12);
+      bufp = bufp + std::sprintf(bufp, "     ; %-3s ", accessType);
+      if (recordType < TraceRecorder::recordTypeIORead) {
+        bufp = Ep128Emu::printHexNumber(bufp, segment, 0, 2, 0);
+        *(bufp++) = ':';
+      }
+      bufp = Ep128Emu::printHexNumber(bufp, addr, 0, 4, 0);
+      *(bufp++) = ' ';
+      *(bufp++) = '=';
+      bufp = Ep128Emu::printHexNumber(bufp, p[4], 1, 2, 0);
+      *bufp = '\0';
+      if (recordType < TraceRecorder::recordTypeIORead &&
+          !cfg.symbols.empty()) {
+        uint32_t    symOffs = 0U;
+        const char  *name = cfg.symbols.findMemorySymbol(
+                                symOffs,
+                                (uint32_t(segment) << 14) | (addr & 0x3FFFU),
+                                addr, 0xFFU);
+        if (name) {
+          bufp = bufp + std::sprintf(bufp, "  ; %.40s", name);
+          if (symOffs)
+            bufp = bufp + std::sprintf(bufp, "+%02X", (unsigned int) symOffs);
+        }
+      }
+      std::fprintf(outFile, "%s\n", &(lineBuf[0]));
+    }
+    if (nRecords < 65536)
+      break;
+  }
+  if (cfg.profileMode)
+    printProfile(outFile, insnCounts, opcodes, cfg.symbols);
+}
+
+int main(int argc, char **argv)
+{
+  TraceDisParameters  cfg;
+  std::FILE *inFile = (std::FILE *) 0;
+  std::FILE *outFile = (std::FILE *) 0;
+  try {
+    bool    endOfOptions = false;
+    for (int i = 1; i < argc; i++) {
+      if (argv[i] == (char *) 0 || argv[i][0] == '\0')
+        continue;
+      if (endOfOptions || argv[i][0] != '-') {
+        if (!cfg.inFileName.empty()) {
+          printUsage();
+          throw Exception("too many trace file names");
+        }
+        cfg.inFileName = argv[i];
+        continue;
+      }
+      std::string s(argv[i]);
+      if (s == "--") {
+        endOfOptions = true;
+      }
+      else if (s == "-h" || s == "-help" || s == "--help") {
+        printUsage();
+        return 0;
+      }
+      else if (s == "-o") {
+        if (++i >= argc)
+          throw Exception("missing argument for -o");
+        cfg.outFileName = argv[i];
+      }
+      else if (s == "-a") {
+        if ((i + 2) >= argc)
+          throw Exception("missing argument for -a");
+        cfg.startAddr = parseHexArgument(argv[++i], 0xFFFFU);
+        cfg.endAddr = parseHexArgument(argv[++i], 0xFFFFU);
+      }
+      else if (s == "-s") {
+        if (++i >= argc)
+          throw Exception("missing argument for -s");
+        cfg.segment = int(parseHexArgument(argv[i], 0xFFU));
+      }
+      else if (s == "-n") {
+        if (++i >= argc)
+          throw Exception("missing argument for -n");
+        char    *endp = (char *) 0;
+        double  n = std::strtod(argv[i], &endp);
+        if (!endp || *endp != '\0' || !(n >= 1.0 && n < 1.0e18))
+          throw Exception("invalid instruction count");
+        cfg.maxInsns = uint64_t(n);
+      }
+      else if (s == "-m") {
+        cfg.printMemoryAccesses = true;
+      }
+      else if (s == "-io") {
+        cfg.printIOAccesses = true;
+      }
+      else if (s == "-p") {
+        cfg.profileMode = true;
+      }
+      else if (s == "-y" || s == "-ys") {
+        int     segment = -1;
+        if (s == "-ys") {
+          if (++i >= argc)
+            throw Exception("missing argument for -ys");
+          segment = int(parseHexArgument(argv[i], 0xFFU));
+        }
+        if (++i >= argc)
+          throw Exception("missing symbol file name");
+        std::FILE *f = std::fopen(argv[i], "rb");
+        if (!f)
+          throw Exception("error opening symbol file");
+        try {
+          cfg.symbols.loadFile(f, segment);
+        }
+        catch (...) {
+          std::fclose(f);
+          throw;
+        }
+        std::fclose(f);
+      }
+      else {
+        printUsage();
+        throw Exception((std::string("invalid option: ") + s).c_str());
+      }
+    }
+    if (cfg.inFileName.empty()) {
+      printUsage();
+      return 0;
+    }
+    inFile = std::fopen(cfg.inFileName.c_str(), "rb");
+    if (!inFile)
+      throw Exception("error opening trace file");
+    if (!cfg.outFileName.empty()) {
+      outFile = std::fopen(cfg.outFileName.c_str(), "w");
+      if (!outFile)
+        throw Exception("error opening output file");
+    }
+    processTraceFile(cfg, inFile, (outFile ? outFile : stdout));
+    std::fclose(inFile);
+    inFile = (std::FILE *) 0;
+    if (outFile) {
+      int     err = std::fclose(outFile);
+      outFile = (std::FILE *) 0;
+      if (err != 0)
+        throw Exception("error writing output file - is the disk full ?");
+    }
+  }
+  catch (std::exception& e) {
+    if (inFile)
+      std::fclose(inFile);
+    if (outFile)
+      std::fclose(outFile);
+    std::fprintf(stderr, " *** tracedis: %s\n", e.what());
+    return -1;
+  }
+  return 0;
+}